@@ -30,12 +30,16 @@
 #include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
 #include "halo/lib/target/triton/triton_config_writer.h"
 #include "halo/lib/transforms/caffeextension_legalizer.h"
+#include "halo/lib/transforms/constant_folding.h"
+#include "halo/lib/transforms/cse.h"
 #include "halo/lib/transforms/dce.h"
 #include "halo/lib/transforms/device_placement.h"
 #include "halo/lib/transforms/fusion.h"
 #include "halo/lib/transforms/input_legalizer.h"
 #include "halo/lib/transforms/input_rewriter.h"
 #include "halo/lib/transforms/inst_simplify.h"
+#include "halo/lib/transforms/layout_assignment.h"
+#include "halo/lib/transforms/memory_scheduling.h"
 #include "halo/lib/transforms/onnxextension_legalizer.h"
 #include "halo/lib/transforms/output_rewriter.h"
 #include "halo/lib/transforms/reorder_channel.h"
@@ -63,6 +67,26 @@ static llvm::cl::opt<std::string> Target(
 static llvm::cl::opt<std::string> Processor("processor",
                                             llvm::cl::desc("processor name"),
                                             llvm::cl::init("native"));
+static llvm::cl::opt<std::string> TargetFeatures(
+    "mattr",
+    llvm::cl::desc("Target features added to those of the processor (e.g. "
+                   "+avx2,-avx512f). The host features are used for the "
+                   "native processor"),
+    llvm::cl::init(""));
+static llvm::cl::opt<bool> FatBinary(
+    "fat-binary",
+    llvm::cl::desc("Emit SSE4.2, AVX2 and AVX-512 variants of the functions "
+                   "with a CPU dispatcher (x86 only). Native processor "
+                   "defaults to baseline x86-64"),
+    llvm::cl::init(false));
+static llvm::cl::opt<int> CodeGenThreads(
+    "codegen-threads",
+    llvm::cl::desc("Number of threads to emit object code. With more than one "
+                   "thread, the functions are compiled in partitions and the "
+                   "output file is a GNU archive of them instead of a single "
+                   "object file; it is linked the same way (0: all hardware "
+                   "threads)"),
+    llvm::cl::init(1));
 static llvm::cl::opt<std::string> OutputFile(
     "o", llvm::cl::desc("output file name."), llvm::cl::Required);
 static llvm::cl::opt<Parser::Format> ModelFormat(
@@ -129,6 +153,27 @@ static llvm::cl::opt<int> Batch(
     llvm::cl::desc("Specify batch size if the first dim of input is negative"),
     llvm::cl::init(1));
 
+static llvm::cl::opt<bool> DisableWinograd(
+    "disable-winograd",
+    llvm::cl::desc("Disable Winograd convolution for 3x3 kernels"),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<bool> DisableParallelLoops(
+    "disable-parallel-loops",
+    llvm::cl::desc("Run the loops generated inline on a single thread"),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<unsigned> MaxFoldedConstantSize(
+    "max-folded-constant-size",
+    llvm::cl::desc("Largest constant (in KB) created by constant folding "
+                   "unless it replaces larger operands"),
+    llvm::cl::init(ConstantFolding::kDefaultMaxSizeInBytes / 1024));
+
+static llvm::cl::opt<bool> EnableMemoryScheduling(
+    "enable-mem-scheduling",
+    llvm::cl::desc("Reorder instructions to reduce the peak memory usage"),
+    llvm::cl::init(false));
+
 static llvm::cl::opt<bool> EnableBF16("enable-bf16",
                                       llvm::cl::desc("Enable BF16"),
                                       llvm::cl::init(false));
@@ -217,6 +262,8 @@ static void PopulateCodeGenPasses(PassManager* pm, std::ostream* out_code,
   }
 
   CodeGen* cg = nullptr;
+  GenericLLVMIRCodeGen* llvm_cg = nullptr;
+  GenericConstantWriter* llvm_constant_writer = nullptr;
   if (is_c_or_cxx_output) {
     Opts opts(EnableBF16 ? true : false);
     if (llvm::StringRef(Target).startswith_lower("cc")) {
@@ -245,46 +292,52 @@ static void PopulateCodeGenPasses(PassManager* pm, std::ostream* out_code,
 
   if (EmitLLVMIR) {
     cg = pm->AddPass<GenericLLVMIRCodeGen>(constant_storage);
+    llvm_cg = static_cast<GenericLLVMIRCodeGen*>(cg);
     pm->AddPass<GenericLLVMIRWriter>(std::ref(*out_code), is_binary_output);
     if (SeparateConstants && !EmitCodeOnly) {
-      pm->AddPass<GenericConstantWriter>(std::ref(*out_constants),
-                                         is_binary_output);
+      llvm_constant_writer = pm->AddPass<GenericConstantWriter>(
+          std::ref(*out_constants), is_binary_output);
     }
   } else {
     llvm::Triple triple(Target);
     switch (triple.getArch()) {
       case llvm::Triple::ArchType::x86:
       case llvm::Triple::ArchType::x86_64: {
-        pm->AddPass<X86LLVMIRCodeGen>(
+        auto x86_cg = pm->AddPass<X86LLVMIRCodeGen>(
             GenericLLVMIRCodeGen::ConstantDataStorage::DeclaredAsExternal);
+        x86_cg->SetFatBinary(FatBinary);
+        llvm_cg = x86_cg;
         pm->AddPass<X86BinaryWriter>(std::ref(*out_code));
         if (SeparateConstants && !EmitCodeOnly) {
-          pm->AddPass<X86ConstantWriter>(std::ref(*out_constants));
+          llvm_constant_writer =
+              pm->AddPass<X86ConstantWriter>(std::ref(*out_constants));
         }
         break;
       }
       case llvm::Triple::ArchType::aarch64: {
-        pm->AddPass<ARMLLVMIRCodeGen>(
+        llvm_cg = pm->AddPass<ARMLLVMIRCodeGen>(
             GenericLLVMIRCodeGen::ConstantDataStorage::DeclaredAsExternal);
         pm->AddPass<ARMBinaryWriter>(std::ref(*out_code));
         if (SeparateConstants && !EmitCodeOnly) {
-          pm->AddPass<ARMConstantWriter>(std::ref(*out_constants));
+          llvm_constant_writer =
+              pm->AddPass<ARMConstantWriter>(std::ref(*out_constants));
         }
         break;
       }
       case llvm::Triple::ArchType::riscv32:
       case llvm::Triple::ArchType::riscv64: {
         if (RISCVOpt) {
-          pm->AddPass<RISCVLLVMIRCodeGen>(
+          llvm_cg = pm->AddPass<RISCVLLVMIRCodeGen>(
               GenericLLVMIRCodeGen::ConstantDataStorage::DeclaredAsExternal,
               "libRT_RISCV.a");
         } else {
-          pm->AddPass<RISCVLLVMIRCodeGen>(
+          llvm_cg = pm->AddPass<RISCVLLVMIRCodeGen>(
               GenericLLVMIRCodeGen::ConstantDataStorage::DeclaredAsExternal);
         }
         pm->AddPass<RISCVBinaryWriter>(std::ref(*out_code));
         if (SeparateConstants && !EmitCodeOnly) {
-          pm->AddPass<RISCVConstantWriter>(std::ref(*out_constants));
+          llvm_constant_writer =
+              pm->AddPass<RISCVConstantWriter>(std::ref(*out_constants));
         }
 
         break;
@@ -298,6 +351,15 @@ static void PopulateCodeGenPasses(PassManager* pm, std::ostream* out_code,
   if (cg != nullptr) {
     cg->SetAPI(Api);
   }
+  if (llvm_cg != nullptr) {
+    llvm_cg->SetWinogradEnabled(!DisableWinograd);
+    llvm_cg->SetParallelLoopsEnabled(!DisableParallelLoops);
+    llvm_cg->SetPrintMemStats(PrintMemStats);
+  }
+  if (llvm_constant_writer != nullptr) {
+    // Leaves out the kernels the code generator transforms for Winograd.
+    llvm_constant_writer->SetWinogradEnabled(!DisableWinograd);
+  }
 }
 
 static void PopulatePasses(PassManager* pm, std::ostream* out_code,
@@ -324,6 +386,12 @@ static void PopulatePasses(PassManager* pm, std::ostream* out_code,
     std::vector<std::string> inputs(Inputs.begin(), Inputs.end());
     pm->AddPass<InputRewriter>(inputs);
   }
+  // Duplicated subgraphs are merged before they are folded or compiled.
+  pm->AddPass<CSE>();
+  // Shapes computed from folded constants are legalized again.
+  pm->AddPass<ConstantFolding>(MaxFoldedConstantSize.getValue() * 1024);
+  pm->AddPass<TypeLegalizer>(true);
+  pm->AddPass<DCE>();
 
   pm->AddPass<InstSimplify>(
       llvm::StringRef(Target).startswith("cxx"), DisableBroadcasting.getValue(),
@@ -332,7 +400,23 @@ static void PopulatePasses(PassManager* pm, std::ostream* out_code,
     pm->AddPass<ReorderChannel>(ReorderChannelLayout ==
                                 ReorderChannel::ChannelOrder::ChannelFirst);
   }
-  pm->AddPass<Fusion>(GetFusionOptions());
+  // Removes the transposes around layout sensitive ops where possible.
+  pm->AddPass<TypeLegalizer>(true);
+  pm->AddPass<LayoutAssignment>();
+  pm->AddPass<DCE>();
+  Fusion::Options fusion_opts = GetFusionOptions();
+  if (is_c_or_cxx_output) {
+    // The C/C++ (ODLA) codegen has no lowering for fused GELU or for fused
+    // elementwise loops.
+    fusion_opts.MatmulBiasGelu = false;
+    fusion_opts.AddRelu = false;
+    fusion_opts.ElementwiseChain = false;
+  }
+  pm->AddPass<Fusion>(fusion_opts);
+  pm->AddPass<DCE>();
+  if (EnableMemoryScheduling) {
+    pm->AddPass<MemoryScheduling>(PrintMemStats.getValue());
+  }
   if (SplitFunction) {
     pm->AddPass<Splitting>();
     pm->AddPass<DevicePlacement>();
@@ -440,7 +524,15 @@ int main(int argc, char** argv) {
   GlobalContext ctx;
   ctx.SetBasePath(argv[0]);
   ctx.SetTargetTriple(Target);
-  ctx.SetProcessorName(Processor);
+  if (FatBinary && Processor == "native") {
+    // The variants are selected at runtime; the fallback code must run on any
+    // x86-64 CPU.
+    ctx.SetProcessorName("x86-64");
+  } else {
+    ctx.SetProcessorName(Processor);
+  }
+  ctx.SetTargetFeatures(TargetFeatures);
+  ctx.SetNumOfCodeGenThreads(CodeGenThreads);
 
   Module m(ctx, ModuleName);
 
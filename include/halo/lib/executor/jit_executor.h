@@ -0,0 +1,75 @@
+//===- jit_executor.h -------------------------------------------*- C++ -*-===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HALO_LIB_EXECUTOR_JIT_EXECUTOR_H_
+#define HALO_LIB_EXECUTOR_JIT_EXECUTOR_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "halo/api/halo_data.h"
+
+namespace halo {
+
+class Module;
+struct JITModule;
+
+/// This class compiles a Halo module for the host CPU in process and runs its
+/// functions. The module is lowered by GenericLLVMIRCodeGen, which links the
+/// libRT_GENERIC bitcode found from the base path of the global context, then
+/// optimized at O3 and compiled by the ORC JIT. Compiled code is cached by
+/// the hash of the LLVM bitcode, so compiling a module identical to an
+/// earlier one, e.g. from another executor, reuses its code. Concurrent
+/// compilations of the same module compile it once.
+class JITExecutor final {
+ public:
+  JITExecutor();
+  ~JITExecutor();
+
+  JITExecutor(const JITExecutor&) = delete;
+  JITExecutor& operator=(const JITExecutor&) = delete;
+
+  /// Compiles `module`, which is expected to be legalized (e.g. by the
+  /// TypeLegalizer), replacing any module compiled before.
+  Status Compile(Module* module);
+
+  /// Runs function `func_name` of the compiled module, or its first function
+  /// if empty. `inputs` holds one dense buffer per function argument and
+  /// `outputs` one per returned value, in order.
+  /// The compiled functions are not reentrant: they keep intermediate results
+  /// in static memory. Concurrent calls, including from executors sharing the
+  /// cached code, are serialized.
+  Status Run(const std::vector<const void*>& inputs,
+             const std::vector<void*>& outputs,
+             const std::string& func_name = "");
+
+  /// Returns true if the last Compile() reused cached code.
+  bool IsCacheHit() const noexcept { return cache_hit_; }
+
+  /// Drops the cached code not used by any executor.
+  static void ClearCache();
+
+ private:
+  std::shared_ptr<JITModule> compiled_;
+  std::string default_func_;
+  bool cache_hit_ = false;
+};
+
+} // namespace halo
+
+#endif // HALO_LIB_EXECUTOR_JIT_EXECUTOR_H_
@@ -57,6 +57,15 @@ class GlobalContext {
   const std::string& GetProcessorName() const noexcept;
   void SetProcessorName(const std::string& processor) noexcept;
 
+  /// Target features ("+avx2,-avx512f") added to those of the processor.
+  const std::string& GetTargetFeatures() const noexcept;
+  void SetTargetFeatures(const std::string& features) noexcept;
+
+  /// Number of threads used to emit object code. 0 selects the number of
+  /// hardware threads.
+  int GetNumOfCodeGenThreads() const noexcept;
+  void SetNumOfCodeGenThreads(int num_threads) noexcept;
+
   /// Set the path of toolchain  so it can locate other components like runtime
   /// library. If a file path is given, it assumes the file is under
   /// `base_path`/bin/file and thus computes the `base_path`.
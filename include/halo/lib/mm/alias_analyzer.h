@@ -0,0 +1,64 @@
+//===- alias_analyzer.h -----------------------------------------*- C++ -*-===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HALO_LIB_MM_ALIAS_ANALYZER_H_
+#define HALO_LIB_MM_ALIAS_ANALYZER_H_
+
+#include <unordered_map>
+
+#include "halo/lib/ir/function.h"
+#include "halo/lib/ir/instruction.h"
+
+namespace halo {
+
+/// This class finds the results that can share the storage of an operand
+/// instead of getting a buffer of their own:
+///  - views (reshapes and slices of a contiguous range) always share the
+///    storage of their input;
+///  - elementwise instructions may write their result over an operand of the
+///    same type (in-place execution) if that storage is not read afterwards.
+/// Values sharing storage form a group whose root is the value that owns it.
+class AliasAnalyzer {
+ public:
+  /// In-place execution is only considered if `in_place` is true.
+  explicit AliasAnalyzer(const Function& func, bool in_place = true);
+
+  virtual ~AliasAnalyzer() = default;
+
+  /// Returns the operand whose storage is shared by `def`, or an undefined
+  /// Def if `def` needs a buffer of its own.
+  Def GetAliasee(const Def& def) const;
+  /// Returns the value that owns the storage of `def`.
+  Def GetRoot(const Def& def) const;
+
+  /// Returns true if the result of `inst` is a view of its first operand. The
+  /// position of the view in the operand, in elements, is returned through
+  /// `offset`.
+  static bool IsView(const Instruction& inst, int64_t* offset = nullptr);
+  /// Returns true if the result of `op` can be written over the operands of
+  /// the same type, i.e. the i-th result element only depends on the i-th
+  /// element of these operands.
+  static bool IsElementwise(OpCode op);
+
+ private:
+  std::unordered_map<Def, Def> aliasees_;
+  std::unordered_map<Def, Def> roots_;
+};
+
+} // namespace halo
+
+#endif // HALO_LIB_MM_ALIAS_ANALYZER_H_
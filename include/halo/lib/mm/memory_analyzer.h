@@ -26,7 +26,8 @@
 
 namespace halo {
 
-/// This class analyzes the memory usage of a module.
+/// This class analyzes the memory usage of a module. Views (see AliasAnalyzer)
+/// take no memory and keep the value they are a view of alive.
 class MemoryAnalyzer {
  public:
   explicit MemoryAnalyzer(const Module& m);
@@ -53,6 +54,10 @@ class MemoryAnalyzer {
   const GlobalContext& ctx_;
   std::unordered_map<uint64_t, int> use_cnts_;
   std::unordered_map<uint64_t, int> curr_use_cnts_;
+  // Maps views to the value owning their storage.
+  std::unordered_map<uint64_t, Def> roots_;
+  // Views of the values owning storage.
+  std::unordered_map<uint64_t, std::vector<Def>> views_;
 
   size_t weights_;
   size_t non_weights_;
@@ -0,0 +1,93 @@
+//===- memory_planner.h -----------------------------------------*- C++ -*-===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HALO_LIB_MM_MEMORY_PLANNER_H_
+#define HALO_LIB_MM_MEMORY_PLANNER_H_
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "halo/lib/ir/function.h"
+#include "halo/lib/ir/instruction.h"
+
+namespace halo {
+
+/// This class statically places the activations of a function into a single
+/// arena. The live interval of a value spans from its defining instruction to
+/// its last reader. Values are placed in decreasing order of size, each one
+/// into the smallest gap left by the already placed values whose intervals
+/// overlap with it (best fit), or on top of them if no gap is large enough.
+/// Views (see AliasAnalyzer) and the values listed as aliases do not own
+/// memory: they extend the interval of the value owning their storage, which
+/// may be defined after them (e.g. the result of a concatenation whose inputs
+/// are written in place).
+class MemoryPlanner {
+ public:
+  static constexpr size_t kDefaultAlignment = 64;
+
+  struct Buffer {
+    Def def;
+    size_t size;   // Size in bytes, rounded up to the alignment.
+    size_t offset; // Offset in bytes from the beginning of the arena.
+    int start;     // Index of the first instruction writing the value.
+    int end;       // Index of the last instruction that reads the value.
+  };
+
+  /// Returns true if the value should be placed in the arena.
+  using Filter = std::function<bool(const Def&)>;
+  /// Maps values to the value whose storage they reuse.
+  using Aliases = std::unordered_map<Def, Def>;
+
+  MemoryPlanner(const Function& func, const Filter& filter,
+                const Aliases& aliases = {},
+                size_t alignment = kDefaultAlignment);
+  /// Places all the instruction results of `func`.
+  explicit MemoryPlanner(const Function& func);
+
+  virtual ~MemoryPlanner() = default;
+
+  /// Returns the placement of `def`, or nullptr if it is not in the arena.
+  const Buffer* GetBuffer(const Def& def) const;
+  const std::vector<Buffer>& GetBuffers() const noexcept { return buffers_; }
+
+  /// Size of the arena.
+  size_t GetArenaSize() const noexcept { return arena_size_; }
+  /// Largest amount of memory simultaneously live, which is the lower bound of
+  /// the arena size.
+  size_t GetPeak() const noexcept { return peak_; }
+  /// Sum of the sizes of all the values, i.e. the memory needed without reuse.
+  size_t GetTotalSize() const noexcept { return total_size_; }
+
+ private:
+  void ComputeLiveIntervals(const Function& func, const Filter& filter,
+                            const Aliases& aliases);
+  void AssignOffsets();
+  void ComputePeak();
+
+  const size_t alignment_;
+  std::vector<Buffer> buffers_;
+  std::unordered_map<Def, size_t> indices_;
+  int num_of_insts_;
+  size_t arena_size_;
+  size_t peak_;
+  size_t total_size_;
+};
+
+} // namespace halo
+
+#endif // HALO_LIB_MM_MEMORY_PLANNER_H_
@@ -42,6 +42,10 @@ class Pass {
   virtual ~Pass() = default;
 
   virtual bool IsPassManager() const noexcept { return false; }
+  /// Returns true if running the pass again right after it changed the IR
+  /// would not change it any further. Pass managers then only rerun the pass
+  /// after some other pass has modified the IR.
+  virtual bool IsIdempotent() const noexcept { return false; }
   const std::string& Name() const noexcept { return name_; }
   virtual void Print(std::ostream& os) const { os << name_ << "\n"; }
 
@@ -56,16 +56,32 @@ class CodeGen : public ModulePass {
           {OpCode::MATMUL, "_sn_rt_matmul"},
           {OpCode::GEMM, "_sn_rt_gemm"},
           {OpCode::PAD, "_sn_rt_pad"},
+          {OpCode::POOLINGAVG, "_sn_rt_poolingavg"},
           {OpCode::POOLINGMAX, "_sn_rt_poolingmax"},
+          {OpCode::REDUCEMAX, "_sn_rt_reduce_max"},
           {OpCode::REDUCEMEAN, "_sn_rt_reduce_mean"},
+          {OpCode::REDUCEMIN, "_sn_rt_reduce_min"},
+          {OpCode::REDUCEPRODUCT, "_sn_rt_reduce_prod"},
+          {OpCode::REDUCESUM, "_sn_rt_reduce_sum"},
           {OpCode::SOFTMAX, "_sn_rt_softmax"},
           {OpCode::ADD, "_sn_rt_add"},
+          {OpCode::AND, "_sn_rt_and"},
+          {OpCode::CMP, "_sn_rt_cmp"},
+          {OpCode::MAXIMUM, "_sn_rt_maximum"},
+          {OpCode::MINIMUM, "_sn_rt_minimum"},
+          {OpCode::OR, "_sn_rt_or"},
+          {OpCode::POW, "_sn_rt_pow"},
+          {OpCode::SHIFTL, "_sn_rt_shiftl"},
+          {OpCode::SHIFTR, "_sn_rt_shiftr"},
           {OpCode::BATCHNORM, "_sn_rt_bn"},
           {OpCode::RELU, "_sn_rt_relu"},
+          {OpCode::SIGMOID, "_sn_rt_sigmoid"},
+          {OpCode::TANH, "_sn_rt_tanh"},
           {OpCode::SUB, "_sn_rt_sub"},
           {OpCode::MUL, "_sn_rt_mul"},
           {OpCode::DIV, "_sn_rt_div"},
           {OpCode::ERF, "_sn_rt_erf"},
+          {OpCode::EXP, "_sn_rt_exp"},
           {OpCode::FLOOR, "_sn_rt_floor"},
           {OpCode::RSQRT, "_sn_rt_rsqrt"},
           {OpCode::BATCHMATMUL, "_sn_rt_batch_matmul"},
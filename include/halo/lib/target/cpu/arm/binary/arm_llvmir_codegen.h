@@ -33,11 +33,13 @@ class ARMLLVMIRCodeGen final : public GenericLLVMIRCodeGen {
 };
 
 // The binary writer for ARM target.
-class ARMBinaryWriter final : public CodeWriter {
+class ARMBinaryWriter final : public GenericObjectWriter {
  public:
   explicit ARMBinaryWriter(std::ostream& os);
 
-  bool RunOnModule(Module* module) override;
+ protected:
+  std::unique_ptr<llvm::TargetMachine> CreateTargetMachine(
+      const GlobalContext& ctx) const override;
 };
 
 // The constant writer for ARM target.
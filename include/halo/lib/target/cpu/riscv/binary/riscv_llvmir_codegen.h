@@ -34,11 +34,13 @@ class RISCVLLVMIRCodeGen final : public GenericLLVMIRCodeGen {
 };
 
 // The binary writer for RISCV target.
-class RISCVBinaryWriter final : public CodeWriter {
+class RISCVBinaryWriter final : public GenericObjectWriter {
  public:
   explicit RISCVBinaryWriter(std::ostream& os);
 
-  bool RunOnModule(Module* module) override;
+ protected:
+  std::unique_ptr<llvm::TargetMachine> CreateTargetMachine(
+      const GlobalContext& ctx) const override;
 };
 
 // The constant writer for RISCV target.
@@ -28,16 +28,29 @@ class X86LLVMIRCodeGen final : public GenericLLVMIRCodeGen {
   X86LLVMIRCodeGen(ConstantDataStorage constant_data_storage);
   X86LLVMIRCodeGen();
 
+  /// Emits SSE4.2, AVX2 and AVX-512 variants of each exported function and
+  /// everything it calls, and turns the exported function into a dispatcher
+  /// selecting the variant for the running CPU. The original code is the
+  /// fallback, so the target machine should use a baseline processor.
+  void SetFatBinary(bool enabled) noexcept { fat_binary_ = enabled; }
+
  protected:
   virtual llvm::TargetMachine* InitTargetMachine() override;
+  void LinkRuntimeLib() override;
+
+ private:
+  void EmitISAVariants();
+  bool fat_binary_ = false;
 };
 
 // The binary writer for X86 target.
-class X86BinaryWriter final : public CodeWriter {
+class X86BinaryWriter final : public GenericObjectWriter {
  public:
   explicit X86BinaryWriter(std::ostream& os);
 
-  bool RunOnModule(Module* module) override;
+ protected:
+  std::unique_ptr<llvm::TargetMachine> CreateTargetMachine(
+      const GlobalContext& ctx) const override;
 };
 
 // The constant writer for X86 target.
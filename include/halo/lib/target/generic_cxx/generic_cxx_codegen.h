@@ -142,6 +142,10 @@ class GenericCXXCodeGen : public CodeGen {
   virtual void RunOnInstruction(TransposeInst*) override;
   virtual void RunOnBinaryInstruction(Instruction*);
   virtual void RunOnUnaryInstruction(Instruction*);
+  // Emits the activation fused into `inst` over its result `value` and
+  // returns the activated value.
+  CXXValue EmitFusedActivation(const Instruction& inst, const CXXValue& value,
+                               ActivationType activation, float alpha);
 
   virtual CXXValue AllocateBuffer(const Def& def, bool on_stack);
   std::string GetFunctionDecl(const Function& func, const Instruction& ret_inst,
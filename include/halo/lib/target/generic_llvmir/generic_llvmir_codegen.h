@@ -18,8 +18,11 @@
 #ifndef HALO_LIB_TARGET_GENERIC_LLVMIR_GENERIC_LLVMIR_CODEGEN_H_
 #define HALO_LIB_TARGET_GENERIC_LLVMIR_GENERIC_LLVMIR_CODEGEN_H_
 
+#include <functional>
 #include <memory>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "halo/lib/framework/global_context.h"
 #include "halo/lib/ir/common_instructions.h"
@@ -27,6 +30,7 @@
 #include "halo/lib/ir/instruction.h"
 #include "halo/lib/ir/nn_activation_instructions.h"
 #include "halo/lib/ir/nn_cnn_instructions.h"
+#include "halo/lib/mm/alias_analyzer.h"
 #include "halo/lib/target/codegen.h"
 
 // Forward declaration here to avoid the need of LLVM header files for API
@@ -37,6 +41,7 @@ class CallInst;
 class ConstantFolder;
 class Function;
 class FunctionCallee;
+class GlobalVariable;
 class IRBuilderDefaultInserter;
 template <typename T, typename Inserter>
 class IRBuilder;
@@ -71,6 +76,24 @@ class GenericLLVMIRCodeGen : public CodeGen {
 
   bool RunOnModule(Module* module) override;
 
+  /// Enables the Winograd F(4x4, 3x3) convolution path for qualified 3x3
+  /// convolutions. The kernels are transformed at compile time. Constant
+  /// writers, where it is off by default, then leave out the kernels only used
+  /// by Winograd convolutions, so it must match the code generator.
+  void SetWinogradEnabled(bool enabled) noexcept { enable_winograd_ = enabled; }
+
+  /// Prints the activation memory usage with and without the memory planner.
+  void SetPrintMemStats(bool enabled) noexcept { print_mem_stats_ = enabled; }
+
+  /// Runs large loop nests generated inline on the runtime thread pool.
+  void SetParallelLoopsEnabled(bool enabled) noexcept {
+    enable_parallel_loops_ = enabled;
+  }
+
+  /// Returns the features of the host CPU ("+avx2,-avx512f,...") followed by
+  /// `extra_features`, which take precedence.
+  static std::string GetHostCPUFeatures(const std::string& extra_features);
+
  protected:
   virtual void RunOnFunction(Function& function);
   virtual void RunOnConstant(Constant& constant);
@@ -80,11 +103,14 @@ class GenericLLVMIRCodeGen : public CodeGen {
   // file.
   virtual void RunOnInstruction(BatchMatMulInst*) override;
   virtual void RunOnInstruction(BatchNormInst*) override;
+  virtual void RunOnInstruction(ConcatInst*) override;
   virtual void RunOnInstruction(Conv2DInst*) override;
+  virtual void RunOnInstruction(FusedElementwiseInst*) override;
   virtual void RunOnInstruction(GatherInst*) override;
   virtual void RunOnInstruction(GemmInst*) override;
   virtual void RunOnInstruction(MatMulInst*) override;
   virtual void RunOnInstruction(PadInst*) override;
+  virtual void RunOnInstruction(PoolingAvgInst*) override;
   virtual void RunOnInstruction(PoolingMaxInst*) override;
   virtual void RunOnInstruction(OneHotInst*) override;
   virtual void RunOnInstruction(ReluInst*) override;
@@ -95,9 +121,21 @@ class GenericLLVMIRCodeGen : public CodeGen {
   virtual void RunOnInstruction(SoftmaxInst*) override;
   virtual void RunOnInstruction(TransposeInst*) override;
 
+  virtual void RunOnInstruction(ReduceMaxInst* inst) override {
+    RunOnCommonReductionInstruction(inst, inst->GetAxis());
+  }
   virtual void RunOnInstruction(ReduceMeanInst* inst) override {
     RunOnCommonReductionInstruction(inst, inst->GetAxis());
   }
+  virtual void RunOnInstruction(ReduceMinInst* inst) override {
+    RunOnCommonReductionInstruction(inst, inst->GetAxis());
+  }
+  virtual void RunOnInstruction(ReduceProductInst* inst) override {
+    RunOnCommonReductionInstruction(inst, inst->GetAxis());
+  }
+  virtual void RunOnInstruction(ReduceSumInst* inst) override {
+    RunOnCommonReductionInstruction(inst, inst->GetAxis());
+  }
   virtual void RunOnInstruction(ArgmaxInst* inst) override {
     RunOnCommonReductionInstruction(inst, {inst->GetAxis()});
   }
@@ -118,6 +156,29 @@ class GenericLLVMIRCodeGen : public CodeGen {
   virtual llvm::Value* AllocateLLVMBuffer(DefaultIRBuilder*, const Def& def);
   llvm::CallInst* CreateCall(llvm::FunctionCallee* callee,
                              llvm::ArrayRef<llvm::Value*> args);
+  /// Emits a loop nest over `dims` at the current insertion point and calls
+  /// `body` with the induction variables inside the innermost loop. The
+  /// innermost loop is marked for vectorization. If set, `outer_bound`
+  /// replaces dims[0] as the (non-zero) trip count of the outermost loop. The
+  /// insertion point is left after the loop nest.
+  void EmitLoopNest(
+      const std::vector<int64_t>& dims,
+      const std::function<void(const std::vector<llvm::Value*>&)>& body,
+      llvm::Value* outer_bound = nullptr);
+
+  /// Loads the element of an input at the current iteration of an elementwise
+  /// loop nest.
+  using ElementLoader = std::function<llvm::Value*(size_t)>;
+  /// Computes the result element from the input elements.
+  using ElementwiseBody = std::function<llvm::Value*(const ElementLoader&)>;
+  /// Emits a loop nest that stores `body` to each element of `buf`, the result
+  /// of type `ret_type`. Inputs are broadcast to the result shape with loop
+  /// bounds and strides emitted as constants. Large loop nests are outlined
+  /// into a task function whose outermost loop is split over the runtime
+  /// thread pool by _sn_rt_fork_call.
+  void EmitElementwiseLoopNest(const halo::Type& ret_type, llvm::Value* buf,
+                               const std::vector<Def>& inputs,
+                               const ElementwiseBody& body);
 
   static llvm::LLVMContext& GetLLVMContext() noexcept;
   static llvm::Type* SNTypeToLLVMType(DataType dt);
@@ -142,6 +203,8 @@ class GenericLLVMIRCodeGen : public CodeGen {
     return limit;
   }
   inline static std::string RuntimeLibName = "libRT_GENERIC.a";
+  // Buffers with up to this many elements are allocated on the stack.
+  static constexpr int64_t kMaxStackBufferSize = 128;
 
  private:
   static std::string GetRTLibFuncName(
@@ -151,7 +214,49 @@ class GenericLLVMIRCodeGen : public CodeGen {
   void RunOnMathUnaryInstruction(Instruction* inst);
   void RunOnCommonReductionInstruction(Instruction* inst,
                                        const std::vector<int>& axis);
+  // `paddings` are in the order of top, bottom, left and right.
+  // `count_include_pad` only affects average pooling.
+  void RunOnCommonPoolingInstruction(Instruction* inst,
+                                     const std::vector<int>& ksize,
+                                     const std::vector<int>& strides,
+                                     DataFormat data_format,
+                                     const std::vector<int>& paddings,
+                                     bool count_include_pad);
+  void RunOnWinogradConv(Conv2DInst* inst, llvm::Value* data);
+  // Applies the fused activation of `inst` that is not done by clipping in
+  // place over its result `buf`.
+  void RunOnFusedActivation(const Instruction& inst, ActivationType activation,
+                            float alpha, llvm::Value* buf);
+  // Returns the clip range implementing a fused activation.
+  static std::pair<float, float> GetActivationClipRange(
+      ActivationType activation);
+  llvm::Value* GetWinogradKernel(Conv2DInst* inst);
+  // Returns true if `constant` is only used as the kernel of convolutions
+  // lowered to Winograd, which read the transformed copy instead.
+  bool IsWinogradKernel(const Constant& constant) const;
+  // Finds the inputs of concatenations that can be written directly into
+  // their part of the result.
+  void PlanConcatInPlace(const Function& function);
+  // Places the global buffers of `function` into one arena.
+  void PlanActivationArena(const Function& function);
   ConstantDataStorage constant_data_storage_;
+  bool enable_winograd_ = true;
+  bool print_mem_stats_ = false;
+  bool enable_parallel_loops_ = true;
+  // Global buffers of the current function, replaced by slices of its arena
+  // once the function is generated.
+  std::unordered_map<Def, llvm::GlobalVariable*> arena_buffers_;
+  std::unique_ptr<AliasAnalyzer> alias_analyzer_;
+  // Values of the current function stored in the global buffer of another
+  // one: results computed in place over an operand and concatenated values.
+  std::unordered_map<Def, Def> buffer_aliases_;
+  // Inputs of concatenations mapped to the result and their offset in bytes.
+  std::unordered_map<Def, std::pair<Def, int64_t>> concat_slots_;
+  // Buffers of the concatenations whose inputs are already written.
+  std::unordered_map<Def, llvm::Value*> concat_buffers_;
+  size_t total_activations_size_ = 0;
+  size_t peak_activations_size_ = 0;
+  size_t arena_size_ = 0;
 };
 
 class GenericLLVMIRWriter : public CodeWriter {
@@ -167,6 +272,22 @@ class GenericLLVMIRWriter : public CodeWriter {
   bool bitcode_format_; // True for Bitcode output, False for text format.
 };
 
+/// This class emits the LLVM module as an object file. With more than one
+/// codegen thread, the module is split by exported functions into partitions
+/// which are compiled concurrently, each in its own LLVMContext, and the
+/// objects are packed into a single GNU archive. Local symbols stay local.
+class GenericObjectWriter : public CodeWriter {
+ public:
+  explicit GenericObjectWriter(const std::string& name, std::ostream& os);
+
+  bool RunOnModule(Module* module) override;
+
+ protected:
+  /// Returns a new target machine. Each partition is compiled with its own.
+  virtual std::unique_ptr<llvm::TargetMachine> CreateTargetMachine(
+      const GlobalContext& ctx) const = 0;
+};
+
 /// This class emits the constants to a separate LLVM module.
 class GenericConstantWriter : public GenericLLVMIRCodeGen {
  public:
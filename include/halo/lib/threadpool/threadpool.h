@@ -0,0 +1,128 @@
+//===- threadpool.h ---------------------------------------------*- C++ -*-===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HALO_LIB_THREADPOOL_THREADPOOL_H_
+#define HALO_LIB_THREADPOOL_THREADPOOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// This header only depends on the standard library: it is compiled into the
+// compiler as well as into the runtime library (RT_GENERIC).
+
+namespace halo {
+
+/// A fork-join thread pool for data parallel loops.
+/// The iteration space of a loop is cut into chunks which are dealt evenly to
+/// the participating threads (the caller and the workers). Each thread claims
+/// chunks from the front of its own range; once it runs dry it steals the back
+/// half of the range of another thread. Ranges are claimed with lock-free
+/// compare-and-swap. Idle workers spin briefly and then sleep until the next
+/// loop is submitted.
+class ThreadPool final {
+ public:
+  /// Creates a pool of `num_threads` threads, the calling thread included.
+  /// A value <= 0 selects GetDefaultNumOfThreads().
+  explicit ThreadPool(int num_threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int GetNumOfThreads() const noexcept { return num_threads_; }
+
+  /// Calls `fn(begin, end)` on disjoint ranges covering [0, n). Ranges are at
+  /// least `grain` iterations long, except for the last one. The loop runs
+  /// serially on the caller if n <= grain, if it is nested in another
+  /// parallel loop, or if the pool is already running a loop.
+  template <typename F>
+  void ParallelFor(int64_t n, int64_t grain, F&& fn) {
+    using Fn = std::remove_reference_t<F>;
+    Run(n, grain,
+        [](void* ctx, int64_t begin, int64_t end) {
+          (*static_cast<Fn*>(ctx))(begin, end);
+        },
+        const_cast<void*>(static_cast<const void*>(&fn)));
+  }
+
+  /// Calls `fn(begin0, end0, begin1, end1)` on tiles of at most
+  /// grain0 x grain1 iterations covering [0, n0) x [0, n1).
+  template <typename F>
+  void ParallelFor2D(int64_t n0, int64_t n1, int64_t grain0, int64_t grain1,
+                     F&& fn) {
+    grain0 = std::max<int64_t>(grain0, 1);
+    grain1 = std::max<int64_t>(grain1, 1);
+    int64_t tiles0 = (n0 + grain0 - 1) / grain0;
+    int64_t tiles1 = (n1 + grain1 - 1) / grain1;
+    ParallelFor(tiles0 * tiles1, 1, [&](int64_t begin, int64_t end) {
+      for (int64_t t = begin; t < end; ++t) {
+        int64_t i0 = t / tiles1 * grain0;
+        int64_t i1 = t % tiles1 * grain1;
+        fn(i0, std::min(n0, i0 + grain0), i1, std::min(n1, i1 + grain1));
+      }
+    });
+  }
+
+  /// Returns true if the calling thread is executing a parallel loop.
+  static bool InParallelRegion() noexcept;
+
+  /// Returns the process wide pool, created on first use.
+  static ThreadPool* GetDefault();
+
+  /// Sets the number of threads of the default pool. An existing default pool
+  /// is recreated; this must not race with loops running on it.
+  static void SetDefaultNumOfThreads(int num_threads);
+
+  /// Returns $HALO_NUM_THREADS if set, or the number of hardware threads.
+  static int GetDefaultNumOfThreads();
+
+ private:
+  using RangeFunc = void (*)(void* ctx, int64_t begin, int64_t end);
+  struct Job;
+  struct alignas(64) Range {
+    // Packed as (end << 32) | begin, in units of chunks.
+    std::atomic<uint64_t> bounds{0};
+  };
+
+  void Run(int64_t n, int64_t grain, RangeFunc fn, void* ctx);
+  void RunJob(Job* job, int id);
+  bool Steal(int id);
+  void WorkerLoop(int id);
+
+  const int num_threads_;
+  std::unique_ptr<Range[]> ranges_;
+  std::vector<std::thread> workers_;
+  // Serializes loops submitted by different threads.
+  std::mutex busy_;
+  // Guards job_ and stop_ and the joined counter of the current job.
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::atomic<uint64_t> epoch_{0};
+  Job* job_ = nullptr;
+  bool stop_ = false;
+};
+
+} // namespace halo
+
+#endif // HALO_LIB_THREADPOOL_THREADPOOL_H_
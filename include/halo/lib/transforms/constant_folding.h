@@ -0,0 +1,47 @@
+//===- constant_folding.h ---------------------------------------*- C++ -*-===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HALO_LIB_TRANSFORMS_CONSTANT_FOLDING_H_
+#define HALO_LIB_TRANSFORMS_CONSTANT_FOLDING_H_
+
+#include "halo/lib/pass/pass.h"
+
+namespace halo {
+
+/// This pass evaluates the instructions whose operands are all constants with
+/// reference kernels and replaces their results with constants. Instructions
+/// are visited in order, so whole constant subgraphs (e.g. shape
+/// computations) collapse in a single run. A result larger than the size
+/// limit is only folded if it is not larger than its operands, so folding
+/// does not grow the emitted constants.
+class ConstantFolding final : public BasicBlockPass {
+ public:
+  static constexpr size_t kDefaultMaxSizeInBytes = 1024 * 1024;
+
+  explicit ConstantFolding(size_t max_size_in_bytes = kDefaultMaxSizeInBytes)
+      : BasicBlockPass("Constant Folding"),
+        max_size_in_bytes_(max_size_in_bytes) {}
+
+  bool RunOnBasicBlock(BasicBlock* bb) override;
+
+ private:
+  size_t max_size_in_bytes_;
+};
+
+} // end namespace halo.
+
+#endif // HALO_LIB_TRANSFORMS_CONSTANT_FOLDING_H_
@@ -28,6 +28,7 @@ class DCE final : public BasicBlockPass {
   DCE() : BasicBlockPass("Dead Code Elimination") {}
 
   bool RunOnBasicBlock(BasicBlock* bb) override;
+  bool IsIdempotent() const noexcept override { return true; }
 };
 
 } // end namespace halo.
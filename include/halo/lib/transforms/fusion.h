@@ -18,12 +18,36 @@
 #ifndef HALO_LIB_TRANSFORMS_FUSION_H_
 #define HALO_LIB_TRANSFORMS_FUSION_H_
 
+#include <vector>
+
 #include "halo/lib/ir/all_instructions.h"
 #include "halo/lib/pass/pass.h"
 
 namespace halo {
 
-/// This pass simplififies instructions to reduce computation strength.
+/// One step of a FusedElementwiseInst. `lhs` and `rhs` are operand ids: k >= 0
+/// refers to the k-th operand and -k-1 to the result of step k.
+struct ElementwiseStep {
+  OpCode op_code;
+  int lhs;
+  int rhs;
+  float alpha = 0.0F;
+};
+
+/// Returns the steps of `inst`.
+std::vector<ElementwiseStep> GetElementwiseSteps(
+    const FusedElementwiseInst& inst);
+/// Sets the steps of `inst`.
+void SetElementwiseSteps(FusedElementwiseInst* inst,
+                         const std::vector<ElementwiseStep>& steps);
+/// Returns true if `inst` can be a step of a FusedElementwiseInst.
+bool IsFusibleElementwise(const Instruction& inst);
+
+/// This pass fuses the patterns defined in fusion.td into single instructions.
+/// Instructions are visited from the last one so that the largest pattern
+/// rooted at an instruction is matched before the patterns it contains. With
+/// the ElementwiseChain option, trees of single-use elementwise instructions
+/// of the same type are fused into FusedElementwiseInsts.
 class Fusion final : public BasicBlockPass {
  public:
   struct Options {
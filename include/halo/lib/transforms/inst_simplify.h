@@ -42,6 +42,7 @@ class InstSimplify final : public BasicBlockPass {
   std::pair<Def, Def> RunOnInstruction(Instruction* inst);
   std::pair<Def, Def> RunOnInstruction(TransposeInst* inst);
   std::pair<Def, Def> RunOnInstruction(ReturnInst* inst);
+  static std::pair<Def, Def> RunOnInstruction(BatchNormInst* inst);
   static std::pair<Def, Def> RunOnInstruction(ConcatInst* inst);
   static std::pair<Def, Def> RunOnInstruction(Conv2DInst* inst);
   static std::pair<Def, Def> RunOnInstruction(GatherInst* inst);
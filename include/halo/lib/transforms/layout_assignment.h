@@ -0,0 +1,43 @@
+//===- layout_assignment.h --------------------------------------*- C++ -*-===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HALO_LIB_TRANSFORMS_LAYOUT_ASSIGNMENT_H_
+#define HALO_LIB_TRANSFORMS_LAYOUT_ASSIGNMENT_H_
+
+#include "halo/lib/pass/pass.h"
+
+namespace halo {
+
+/// This pass chooses the layout of the values computed by layout transparent
+/// instructions (element-wise, concat, pad and reduce with kept dimensions).
+/// Connected transparent instructions form a region whose values share one
+/// layout: either the current one or a permutation of it taken from the
+/// transposes around the region. A region is permuted if that lowers the
+/// number of bytes transposed, counting the transposes removed from and
+/// inserted at its boundary. Axis attributes and constant operands of the
+/// region are permuted at compile time. Layout sensitive instructions (e.g.
+/// convolutions placed by ReorderChannel) keep their layouts.
+class LayoutAssignment final : public BasicBlockPass {
+ public:
+  LayoutAssignment() : BasicBlockPass("Layout Assignment") {}
+
+  bool RunOnBasicBlock(BasicBlock* bb) override;
+};
+
+} // end namespace halo.
+
+#endif // HALO_LIB_TRANSFORMS_LAYOUT_ASSIGNMENT_H_
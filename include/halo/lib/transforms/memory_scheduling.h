@@ -0,0 +1,44 @@
+//===- memory_scheduling.h --------------------------------------*- C++ -*-===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HALO_LIB_TRANSFORMS_MEMORY_SCHEDULING_H_
+#define HALO_LIB_TRANSFORMS_MEMORY_SCHEDULING_H_
+
+#include "halo/lib/pass/pass.h"
+
+namespace halo {
+
+/// This pass reorders the instructions of each basic block to reduce the peak
+/// amount of memory held by live activations. Small blocks are scheduled
+/// optimally with a dynamic programming over the sets of executed
+/// instructions; larger ones with a greedy list scheduler that looks a few
+/// instructions ahead. A block keeps its order unless the new one lowers the
+/// peak.
+class MemoryScheduling final : public FunctionPass {
+ public:
+  explicit MemoryScheduling(bool print_stats = false)
+      : FunctionPass("Memory Aware Scheduling"), print_stats_(print_stats) {}
+
+  bool RunOnFunction(Function* func) override;
+
+ private:
+  bool print_stats_;
+};
+
+} // end namespace halo.
+
+#endif // HALO_LIB_TRANSFORMS_MEMORY_SCHEDULING_H_
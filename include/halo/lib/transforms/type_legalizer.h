@@ -32,6 +32,7 @@ class TypeLegalizer final : public BasicBlockPass {
   TypeLegalizer() : TypeLegalizer(false) {}
 
   bool RunOnBasicBlock(BasicBlock* bb) override;
+  bool IsIdempotent() const noexcept override { return true; }
 
  private:
   bool relaxed_; // Skip uninferable shape if true.
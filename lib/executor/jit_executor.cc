@@ -0,0 +1,332 @@
+//===- jit_executor.cc ----------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "halo/lib/executor/jit_executor.h"
+
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+#include "halo/lib/framework/global_context.h"
+#include "halo/lib/ir/module.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/target/codegen_object.h"
+#include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+
+namespace halo {
+
+// Suffix of the wrappers that take the buffers of a function as an array.
+static const char* const kEntrySuffix = "_jit_entry";
+
+// The code of one compiled module.
+struct JITModule {
+  struct Entry {
+    size_t num_of_args;
+    void (*func)(void**);
+  };
+
+  ~JITModule() {
+    if (jit != nullptr) {
+      llvm::consumeError(jit->runDestructors());
+    }
+    cxx_overrides.runDestructors();
+  }
+
+  std::string bitcode;
+  // Provides __dso_handle and __cxa_atexit to the JIT'ed code (e.g. for the
+  // default thread pool of the runtime library). Outlives the JIT.
+  llvm::orc::LocalCXXRuntimeOverrides cxx_overrides;
+  std::unique_ptr<llvm::orc::LLJIT> jit;
+  std::unordered_map<std::string, Entry> entries;
+  // The functions keep their intermediate results in static arenas, so the
+  // runs of the code, from any executor sharing it, are serialized.
+  std::mutex run_mutex;
+};
+
+using JITModuleFuture = std::shared_future<std::shared_ptr<JITModule>>;
+
+// Compiled modules by the hash of their bitcode. A module being compiled is
+// already in the cache, so that executors compiling the same module wait for
+// it instead of compiling it again. The mutex only guards the map.
+static std::mutex& GetCacheMutex() {
+  static std::mutex mu;
+  return mu;
+}
+
+static std::unordered_map<uint64_t, JITModuleFuture>& GetCache() {
+  static std::unordered_map<uint64_t, JITModuleFuture> cache;
+  return cache;
+}
+
+static bool CheckError(llvm::Error err) {
+  if (err) {
+    llvm::logAllUnhandledErrors(std::move(err), llvm::errs(), "JIT error: ");
+    return false;
+  }
+  return true;
+}
+
+// Adds `<name>_jit_entry(i8** args)` which calls `func` with the buffers in
+// `args`, so that functions of any arity are called through one signature.
+static void AddEntryWrapper(llvm::Function* func) {
+  llvm::LLVMContext& ctx = func->getContext();
+  llvm::PointerType* i8_ptr_ty = llvm::Type::getInt8PtrTy(ctx);
+  llvm::FunctionType* wrapper_ty = llvm::FunctionType::get(
+      llvm::Type::getVoidTy(ctx), {i8_ptr_ty->getPointerTo()}, false);
+  llvm::Function* wrapper = llvm::Function::Create(
+      wrapper_ty, llvm::GlobalValue::ExternalLinkage,
+      func->getName() + kEntrySuffix, func->getParent());
+  llvm::IRBuilder<> ir_builder(llvm::BasicBlock::Create(ctx, "entry", wrapper));
+  llvm::Value* bufs = &*wrapper->arg_begin();
+  std::vector<llvm::Value*> args;
+  for (const llvm::Argument& arg : func->args()) {
+    llvm::Value* buf = ir_builder.CreateLoad(
+        ir_builder.CreateConstGEP1_64(bufs, arg.getArgNo()));
+    args.push_back(ir_builder.CreateBitCast(buf, arg.getType()));
+  }
+  ir_builder.CreateCall(func, args);
+  ir_builder.CreateRetVoid();
+}
+
+// Runs the O3 pipeline, including the loop and SLP vectorizers, for `tm`.
+static void Optimize(llvm::Module* module, llvm::TargetMachine* tm) {
+  llvm::PassManagerBuilder builder;
+  builder.OptLevel = 3;
+  builder.SizeLevel = 0;
+  builder.Inliner = llvm::createFunctionInliningPass(3, 0, false);
+  builder.LoopVectorize = true;
+  builder.SLPVectorize = true;
+  tm->adjustPassManager(builder);
+
+  llvm::legacy::FunctionPassManager fpm(module);
+  llvm::legacy::PassManager mpm;
+  fpm.add(
+      llvm::createTargetTransformInfoWrapperPass(tm->getTargetIRAnalysis()));
+  mpm.add(
+      llvm::createTargetTransformInfoWrapperPass(tm->getTargetIRAnalysis()));
+  builder.populateFunctionPassManager(fpm);
+  builder.populateModulePassManager(mpm);
+
+  fpm.doInitialization();
+  for (llvm::Function& func : *module) {
+    fpm.run(func);
+  }
+  fpm.doFinalization();
+  mpm.run(*module);
+}
+
+// JIT-compiles `bitcode` and resolves the entries of the functions `names`.
+static std::shared_ptr<JITModule> CompileBitcode(
+    const std::string& bitcode, const std::vector<std::string>& names) {
+  auto jtmb = llvm::orc::JITTargetMachineBuilder::detectHost();
+  if (!jtmb) {
+    CheckError(jtmb.takeError());
+    return nullptr;
+  }
+  jtmb->setCodeGenOptLevel(llvm::CodeGenOpt::Aggressive);
+  auto tm = jtmb->createTargetMachine();
+  if (!tm) {
+    CheckError(tm.takeError());
+    return nullptr;
+  }
+
+  auto llvm_ctx = llvm::make_unique<llvm::LLVMContext>();
+  auto llvm_module = llvm::parseBitcodeFile(
+      llvm::MemoryBufferRef(bitcode, "jit_module"), *llvm_ctx);
+  if (!llvm_module) {
+    CheckError(llvm_module.takeError());
+    return nullptr;
+  }
+  (*llvm_module)->setDataLayout((*tm)->createDataLayout());
+  std::vector<size_t> num_of_args;
+  for (const auto& name : names) {
+    llvm::Function* func = (*llvm_module)->getFunction(name);
+    HLCHECK(func != nullptr && !func->isDeclaration());
+    num_of_args.push_back(func->arg_size());
+    AddEntryWrapper(func);
+  }
+  Optimize(llvm_module->get(), tm->get());
+
+  auto jit = llvm::orc::LLJITBuilder()
+                 .setJITTargetMachineBuilder(std::move(*jtmb))
+                 .create();
+  if (!jit) {
+    CheckError(jit.takeError());
+    return nullptr;
+  }
+  auto compiled = std::make_shared<JITModule>();
+  compiled->bitcode = bitcode;
+  compiled->jit = std::move(*jit);
+  llvm::orc::LLJIT& lljit = *compiled->jit;
+  const llvm::DataLayout& dl = lljit.getDataLayout();
+
+  // Unresolved symbols (libc, libm, pthread) come from the host process.
+  auto generator =
+      llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+          dl.getGlobalPrefix());
+  if (!generator) {
+    CheckError(generator.takeError());
+    return nullptr;
+  }
+  lljit.getMainJITDylib().setGenerator(std::move(*generator));
+  llvm::orc::MangleAndInterner mangle(lljit.getExecutionSession(), dl);
+  if (!CheckError(
+          compiled->cxx_overrides.enable(lljit.getMainJITDylib(), mangle)) ||
+      !CheckError(lljit.addIRModule(llvm::orc::ThreadSafeModule(
+          std::move(*llvm_module), std::move(llvm_ctx)))) ||
+      !CheckError(lljit.runConstructors())) {
+    return nullptr;
+  }
+
+  for (size_t i = 0, e = names.size(); i < e; ++i) {
+    auto sym = lljit.lookup(names[i] + kEntrySuffix);
+    if (!sym) {
+      CheckError(sym.takeError());
+      return nullptr;
+    }
+    compiled->entries[names[i]] = {
+        num_of_args[i], reinterpret_cast<void (*)(void**)>( // NOLINT.
+                            static_cast<uintptr_t>(sym->getAddress()))};
+  }
+  return compiled;
+}
+
+JITExecutor::JITExecutor() = default;
+
+JITExecutor::~JITExecutor() = default;
+
+Status JITExecutor::Compile(Module* module) {
+  compiled_.reset();
+  default_func_.clear();
+  cache_hit_ = false;
+
+  GlobalContext& ctx = module->GetGlobalContext();
+  ctx.GetCodeGenObject().SetLLVMModule(nullptr);
+  PassManager pm(ctx);
+  pm.AddPass<GenericLLVMIRCodeGen>(
+      GenericLLVMIRCodeGen::ConstantDataStorage::DefinedAsStatic);
+  pm.Run(module);
+  llvm::Module* llvm_module = ctx.GetCodeGenObject().GetLLVMModule();
+  if (llvm_module == nullptr) {
+    return Status::COMPILE_FAILURE;
+  }
+
+  std::vector<std::string> names;
+  for (auto& func : *module) {
+    names.push_back(func->GetName());
+  }
+  if (names.empty()) {
+    return Status::ILLEGAL_PARAM;
+  }
+
+  std::string bitcode;
+  llvm::raw_string_ostream os(bitcode);
+  llvm::WriteBitcodeToFile(*llvm_module, os);
+  os.flush();
+  uint64_t hash = llvm::xxHash64(bitcode);
+
+  std::promise<std::shared_ptr<JITModule>> promise;
+  JITModuleFuture future;
+  bool is_compiling = false;
+  {
+    std::lock_guard<std::mutex> lock(GetCacheMutex());
+    auto& cache = GetCache();
+    auto it = cache.find(hash);
+    if (it == cache.end()) {
+      future = promise.get_future().share();
+      cache.emplace(hash, future);
+      is_compiling = true;
+    } else {
+      future = it->second;
+    }
+  }
+  if (is_compiling) {
+    auto compiled = CompileBitcode(bitcode, names);
+    if (compiled == nullptr) {
+      std::lock_guard<std::mutex> lock(GetCacheMutex());
+      GetCache().erase(hash);
+    }
+    promise.set_value(std::move(compiled));
+  }
+
+  compiled_ = future.get();
+  if (compiled_ != nullptr && compiled_->bitcode != bitcode) {
+    // Hash collision: the module is compiled without being cached.
+    compiled_ = CompileBitcode(bitcode, names);
+  } else {
+    cache_hit_ = !is_compiling;
+  }
+  if (compiled_ == nullptr) {
+    cache_hit_ = false;
+    return Status::COMPILE_FAILURE;
+  }
+  default_func_ = names.front();
+  return Status::SUCCESS;
+}
+
+Status JITExecutor::Run(const std::vector<const void*>& inputs,
+                        const std::vector<void*>& outputs,
+                        const std::string& func_name) {
+  if (compiled_ == nullptr) {
+    return Status::NULL_PTR;
+  }
+  auto it =
+      compiled_->entries.find(func_name.empty() ? default_func_ : func_name);
+  if (it == compiled_->entries.end() ||
+      it->second.num_of_args != inputs.size() + outputs.size()) {
+    return Status::ILLEGAL_PARAM;
+  }
+  std::vector<void*> bufs;
+  bufs.reserve(inputs.size() + outputs.size());
+  for (const void* input : inputs) {
+    bufs.push_back(const_cast<void*>(input)); // NOLINT.
+  }
+  bufs.insert(bufs.end(), outputs.begin(), outputs.end());
+  std::lock_guard<std::mutex> lock(compiled_->run_mutex);
+  it->second.func(bufs.data());
+  return Status::SUCCESS;
+}
+
+void JITExecutor::ClearCache() {
+  std::lock_guard<std::mutex> lock(GetCacheMutex());
+  auto& cache = GetCache();
+  for (auto it = cache.begin(); it != cache.end();) {
+    // Modules still being compiled are kept.
+    bool is_unused = it->second.wait_for(std::chrono::seconds(0)) ==
+                         std::future_status::ready &&
+                     it->second.get().use_count() == 1;
+    it = is_unused ? cache.erase(it) : std::next(it);
+  }
+}
+
+} // namespace halo
@@ -67,6 +67,16 @@ class GlobalContextImpl {
     processor_ = processor;
   }
 
+  const std::string& GetTargetFeatures() const noexcept { return features_; }
+  void SetTargetFeatures(const std::string& features) noexcept {
+    features_ = features;
+  }
+
+  int GetNumOfCodeGenThreads() const noexcept { return codegen_threads_; }
+  void SetNumOfCodeGenThreads(int num_threads) noexcept {
+    codegen_threads_ = num_threads;
+  }
+
  private:
   // A global counter
   uint64_t global_counter_ = 0;
@@ -75,6 +85,8 @@ class GlobalContextImpl {
   std::string base_path_{""};
   std::string triple_{LLVM_HOST_TRIPLE};
   std::string processor_{"native"};
+  std::string features_{""};
+  int codegen_threads_ = 1;
 };
 
 GlobalContext::GlobalContext() : impl_(std::make_unique<GlobalContextImpl>()) {}
@@ -122,6 +134,22 @@ void GlobalContext::SetProcessorName(const std::string& processor) noexcept {
   impl_->SetProcessorName(processor);
 }
 
+const std::string& GlobalContext::GetTargetFeatures() const noexcept {
+  return impl_->GetTargetFeatures();
+}
+
+void GlobalContext::SetTargetFeatures(const std::string& features) noexcept {
+  impl_->SetTargetFeatures(features);
+}
+
+int GlobalContext::GetNumOfCodeGenThreads() const noexcept {
+  return impl_->GetNumOfCodeGenThreads();
+}
+
+void GlobalContext::SetNumOfCodeGenThreads(int num_threads) noexcept {
+  impl_->SetNumOfCodeGenThreads(num_threads);
+}
+
 std::ostream& GlobalContext::Dbgs() noexcept { return std::cerr; }
 
 } // namespace halo
\ No newline at end of file
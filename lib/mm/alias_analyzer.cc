@@ -0,0 +1,215 @@
+//===- alias_analyzer.cc --------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "halo/lib/mm/alias_analyzer.h"
+
+#include <vector>
+
+#include "halo/lib/ir/constant.h"
+
+namespace halo {
+
+static bool HaveSameLayout(const Type& lhs, const Type& rhs) {
+  return lhs.IsValid() && rhs.IsValid() &&
+         lhs.GetDataType() == rhs.GetDataType() &&
+         lhs.GetTotalNumOfElements() == rhs.GetTotalNumOfElements();
+}
+
+// Returns true if the slice `inst` takes a contiguous range of its input,
+// i.e. all the dimensions after the first sliced one are taken entirely and
+// all the ones before it have a single element.
+static bool IsContiguousSlice(const Instruction& inst, int64_t* offset) {
+  const Type& input_type = inst.GetOperand(0).GetType();
+  const Type& ret_type = inst.GetResultType();
+  if (!input_type.IsValid() || !ret_type.IsValid() ||
+      input_type.GetNumOfDims() != ret_type.GetNumOfDims()) {
+    return false;
+  }
+  for (size_t i = 1, e = inst.GetNumOfOperands(); i < e; ++i) {
+    if (!IsA<Constant>(inst.GetOperand(i))) {
+      return false;
+    }
+  }
+  if (inst.GetNumOfOperands() > 3) {
+    const Def& op3 = inst.GetOperand(3);
+    const Constant* steps = DynCast<Constant>(op3);
+    for (int i = 0, e = op3.GetType().GetTotalNumOfElements(); i < e; ++i) {
+      if (steps->GetDataAsInt64(i) != 1) {
+        return false;
+      }
+    }
+  }
+
+  int dims = static_cast<int>(input_type.GetNumOfDims());
+  std::vector<bool> is_sliced(dims, inst.GetNumOfOperands() <= 4);
+  if (inst.GetNumOfOperands() > 4) {
+    const Def& op4 = inst.GetOperand(4);
+    const Constant* axes = DynCast<Constant>(op4);
+    for (int i = 0, e = op4.GetType().GetTotalNumOfElements(); i < e; ++i) {
+      int64_t axis = axes->GetDataAsInt64(i);
+      is_sliced[axis < 0 ? axis + dims : axis] = true;
+    }
+  }
+  // The starts are given in the order of the sliced dimensions.
+  const Constant* starts = DynCast<Constant>(inst.GetOperand(1));
+  std::vector<int64_t> begins(dims);
+  for (int i = 0, j = 0; i < dims; ++i) {
+    begins[i] = is_sliced[i] ? starts->GetDataAsInt64(j++) : 0;
+    if (begins[i] < 0) {
+      begins[i] += input_type.GetNumOfElementsInDim(i);
+    }
+  }
+
+  bool is_inner_full = true;
+  int64_t stride = 1;
+  int64_t pos = 0;
+  for (int i = dims - 1; i >= 0; --i) {
+    int64_t input_dim = input_type.GetNumOfElementsInDim(i);
+    int64_t ret_dim = ret_type.GetNumOfElementsInDim(i);
+    if (!is_inner_full && ret_dim != 1) {
+      return false;
+    }
+    pos += begins[i] * stride;
+    is_inner_full &= ret_dim == input_dim;
+    stride *= input_dim;
+  }
+  if (offset != nullptr) {
+    *offset = pos;
+  }
+  return true;
+}
+
+bool AliasAnalyzer::IsView(const Instruction& inst, int64_t* offset) {
+  if (offset != nullptr) {
+    *offset = 0;
+  }
+  switch (inst.GetOpCode()) {
+    case OpCode::RESHAPE: {
+      return inst.GetNumOfOperands() > 0;
+    }
+    case OpCode::SLICE: {
+      return IsContiguousSlice(inst, offset);
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+bool AliasAnalyzer::IsElementwise(OpCode op) {
+  switch (op) {
+    case OpCode::ADD:
+    case OpCode::BATCHNORM:
+    case OpCode::DIV:
+    case OpCode::ERF:
+    case OpCode::EXP:
+    case OpCode::FLOOR:
+    case OpCode::FUSEDELEMENTWISE:
+    case OpCode::MAXIMUM:
+    case OpCode::MINIMUM:
+    case OpCode::MUL:
+    case OpCode::POW:
+    case OpCode::RELU:
+    case OpCode::RSQRT:
+    case OpCode::SIGMOID:
+    case OpCode::SQRT:
+    case OpCode::SUB:
+    case OpCode::TANH: {
+      return true;
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+AliasAnalyzer::AliasAnalyzer(const Function& func, bool in_place) {
+  // The last reader of a value is only known within a basic block.
+  in_place &= func.size() == 1;
+  // Number of pending reads of the storage owned by each root.
+  std::unordered_map<Def, size_t> unread;
+
+  for (auto& bb : func) {
+    for (auto& it : bb->Instructions()) {
+      Instruction* inst = it.get();
+      const auto& operands = inst->GetOperands();
+      for (const auto& op : operands) {
+        auto group = unread.find(GetRoot(op));
+        if (group != unread.end()) {
+          --group->second;
+        }
+      }
+
+      Def aliasee = Def::GetUndefined();
+      OpCode op_code = inst->GetOpCode();
+      if (IsView(*inst)) {
+        aliasee = operands[0];
+      } else if (in_place && IsElementwise(op_code) &&
+                 inst->GetNumOfResults() == 1) {
+        // BatchNorm can only be computed over its data.
+        size_t candidates = op_code == OpCode::BATCHNORM ? 1 : operands.size();
+        for (size_t i = 0; i < candidates && aliasee.IsNull(); ++i) {
+          const Def& op = operands[i];
+          Def root = GetRoot(op);
+          auto group = unread.find(root);
+          if (group == unread.end() || group->second != 0 ||
+              !HaveSameLayout(op.GetType(), inst->GetResultType())) {
+            continue;
+          }
+          // Other reads of the overwritten storage must be of the same
+          // elements.
+          bool conflict = false;
+          for (const auto& other : operands) {
+            conflict |= GetRoot(other) == root &&
+                        !HaveSameLayout(other.GetType(), op.GetType());
+          }
+          if (!conflict) {
+            aliasee = op;
+          }
+        }
+      }
+
+      const auto& uses = inst->GetResultsUses();
+      for (int i = 0, e = static_cast<int>(uses.size()); i < e; ++i) {
+        Def def{inst, i};
+        if (i == 0 && !aliasee.IsNull()) {
+          Def root = GetRoot(aliasee);
+          aliasees_.emplace(def, aliasee);
+          roots_.emplace(def, root);
+          auto group = unread.find(root);
+          if (group != unread.end()) {
+            group->second += uses[i].GetNumOfUses();
+          }
+        } else {
+          unread[def] = uses[i].GetNumOfUses();
+        }
+      }
+    }
+  }
+}
+
+Def AliasAnalyzer::GetAliasee(const Def& def) const {
+  auto it = aliasees_.find(def);
+  return it == aliasees_.end() ? Def::GetUndefined() : it->second;
+}
+
+Def AliasAnalyzer::GetRoot(const Def& def) const {
+  auto it = roots_.find(def);
+  return it == roots_.end() ? def : it->second;
+}
+
+} // namespace halo
@@ -18,6 +18,7 @@
 #include "halo/lib/mm/memory_analyzer.h"
 
 #include "halo/lib/framework/data_layout.h"
+#include "halo/lib/mm/alias_analyzer.h"
 
 namespace halo {
 
@@ -28,8 +29,17 @@ void MemoryAnalyzer::RunOnFunction(const Function& func) {
     const Type& ty = constant->GetResultType();
     weights_ += dl.Bytes(ty);
   }
+  AliasAnalyzer alias_analyzer(func, false /* in_place */);
   for (auto& bb : func.BasicBlocks()) {
     for (auto& inst : bb->Instructions()) {
+      Def root = alias_analyzer.GetRoot(Def{inst.get(), 0});
+      if (root.GetOwner() != inst.get() && IsA<Instruction>(root)) {
+        auto id = root.GetOwner()->GetId();
+        use_cnts_[id] += inst->GetNumberOfUses();
+        roots_.emplace(inst->GetId(), root);
+        views_[id].push_back(Def{inst.get(), 0});
+        continue;
+      }
       use_cnts_[inst->GetId()] = inst->GetNumberOfUses();
       for (auto& ty : inst->GetResultsTypes()) {
         non_weights_ += dl.Bytes(ty);
@@ -41,18 +51,26 @@ void MemoryAnalyzer::RunOnFunction(const Function& func) {
 std::vector<Def> MemoryAnalyzer::Executed(const Instruction* inst) {
   const DataLayout& dl = ctx_.GetDefaultDataLayout();
   std::vector<Def> dead;
-  for (auto& ty : inst->GetResultsTypes()) {
-    curr_non_weights_ += dl.Bytes(ty);
+  if (roots_.count(inst->GetId()) == 0) {
+    for (auto& ty : inst->GetResultsTypes()) {
+      curr_non_weights_ += dl.Bytes(ty);
+    }
   }
   for (const auto& op : inst->GetOperands()) {
     if (!IsA<Instruction>(op)) {
       continue;
     }
-    auto id = op.GetOwner()->GetId();
+    auto root = roots_.find(op.GetOwner()->GetId());
+    const Def& owner = root == roots_.end() ? op : root->second;
+    auto id = owner.GetOwner()->GetId();
     --curr_use_cnts_[id];
     if (curr_use_cnts_[id] == 0) {
-      dead.push_back(op);
-      curr_non_weights_ -= dl.Bytes(op.GetType());
+      dead.push_back(owner);
+      auto views = views_.find(id);
+      if (views != views_.end()) {
+        dead.insert(dead.end(), views->second.begin(), views->second.end());
+      }
+      curr_non_weights_ -= dl.Bytes(owner.GetType());
     }
   }
   peak_ = std::max(peak_, curr_non_weights_);
@@ -0,0 +1,172 @@
+//===- memory_planner.cc --------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "halo/lib/mm/memory_planner.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "halo/lib/framework/data_layout.h"
+#include "halo/lib/framework/global_context.h"
+#include "halo/lib/mm/alias_analyzer.h"
+
+namespace halo {
+
+MemoryPlanner::MemoryPlanner(const Function& func, const Filter& filter,
+                             const Aliases& aliases, size_t alignment)
+    : alignment_(alignment),
+      num_of_insts_(0),
+      arena_size_(0),
+      peak_(0),
+      total_size_(0) {
+  HLCHECK(alignment_ > 0);
+  ComputeLiveIntervals(func, filter, aliases);
+  AssignOffsets();
+  ComputePeak();
+}
+
+MemoryPlanner::MemoryPlanner(const Function& func)
+    : MemoryPlanner(func, [](const Def&) { return true; }) {}
+
+const MemoryPlanner::Buffer* MemoryPlanner::GetBuffer(const Def& def) const {
+  auto it = indices_.find(def);
+  return it == indices_.end() ? nullptr : &buffers_[it->second];
+}
+
+void MemoryPlanner::ComputeLiveIntervals(const Function& func,
+                                         const Filter& filter,
+                                         const Aliases& aliases) {
+  const DataLayout& dl = func.GetGlobalContext().GetDefaultDataLayout();
+  // Returns the value owning the storage of `def`. Aliases may refer to values
+  // defined later, e.g. the inputs of a concatenation written into its result.
+  auto get_root = [&aliases](Def def) {
+    for (;;) {
+      auto alias = aliases.find(def);
+      auto* inst = DynCast<Instruction>(def.GetOwner());
+      if (alias != aliases.end()) {
+        def = alias->second;
+      } else if (inst != nullptr && def.GetDefResultIdx() == 0 &&
+                 AliasAnalyzer::IsView(*inst)) {
+        def = inst->GetOperand(0);
+      } else {
+        return def;
+      }
+    }
+  };
+
+  int idx = 0;
+  for (auto& bb : func) {
+    for (auto& it : bb->Instructions()) {
+      Instruction* inst = it.get();
+      for (const auto& op : inst->GetOperands()) {
+        auto buf = indices_.find(get_root(op));
+        if (buf != indices_.end()) {
+          buffers_[buf->second].end = idx;
+        }
+      }
+      // The results of a return are the outputs of the function.
+      int num_of_results = inst->GetOpCode() == OpCode::RETURN
+                               ? 0
+                               : static_cast<int>(inst->GetNumOfResults());
+      for (int i = 0; i < num_of_results; ++i) {
+        // The buffer is allocated by the first value stored into it.
+        Def root = get_root(Def{inst, i});
+        if (IsA<Instruction>(root) && indices_.count(root) == 0 &&
+            filter(root)) {
+          size_t size = dl.Bytes(root.GetType());
+          size = (size + alignment_ - 1) / alignment_ * alignment_;
+          indices_[root] = buffers_.size();
+          buffers_.push_back(Buffer{root, size, 0, idx, idx});
+          total_size_ += size;
+        }
+      }
+      ++idx;
+    }
+  }
+  num_of_insts_ = idx;
+
+  // Without the order of execution of the basic blocks, values are kept alive
+  // through the whole function.
+  if (func.size() > 1) {
+    for (auto& buf : buffers_) {
+      buf.start = 0;
+      buf.end = num_of_insts_ - 1;
+    }
+  }
+}
+
+void MemoryPlanner::AssignOffsets() {
+  std::vector<size_t> order(buffers_.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+    return buffers_[a].size > buffers_[b].size;
+  });
+
+  std::vector<const Buffer*> placed;
+  std::vector<const Buffer*> conflicts;
+  for (size_t i : order) {
+    Buffer& buf = buffers_[i];
+    conflicts.clear();
+    for (const Buffer* other : placed) {
+      if (other->start <= buf.end && buf.start <= other->end) {
+        conflicts.push_back(other);
+      }
+    }
+    std::sort(conflicts.begin(), conflicts.end(),
+              [](const Buffer* a, const Buffer* b) {
+                return a->offset < b->offset;
+              });
+
+    // Find the smallest gap between conflicting buffers that fits.
+    size_t best_offset = std::numeric_limits<size_t>::max();
+    size_t best_gap = std::numeric_limits<size_t>::max();
+    size_t top = 0;
+    for (const Buffer* other : conflicts) {
+      if (other->offset >= top) {
+        size_t gap = other->offset - top;
+        if (gap >= buf.size && gap < best_gap) {
+          best_gap = gap;
+          best_offset = top;
+        }
+      }
+      top = std::max(top, other->offset + other->size);
+    }
+    buf.offset = best_offset == std::numeric_limits<size_t>::max()
+                     ? top
+                     : best_offset;
+    arena_size_ = std::max(arena_size_, buf.offset + buf.size);
+    placed.push_back(&buf);
+  }
+}
+
+void MemoryPlanner::ComputePeak() {
+  std::vector<size_t> allocated(num_of_insts_ + 1);
+  std::vector<size_t> released(num_of_insts_ + 1);
+  for (const auto& buf : buffers_) {
+    allocated[buf.start] += buf.size;
+    released[buf.end + 1] += buf.size;
+  }
+  size_t curr = 0;
+  for (int i = 0; i < num_of_insts_; ++i) {
+    curr = curr + allocated[i] - released[i];
+    peak_ = std::max(peak_, curr);
+  }
+}
+
+} // namespace halo
@@ -17,6 +17,9 @@
 
 #include "halo/lib/pass/pass_manager.h"
 
+#include <deque>
+#include <unordered_set>
+
 namespace halo {
 
 class PassManagerImpl {
@@ -63,23 +66,77 @@ void PassManager::Print(std::ostream& os) const { impl_->Print(os); }
 
 void PassManager::Dump() const { Print(GlobalContext::Dbgs()); }
 
+// Runs `passes` on an IR object in a round-robin until every pass has run
+// without a change since the last change, as reported by `run`. An idempotent
+// pass is not rerun right after its own change. Returns true if any pass made
+// a change.
+template <typename T, typename F>
+static bool RunToFixedPoint(const std::list<std::unique_ptr<T>>& passes,
+                            F run) {
+  bool changed = false;
+  size_t clean = 0;
+  for (auto it = passes.begin(); clean < passes.size();) {
+    if (run(it->get())) {
+      changed = true;
+      clean = (*it)->IsIdempotent() ? 1 : 0;
+    } else {
+      ++clean;
+    }
+    if (++it == passes.end()) {
+      it = passes.begin();
+    }
+  }
+  return changed;
+}
+
 // BasicBlockPassManager is a function level pass that contains basic block
 // passes.
 class BasicBlockPassManager final : public FunctionPass {
  public:
   BasicBlockPassManager() : FunctionPass("BasicBlockPassManager") {}
   bool RunOnFunction(Function* function) override {
-    bool changed = true;
-    while (changed) {
-      changed = false;
-      for (auto& bb : *function) {
-        for (auto& fp : passes_) {
-          changed |= fp->RunOnBasicBlock(bb.get());
-        }
+    // Only the blocks changed by some pass, or the blocks connected to them
+    // through def-use edges, are revisited.
+    std::deque<BasicBlock*> worklist;
+    std::unordered_set<const BasicBlock*> queued;
+    auto enqueue = [&worklist, &queued](BasicBlock* bb) {
+      if (bb != nullptr && queued.insert(bb).second) {
+        worklist.push_back(bb);
+      }
+    };
+    for (auto& bb : *function) {
+      enqueue(bb.get());
+    }
+
+    bool changed = false;
+    while (!worklist.empty()) {
+      BasicBlock* bb = worklist.front();
+      worklist.pop_front();
+      bool bb_changed = RunToFixedPoint(passes_, [bb](BasicBlockPass* pass) {
+        return pass->RunOnBasicBlock(bb);
+      });
+      if (!bb_changed) {
+        queued.erase(bb);
+        continue;
       }
-      if (!changed) {
-        break;
+      changed = true;
+      // `bb` stays in `queued` so it is not enqueued for its own defs.
+      for (auto& inst : *bb) {
+        for (auto& operand : inst->GetOperands()) {
+          IRObject* def = operand.GetOwner();
+          if (def != nullptr && IsA<Instruction>(def)) {
+            enqueue(Downcast<Instruction>(def)->GetParent());
+          }
+        }
+        for (auto& uses : inst->GetResultsUses()) {
+          for (auto& use : uses) {
+            if (IsA<Instruction>(use.GetUse())) {
+              enqueue(Downcast<Instruction>(use.GetUse())->GetParent());
+            }
+          }
+        }
       }
+      queued.erase(bb);
     }
     return changed;
   }
@@ -95,6 +152,7 @@ class BasicBlockPassManager final : public FunctionPass {
   }
 
   bool IsPassManager() const noexcept override { return true; }
+  bool IsIdempotent() const noexcept override { return true; }
 
  private:
   std::list<std::unique_ptr<BasicBlockPass>> passes_;
@@ -105,13 +163,21 @@ class FunctionPassManager final : public ModulePass {
  public:
   FunctionPassManager() : ModulePass("FunctionPassManager") {}
   bool RunOnModule(Module* module) override {
-    bool changed = true;
-    while (changed) {
-      changed = false;
+    // Each function is run to its own fixed point. Functions created by a
+    // pass (e.g. splitting) are picked up by the next sweep.
+    std::unordered_set<const Function*> visited;
+    bool changed = false;
+    for (bool found = true; found;) {
+      found = false;
       for (auto& func : *module) {
-        for (auto& fp : passes_) {
-          changed |= fp->RunOnFunction(func.get());
+        Function* f = func.get();
+        if (!visited.insert(f).second) {
+          continue;
         }
+        found = true;
+        changed |= RunToFixedPoint(passes_, [f](FunctionPass* pass) {
+          return pass->RunOnFunction(f);
+        });
       }
     }
     return changed;
@@ -18,21 +18,14 @@
 #include "halo/lib/target/cpu/arm/binary/arm_llvmir_codegen.h"
 
 #include "llvm-c/Target.h"
-#include "llvm/IR/LegacyPassManager.h"
 #include "llvm/Support/CodeGen.h"
 #include "llvm/Support/TargetRegistry.h"
-#include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Target/TargetMachine.h"
-#include "halo/lib/target/codegen_object.h"
 #include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
 
 namespace halo {
 
-static llvm::TargetMachine* GetARMTargetMachine(const GlobalContext& ctx) {
-  static llvm::TargetMachine* tm = nullptr;
-  if (tm != nullptr) {
-    return tm;
-  }
+static llvm::TargetMachine* CreateARMTargetMachine(const GlobalContext& ctx) {
   LLVMInitializeAArch64TargetInfo();
   LLVMInitializeAArch64Target();
   LLVMInitializeAArch64TargetMC();
@@ -50,7 +43,10 @@ static llvm::TargetMachine* GetARMTargetMachine(const GlobalContext& ctx) {
   if (cpu.empty() || cpu == "native") {
     cpu = "cortex-a57";
   }
-  llvm::StringRef features("+fp-armv8");
+  std::string features = "+fp-armv8";
+  if (!ctx.GetTargetFeatures().empty()) {
+    features += "," + ctx.GetTargetFeatures();
+  }
   llvm::Reloc::Model reloc = llvm::Reloc::Static;
   llvm::CodeGenOpt::Level opt_level = llvm::CodeGenOpt::Aggressive;
   llvm::CodeModel::Model cm = llvm::CodeModel::Large;
@@ -60,8 +56,12 @@ static llvm::TargetMachine* GetARMTargetMachine(const GlobalContext& ctx) {
   options.NoNaNsFPMath = true;
   options.NoSignedZerosFPMath = true;
 
-  tm = target->createTargetMachine(triple.getTriple(), cpu, features, options,
-                                   reloc, cm, opt_level);
+  return target->createTargetMachine(triple.getTriple(), cpu, features, options,
+                                     reloc, cm, opt_level);
+}
+
+static llvm::TargetMachine* GetARMTargetMachine(const GlobalContext& ctx) {
+  static llvm::TargetMachine* tm = CreateARMTargetMachine(ctx);
   return tm;
 }
 
@@ -76,22 +76,11 @@ llvm::TargetMachine* ARMLLVMIRCodeGen::InitTargetMachine() {
 }
 
 ARMBinaryWriter::ARMBinaryWriter(std::ostream& os)
-    : CodeWriter("ARM Binary Writer", os) {}
-
-bool ARMBinaryWriter::RunOnModule(Module* module) {
-  llvm::legacy::PassManager pm;
-  std::error_code ec;
-  llvm::raw_os_ostream llvm_os(os_);
-  llvm::buffer_ostream buf(llvm_os);
-  GlobalContext& ctx = module->GetGlobalContext();
-
-  auto llvm_module =
-      module->GetGlobalContext().GetCodeGenObject().GetLLVMModule();
+    : GenericObjectWriter("ARM Binary Writer", os) {}
 
-  GetARMTargetMachine(ctx)->addPassesToEmitFile(
-      pm, buf, nullptr, llvm::TargetMachine::CodeGenFileType::CGFT_ObjectFile);
-  pm.run(*llvm_module);
-  return false;
+std::unique_ptr<llvm::TargetMachine> ARMBinaryWriter::CreateTargetMachine(
+    const GlobalContext& ctx) const {
+  return std::unique_ptr<llvm::TargetMachine>(CreateARMTargetMachine(ctx));
 }
 
 ARMConstantWriter::ARMConstantWriter(std::ostream& os)
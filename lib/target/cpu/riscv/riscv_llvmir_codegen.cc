@@ -18,22 +18,15 @@
 #include "halo/lib/target/cpu/riscv/binary/riscv_llvmir_codegen.h"
 
 #include "llvm-c/Target.h"
-#include "llvm/IR/LegacyPassManager.h"
 #include "llvm/MC/MCTargetOptions.h"
 #include "llvm/Support/CodeGen.h"
 #include "llvm/Support/TargetRegistry.h"
-#include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Target/TargetMachine.h"
-#include "halo/lib/target/codegen_object.h"
 #include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
 
 namespace halo {
 
-static llvm::TargetMachine* GetRISCVTargetMachine(const GlobalContext& ctx) {
-  static llvm::TargetMachine* tm = nullptr;
-  if (tm != nullptr) {
-    return tm;
-  }
+static llvm::TargetMachine* CreateRISCVTargetMachine(const GlobalContext& ctx) {
   LLVMInitializeRISCVTargetInfo();
   LLVMInitializeRISCVTarget();
   LLVMInitializeRISCVTargetMC();
@@ -51,9 +44,10 @@ static llvm::TargetMachine* GetRISCVTargetMachine(const GlobalContext& ctx) {
   if (cpu.empty() || cpu == "native") {
     cpu = "generic-rv32";
   }
-
-  // TODO (unknown) : get target specific feature string from ctx.
-  llvm::StringRef features("+a,+m,+f,+d,+c,+relax");
+  std::string features = "+a,+m,+f,+d,+c,+relax";
+  if (!ctx.GetTargetFeatures().empty()) {
+    features += "," + ctx.GetTargetFeatures();
+  }
   llvm::Reloc::Model reloc = llvm::Reloc::Static;
   llvm::CodeGenOpt::Level opt_level = llvm::CodeGenOpt::Aggressive;
   llvm::CodeModel::Model cm = llvm::CodeModel::Medium;
@@ -65,8 +59,12 @@ static llvm::TargetMachine* GetRISCVTargetMachine(const GlobalContext& ctx) {
   options.NoNaNsFPMath = true;
   options.NoSignedZerosFPMath = true;
 
-  tm = target->createTargetMachine(triple.getTriple(), cpu, features, options,
-                                   reloc, cm, opt_level);
+  return target->createTargetMachine(triple.getTriple(), cpu, features, options,
+                                     reloc, cm, opt_level);
+}
+
+static llvm::TargetMachine* GetRISCVTargetMachine(const GlobalContext& ctx) {
+  static llvm::TargetMachine* tm = CreateRISCVTargetMachine(ctx);
   return tm;
 }
 
@@ -84,22 +82,11 @@ llvm::TargetMachine* RISCVLLVMIRCodeGen::InitTargetMachine() {
 }
 
 RISCVBinaryWriter::RISCVBinaryWriter(std::ostream& os)
-    : CodeWriter("RISCV Binary Writer", os) {}
-
-bool RISCVBinaryWriter::RunOnModule(Module* module) {
-  llvm::legacy::PassManager pm;
-  std::error_code ec;
-  llvm::raw_os_ostream llvm_os(os_);
-  llvm::buffer_ostream buf(llvm_os);
-  GlobalContext& ctx = module->GetGlobalContext();
-
-  auto llvm_module =
-      module->GetGlobalContext().GetCodeGenObject().GetLLVMModule();
+    : GenericObjectWriter("RISCV Binary Writer", os) {}
 
-  GetRISCVTargetMachine(ctx)->addPassesToEmitFile(
-      pm, buf, nullptr, llvm::TargetMachine::CodeGenFileType::CGFT_ObjectFile);
-  pm.run(*llvm_module);
-  return false;
+std::unique_ptr<llvm::TargetMachine> RISCVBinaryWriter::CreateTargetMachine(
+    const GlobalContext& ctx) const {
+  return std::unique_ptr<llvm::TargetMachine>(CreateRISCVTargetMachine(ctx));
 }
 
 RISCVConstantWriter::RISCVConstantWriter(std::ostream& os)
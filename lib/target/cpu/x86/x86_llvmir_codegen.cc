@@ -17,22 +17,25 @@
 
 #include "halo/lib/target/cpu/x86/binary/x86_llvmir_codegen.h"
 
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 #include "llvm-c/Target.h"
-#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/TargetRegistry.h"
-#include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Target/TargetMachine.h"
-#include "halo/lib/target/codegen_object.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
 #include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
 
 namespace halo {
 
-static llvm::TargetMachine* GetX86TargetMachine(const GlobalContext& ctx) {
-  static llvm::TargetMachine* tm = nullptr;
-  if (tm != nullptr) {
-    return tm;
-  }
+static llvm::TargetMachine* CreateX86TargetMachine(const GlobalContext& ctx) {
   // LLVMInitializeNativeTarget();
   LLVMInitializeX86TargetInfo();
   LLVMInitializeX86Target();
@@ -48,11 +51,11 @@ static llvm::TargetMachine* GetX86TargetMachine(const GlobalContext& ctx) {
   }
   HLCHECK(target);
   auto cpu = ctx.GetProcessorName();
+  std::string features = ctx.GetTargetFeatures();
   if (cpu.empty() || cpu == "native") {
     cpu = llvm::sys::getHostCPUName();
+    features = GenericLLVMIRCodeGen::GetHostCPUFeatures(features);
   }
-  llvm::StringRef features(
-      ""); // TODO (unknown) : get target specific feature string from ctx.
   llvm::Reloc::Model reloc = llvm::Reloc::Static;
   llvm::CodeGenOpt::Level opt_level = llvm::CodeGenOpt::Aggressive;
   llvm::CodeModel::Model cm = llvm::CodeModel::Medium;
@@ -62,8 +65,12 @@ static llvm::TargetMachine* GetX86TargetMachine(const GlobalContext& ctx) {
   options.NoNaNsFPMath = true;
   options.NoSignedZerosFPMath = true;
 
-  tm = target->createTargetMachine(triple.getTriple(), cpu, features, options,
-                                   reloc, cm, opt_level);
+  return target->createTargetMachine(triple.getTriple(), cpu, features, options,
+                                     reloc, cm, opt_level);
+}
+
+static llvm::TargetMachine* GetX86TargetMachine(const GlobalContext& ctx) {
+  static llvm::TargetMachine* tm = CreateX86TargetMachine(ctx);
   return tm;
 }
 
@@ -77,23 +84,160 @@ llvm::TargetMachine* X86LLVMIRCodeGen::InitTargetMachine() {
   return GetX86TargetMachine(*ctx_);
 }
 
+namespace {
+// A function variant built for an ISA level of _sn_rt_get_x86_isa_level().
+struct ISAVariant {
+  const char* suffix;
+  int level;
+  const char* features;
+};
+} // namespace
+
+// Ordered from the widest ISA, which is tried first by the dispatchers.
+static const ISAVariant kISAVariants[] = {
+    {"_avx512", 3,
+     "+avx512f,+avx512bw,+avx512dq,+avx512vl,+avx2,+fma,+popcnt"},
+    {"_avx2", 2, "+avx2,+fma,+popcnt"},
+    {"_sse42", 1, "+sse4.2,+popcnt"},
+};
+
+static const char* const kISALevelFuncName = "_sn_rt_get_x86_isa_level";
+
+// Returns the defined functions reachable from `roots` through calls or taken
+// addresses, `roots` included.
+static std::vector<llvm::Function*> GetReachableFunctions(
+    const std::vector<llvm::Function*>& roots, const llvm::Function* skipped) {
+  std::vector<llvm::Function*> funcs(roots);
+  std::unordered_set<const llvm::Function*> visited(roots.begin(), roots.end());
+  visited.insert(skipped);
+  for (size_t i = 0; i < funcs.size(); ++i) {
+    for (auto& bb : *funcs[i]) {
+      for (auto& inst : bb) {
+        for (const llvm::Use& op : inst.operands()) {
+          auto callee =
+              llvm::dyn_cast<llvm::Function>(op->stripPointerCasts());
+          if (callee != nullptr && !callee->isDeclaration() &&
+              visited.insert(callee).second) {
+            funcs.push_back(callee);
+          }
+        }
+      }
+    }
+  }
+  return funcs;
+}
+
+void X86LLVMIRCodeGen::LinkRuntimeLib() {
+  if (fat_binary_) {
+    // Declared first so the runtime library provides the definition.
+    llvm_module_->getOrInsertFunction(
+        kISALevelFuncName, llvm::Type::getInt32Ty(llvm_module_->getContext()));
+  }
+  GenericLLVMIRCodeGen::LinkRuntimeLib();
+  if (fat_binary_) {
+    EmitISAVariants();
+  }
+}
+
+void X86LLVMIRCodeGen::EmitISAVariants() {
+  llvm::Function* get_isa_level = llvm_module_->getFunction(kISALevelFuncName);
+  HLCHECK(get_isa_level != nullptr && !get_isa_level->isDeclaration());
+
+  std::vector<llvm::Function*> entries;
+  for (auto& func : *llvm_module_) {
+    if (!func.isDeclaration() && !func.hasLocalLinkage()) {
+      entries.push_back(&func);
+    }
+  }
+  std::vector<llvm::Function*> funcs =
+      GetReachableFunctions(entries, get_isa_level);
+
+  // Clones all the reachable functions for each variant. Calls and function
+  // pointers are remapped to the clones of the same variant.
+  std::unordered_map<const llvm::Function*, std::vector<llvm::Function*>>
+      entry_variants;
+  for (const ISAVariant& variant : kISAVariants) {
+    llvm::ValueToValueMapTy vmap;
+    std::vector<llvm::Function*> clones;
+    clones.reserve(funcs.size());
+    for (llvm::Function* func : funcs) {
+      llvm::Function* clone = llvm::Function::Create(
+          func->getFunctionType(), llvm::GlobalValue::InternalLinkage,
+          func->getName() + variant.suffix, llvm_module_.get());
+      vmap[func] = clone;
+      clones.push_back(clone);
+    }
+    for (size_t i = 0, e = funcs.size(); i < e; ++i) {
+      llvm::Function* func = funcs[i];
+      llvm::Function* clone = clones[i];
+      auto clone_arg = clone->arg_begin();
+      for (auto& arg : func->args()) {
+        clone_arg->setName(arg.getName());
+        vmap[&arg] = &*clone_arg++;
+      }
+      llvm::SmallVector<llvm::ReturnInst*, 4> returns;
+      llvm::CloneFunctionInto(clone, func, vmap, false, returns);
+      clone->setLinkage(llvm::GlobalValue::InternalLinkage);
+      clone->addFnAttr("target-features", variant.features);
+    }
+    for (size_t i = 0, e = entries.size(); i < e; ++i) {
+      entry_variants[entries[i]].push_back(clones[i]);
+    }
+  }
+
+  // The original function becomes the baseline variant and a dispatcher
+  // takes over its name.
+  for (llvm::Function* entry : entries) {
+    std::string name = entry->getName();
+    entry->setName(name + "_generic");
+    entry->setLinkage(llvm::GlobalValue::InternalLinkage);
+    llvm::Function* dispatcher =
+        llvm::Function::Create(entry->getFunctionType(),
+                               llvm::GlobalValue::ExternalLinkage, name,
+                               llvm_module_.get());
+    dispatcher->copyAttributesFrom(entry);
+    std::vector<llvm::Value*> args;
+    auto entry_arg = entry->arg_begin();
+    for (auto& arg : dispatcher->args()) {
+      arg.setName((entry_arg++)->getName());
+      args.push_back(&arg);
+    }
+
+    auto& llvm_ctx = llvm_module_->getContext();
+    llvm::IRBuilder<> builder(
+        llvm::BasicBlock::Create(llvm_ctx, "entry", dispatcher));
+    auto emit_tail_call = [&builder, &args](llvm::Function* callee) {
+      llvm::CallInst* call = builder.CreateCall(callee, args);
+      call->setTailCall();
+      if (call->getType()->isVoidTy()) {
+        builder.CreateRetVoid();
+      } else {
+        builder.CreateRet(call);
+      }
+    };
+    llvm::Value* level = builder.CreateCall(get_isa_level);
+    const auto& variants = entry_variants[entry];
+    for (size_t i = 0, e = variants.size(); i < e; ++i) {
+      auto call_bb = llvm::BasicBlock::Create(
+          llvm_ctx, std::string("isa") + kISAVariants[i].suffix, dispatcher);
+      auto next_bb = llvm::BasicBlock::Create(llvm_ctx, "next", dispatcher);
+      builder.CreateCondBr(
+          builder.CreateICmpSGE(level, builder.getInt32(kISAVariants[i].level)),
+          call_bb, next_bb);
+      builder.SetInsertPoint(call_bb);
+      emit_tail_call(variants[i]);
+      builder.SetInsertPoint(next_bb);
+    }
+    emit_tail_call(entry);
+  }
+}
+
 X86BinaryWriter::X86BinaryWriter(std::ostream& os)
-    : CodeWriter("X86 Binary Writer", os) {}
-
-bool X86BinaryWriter::RunOnModule(Module* module) {
-  llvm::legacy::PassManager pm;
-  std::error_code ec;
-  llvm::raw_os_ostream llvm_os(os_);
-  llvm::buffer_ostream buf(llvm_os);
-  GlobalContext& ctx = module->GetGlobalContext();
-
-  auto llvm_module =
-      module->GetGlobalContext().GetCodeGenObject().GetLLVMModule();
-
-  GetX86TargetMachine(ctx)->addPassesToEmitFile(
-      pm, buf, nullptr, llvm::TargetMachine::CodeGenFileType::CGFT_ObjectFile);
-  pm.run(*llvm_module);
-  return false;
+    : GenericObjectWriter("X86 Binary Writer", os) {}
+
+std::unique_ptr<llvm::TargetMachine> X86BinaryWriter::CreateTargetMachine(
+    const GlobalContext& ctx) const {
+  return std::unique_ptr<llvm::TargetMachine>(CreateX86TargetMachine(ctx));
 }
 
 X86ConstantWriter::X86ConstantWriter(std::ostream& os)
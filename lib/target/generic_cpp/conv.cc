@@ -81,7 +81,8 @@ void GenericCXXCodeGen::RunOnInstruction(Conv2DInst* inst) {
                std::vector<uint32_t>{padding_top, padding_left},
                std::vector<uint32_t>{padding_bottom, padding_right}, bias_name,
                EmitShape(ret_type));
-  ir_mapping_[*inst] = ret;
+  ir_mapping_[*inst] = EmitFusedActivation(*inst, ret, inst->GetActivation(),
+                                           inst->GetActivationAlpha());
   return;
 
   const auto& axis_info = ImageAxisInfo::GetImageAxisInfo(
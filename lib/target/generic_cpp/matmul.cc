@@ -42,7 +42,8 @@ void GenericCXXCodeGen::RunOnInstruction(MatMulInst* inst) {
 
   EmitODLACall(ret, "odla_Gemm", op0, inst->GetTransposeA(), op1,
                inst->GetTransposeB(), 1, 0, bias_name, EmitShape(ret_type));
-  ir_mapping_[*inst] = ret;
+  ir_mapping_[*inst] = EmitFusedActivation(*inst, ret, inst->GetActivation(),
+                                           inst->GetActivationAlpha());
 }
 
 void GenericCXXCodeGen::RunOnInstruction(BatchMatMulInst* inst) {
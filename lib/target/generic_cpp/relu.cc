@@ -15,6 +15,7 @@
 // limitations under the License.
 // =============================================================================
 
+#include "halo/lib/framework/common.h"
 #include "halo/lib/target/generic_cxx/generic_cxx_codegen.h"
 
 namespace halo {
@@ -53,4 +54,33 @@ void GenericCXXCodeGen::RunOnInstruction(LeakyReluInst* inst) {
   ir_mapping_[*inst] = ret;
 }
 
+CXXValue GenericCXXCodeGen::EmitFusedActivation(const Instruction& inst,
+                                                const CXXValue& value,
+                                                ActivationType activation,
+                                                float alpha) {
+  if (activation == ActivationType::NONE) {
+    return value;
+  }
+  CXXValue ret(inst.GetName() + "_act", value.type);
+  switch (activation) {
+    case ActivationType::RELU: {
+      EmitODLACall(ret, "odla_Relu", value);
+      break;
+    }
+    case ActivationType::RELU6: {
+      constexpr int hi = 6;
+      EmitODLACall(ret, "odla_Clamp", value, 0, hi);
+      break;
+    }
+    case ActivationType::LEAKY_RELU: {
+      EmitODLACall(ret, "odla_LeakyRelu", value, alpha);
+      break;
+    }
+    default: {
+      HLCHECK(0 && "Unsupported fused activation");
+    }
+  }
+  return ret;
+}
+
 } // namespace halo
@@ -42,7 +42,7 @@ void GenericLLVMIRCodeGen::RunOnInstruction(BatchMatMulInst* inst) {
   llvm::FunctionType* ftype = llvm::FunctionType::get(
       ir_builder->getVoidTy(),
       {ptr_type, ptr_type, ptr_type, int64_type, int64_type, int64_type,
-       int64_type, int64_type, bool_type, bool_type},
+       int64_type, int64_type, bool_type, bool_type, bool_type},
       false);
 
   llvm::FunctionCallee callee = llvm_module->getOrInsertFunction(fname, ftype);
@@ -50,27 +50,31 @@ void GenericLLVMIRCodeGen::RunOnInstruction(BatchMatMulInst* inst) {
   llvm::Value* param0 = ir_builder->CreateBitCast(op0, ptr_type);
   llvm::Value* param1 = ir_builder->CreateBitCast(op1, ptr_type);
   const halo::Type& lhs_type = lhs.GetType();
+  const halo::Type& rhs_type = rhs.GetType();
   size_t dim_size = lhs_type.GetNumOfDims();
+  size_t rhs_dim_size = rhs_type.GetNumOfDims();
   int64_t lhs_row = lhs_type.GetNumOfElementsInDim(dim_size - 2);
   int64_t lhs_col = lhs_type.GetNumOfElementsInDim(dim_size - 1);
+  int64_t rhs_row = rhs_type.GetNumOfElementsInDim(rhs_dim_size - 2);
+  int64_t rhs_col = rhs_type.GetNumOfElementsInDim(rhs_dim_size - 1);
   size_t num_batches = lhs_type.GetTotalNumOfElements() / lhs_row / lhs_col;
+  // The rhs is shared by all batches, so the runtime packs it only once.
+  bool shared_rhs = rhs_type.GetTotalNumOfElements() == rhs_row * rhs_col;
   llvm::Value* dim_lhs_0 = ir_builder->getInt64(lhs_row);
   llvm::Value* dim_lhs_1 = ir_builder->getInt64(lhs_col);
-  llvm::Value* dim_rhs_0 =
-      ir_builder->getInt64(rhs.GetType().GetNumOfElementsInDim(dim_size - 2));
-  llvm::Value* dim_rhs_1 =
-      ir_builder->getInt64(rhs.GetType().GetNumOfElementsInDim(dim_size - 1));
+  llvm::Value* dim_rhs_0 = ir_builder->getInt64(rhs_row);
+  llvm::Value* dim_rhs_1 = ir_builder->getInt64(rhs_col);
 
   llvm::Value* batch = ir_builder->getInt64(num_batches);
   llvm::Value* transpose_a = ir_builder->getInt1(inst->GetTransposeA());
   llvm::Value* transpose_b = ir_builder->getInt1(inst->GetTransposeB());
+  llvm::Value* shared_b = ir_builder->getInt1(shared_rhs);
 
-  llvm::Value* ret_buf = ir_builder->CreateAlloca(
-      TensorTypeToLLVMType(inst->GetResultType(), false), nullptr,
-      inst->GetName());
+  llvm::Value* ret_buf = AllocateLLVMBuffer(ir_builder, Def{inst, 0});
   llvm::Value* ret_buf_ptr = ir_builder->CreateBitCast(ret_buf, ptr_type);
   CreateCall(&callee, {ret_buf_ptr, param0, param1, batch, dim_lhs_0, dim_lhs_1,
-                       dim_rhs_0, dim_rhs_1, transpose_a, transpose_b});
+                       dim_rhs_0, dim_rhs_1, transpose_a, transpose_b,
+                       shared_b});
   ir_mapping_[*inst] = ret_buf;
 }
 
@@ -0,0 +1,141 @@
+//===- concat.cc ----------------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "llvm/IR/IRBuilder.h"
+#include "halo/lib/framework/data_layout.h"
+#include "halo/lib/framework/global_context.h"
+#include "halo/lib/ir/common_instructions.h"
+#include "halo/lib/mm/alias_analyzer.h"
+#include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
+
+namespace halo {
+
+static int GetNumOfInputs(const ConcatInst& inst) {
+  return inst.GetN() > 0 ? inst.GetN()
+                         : static_cast<int>(inst.GetNumOfOperands());
+}
+
+// Returns the number of blocks of the concatenated axis and the following
+// ones, i.e. the product of the dimensions before the axis.
+static int64_t GetNumOfRows(const ConcatInst& inst) {
+  const halo::Type& type = inst.GetResultType();
+  int axis = inst.GetAxis();
+  if (axis < 0) {
+    axis += type.GetNumOfDims();
+  }
+  int64_t rows = 1;
+  for (int i = 0; i < axis; ++i) {
+    rows *= type.GetNumOfElementsInDim(i);
+  }
+  return rows;
+}
+
+void GenericLLVMIRCodeGen::PlanConcatInPlace(const Function& function) {
+  concat_slots_.clear();
+  concat_buffers_.clear();
+  const DataLayout& dl = function.GetGlobalContext().GetDefaultDataLayout();
+  for (auto& bb : function) {
+    for (auto& it : *bb) {
+      ConcatInst* inst = DynCast<ConcatInst>(it.get());
+      // Only the inputs concatenated along the outermost axis (ignoring the
+      // ones of a single element) occupy a contiguous part of the result.
+      if (inst == nullptr || !inst->GetResultType().IsValid() ||
+          inst->GetResultType().GetTotalNumOfElements() <=
+              kMaxStackBufferSize ||
+          GetNumOfRows(*inst) != 1) {
+        continue;
+      }
+      int64_t offset = 0;
+      for (int i = 0, e = GetNumOfInputs(*inst); i < e; ++i) {
+        const Def& op = inst->GetOperand(i);
+        Instruction* producer = DynCast<Instruction>(op.GetOwner());
+        // The input must not be read by anything else.
+        if (producer != nullptr && !AliasAnalyzer::IsView(*producer) &&
+            producer->GetResultsUses()[op.GetDefResultIdx()]
+                    .GetNumOfUses() == 1) {
+          concat_slots_.emplace(op, std::make_pair(Def{inst, 0}, offset));
+        }
+        offset += dl.Bytes(op.GetType());
+      }
+    }
+  }
+}
+
+void GenericLLVMIRCodeGen::RunOnInstruction(ConcatInst* inst) {
+  llvm::IRBuilder<>* ir_builder = current_llvm_builder_;
+  const halo::Type& ret_type = inst->GetResultType();
+  const Def ret{inst, 0};
+
+  llvm::Type* elem_type = SNTypeToLLVMType(ret_type.GetDataType());
+  llvm::PointerType* data_ptr_type = elem_type->getPointerTo();
+  llvm::Type* int64_type = ir_builder->getInt64Ty();
+  auto alignment = llvm_module_->getDataLayout().getABITypeAlignment(elem_type);
+  auto elem_size = llvm_module_->getDataLayout().getTypeAllocSize(elem_type);
+
+  llvm::Value* ret_buf = AllocateLLVMBuffer(ir_builder, ret);
+  llvm::Value* ret_buf_ptr = ir_builder->CreateBitCast(ret_buf, data_ptr_type);
+
+  // The result is seen as rows made of one block of each input.
+  int64_t rows = GetNumOfRows(*inst);
+  int64_t row_size = ret_type.GetTotalNumOfElements() / rows;
+  int64_t offset = 0;
+  for (int i = 0, e = GetNumOfInputs(*inst); i < e; ++i) {
+    const Def& op = inst->GetOperand(i);
+    int64_t size = op.GetType().GetTotalNumOfElements() / rows;
+    auto alias = buffer_aliases_.find(op);
+    // Inputs already written in place need no copy.
+    if (alias != buffer_aliases_.end() && alias->second == ret) {
+      offset += size;
+      continue;
+    }
+    llvm::Value* op_i = ir_mapping_[op];
+    if (!op_i->getType()->isPointerTy()) {
+      auto buf =
+          ir_builder->CreateAlloca(TensorTypeToLLVMType(op.GetType(), false),
+                                   nullptr, op.GetOwner()->GetName() + "_buf");
+      ir_builder->CreateStore(op_i, buf);
+      op_i = buf;
+    }
+    op_i = ir_builder->CreateBitCast(op_i, data_ptr_type);
+    if (rows == 1) {
+      llvm::Value* dst = ir_builder->CreateInBoundsGEP(
+          ret_buf_ptr, ir_builder->getInt64(offset));
+      ir_builder->CreateMemCpy(dst, alignment, op_i, alignment,
+                               ir_builder->getInt64(size * elem_size));
+    } else {
+      // The runtime copies bytes, so it handles every element type.
+      llvm::PointerType* i8_ptr_type = ir_builder->getInt8PtrTy();
+      llvm::FunctionType* ftype = llvm::FunctionType::get(
+          ir_builder->getVoidTy(),
+          {i8_ptr_type, i8_ptr_type, int64_type, int64_type, int64_type,
+           int64_type, int64_type},
+          false);
+      llvm::FunctionCallee callee =
+          llvm_module_->getOrInsertFunction("_sn_rt_concat", ftype);
+      CreateCall(&callee,
+                 {ir_builder->CreateBitCast(ret_buf_ptr, i8_ptr_type),
+                  ir_builder->CreateBitCast(op_i, i8_ptr_type),
+                  ir_builder->getInt64(rows), ir_builder->getInt64(size),
+                  ir_builder->getInt64(row_size), ir_builder->getInt64(offset),
+                  ir_builder->getInt64(elem_size)});
+    }
+    offset += size;
+  }
+  ir_mapping_[*inst] = ret_buf;
+}
+
+} // namespace halo
@@ -15,12 +15,213 @@
 // limitations under the License.
 // =============================================================================
 
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "halo/lib/ir/ir_builder.h"
 #include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
 #include "halo/lib/transforms/type_legalizer.h"
 #include "llvm/IR/IRBuilder.h"
 
 namespace halo {
 
+// Returns true if the convolution qualifies for Winograd F(4x4, 3x3): constant
+// 3x3 kernel, unit stride and dilation, and enough channels to amortize the
+// tile transforms.
+static bool IsWinogradConv(const Conv2DInst& inst, const ImageAxisInfo& info) {
+  constexpr int64_t min_channels = 8;
+  constexpr int64_t min_pixels = 16;
+  const Def& kernel = inst.GetOperand(1);
+  const auto& kernel_type = kernel.GetType();
+  const auto& ret_type = inst.GetResultType();
+  if (!IsA<Constant>(kernel.GetOwner()) ||
+      kernel_type.GetDataType() != DataType::FLOAT32 || inst.GetGroup() != 1) {
+    return false;
+  }
+  const auto& strides = inst.GetStrides();
+  const auto& dilations = inst.GetDilations();
+  for (int axis : {info.data_height_axis, info.data_width_axis}) {
+    if (strides[axis] != 1 || (!dilations.empty() && dilations[axis] != 1)) {
+      return false;
+    }
+  }
+  return kernel_type.GetNumOfElementsInDim(info.kernel_height_axis) == 3 &&
+         kernel_type.GetNumOfElementsInDim(info.kernel_width_axis) == 3 &&
+         kernel_type.GetNumOfElementsInDim(info.kernel_input_axis) >=
+             min_channels &&
+         kernel_type.GetNumOfElementsInDim(info.kernel_output_axis) >=
+             min_channels &&
+         ret_type.GetNumOfElementsInDim(info.data_height_axis) *
+                 ret_type.GetNumOfElementsInDim(info.data_width_axis) >=
+             min_pixels;
+}
+
+// Computes U = G * g * G^T for each (input, output) channel pair. The result is
+// laid out as [36][ic][oc] as expected by _sn_rt_conv2d_winograd_f32_*.
+static std::vector<float> TransformWinogradKernel(const Constant& kernel,
+                                                  const ImageAxisInfo& info) {
+  constexpr int alpha = 6;
+  constexpr int r = 3;
+  static const double g_mat[alpha][r] = {
+      {1.0 / 4, 0, 0},
+      {-1.0 / 6, -1.0 / 6, -1.0 / 6},
+      {-1.0 / 6, 1.0 / 6, -1.0 / 6},
+      {1.0 / 24, 1.0 / 12, 1.0 / 6},
+      {1.0 / 24, -1.0 / 12, 1.0 / 6},
+      {0, 0, 1}};
+  const auto& type = kernel.GetResultType();
+  auto dims = type.GetNumOfDims();
+  std::vector<int64_t> strides(dims, 1);
+  for (int i = static_cast<int>(dims) - 2; i >= 0; --i) {
+    strides[i] = strides[i + 1] * type.GetNumOfElementsInDim(i + 1);
+  }
+  int64_t ic = type.GetNumOfElementsInDim(info.kernel_input_axis);
+  int64_t oc = type.GetNumOfElementsInDim(info.kernel_output_axis);
+  const float* data = kernel.GetDataPtr<float>();
+  std::vector<float> ret(alpha * alpha * ic * oc);
+  for (int64_t i = 0; i < ic; ++i) {
+    for (int64_t o = 0; o < oc; ++o) {
+      const float* g = data + i * strides[info.kernel_input_axis] +
+                       o * strides[info.kernel_output_axis];
+      auto at = [&](int h, int w) {
+        return static_cast<double>(g[h * strides[info.kernel_height_axis] +
+                                     w * strides[info.kernel_width_axis]]);
+      };
+      // tmp = G * g
+      double tmp[alpha][r];
+      for (int a = 0; a < alpha; ++a) {
+        for (int w = 0; w < r; ++w) {
+          tmp[a][w] = 0;
+          for (int h = 0; h < r; ++h) {
+            tmp[a][w] += g_mat[a][h] * at(h, w);
+          }
+        }
+      }
+      // U = tmp * G^T
+      for (int a = 0; a < alpha; ++a) {
+        for (int b = 0; b < alpha; ++b) {
+          double u = 0;
+          for (int w = 0; w < r; ++w) {
+            u += tmp[a][w] * g_mat[b][w];
+          }
+          ret[((a * alpha + b) * ic + i) * oc + o] = static_cast<float>(u);
+        }
+      }
+    }
+  }
+  return ret;
+}
+
+bool GenericLLVMIRCodeGen::IsWinogradKernel(const Constant& constant) const {
+  if (!enable_winograd_ || constant.GetResultsUses().empty() ||
+      !constant.GetResultsUses()[0].HasUses()) {
+    return false;
+  }
+  for (const auto& use : constant.GetResultsUses()[0]) {
+    IRObject* user = use.GetUse();
+    if (use.GetUseOperandIdx() != 1 || !IsA<Instruction>(user) ||
+        DynCast<Instruction>(user)->GetOpCode() != OpCode::CONV2D) {
+      return false;
+    }
+    const auto& conv = *Downcast<Conv2DInst>(user);
+    const auto& info = ImageAxisInfo::GetImageAxisInfo(conv.GetDataFormat(),
+                                                       conv.GetFilterFormat());
+    if (!IsWinogradConv(conv, info)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+llvm::Value* GenericLLVMIRCodeGen::GetWinogradKernel(Conv2DInst* inst) {
+  const auto& info = ImageAxisInfo::GetImageAxisInfo(inst->GetDataFormat(),
+                                                     inst->GetFilterFormat());
+  const Constant& kernel = *DynCast<Constant>(inst->GetOperand(1).GetOwner());
+  const std::string name = kernel.GetName() + "_winograd";
+  // Kernels shared by several convolutions are transformed only once.
+  if (llvm::GlobalVariable* gv = llvm_module_->getNamedGlobal(name)) {
+    return gv;
+  }
+  // The transformed kernel goes straight into the LLVM module, so no transform
+  // runs at inference time and the Halo IR is left untouched. The original
+  // kernel is not emitted when only Winograd convolutions use it.
+  std::vector<float> data = TransformWinogradKernel(kernel, info);
+  llvm::Constant* cv = llvm::ConstantDataArray::get(
+      llvm_module_->getContext(), llvm::ArrayRef<float>(data));
+  return new llvm::GlobalVariable(*llvm_module_, cv->getType(), true,
+                                  llvm::GlobalValue::InternalLinkage, cv, name);
+}
+
+// Returns the fused per-channel bias of a convolution (the optional third
+// operand), or a null pointer.
+static llvm::Value* GetConvBias(const Conv2DInst& inst,
+                                const std::unordered_map<Def, llvm::Value*>& ir,
+                                llvm::IRBuilder<>* ir_builder,
+                                llvm::Type* ptr_ty, int64_t output_channel) {
+  if (inst.GetNumOfOperands() < 3) {
+    return llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(ptr_ty));
+  }
+  const Def& bias = inst.GetOperand(2);
+  HLCHECK(bias.GetType().GetTotalNumOfElements() == output_channel &&
+          "Conv bias must have one value per output channel");
+  return ir_builder->CreateBitCast(ir.at(bias), ptr_ty);
+}
+
+void GenericLLVMIRCodeGen::RunOnWinogradConv(Conv2DInst* inst,
+                                             llvm::Value* data) {
+  llvm::IRBuilder<>* ir_builder = current_llvm_builder_;
+  const Def& lhs = inst->GetOperand(0);
+  const auto& info = ImageAxisInfo::GetImageAxisInfo(inst->GetDataFormat(),
+                                                     inst->GetFilterFormat());
+  std::string fname = "_sn_rt_conv2d_winograd" +
+                      SNTypeToRTLibFuncSuffix(lhs.GetType().GetDataType()) +
+                      DataFormatToRTLibFuncSuffix(inst->GetDataFormat());
+  llvm::Type* ptr_ty =
+      SNTypeToLLVMType(lhs.GetType().GetDataType())->getPointerTo();
+  llvm::Type* int64_ty = ir_builder->getInt64Ty();
+  llvm::Type* float_ty = ir_builder->getFloatTy();
+  llvm::FunctionType* ftype = llvm::FunctionType::get(
+      ir_builder->getVoidTy(),
+      {ptr_ty, ptr_ty, ptr_ty, ptr_ty, int64_ty, int64_ty, int64_ty, int64_ty,
+       int64_ty, int64_ty, int64_ty, int64_ty, int64_ty, float_ty, float_ty},
+      false);
+  auto llvm_module = ir_builder->GetInsertBlock()->getParent()->getParent();
+  llvm::FunctionCallee callee = llvm_module->getOrInsertFunction(fname, ftype);
+
+  const auto& data_type = lhs.GetType();
+  const auto& ret_type = inst->GetResultType();
+  int64_t output_channel =
+      ret_type.GetNumOfElementsInDim(info.data_channel_axis);
+  llvm::Value* kernel =
+      ir_builder->CreateBitCast(GetWinogradKernel(inst), ptr_ty);
+  llvm::Value* bias =
+      GetConvBias(*inst, ir_mapping_, ir_builder, ptr_ty, output_channel);
+  llvm::Value* result = AllocateLLVMBuffer(ir_builder, Def{inst, 0});
+  llvm::Value* ret_buf_ptr = ir_builder->CreateBitCast(result, ptr_ty);
+  auto clip = GetActivationClipRange(inst->GetActivation());
+  auto dim = [&data_type, ir_builder](int axis) {
+    return ir_builder->getInt64(data_type.GetNumOfElementsInDim(axis));
+  };
+  CreateCall(
+      &callee,
+      {ret_buf_ptr, data, kernel, bias, dim(info.batch_axis),
+       dim(info.data_height_axis), dim(info.data_width_axis),
+       dim(info.data_channel_axis),
+       ir_builder->getInt64(
+           ret_type.GetNumOfElementsInDim(info.data_height_axis)),
+       ir_builder->getInt64(
+           ret_type.GetNumOfElementsInDim(info.data_width_axis)),
+       ir_builder->getInt64(output_channel),
+       ir_builder->getInt64(inst->GetPaddingTop()),
+       ir_builder->getInt64(inst->GetPaddingLeft()),
+       llvm::ConstantFP::get(float_ty, clip.first),
+       llvm::ConstantFP::get(float_ty, clip.second)});
+  RunOnFusedActivation(*inst, inst->GetActivation(),
+                       inst->GetActivationAlpha(), result);
+  ir_mapping_[*inst] = result;
+}
+
 void GenericLLVMIRCodeGen::RunOnInstruction(Conv2DInst* inst0) {
   Conv2DInst& inst = *inst0;
   llvm::IRBuilder<>* ir_builder = current_llvm_builder_;
@@ -44,25 +245,38 @@ void GenericLLVMIRCodeGen::RunOnInstruction(Conv2DInst* inst0) {
 
   llvm::Type* ptr_ty =
       SNTypeToLLVMType(lhs.GetType().GetDataType())->getPointerTo();
+  HLCHECK((inst.GetDataFormat() == DataFormat::NHWC ||
+           inst.GetDataFormat() == DataFormat::NCHW) &&
+          "Data format NHWC is expected");
+  const auto& info = ImageAxisInfo::GetImageAxisInfo(inst.GetDataFormat(),
+                                                     inst.GetFilterFormat());
+  llvm::Value* data = ir_builder->CreateBitCast(op0, ptr_ty);
+  if (enable_winograd_ && IsWinogradConv(inst, info)) {
+    RunOnWinogradConv(inst0, data);
+    return;
+  }
+
   llvm::Type* int64_ty = ir_builder->getInt64Ty();
+  llvm::Type* float_ty = ir_builder->getFloatTy();
   llvm::FunctionType* ftype = llvm::FunctionType::get(
       ir_builder->getVoidTy(),
-      {ptr_ty, ptr_ty, ptr_ty, int64_ty, int64_ty, int64_ty, int64_ty, int64_ty,
-       int64_ty, int64_ty, int64_ty, int64_ty, int64_ty, int64_ty, int64_ty,
-       int64_ty, int64_ty, int64_ty},
+      {ptr_ty,   ptr_ty,   ptr_ty,   ptr_ty,   int64_ty, int64_ty,
+       int64_ty, int64_ty, int64_ty, int64_ty, int64_ty, int64_ty,
+       int64_ty, int64_ty, int64_ty, int64_ty, int64_ty, int64_ty,
+       int64_ty, int64_ty, int64_ty, int64_ty, float_ty, float_ty},
       false);
 
   auto llvm_module = ir_builder->GetInsertBlock()->getParent()->getParent();
   llvm::FunctionCallee callee = llvm_module->getOrInsertFunction(fname, ftype);
 
-  HLCHECK((inst.GetDataFormat() == DataFormat::NHWC ||
-           inst.GetDataFormat() == DataFormat::NCHW) &&
-          "Data format NHWC is expected");
-
-  const auto& info = ImageAxisInfo::GetImageAxisInfo(inst.GetDataFormat(),
-                                                     inst.GetFilterFormat());
-  llvm::Value* data = ir_builder->CreateBitCast(op0, ptr_ty);
+  int64_t oc = inst.GetResultType().GetNumOfElementsInDim(info.data_channel_axis);
+  int64_t group = std::max(inst.GetGroup(), 1);
+  HLCHECK(lhs.GetType().GetNumOfElementsInDim(info.data_channel_axis) %
+                  group ==
+              0 &&
+          oc % group == 0 && "Channels must be divisible by group");
   llvm::Value* kernel = ir_builder->CreateBitCast(op1, ptr_ty);
+  llvm::Value* bias = GetConvBias(inst, ir_mapping_, ir_builder, ptr_ty, oc);
   llvm::Value* batch = ir_builder->getInt64(
       lhs.GetType().GetNumOfElementsInDim(info.batch_axis));
   llvm::Value* spatial_h = ir_builder->getInt64(
@@ -75,8 +289,10 @@ void GenericLLVMIRCodeGen::RunOnInstruction(Conv2DInst* inst0) {
       rhs.GetType().GetNumOfElementsInDim(info.kernel_height_axis));
   llvm::Value* kernel_w = ir_builder->getInt64(
       rhs.GetType().GetNumOfElementsInDim(info.kernel_width_axis));
-  llvm::Value* output_channel = ir_builder->getInt64(
-      rhs.GetType().GetNumOfElementsInDim(info.kernel_output_axis));
+  // For grouped filters the kernel output dimension may not be the number of
+  // output channels (e.g. depthwise [kh, kw, ic, multiplier]), so take it from
+  // the result.
+  llvm::Value* output_channel = ir_builder->getInt64(oc);
   llvm::Value* output_h = ir_builder->getInt64(
       inst.GetResultType().GetNumOfElementsInDim(info.data_height_axis));
   llvm::Value* output_w = ir_builder->getInt64(
@@ -85,19 +301,31 @@ void GenericLLVMIRCodeGen::RunOnInstruction(Conv2DInst* inst0) {
       ir_builder->getInt64(inst.GetStrides()[info.data_height_axis]);
   llvm::Value* stride_w =
       ir_builder->getInt64(inst.GetStrides()[info.data_width_axis]);
+  llvm::Value* dilation_h =
+      ir_builder->getInt64(inst.GetDilations()[info.data_height_axis]);
+  llvm::Value* dilation_w =
+      ir_builder->getInt64(inst.GetDilations()[info.data_width_axis]);
   llvm::Value* padding_left = ir_builder->getInt64(inst.GetPaddingLeft());
   llvm::Value* padding_right = ir_builder->getInt64(inst.GetPaddingRight());
   llvm::Value* padding_top = ir_builder->getInt64(inst.GetPaddingTop());
   llvm::Value* padding_bottom = ir_builder->getInt64(inst.GetPaddingBottom());
+  // ReLU and ReLU6 activations are fused into the kernel as clipping.
+  auto clip = GetActivationClipRange(inst.GetActivation());
+  llvm::Value* clip_min = llvm::ConstantFP::get(float_ty, clip.first);
+  llvm::Value* clip_max = llvm::ConstantFP::get(float_ty, clip.second);
 
   llvm::Value* result = AllocateLLVMBuffer(ir_builder, Def{&inst, 0});
 
   llvm::Value* ret_buf_ptr = ir_builder->CreateBitCast(result, ptr_ty);
-  CreateCall(&callee, {ret_buf_ptr, data, kernel, batch, spatial_h, spatial_w,
-                       channel, output_h, output_w, output_channel, kernel_h,
-                       kernel_w, stride_h, stride_w, padding_left,
-                       padding_right, padding_top, padding_bottom});
+  CreateCall(&callee,
+             {ret_buf_ptr, data, kernel, bias, batch, spatial_h, spatial_w,
+              channel, output_h, output_w, output_channel, kernel_h, kernel_w,
+              stride_h, stride_w, dilation_h, dilation_w, padding_top,
+              padding_bottom, padding_left, padding_right,
+              ir_builder->getInt64(group), clip_min, clip_max});
+  RunOnFusedActivation(inst, inst.GetActivation(), inst.GetActivationAlpha(),
+                       result);
   ir_mapping_[inst] = result;
 }
 
-} // namespace halo
\ No newline at end of file
+} // namespace halo
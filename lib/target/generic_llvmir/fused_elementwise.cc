@@ -0,0 +1,427 @@
+//===- fused_elementwise.cc -----------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include <limits>
+#include <vector>
+
+#include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
+#include "halo/lib/transforms/fusion.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Metadata.h"
+
+namespace halo {
+
+// Elementwise loop nests with fewer elements run serially. This matches
+// _sn_rt_parallel_min_cost of the runtime library.
+static constexpr int64_t kParallelMinElements = 1 << 15;
+
+// Returns a distinct loop ID that enables the loop vectorizer on the loop.
+static llvm::MDNode* GetVectorizeLoopID(llvm::LLVMContext& ctx) {
+  llvm::Metadata* enable[] = {
+      llvm::MDString::get(ctx, "llvm.loop.vectorize.enable"),
+      llvm::ConstantAsMetadata::get(llvm::ConstantInt::getTrue(ctx))};
+  auto self = llvm::MDNode::getTemporary(ctx, llvm::None);
+  llvm::Metadata* ops[] = {self.get(), llvm::MDNode::get(ctx, enable)};
+  llvm::MDNode* loop_id = llvm::MDNode::getDistinct(ctx, ops);
+  loop_id->replaceOperandWith(0, loop_id);
+  return loop_id;
+}
+
+void GenericLLVMIRCodeGen::EmitLoopNest(
+    const std::vector<int64_t>& dims,
+    const std::function<void(const std::vector<llvm::Value*>&)>& body,
+    llvm::Value* outer_bound) {
+  llvm::IRBuilder<>* ir_builder = current_llvm_builder_;
+  llvm::Function* func = ir_builder->GetInsertBlock()->getParent();
+  std::vector<llvm::PHINode*> ivs;
+  std::vector<llvm::BasicBlock*> headers;
+  for (size_t i = 0, e = dims.size(); i < e; ++i) {
+    llvm::BasicBlock* preheader = ir_builder->GetInsertBlock();
+    llvm::BasicBlock* header =
+        llvm::BasicBlock::Create(GetLLVMContext(), "loop", func);
+    ir_builder->CreateBr(header);
+    ir_builder->SetInsertPoint(header);
+    llvm::PHINode* iv = ir_builder->CreatePHI(ir_builder->getInt64Ty(), 2,
+                                              "iv" + std::to_string(i));
+    iv->addIncoming(ir_builder->getInt64(0), preheader);
+    ivs.push_back(iv);
+    headers.push_back(header);
+  }
+  body(std::vector<llvm::Value*>(ivs.begin(), ivs.end()));
+  for (int i = static_cast<int>(dims.size()) - 1; i >= 0; --i) {
+    llvm::Value* next = ir_builder->CreateAdd(ivs[i], ir_builder->getInt64(1),
+                                              "", true /* HasNUW */);
+    llvm::BasicBlock* latch = ir_builder->GetInsertBlock();
+    llvm::BasicBlock* exit =
+        llvm::BasicBlock::Create(GetLLVMContext(), "loop.exit", func);
+    llvm::Value* bound = (i == 0 && outer_bound != nullptr)
+                             ? outer_bound
+                             : ir_builder->getInt64(dims[i]);
+    llvm::BranchInst* br = ir_builder->CreateCondBr(
+        ir_builder->CreateICmpULT(next, bound), headers[i], exit);
+    if (i == static_cast<int>(dims.size()) - 1) {
+      br->setMetadata(llvm::LLVMContext::MD_loop,
+                      GetVectorizeLoopID(GetLLVMContext()));
+    }
+    ivs[i]->addIncoming(next, latch);
+    ir_builder->SetInsertPoint(exit);
+  }
+}
+
+// Collapses the result dimensions into as few loops as possible: unit
+// dimensions are dropped and adjacent dimensions are merged if every input is
+// either broadcast along both or along none of them. Returns the loop bounds
+// and sets the stride of each input along each loop (0 if broadcast).
+static std::vector<int64_t> GetElementwiseLoops(
+    const Type& ret_type, const std::vector<Type>& types,
+    std::vector<std::vector<int64_t>>* strides) {
+  int rank = static_cast<int>(ret_type.GetNumOfDims());
+  std::vector<int64_t> dims;
+  std::vector<std::vector<bool>> full(types.size());
+  for (int d = 0; d < rank; ++d) {
+    int64_t n = ret_type.GetNumOfElementsInDim(d);
+    if (n == 1) {
+      continue;
+    }
+    std::vector<bool> mask(types.size());
+    for (size_t i = 0, e = types.size(); i < e; ++i) {
+      int axis = d - (rank - static_cast<int>(types[i].GetNumOfDims()));
+      mask[i] = axis >= 0 && types[i].GetNumOfElementsInDim(axis) == n;
+    }
+    bool mergeable = !dims.empty();
+    for (size_t i = 0, e = types.size(); i < e && mergeable; ++i) {
+      mergeable = full[i].back() == mask[i];
+    }
+    if (mergeable) {
+      dims.back() *= n;
+      continue;
+    }
+    dims.push_back(n);
+    for (size_t i = 0, e = types.size(); i < e; ++i) {
+      full[i].push_back(mask[i]);
+    }
+  }
+  if (dims.empty()) {
+    dims.push_back(1);
+    for (auto& f : full) {
+      f.push_back(false);
+    }
+  }
+  strides->assign(types.size(), std::vector<int64_t>(dims.size()));
+  for (size_t i = 0, e = types.size(); i < e; ++i) {
+    int64_t stride = 1;
+    for (int d = static_cast<int>(dims.size()) - 1; d >= 0; --d) {
+      (*strides)[i][d] = full[i][d] ? stride : 0;
+      stride *= full[i][d] ? dims[d] : 1;
+    }
+  }
+  return dims;
+}
+
+static llvm::Value* EmitElementwiseStep(llvm::IRBuilder<>* ir_builder,
+                                        const ElementwiseStep& step,
+                                        llvm::Value* lhs, llvm::Value* rhs) {
+  llvm::Type* ty = lhs->getType();
+  llvm::Value* zero = llvm::ConstantFP::get(ty, 0);
+  llvm::Value* one = llvm::ConstantFP::get(ty, 1);
+  switch (step.op_code) {
+    case OpCode::ADD: {
+      return ir_builder->CreateFAdd(lhs, rhs);
+    }
+    case OpCode::DIV: {
+      return ir_builder->CreateFDiv(lhs, rhs);
+    }
+    case OpCode::MAXIMUM: {
+      return ir_builder->CreateSelect(ir_builder->CreateFCmpOGT(lhs, rhs), lhs,
+                                      rhs);
+    }
+    case OpCode::MINIMUM: {
+      return ir_builder->CreateSelect(ir_builder->CreateFCmpOLT(lhs, rhs), lhs,
+                                      rhs);
+    }
+    case OpCode::MUL: {
+      return ir_builder->CreateFMul(lhs, rhs);
+    }
+    case OpCode::SUB: {
+      return ir_builder->CreateFSub(lhs, rhs);
+    }
+    case OpCode::ABS: {
+      return ir_builder->CreateIntrinsic(llvm::Intrinsic::fabs, {ty}, {lhs});
+    }
+    case OpCode::LEAKYRELU: {
+      llvm::Value* scaled =
+          ir_builder->CreateFMul(lhs, llvm::ConstantFP::get(ty, step.alpha));
+      return ir_builder->CreateSelect(ir_builder->CreateFCmpOGT(lhs, zero),
+                                      lhs, scaled);
+    }
+    case OpCode::NEG: {
+      return ir_builder->CreateFNeg(lhs);
+    }
+    case OpCode::RCP: {
+      return ir_builder->CreateFDiv(one, lhs);
+    }
+    case OpCode::RELU: {
+      return ir_builder->CreateSelect(ir_builder->CreateFCmpOGT(lhs, zero),
+                                      lhs, zero);
+    }
+    case OpCode::RELU6: {
+      llvm::Value* six = llvm::ConstantFP::get(ty, 6);
+      llvm::Value* ret = ir_builder->CreateSelect(
+          ir_builder->CreateFCmpOGT(lhs, zero), lhs, zero);
+      return ir_builder->CreateSelect(ir_builder->CreateFCmpOLT(ret, six), ret,
+                                      six);
+    }
+    case OpCode::RSQRT: {
+      return ir_builder->CreateFDiv(
+          one, ir_builder->CreateIntrinsic(llvm::Intrinsic::sqrt, {ty}, {lhs}));
+    }
+    case OpCode::SQRT: {
+      return ir_builder->CreateIntrinsic(llvm::Intrinsic::sqrt, {ty}, {lhs});
+    }
+    default: {
+      HLCHECK(0 && "Unsupported fused elementwise operation");
+      return nullptr;
+    }
+  }
+}
+
+void GenericLLVMIRCodeGen::EmitElementwiseLoopNest(
+    const halo::Type& ret_type, llvm::Value* buf,
+    const std::vector<Def>& inputs, const ElementwiseBody& body) {
+  // The loops are bottom-tested and always run once, so nothing is emitted
+  // for an empty result.
+  if (ret_type.GetTotalNumOfElements() == 0) {
+    return;
+  }
+  llvm::IRBuilder<>* ir_builder = current_llvm_builder_;
+  std::vector<halo::Type> types;
+  std::vector<llvm::Type*> elem_types;
+  // Pointers to the inputs followed by the pointer to the result.
+  std::vector<llvm::Value*> ptrs;
+  for (const auto& op : inputs) {
+    llvm::Value* input = ir_mapping_[op];
+    if (!input->getType()->isPointerTy()) {
+      auto input_buf =
+          ir_builder->CreateAlloca(TensorTypeToLLVMType(op.GetType(), false),
+                                   nullptr, op.GetOwner()->GetName() + "_buf");
+      ir_builder->CreateStore(input, input_buf);
+      input = input_buf;
+    }
+    llvm::Type* elem_ty = SNTypeToLLVMType(op.GetType().GetDataType());
+    types.push_back(op.GetType());
+    elem_types.push_back(elem_ty);
+    ptrs.push_back(ir_builder->CreateBitCast(input, elem_ty->getPointerTo()));
+  }
+  llvm::Type* ret_elem_ty = SNTypeToLLVMType(ret_type.GetDataType());
+  ptrs.push_back(ir_builder->CreateBitCast(buf, ret_elem_ty->getPointerTo()));
+
+  std::vector<std::vector<int64_t>> strides;
+  std::vector<int64_t> dims = GetElementwiseLoops(ret_type, types, &strides);
+  std::vector<int64_t> ret_strides(dims.size(), 1);
+  for (int d = static_cast<int>(dims.size()) - 2; d >= 0; --d) {
+    ret_strides[d] = ret_strides[d + 1] * dims[d + 1];
+  }
+
+  // Emits the loops over [begin, begin + outer_bound) of the outermost
+  // dimension, or over all of it if `begin` is null.
+  auto emit_loops = [&](const std::vector<llvm::Value*>& loop_ptrs,
+                        llvm::Value* begin, llvm::Value* outer_bound) {
+    EmitLoopNest(
+        dims,
+        [&](const std::vector<llvm::Value*>& ivs) {
+          std::vector<llvm::Value*> idx(ivs);
+          if (begin != nullptr) {
+            idx[0] =
+                ir_builder->CreateAdd(begin, ivs[0], "", true /* HasNUW */);
+          }
+          auto get_offset = [&idx, ir_builder](const std::vector<int64_t>& s) {
+            llvm::Value* offset = ir_builder->getInt64(0);
+            for (size_t d = 0, e = idx.size(); d < e; ++d) {
+              if (s[d] != 0) {
+                offset = ir_builder->CreateAdd(
+                    offset, ir_builder->CreateMul(idx[d],
+                                                  ir_builder->getInt64(s[d]),
+                                                  "", true /* HasNUW */));
+              }
+            }
+            return offset;
+          };
+          // Inputs are only loaded if they are used.
+          std::vector<llvm::Value*> values(elem_types.size());
+          auto load = [&](size_t i) {
+            if (values[i] == nullptr) {
+              values[i] = ir_builder->CreateLoad(ir_builder->CreateGEP(
+                  elem_types[i], loop_ptrs[i], get_offset(strides[i])));
+            }
+            return values[i];
+          };
+          ir_builder->CreateStore(
+              body(load), ir_builder->CreateGEP(ret_elem_ty, loop_ptrs.back(),
+                                                get_offset(ret_strides)));
+        },
+        outer_bound);
+  };
+
+  int64_t inner = 1;
+  for (size_t d = 1, e = dims.size(); d < e; ++d) {
+    inner *= dims[d];
+  }
+  int64_t grain = (kParallelMinElements + inner - 1) / inner;
+  if (!enable_parallel_loops_ || dims[0] <= grain) {
+    emit_loops(ptrs, nullptr, nullptr);
+    return;
+  }
+
+  // The task gets the pointers that are not constants (e.g. stack buffers)
+  // through an array of i8*.
+  llvm::PointerType* i8_ptr_ty = ir_builder->getInt8PtrTy();
+  std::vector<size_t> captured;
+  for (size_t i = 0, e = ptrs.size(); i < e; ++i) {
+    if (!llvm::isa<llvm::Constant>(ptrs[i])) {
+      captured.push_back(i);
+    }
+  }
+  llvm::Value* task_ctx = llvm::ConstantPointerNull::get(i8_ptr_ty);
+  if (!captured.empty()) {
+    llvm::Value* ctx_buf = ir_builder->CreateAlloca(
+        llvm::ArrayType::get(i8_ptr_ty, captured.size()), nullptr, "task_ctx");
+    for (size_t k = 0, e = captured.size(); k < e; ++k) {
+      ir_builder->CreateStore(
+          ir_builder->CreateBitCast(ptrs[captured[k]], i8_ptr_ty),
+          ir_builder->CreateConstGEP2_64(ctx_buf, 0, k));
+    }
+    task_ctx = ir_builder->CreateBitCast(ctx_buf, i8_ptr_ty);
+  }
+
+  llvm::Type* i64_ty = ir_builder->getInt64Ty();
+  llvm::FunctionType* task_ty = llvm::FunctionType::get(
+      ir_builder->getVoidTy(), {i8_ptr_ty, i64_ty, i64_ty}, false);
+  llvm::Function* task = llvm::Function::Create(
+      task_ty, llvm::GlobalValue::InternalLinkage,
+      ir_builder->GetInsertBlock()->getParent()->getName() + "_task",
+      llvm_module_.get());
+  {
+    llvm::IRBuilderBase::InsertPointGuard guard(*ir_builder);
+    ir_builder->SetInsertPoint(
+        llvm::BasicBlock::Create(GetLLVMContext(), "entry", task));
+    auto args = task->arg_begin();
+    llvm::Value* ctx_arg = ir_builder->CreateBitCast(
+        &*args++, i8_ptr_ty->getPointerTo(), "task_ctx");
+    llvm::Value* begin = &*args++;
+    llvm::Value* end = &*args;
+    std::vector<llvm::Value*> task_ptrs(ptrs);
+    for (size_t k = 0, e = captured.size(); k < e; ++k) {
+      llvm::Value* ptr = ir_builder->CreateLoad(
+          ir_builder->CreateConstGEP1_64(ctx_arg, k));
+      task_ptrs[captured[k]] =
+          ir_builder->CreateBitCast(ptr, ptrs[captured[k]]->getType());
+    }
+    emit_loops(task_ptrs, begin, ir_builder->CreateSub(end, begin));
+    ir_builder->CreateRetVoid();
+  }
+
+  llvm::FunctionType* ftype = llvm::FunctionType::get(
+      ir_builder->getVoidTy(),
+      {task_ty->getPointerTo(), i8_ptr_ty, i64_ty, i64_ty}, false);
+  llvm::FunctionCallee callee =
+      llvm_module_->getOrInsertFunction("_sn_rt_fork_call", ftype);
+  CreateCall(&callee, {task, task_ctx, ir_builder->getInt64(dims[0]),
+                       ir_builder->getInt64(grain)});
+}
+
+void GenericLLVMIRCodeGen::RunOnInstruction(FusedElementwiseInst* inst) {
+  llvm::IRBuilder<>* ir_builder = current_llvm_builder_;
+  const auto& ret_type = inst->GetResultType();
+  HLCHECK(ret_type.GetDataType() == DataType::FLOAT32 &&
+          "Fused elementwise only supports float");
+  const auto& steps = GetElementwiseSteps(*inst);
+
+  llvm::Value* result = AllocateLLVMBuffer(ir_builder, Def{inst, 0});
+  EmitElementwiseLoopNest(
+      ret_type, result, inst->GetOperands(), [&](const ElementLoader& load) {
+        std::vector<llvm::Value*> results;
+        auto get_value = [&](int id) {
+          return id < 0 ? results[-id - 1] : load(id);
+        };
+        for (const auto& step : steps) {
+          results.push_back(EmitElementwiseStep(ir_builder, step,
+                                                get_value(step.lhs),
+                                                get_value(step.rhs)));
+        }
+        return results.back();
+      });
+  ir_mapping_[*inst] = result;
+}
+
+std::pair<float, float> GenericLLVMIRCodeGen::GetActivationClipRange(
+    ActivationType activation) {
+  switch (activation) {
+    case ActivationType::RELU: {
+      return {0.0F, std::numeric_limits<float>::max()};
+    }
+    case ActivationType::RELU6: {
+      return {0.0F, 6.0F};
+    }
+    default: {
+      return {std::numeric_limits<float>::lowest(),
+              std::numeric_limits<float>::max()};
+    }
+  }
+}
+
+void GenericLLVMIRCodeGen::RunOnFusedActivation(const Instruction& inst,
+                                                ActivationType activation,
+                                                float alpha, llvm::Value* buf) {
+  llvm::IRBuilder<>* ir_builder = current_llvm_builder_;
+  const auto& type = inst.GetResultType();
+  llvm::Type* elem_ty = SNTypeToLLVMType(type.GetDataType());
+  llvm::Type* ptr_ty = elem_ty->getPointerTo();
+  int64_t elems = type.GetTotalNumOfElements();
+  llvm::Value* ptr = ir_builder->CreateBitCast(buf, ptr_ty);
+  switch (activation) {
+    case ActivationType::NONE:
+    case ActivationType::RELU:
+    case ActivationType::RELU6: {
+      break;
+    }
+    case ActivationType::LEAKY_RELU: {
+      ElementwiseStep step{OpCode::LEAKYRELU, 0, 0, alpha};
+      EmitLoopNest({elems}, [&](const std::vector<llvm::Value*>& ivs) {
+        llvm::Value* p = ir_builder->CreateGEP(elem_ty, ptr, ivs[0]);
+        llvm::Value* x = ir_builder->CreateLoad(p);
+        ir_builder->CreateStore(EmitElementwiseStep(ir_builder, step, x, x),
+                                p);
+      });
+      break;
+    }
+    case ActivationType::GELU: {
+      llvm::FunctionType* ftype = llvm::FunctionType::get(
+          ir_builder->getVoidTy(), {ptr_ty, ptr_ty, ir_builder->getInt64Ty()},
+          false);
+      llvm::FunctionCallee callee = llvm_module_->getOrInsertFunction(
+          "_sn_rt_gelu" + SNTypeToRTLibFuncSuffix(type.GetDataType()), ftype);
+      CreateCall(&callee, {ptr, ptr, ir_builder->getInt64(elems)});
+      break;
+    }
+    default: {
+      HLCHECK(0 && "Unsupported fused activation");
+    }
+  }
+}
+
+} // namespace halo
@@ -16,6 +16,7 @@
 // =============================================================================
 
 #include <cstdio>
+#include <limits>
 
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/IRBuilder.h"
@@ -46,7 +47,7 @@ void GenericLLVMIRCodeGen::RunOnInstruction(GemmInst* inst) {
       ir_builder->getVoidTy(),
       {ptr_type, ptr_type, ptr_type, ptr_type, int64_type, int64_type,
        int64_type, int64_type, int64_type, bool_type, bool_type, fp32_type,
-       fp32_type},
+       fp32_type, fp32_type, fp32_type},
       false);
 
   llvm::FunctionCallee callee = llvm_module->getOrInsertFunction(fname, ftype);
@@ -68,14 +69,16 @@ void GenericLLVMIRCodeGen::RunOnInstruction(GemmInst* inst) {
   llvm::Value* transpose_b = ir_builder->getInt1(inst->GetTransposeB());
   llvm::Value* alpha = llvm::ConstantFP::get(fp32_type, inst->GetAlpha());
   llvm::Value* beta = llvm::ConstantFP::get(fp32_type, inst->GetBeta());
+  llvm::Value* clip_min =
+      llvm::ConstantFP::get(fp32_type, std::numeric_limits<float>::lowest());
+  llvm::Value* clip_max =
+      llvm::ConstantFP::get(fp32_type, std::numeric_limits<float>::max());
 
-  llvm::Value* ret_buf = ir_builder->CreateAlloca(
-      TensorTypeToLLVMType(inst->GetResultType(), false), nullptr,
-      inst->GetName());
+  llvm::Value* ret_buf = AllocateLLVMBuffer(ir_builder, Def{inst, 0});
   llvm::Value* ret_buf_ptr = ir_builder->CreateBitCast(ret_buf, ptr_type);
   CreateCall(&callee, {ret_buf_ptr, param0, param1, param2, dim_lhs_0,
                        dim_lhs_1, dim_rhs_0, dim_rhs_1, num_bias, transpose_a,
-                       transpose_b, alpha, beta});
+                       transpose_b, alpha, beta, clip_min, clip_max});
   ir_mapping_[*inst] = ret_buf;
 }
 
@@ -41,7 +41,10 @@ GenericConstantWriter::GenericConstantWriter(const std::string& name,
                                              bool bitcode_format)
     : GenericLLVMIRCodeGen(name, ConstantDataStorage::DefinedAsGlobal),
       os_(os),
-      bitcode_format_(bitcode_format) {}
+      bitcode_format_(bitcode_format) {
+  // Only drops the Winograd kernels when enabled as in the code generator.
+  enable_winograd_ = false;
+}
 
 GenericConstantWriter::GenericConstantWriter(std::ostream& os,
                                              bool bitcode_format)
@@ -65,7 +68,9 @@ bool GenericConstantWriter::RunOnModule(Module* module) {
   llvm_module_->setTargetTriple(target_machine_->getTargetTriple().getTriple());
   for (auto& func : *module) {
     for (auto& constant : func->Constants()) {
-      RunOnConstant(*constant);
+      if (!IsWinogradKernel(*constant)) {
+        RunOnConstant(*constant);
+      }
     }
   }
   WriteToBuf();
@@ -17,11 +17,13 @@
 
 #include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
 
+#include <iostream>
 #include <limits>
 #include <unordered_map>
 
 #include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/GlobalValue.h"
 #include "llvm/IR/GlobalVariable.h"
@@ -30,9 +32,11 @@
 #include "llvm/IR/Verifier.h"
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/Linker/Linker.h"
+#include "llvm/MC/SubtargetFeature.h"
 #include "llvm/Object/Archive.h"
 #include "llvm/Support/CodeGen.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/SourceMgr.h"
@@ -45,6 +49,7 @@
 #include "halo/api/halo_data.h"
 #include "halo/lib/framework/global_context.h"
 #include "halo/lib/ir/all_instructions.h"
+#include "halo/lib/mm/memory_planner.h"
 #include "halo/lib/target/codegen.h"
 #include "halo/lib/target/codegen_object.h"
 
@@ -70,6 +75,22 @@ llvm::LLVMContext& GenericLLVMIRCodeGen::GetLLVMContext() noexcept {
   return ctx;
 }
 
+std::string GenericLLVMIRCodeGen::GetHostCPUFeatures(
+    const std::string& extra_features) {
+  llvm::StringMap<bool> host_features;
+  llvm::SubtargetFeatures features;
+  if (llvm::sys::getHostCPUFeatures(host_features)) {
+    for (const auto& feature : host_features) {
+      features.AddFeature(feature.first(), feature.second);
+    }
+  }
+  std::string ret = features.getString();
+  if (!extra_features.empty()) {
+    ret += ret.empty() ? extra_features : "," + extra_features;
+  }
+  return ret;
+}
+
 llvm::TargetMachine* GenericLLVMIRCodeGen::InitTargetMachine() {
   llvm::InitializeNativeTarget();
   llvm::InitializeNativeTargetAsmPrinter();
@@ -78,8 +99,12 @@ llvm::TargetMachine* GenericLLVMIRCodeGen::InitTargetMachine() {
   const llvm::Target* target =
       llvm::TargetRegistry::lookupTarget(triple.getTriple(), error);
   HLCHECK(target);
-  llvm::StringRef cpu("");
-  llvm::StringRef features("");
+  std::string cpu = ctx_ == nullptr ? "" : ctx_->GetProcessorName();
+  std::string features = ctx_ == nullptr ? "" : ctx_->GetTargetFeatures();
+  if (cpu.empty() || cpu == "native") {
+    cpu = llvm::sys::getHostCPUName();
+    features = GetHostCPUFeatures(features);
+  }
   llvm::Reloc::Model reloc = llvm::Reloc::Static;
   llvm::CodeGenOpt::Level opt_level = llvm::CodeGenOpt::Aggressive;
   llvm::CodeModel::Model cm = llvm::CodeModel::Medium;
@@ -95,6 +120,8 @@ llvm::TargetMachine* GenericLLVMIRCodeGen::InitTargetMachine() {
 
 llvm::Type* GenericLLVMIRCodeGen::SNTypeToLLVMType(DataType dt) {
   switch (dt) {
+    // Booleans are stored one per byte, as the runtime library expects.
+    case DataType::BOOL:
     case DataType::INT8:
     case DataType::UINT8: {
       return llvm::Type::getInt8Ty(GetLLVMContext());
@@ -120,6 +147,7 @@ const std::string& GenericLLVMIRCodeGen::SNTypeToRTLibFuncSuffix(DataType dt) {
   static const std::unordered_map<DataType, std::string> suffixes = {
       {DataType::FLOAT32, "_f32"},
       {DataType::INT32, "_i32"},
+      {DataType::BOOL, "_bool"},
       {DataType::INVALID, "_inv"}};
   if (auto kv = suffixes.find(dt); kv != suffixes.end()) {
     return kv->second;
@@ -162,9 +190,40 @@ llvm::BasicBlock* GenericLLVMIRCodeGen::GetLLVMBasicBlock(Instruction* inst) {
 
 llvm::Value* GenericLLVMIRCodeGen::AllocateLLVMBuffer(
     llvm::IRBuilder<>* ir_builder, const Def& def) {
-  constexpr int64_t stack_threshold =
-      128; // std::numeric_limits<int64_t>::max();
-  bool use_stack = def.GetType().GetTotalNumOfElements() <= stack_threshold;
+  if (auto it = concat_buffers_.find(def); it != concat_buffers_.end()) {
+    return it->second;
+  }
+  // Write an input of a concatenation directly into its part of the result.
+  if (auto slot = concat_slots_.find(def); slot != concat_slots_.end()) {
+    const Def& concat = slot->second.first;
+    llvm::Value* buf = AllocateLLVMBuffer(ir_builder, concat);
+    HLCHECK(llvm::isa<llvm::Constant>(buf));
+    concat_buffers_.emplace(concat, buf);
+    buffer_aliases_.emplace(def, concat);
+    llvm::Type* i8_ty = ir_builder->getInt8Ty();
+    llvm::Constant* ptr = llvm::ConstantExpr::getInBoundsGetElementPtr(
+        i8_ty,
+        llvm::ConstantExpr::getBitCast(llvm::cast<llvm::Constant>(buf),
+                                       i8_ty->getPointerTo()),
+        ir_builder->getInt64(slot->second.second));
+    return llvm::ConstantExpr::getBitCast(
+        ptr, TensorTypeToLLVMType(def.GetType(), true));
+  }
+  // Compute in place over the global buffer of an operand that is not read
+  // afterwards. Stack buffers are left to LLVM.
+  Def aliasee = alias_analyzer_ == nullptr ? Def::GetUndefined()
+                                           : alias_analyzer_->GetAliasee(def);
+  if (!aliasee.IsNull()) {
+    auto it = arena_buffers_.find(alias_analyzer_->GetRoot(aliasee));
+    llvm::Value* buf = ir_mapping_[aliasee];
+    if (it != arena_buffers_.end() && it->second == buf &&
+        buf->getType() == TensorTypeToLLVMType(def.GetType(), true)) {
+      buffer_aliases_.emplace(def, aliasee);
+      return buf;
+    }
+  }
+  bool use_stack =
+      def.GetType().GetTotalNumOfElements() <= kMaxStackBufferSize;
   return AllocateLLVMBuffer(ir_builder, def, use_stack);
 }
 
@@ -183,9 +242,54 @@ llvm::Value* GenericLLVMIRCodeGen::AllocateLLVMBuffer(
                                llvm::GlobalValue::LinkageTypes::InternalLinkage,
                                nullptr, def.GetOwner()->GetName());
   gv->setInitializer(llvm::Constant::getNullValue(type));
+  arena_buffers_.emplace(def, gv);
   return gv;
 }
 
+void GenericLLVMIRCodeGen::PlanActivationArena(const Function& function) {
+  if (arena_buffers_.empty()) {
+    return;
+  }
+  std::unordered_map<Def, llvm::GlobalVariable*> buffers;
+  buffers.swap(arena_buffers_);
+  MemoryPlanner planner(
+      function, [&buffers](const Def& def) { return buffers.count(def) > 0; },
+      buffer_aliases_);
+
+  auto arena_ty = llvm::ArrayType::get(
+      llvm::Type::getInt8Ty(GetLLVMContext()), planner.GetArenaSize());
+  llvm::GlobalVariable* arena = new llvm::GlobalVariable(
+      *llvm_module_, arena_ty, false,
+      llvm::GlobalValue::LinkageTypes::InternalLinkage,
+      llvm::Constant::getNullValue(arena_ty), function.GetName() + "_arena");
+  arena->setAlignment(MemoryPlanner::kDefaultAlignment);
+
+  llvm::Type* i64_ty = llvm::Type::getInt64Ty(GetLLVMContext());
+  std::unordered_map<llvm::Value*, llvm::Constant*> replacements;
+  for (const auto& buf : planner.GetBuffers()) {
+    llvm::GlobalVariable* gv = buffers[buf.def];
+    llvm::Constant* indices[] = {llvm::ConstantInt::get(i64_ty, 0),
+                                 llvm::ConstantInt::get(i64_ty, buf.offset)};
+    llvm::Constant* ptr = llvm::ConstantExpr::getBitCast(
+        llvm::ConstantExpr::getInBoundsGetElementPtr(arena_ty, arena, indices),
+        gv->getType());
+    gv->replaceAllUsesWith(ptr);
+    replacements[gv] = ptr;
+    gv->eraseFromParent();
+  }
+  // Values aliasing a buffer (e.g. reshapes) are mapped to it as well.
+  for (auto& kv : ir_mapping_) {
+    auto it = replacements.find(kv.second);
+    if (it != replacements.end()) {
+      kv.second = it->second;
+    }
+  }
+
+  total_activations_size_ += planner.GetTotalSize();
+  peak_activations_size_ += planner.GetPeak();
+  arena_size_ += planner.GetArenaSize();
+}
+
 bool GenericLLVMIRCodeGen::RunOnModule(Module* module) {
   ctx_ = &module->GetGlobalContext();
   if (target_machine_ == nullptr) {
@@ -197,11 +301,22 @@ bool GenericLLVMIRCodeGen::RunOnModule(Module* module) {
       llvm::make_unique<llvm::Module>(module->GetName(), GetLLVMContext());
   llvm_module_->setDataLayout(target_machine_->createDataLayout());
   llvm_module_->setTargetTriple(target_machine_->getTargetTriple().getTriple());
+  total_activations_size_ = 0;
+  peak_activations_size_ = 0;
+  arena_size_ = 0;
   for (auto& func : *module) {
     RunOnFunction(*func);
   }
   LinkRuntimeLib();
 
+  if (print_mem_stats_) {
+    std::cout << "Total Activation Memory: " << total_activations_size_
+              << " bytes\n";
+    std::cout << "Peak Activation Memory: " << peak_activations_size_
+              << " bytes\n";
+    std::cout << "Planned Activation Memory: " << arena_size_ << " bytes\n";
+  }
+
   // Verify LLVM Module.
   std::string error;
   llvm::raw_string_ostream err_os(error);
@@ -242,6 +357,9 @@ void GenericLLVMIRCodeGen::RunOnFunction(Function& function) {
   // sub-target to overide the behavior.
   llvm_func->addFnAttr(llvm::Attribute::NoUnwind);
   ir_mapping_[function] = llvm_func;
+  alias_analyzer_ = std::make_unique<AliasAnalyzer>(function);
+  buffer_aliases_.clear();
+  PlanConcatInPlace(function);
 
   llvm_func->setCallingConv(llvm::CallingConv::C);
 
@@ -264,7 +382,9 @@ void GenericLLVMIRCodeGen::RunOnFunction(Function& function) {
   }
 
   for (auto& constant : function.Constants()) {
-    RunOnConstant(*constant);
+    if (!IsWinogradKernel(*constant)) {
+      RunOnConstant(*constant);
+    }
   }
 
   for (auto& bb : function) {
@@ -275,7 +395,9 @@ void GenericLLVMIRCodeGen::RunOnFunction(Function& function) {
   llvm::BasicBlock& last_bb = llvm_func->back();
   llvm::IRBuilder<> ir_builder(&last_bb);
   ir_builder.CreateRetVoid();
-} // namespace halo
+
+  PlanActivationArena(function);
+}
 
 llvm::CallInst* GenericLLVMIRCodeGen::CreateCall(
     llvm::FunctionCallee* callee, llvm::ArrayRef<llvm::Value*> args) {
@@ -465,16 +587,27 @@ void GenericLLVMIRCodeGen::LinkRuntimeLib() {
 void GenericLLVMIRCodeGen::RunOnBaseInstruction(Instruction* inst) {
   switch (inst->GetOpCode()) {
     case OpCode::ADD:
-    case OpCode::SUB:
+    case OpCode::AND:
+    case OpCode::CMP:
     case OpCode::DIV:
-    case OpCode::MUL: {
+    case OpCode::MAXIMUM:
+    case OpCode::MINIMUM:
+    case OpCode::MUL:
+    case OpCode::OR:
+    case OpCode::POW:
+    case OpCode::SHIFTL:
+    case OpCode::SHIFTR:
+    case OpCode::SUB: {
       RunOnMathBinaryInstruction(inst);
       break;
     }
     case OpCode::FLOOR:
     case OpCode::ERF:
+    case OpCode::EXP:
     case OpCode::RSQRT:
-    case OpCode::SQRT: {
+    case OpCode::SIGMOID:
+    case OpCode::SQRT:
+    case OpCode::TANH: {
       RunOnMathUnaryInstruction(inst);
       break;
     }
@@ -26,39 +26,208 @@
 
 namespace halo {
 
+static const char* GetPredicateSuffix(KindPredicate pred) {
+  switch (pred) {
+    case KindPredicate::EQ:
+      return "_eq";
+    case KindPredicate::NE:
+      return "_ne";
+    case KindPredicate::GT:
+      return "_gt";
+    case KindPredicate::LT:
+      return "_lt";
+    case KindPredicate::GE:
+      return "_ge";
+    case KindPredicate::LE:
+      return "_le";
+    default:
+      HLCHECK(0 && "Invalid predicate");
+  }
+  return "";
+}
+
+// Emits an internal global holding `dims` and returns an i64* to it.
+static llvm::Value* CreateShapeGlobal(llvm::Module* llvm_module,
+                                      llvm::IRBuilder<>* ir_builder,
+                                      const std::string& name,
+                                      const std::vector<int64_t>& dims) {
+  llvm::Type* shape_type =
+      llvm::ArrayType::get(ir_builder->getInt64Ty(), dims.size());
+  llvm::Constant* shape_cv = llvm::ConstantDataArray::get(
+      llvm_module->getContext(), llvm::ArrayRef<int64_t>(dims));
+  auto shape_gv = llvm_module->getOrInsertGlobal(name, shape_type);
+  llvm::GlobalVariable* gv = llvm_module->getNamedGlobal(shape_gv->getName());
+  gv->setInitializer(shape_cv);
+  gv->setLinkage(llvm::GlobalValue::LinkageTypes::InternalLinkage);
+  return ir_builder->CreateBitCast(gv,
+                                   ir_builder->getInt64Ty()->getPointerTo());
+}
+
+// Rank aligned shape of `type` within a result of rank `dim`.
+static std::vector<int64_t> GetAlignedShape(const halo::Type& type, int dim) {
+  std::vector<int64_t> dims(dim, 1);
+  for (int i = dim - 1, j = static_cast<int>(type.GetNumOfDims()) - 1; j >= 0;
+       i--, j--) {
+    dims[i] = type.GetNumOfElementsInDim(j);
+  }
+  return dims;
+}
+
+// Returns true if `inst` is lowered to a loop nest instead of a call into the
+// runtime library. Operations that need libm (e.g. pow) are left to the runtime
+// library, whose kernels are vectorized.
+static bool IsLoweredToLoops(const Instruction& inst) {
+  DataType dt = inst.GetOperand(0).GetType().GetDataType();
+  bool is_int = dt == DataType::INT8 || dt == DataType::INT16 ||
+                dt == DataType::INT32;
+  switch (inst.GetOpCode()) {
+    case OpCode::ADD:
+    case OpCode::CMP:
+    case OpCode::DIV:
+    case OpCode::MAXIMUM:
+    case OpCode::MINIMUM:
+    case OpCode::MUL:
+    case OpCode::SUB: {
+      return dt == DataType::FLOAT32 || is_int;
+    }
+    case OpCode::AND:
+    case OpCode::OR: {
+      return dt == DataType::BOOL || is_int;
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+static llvm::CmpInst::Predicate GetLLVMPredicate(KindPredicate pred,
+                                                 bool is_fp) {
+  switch (pred) {
+    case KindPredicate::EQ:
+      return is_fp ? llvm::CmpInst::FCMP_OEQ : llvm::CmpInst::ICMP_EQ;
+    case KindPredicate::NE:
+      return is_fp ? llvm::CmpInst::FCMP_UNE : llvm::CmpInst::ICMP_NE;
+    case KindPredicate::GT:
+      return is_fp ? llvm::CmpInst::FCMP_OGT : llvm::CmpInst::ICMP_SGT;
+    case KindPredicate::LT:
+      return is_fp ? llvm::CmpInst::FCMP_OLT : llvm::CmpInst::ICMP_SLT;
+    case KindPredicate::GE:
+      return is_fp ? llvm::CmpInst::FCMP_OGE : llvm::CmpInst::ICMP_SGE;
+    case KindPredicate::LE:
+      return is_fp ? llvm::CmpInst::FCMP_OLE : llvm::CmpInst::ICMP_SLE;
+    default:
+      HLCHECK(0 && "Invalid predicate");
+  }
+  return llvm::CmpInst::BAD_ICMP_PREDICATE;
+}
+
+// Computes one result element of `inst` from the operand elements.
+static llvm::Value* EmitBinaryElement(llvm::IRBuilder<>* ir_builder,
+                                      Instruction* inst, llvm::Value* lhs,
+                                      llvm::Value* rhs) {
+  bool is_fp = lhs->getType()->isFloatingPointTy();
+  switch (inst->GetOpCode()) {
+    case OpCode::ADD: {
+      return is_fp ? ir_builder->CreateFAdd(lhs, rhs)
+                   : ir_builder->CreateAdd(lhs, rhs);
+    }
+    case OpCode::AND: {
+      return ir_builder->CreateAnd(lhs, rhs);
+    }
+    case OpCode::CMP: {
+      KindPredicate pred = DynCast<CmpInst>(inst)->GetPredicator();
+      // Booleans are stored one per byte.
+      return ir_builder->CreateZExt(
+          ir_builder->CreateCmp(GetLLVMPredicate(pred, is_fp), lhs, rhs),
+          ir_builder->getInt8Ty());
+    }
+    case OpCode::DIV: {
+      return is_fp ? ir_builder->CreateFDiv(lhs, rhs)
+                   : ir_builder->CreateSDiv(lhs, rhs);
+    }
+    case OpCode::MAXIMUM: {
+      return ir_builder->CreateSelect(
+          is_fp ? ir_builder->CreateFCmpOGT(lhs, rhs)
+                : ir_builder->CreateICmpSGT(lhs, rhs),
+          lhs, rhs);
+    }
+    case OpCode::MINIMUM: {
+      return ir_builder->CreateSelect(
+          is_fp ? ir_builder->CreateFCmpOLT(lhs, rhs)
+                : ir_builder->CreateICmpSLT(lhs, rhs),
+          lhs, rhs);
+    }
+    case OpCode::MUL: {
+      return is_fp ? ir_builder->CreateFMul(lhs, rhs)
+                   : ir_builder->CreateMul(lhs, rhs);
+    }
+    case OpCode::OR: {
+      return ir_builder->CreateOr(lhs, rhs);
+    }
+    case OpCode::SUB: {
+      return is_fp ? ir_builder->CreateFSub(lhs, rhs)
+                   : ir_builder->CreateSub(lhs, rhs);
+    }
+    default: {
+      HLCHECK(0 && "Unsupported elementwise binary operation");
+      return nullptr;
+    }
+  }
+}
+
 void GenericLLVMIRCodeGen::RunOnMathBinaryInstruction(Instruction* inst) {
   llvm::IRBuilder<>* ir_builder = current_llvm_builder_;
   const Def& lhs = inst->GetOperand(0);
   const Def& rhs = inst->GetOperand(1);
 
+  if (IsLoweredToLoops(*inst)) {
+    llvm::Value* ret_buf = AllocateLLVMBuffer(ir_builder, Def{inst, 0});
+    EmitElementwiseLoopNest(
+        inst->GetResultsTypes()[0], ret_buf, {lhs, rhs},
+        [&](const ElementLoader& load) {
+          return EmitBinaryElement(ir_builder, inst, load(0), load(1));
+        });
+    ir_mapping_[*inst] = ret_buf;
+    return;
+  }
+
   llvm::Value* op0 = ir_mapping_[lhs];
   llvm::Value* op1 = ir_mapping_[rhs];
 
+  const halo::Type& ret_type = inst->GetResultsTypes()[0];
+  const halo::Type& lhs_type = lhs.GetType();
+  const halo::Type& rhs_type = rhs.GetType();
+
   // TODO(unknown): we can split into multiple smaller vec ops.
   llvm::PointerType* data_ptr_type =
-      SNTypeToLLVMType(lhs.GetType().GetDataType())->getPointerTo();
+      SNTypeToLLVMType(lhs_type.GetDataType())->getPointerTo();
+  // Comparisons produce booleans.
+  llvm::PointerType* ret_ptr_type =
+      SNTypeToLLVMType(ret_type.GetDataType())->getPointerTo();
   llvm::Type* i64_type = ir_builder->getInt64Ty();
   llvm::PointerType* i64_ptr_type = i64_type->getPointerTo();
   llvm::Type* i32_type = ir_builder->getInt32Ty();
   llvm::Type* bool_type = ir_builder->getInt1Ty();
   llvm::FunctionType* ftype = llvm::FunctionType::get(
       ir_builder->getVoidTy(),
-      {data_ptr_type, data_ptr_type, data_ptr_type, i64_type, bool_type,
+      {ret_ptr_type, data_ptr_type, data_ptr_type, i64_type, bool_type,
        i64_ptr_type, i64_ptr_type, i64_ptr_type, i32_type},
       false);
 
-  std::string fname = GetRTLibFuncName(*inst, lhs.GetType().GetDataType());
+  std::string fname = GetRTLibFuncName(*inst, lhs_type.GetDataType());
+  if (inst->GetOpCode() == OpCode::CMP) {
+    fname = CodeGen::GetRTLibFuncName(*inst) +
+            GetPredicateSuffix(DynCast<CmpInst>(inst)->GetPredicator()) +
+            SNTypeToRTLibFuncSuffix(lhs_type.GetDataType());
+  }
 
   llvm::FunctionCallee callee = llvm_module_->getOrInsertFunction(fname, ftype);
 
   llvm::Value* ret_buf = AllocateLLVMBuffer(ir_builder, Def{inst, 0});
-  auto ret_buf_ptr = ir_builder->CreateBitCast(ret_buf, data_ptr_type);
+  auto ret_buf_ptr = ir_builder->CreateBitCast(ret_buf, ret_ptr_type);
   op0 = ir_builder->CreateBitCast(op0, data_ptr_type);
   op1 = ir_builder->CreateBitCast(op1, data_ptr_type);
 
-  const halo::Type& ret_type = inst->GetResultsTypes()[0];
-  const halo::Type& lhs_type = lhs.GetType();
-  const halo::Type& rhs_type = rhs.GetType();
   int dim = ret_type.GetNumOfDims();
   auto noe = ret_type.GetTotalNumOfElements();
   llvm::Value* dim_v = ir_builder->getInt32(dim);
@@ -70,52 +239,18 @@ void GenericLLVMIRCodeGen::RunOnMathBinaryInstruction(Instruction* inst) {
                {ret_buf_ptr, op0, op1, noe_v, ir_builder->getInt1(false),
                 null_ptr, null_ptr, null_ptr, dim_v});
   } else {
-    llvm::Type* shape_type =
-        llvm::ArrayType::get(ir_builder->getInt64Ty(), dim);
-    llvm::ArrayRef<int64_t> shape_data(ret_type.GetDimSizes());
-    llvm::Constant* shape_cv =
-        llvm::ConstantDataArray::get(llvm_module_->getContext(), shape_data);
-    auto shape_gv =
-        llvm_module_->getOrInsertGlobal(inst->GetName() + "_shape", shape_type);
-    llvm::GlobalVariable* gv =
-        llvm_module_->getNamedGlobal(shape_gv->getName());
-    gv->setInitializer(shape_cv);
-    gv->setLinkage(llvm::GlobalValue::LinkageTypes::InternalLinkage);
-
-    llvm::Value* shape_gv_ptr = ir_builder->CreateBitCast(gv, i64_ptr_type);
-
-    std::vector<int64_t> lhs_dims(dim, 1);
-    for (int i = dim - 1, j = static_cast<int>(lhs_type.GetNumOfDims()) - 1;
-         j >= 0; i--, j--) {
-      lhs_dims[i] = lhs_type.GetNumOfElementsInDim(j);
-    }
-    llvm::ArrayRef<int64_t> lhs_shape_data(lhs_dims);
-    shape_cv = llvm::ConstantDataArray::get(llvm_module_->getContext(),
-                                            lhs_shape_data);
-    shape_gv = llvm_module_->getOrInsertGlobal(
-        lhs.GetOwner()->GetName() + "_shape", shape_type);
-    gv = llvm_module_->getNamedGlobal(shape_gv->getName());
-    gv->setInitializer(shape_cv);
-    gv->setLinkage(llvm::GlobalValue::LinkageTypes::InternalLinkage);
-
-    llvm::Value* lhs_shape_gv_ptr = ir_builder->CreateBitCast(gv, i64_ptr_type);
-
-    std::vector<int64_t> rhs_dims(dim, 1);
-    for (int i = dim - 1, j = static_cast<int>(rhs_type.GetNumOfDims()) - 1;
-         j >= 0; i--, j--) {
-      rhs_dims[i] = rhs_type.GetNumOfElementsInDim(j);
-    }
-    llvm::ArrayRef<int64_t> rhs_shape_data(rhs_dims);
-    shape_cv = llvm::ConstantDataArray::get(llvm_module_->getContext(),
-                                            rhs_shape_data);
-    shape_gv = llvm_module_->getOrInsertGlobal(
-        rhs.GetOwner()->GetName() + "_shape", shape_type);
-    gv = llvm_module_->getNamedGlobal(shape_gv->getName());
-    gv->setInitializer(shape_cv);
-    gv->setLinkage(llvm::GlobalValue::LinkageTypes::InternalLinkage);
-
-    llvm::Value* rhs_shape_gv_ptr = ir_builder->CreateBitCast(gv, i64_ptr_type);
-
+    // Shapes are named after the instruction: the same operand may be
+    // broadcast to results of different ranks.
+    llvm::Module* llvm_module = llvm_module_.get();
+    llvm::Value* shape_gv_ptr = CreateShapeGlobal(
+        llvm_module, ir_builder, inst->GetName() + "_shape",
+        ret_type.GetDimSizes());
+    llvm::Value* lhs_shape_gv_ptr =
+        CreateShapeGlobal(llvm_module, ir_builder, inst->GetName() + "_lhs_shape",
+                          GetAlignedShape(lhs_type, dim));
+    llvm::Value* rhs_shape_gv_ptr =
+        CreateShapeGlobal(llvm_module, ir_builder, inst->GetName() + "_rhs_shape",
+                          GetAlignedShape(rhs_type, dim));
     CreateCall(&callee,
                {ret_buf_ptr, op0, op1, noe_v, ir_builder->getInt1(true),
                 shape_gv_ptr, lhs_shape_gv_ptr, rhs_shape_gv_ptr, dim_v});
@@ -123,4 +258,4 @@ void GenericLLVMIRCodeGen::RunOnMathBinaryInstruction(Instruction* inst) {
   ir_mapping_[*inst] = ret_buf;
 }
 
-} // namespace halo
\ No newline at end of file
+} // namespace halo
@@ -21,13 +21,67 @@
 #include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
 
 namespace halo {
 
+// Returns true if `inst` is lowered to a loop nest instead of a call into the
+// runtime library. Transcendental functions are left to the runtime library,
+// whose kernels are vectorized.
+static bool IsLoweredToLoops(const Instruction& inst) {
+  if (inst.GetOperand(0).GetType().GetDataType() != DataType::FLOAT32) {
+    return false;
+  }
+  switch (inst.GetOpCode()) {
+    case OpCode::FLOOR:
+    case OpCode::RSQRT:
+    case OpCode::SQRT: {
+      return true;
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+// Computes one result element of `inst` from the operand element.
+static llvm::Value* EmitUnaryElement(llvm::IRBuilder<>* ir_builder,
+                                     const Instruction& inst, llvm::Value* x) {
+  llvm::Type* ty = x->getType();
+  switch (inst.GetOpCode()) {
+    case OpCode::FLOOR: {
+      return ir_builder->CreateIntrinsic(llvm::Intrinsic::floor, {ty}, {x});
+    }
+    case OpCode::RSQRT: {
+      return ir_builder->CreateFDiv(
+          llvm::ConstantFP::get(ty, 1),
+          ir_builder->CreateIntrinsic(llvm::Intrinsic::sqrt, {ty}, {x}));
+    }
+    case OpCode::SQRT: {
+      return ir_builder->CreateIntrinsic(llvm::Intrinsic::sqrt, {ty}, {x});
+    }
+    default: {
+      HLCHECK(0 && "Unsupported elementwise unary operation");
+      return nullptr;
+    }
+  }
+}
+
 void GenericLLVMIRCodeGen::RunOnMathUnaryInstruction(Instruction* inst) {
   llvm::IRBuilder<>* ir_builder = current_llvm_builder_;
   const Def& lhs = inst->GetOperand(0);
 
+  if (IsLoweredToLoops(*inst)) {
+    llvm::Value* ret_buf = AllocateLLVMBuffer(ir_builder, Def{inst, 0});
+    EmitElementwiseLoopNest(
+        inst->GetResultsTypes()[0], ret_buf, {lhs},
+        [&](const ElementLoader& load) {
+          return EmitUnaryElement(ir_builder, *inst, load(0));
+        });
+    ir_mapping_[*inst] = ret_buf;
+    return;
+  }
+
   llvm::Value* op0 = ir_mapping_[lhs];
 
   auto lhs_elms = lhs.GetType().GetTotalNumOfElements();
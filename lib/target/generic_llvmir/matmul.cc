@@ -32,7 +32,15 @@ void GenericLLVMIRCodeGen::RunOnInstruction(MatMulInst* inst) {
   llvm::Value* op0 = ir_mapping_[lhs];
   llvm::Value* op1 = ir_mapping_[rhs];
 
-  std::string fname = GetRTLibFuncName(*inst, lhs.GetType().GetDataType());
+  // A fused bias (the optional third operand) and activation are applied by
+  // the epilogue of the gemm kernel.
+  bool has_bias = inst->GetNumOfOperands() > 2;
+  ActivationType activation = inst->GetActivation();
+  bool is_fused = has_bias || activation != ActivationType::NONE;
+  std::string fname =
+      is_fused ? "_sn_rt_gemm" +
+                     SNTypeToRTLibFuncSuffix(lhs.GetType().GetDataType())
+               : GetRTLibFuncName(*inst, lhs.GetType().GetDataType());
 
   auto llvm_module = ir_builder->GetInsertBlock()->getParent()->getParent();
   llvm::PointerType* ptr_type =
@@ -40,11 +48,20 @@ void GenericLLVMIRCodeGen::RunOnInstruction(MatMulInst* inst) {
   //     llvm::dyn_cast<llvm::PointerType>(op0->getType());
   llvm::Type* bool_type = ir_builder->getInt1Ty();
   llvm::Type* int64_type = ir_builder->getInt64Ty();
-  llvm::FunctionType* ftype = llvm::FunctionType::get(
-      ir_builder->getVoidTy(),
-      {ptr_type, ptr_type, ptr_type, int64_type, int64_type, int64_type,
-       int64_type, bool_type, bool_type},
-      false);
+  llvm::Type* fp32_type = ir_builder->getFloatTy();
+  llvm::FunctionType* ftype =
+      is_fused
+          ? llvm::FunctionType::get(
+                ir_builder->getVoidTy(),
+                {ptr_type, ptr_type, ptr_type, ptr_type, int64_type,
+                 int64_type, int64_type, int64_type, int64_type, bool_type,
+                 bool_type, fp32_type, fp32_type, fp32_type, fp32_type},
+                false)
+          : llvm::FunctionType::get(
+                ir_builder->getVoidTy(),
+                {ptr_type, ptr_type, ptr_type, int64_type, int64_type,
+                 int64_type, int64_type, bool_type, bool_type},
+                false);
 
   llvm::FunctionCallee callee = llvm_module->getOrInsertFunction(fname, ftype);
 
@@ -61,12 +78,32 @@ void GenericLLVMIRCodeGen::RunOnInstruction(MatMulInst* inst) {
   llvm::Value* transpose_a = ir_builder->getInt1(inst->GetTransposeA());
   llvm::Value* transpose_b = ir_builder->getInt1(inst->GetTransposeB());
 
-  llvm::Value* ret_buf = ir_builder->CreateAlloca(
-      TensorTypeToLLVMType(inst->GetResultType(), false), nullptr,
-      inst->GetName());
+  llvm::Value* ret_buf = AllocateLLVMBuffer(ir_builder, Def{inst, 0});
   llvm::Value* ret_buf_ptr = ir_builder->CreateBitCast(ret_buf, ptr_type);
-  CreateCall(&callee, {ret_buf_ptr, param0, param1, dim_lhs_0, dim_lhs_1,
-                       dim_rhs_0, dim_rhs_1, transpose_a, transpose_b});
+  if (!is_fused) {
+    CreateCall(&callee, {ret_buf_ptr, param0, param1, dim_lhs_0, dim_lhs_1,
+                         dim_rhs_0, dim_rhs_1, transpose_a, transpose_b});
+    ir_mapping_[*inst] = ret_buf;
+    return;
+  }
+
+  llvm::Value* bias = llvm::ConstantPointerNull::get(ptr_type);
+  int64_t num_bias = 0;
+  if (has_bias) {
+    const Def& op2 = inst->GetOperand(2);
+    bias = ir_builder->CreateBitCast(ir_mapping_[op2], ptr_type);
+    num_bias = op2.GetType().GetTotalNumOfElements();
+  }
+  auto clip = GetActivationClipRange(activation);
+  llvm::Value* one = llvm::ConstantFP::get(fp32_type, 1.0);
+  CreateCall(&callee,
+             {ret_buf_ptr, param0, param1, bias, dim_lhs_0, dim_lhs_1,
+              dim_rhs_0, dim_rhs_1, ir_builder->getInt64(num_bias),
+              transpose_a, transpose_b, one, one,
+              llvm::ConstantFP::get(fp32_type, clip.first),
+              llvm::ConstantFP::get(fp32_type, clip.second)});
+  RunOnFusedActivation(*inst, activation, inst->GetActivationAlpha(),
+                       ret_buf);
   ir_mapping_[*inst] = ret_buf;
 }
 
@@ -0,0 +1,155 @@
+//===- object_writer.cc ---------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Object/ArchiveWriter.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_os_ostream.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
+#include "halo/lib/target/codegen_object.h"
+#include "halo/lib/threadpool/threadpool.h"
+
+namespace halo {
+
+GenericObjectWriter::GenericObjectWriter(const std::string& name,
+                                         std::ostream& os)
+    : CodeWriter(name, os) {}
+
+static void EmitObject(llvm::TargetMachine* tm, llvm::Module* module,
+                       llvm::raw_pwrite_stream* os) {
+  llvm::legacy::PassManager pm;
+  tm->addPassesToEmitFile(
+      pm, *os, nullptr, llvm::TargetMachine::CodeGenFileType::CGFT_ObjectFile);
+  pm.run(*module);
+}
+
+// Writes `objects` as members of a GNU archive to `os`. The archive writer
+// only writes to files, so the archive goes through a temporary file.
+static bool WriteArchive(const std::vector<llvm::SmallString<0>>& objects,
+                         std::ostream& os) {
+  std::vector<std::string> names;
+  names.reserve(objects.size());
+  std::vector<llvm::NewArchiveMember> members;
+  for (size_t i = 0, e = objects.size(); i < e; ++i) {
+    names.push_back("part" + std::to_string(i) + ".o");
+    members.emplace_back(llvm::MemoryBufferRef(objects[i], names.back()));
+  }
+
+  llvm::SmallString<128> path;
+  if (llvm::sys::fs::createTemporaryFile("halo", "a", path)) {
+    return false;
+  }
+  llvm::Error err = llvm::writeArchive(path, members, true,
+                                       llvm::object::Archive::K_GNU, true,
+                                       false);
+  bool ok = !err;
+  llvm::logAllUnhandledErrors(std::move(err), llvm::errs());
+  if (ok) {
+    auto buf = llvm::MemoryBuffer::getFile(path);
+    ok = static_cast<bool>(buf);
+    if (ok) {
+      os.write((*buf)->getBufferStart(), (*buf)->getBufferSize());
+    }
+  }
+  llvm::sys::fs::remove(path);
+  return ok;
+}
+
+bool GenericObjectWriter::RunOnModule(Module* module) {
+  GlobalContext& ctx = module->GetGlobalContext();
+  llvm::Module* llvm_module = ctx.GetCodeGenObject().GetLLVMModule();
+
+  int num_threads = ctx.GetNumOfCodeGenThreads();
+  if (num_threads <= 0) {
+    num_threads = ThreadPool::GetDefaultNumOfThreads();
+  }
+  // Local functions, including the linked runtime library, stay with their
+  // callers, so only the exported functions can be compiled apart.
+  int num_of_funcs = 0;
+  for (const llvm::Function& func : *llvm_module) {
+    num_of_funcs += func.isDeclaration() || func.hasLocalLinkage() ? 0 : 1;
+  }
+  int num_parts = std::min(num_threads, num_of_funcs);
+
+  if (num_parts <= 1) {
+    llvm::raw_os_ostream llvm_os(os_);
+    llvm::buffer_ostream buf(llvm_os);
+    EmitObject(CreateTargetMachine(ctx).get(), llvm_module, &buf);
+    return false;
+  }
+
+  // LLVMContext is not thread-safe. Each partition is serialized to bitcode
+  // and loaded into a context of its own by the thread compiling it. Local
+  // symbols are kept in the partition of their users rather than promoted to
+  // global ones, which could clash with the symbols of other objects.
+  std::vector<llvm::SmallString<0>> bitcodes;
+  llvm::SplitModule(
+      llvm::CloneModule(*llvm_module), num_parts,
+      [&bitcodes](std::unique_ptr<llvm::Module> part) {
+        bitcodes.emplace_back();
+        llvm::raw_svector_ostream os(bitcodes.back());
+        llvm::WriteBitcodeToFile(*part, os);
+      },
+      true /* PreserveLocals */);
+
+  // Target machines are created upfront as target initialization is not
+  // thread-safe.
+  std::vector<std::unique_ptr<llvm::TargetMachine>> tms;
+  tms.reserve(bitcodes.size());
+  for (size_t i = 0, e = bitcodes.size(); i < e; ++i) {
+    tms.push_back(CreateTargetMachine(ctx));
+    HLCHECK(tms.back());
+  }
+
+  std::vector<llvm::SmallString<0>> objects(bitcodes.size());
+  ThreadPool pool(num_parts);
+  pool.ParallelFor(bitcodes.size(), 1, [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i) {
+      llvm::LLVMContext llvm_ctx;
+      auto part = llvm::parseBitcodeFile(
+          llvm::MemoryBufferRef(bitcodes[i], "part"), llvm_ctx);
+      if (!part) {
+        llvm::consumeError(part.takeError());
+        HLCHECK(0 && "Invalid partition");
+        continue;
+      }
+      llvm::raw_svector_ostream os(objects[i]);
+      EmitObject(tms[i].get(), part->get(), &os);
+    }
+  });
+
+  HLCHECK(WriteArchive(objects, os_));
+  return false;
+}
+
+} // namespace halo
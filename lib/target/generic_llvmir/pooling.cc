@@ -21,14 +21,16 @@
 
 namespace halo {
 
-void GenericLLVMIRCodeGen::RunOnInstruction(PoolingMaxInst* inst0) {
-  PoolingMaxInst& inst = *inst0;
+void GenericLLVMIRCodeGen::RunOnCommonPoolingInstruction(
+    Instruction* inst, const std::vector<int>& ksize,
+    const std::vector<int>& strides, DataFormat data_format,
+    const std::vector<int>& paddings, bool count_include_pad) {
   llvm::IRBuilder<>* ir_builder = current_llvm_builder_;
-  const Def& lhs = inst.GetOperand(0);
+  const Def& lhs = inst->GetOperand(0);
   llvm::Value* op0 = ir_mapping_[lhs];
 
   std::string fname =
-      GetRTLibFuncName(inst, lhs.GetType().GetDataType(), inst.GetDataFormat());
+      GetRTLibFuncName(*inst, lhs.GetType().GetDataType(), data_format);
   llvm::Type* ptr_ty =
       SNTypeToLLVMType(lhs.GetType().GetDataType())->getPointerTo();
 
@@ -41,23 +43,25 @@ void GenericLLVMIRCodeGen::RunOnInstruction(PoolingMaxInst* inst0) {
     op0 = buf;
   }
   llvm::Type* int64_ty = ir_builder->getInt64Ty();
+  llvm::Type* bool_ty = ir_builder->getInt1Ty();
   llvm::FunctionType* ftype = llvm::FunctionType::get(
       ir_builder->getVoidTy(),
       {ptr_ty, ptr_ty, int64_ty, int64_ty, int64_ty, int64_ty, int64_ty,
        int64_ty, int64_ty, int64_ty, int64_ty, int64_ty, int64_ty, int64_ty,
-       int64_ty, int64_ty},
+       int64_ty, int64_ty, bool_ty},
       false);
 
   auto llvm_module = ir_builder->GetInsertBlock()->getParent()->getParent();
   llvm::FunctionCallee callee = llvm_module->getOrInsertFunction(fname, ftype);
 
-  HLCHECK((inst.GetDataFormat() == DataFormat::NHWC ||
-           inst.GetDataFormat() == DataFormat::NCHW) &&
+  HLCHECK((data_format == DataFormat::NHWC ||
+           data_format == DataFormat::NCHW) &&
           "Data format NHWC or NCHW is expected");
 
   const auto& info = ImageAxisInfo::GetImageAxisInfo(
-      inst.GetDataFormat(), inst.GetDataFormat() /* filter format */);
+      data_format, data_format /* filter format */);
 
+  const auto& ret_type = inst->GetResultType();
   llvm::Value* data = ir_builder->CreateBitCast(op0, ptr_ty);
   llvm::Value* batch = ir_builder->getInt64(
       lhs.GetType().GetNumOfElementsInDim(info.batch_axis));
@@ -67,31 +71,45 @@ void GenericLLVMIRCodeGen::RunOnInstruction(PoolingMaxInst* inst0) {
       lhs.GetType().GetNumOfElementsInDim(info.data_width_axis));
   llvm::Value* channel = ir_builder->getInt64(
       lhs.GetType().GetNumOfElementsInDim(info.data_channel_axis));
-  llvm::Value* kernel_h =
-      ir_builder->getInt64(inst.GetKsize()[info.kernel_height_axis]);
-  llvm::Value* kernel_w =
-      ir_builder->getInt64(inst.GetKsize()[info.kernel_width_axis]);
+  llvm::Value* kernel_h = ir_builder->getInt64(ksize[info.kernel_height_axis]);
+  llvm::Value* kernel_w = ir_builder->getInt64(ksize[info.kernel_width_axis]);
   llvm::Value* output_h = ir_builder->getInt64(
-      inst.GetResultType().GetNumOfElementsInDim(info.data_height_axis));
+      ret_type.GetNumOfElementsInDim(info.data_height_axis));
   llvm::Value* output_w = ir_builder->getInt64(
-      inst.GetResultType().GetNumOfElementsInDim(info.data_width_axis));
-  llvm::Value* stride_h =
-      ir_builder->getInt64(inst.GetStrides()[info.data_height_axis]);
-  llvm::Value* stride_w =
-      ir_builder->getInt64(inst.GetStrides()[info.data_width_axis]);
-  llvm::Value* padding_left = ir_builder->getInt64(inst.GetPaddingLeft());
-  llvm::Value* padding_right = ir_builder->getInt64(inst.GetPaddingRight());
-  llvm::Value* padding_top = ir_builder->getInt64(inst.GetPaddingTop());
-  llvm::Value* padding_bottom = ir_builder->getInt64(inst.GetPaddingBottom());
+      ret_type.GetNumOfElementsInDim(info.data_width_axis));
+  llvm::Value* stride_h = ir_builder->getInt64(strides[info.data_height_axis]);
+  llvm::Value* stride_w = ir_builder->getInt64(strides[info.data_width_axis]);
+  // The runtime takes the paddings as top, bottom, left, right.
+  llvm::Value* padding_top = ir_builder->getInt64(paddings[0]);
+  llvm::Value* padding_bottom = ir_builder->getInt64(paddings[1]);
+  llvm::Value* padding_left = ir_builder->getInt64(paddings[2]);
+  llvm::Value* padding_right = ir_builder->getInt64(paddings[3]);
 
-  llvm::Value* result = AllocateLLVMBuffer(ir_builder, Def{&inst, 0});
+  llvm::Value* result = AllocateLLVMBuffer(ir_builder, Def{inst, 0});
 
   llvm::Value* ret_buf_ptr = ir_builder->CreateBitCast(result, ptr_ty);
   CreateCall(&callee,
              {ret_buf_ptr, data, batch, spatial_h, spatial_w, channel, output_h,
-              output_w, kernel_h, kernel_w, stride_h, stride_w, padding_left,
-              padding_right, padding_top, padding_bottom});
-  ir_mapping_[inst] = result;
+              output_w, kernel_h, kernel_w, stride_h, stride_w, padding_top,
+              padding_bottom, padding_left, padding_right,
+              ir_builder->getInt1(count_include_pad)});
+  ir_mapping_[*inst] = result;
+}
+
+void GenericLLVMIRCodeGen::RunOnInstruction(PoolingAvgInst* inst) {
+  RunOnCommonPoolingInstruction(
+      inst, inst->GetKsize(), inst->GetStrides(), inst->GetDataFormat(),
+      {inst->GetPaddingTop(), inst->GetPaddingBottom(),
+       inst->GetPaddingLeft(), inst->GetPaddingRight()},
+      inst->GetCountIncludePad());
+}
+
+void GenericLLVMIRCodeGen::RunOnInstruction(PoolingMaxInst* inst) {
+  RunOnCommonPoolingInstruction(
+      inst, inst->GetKsize(), inst->GetStrides(), inst->GetDataFormat(),
+      {inst->GetPaddingTop(), inst->GetPaddingBottom(),
+       inst->GetPaddingLeft(), inst->GetPaddingRight()},
+      true /* count_include_pad */);
 }
 
 } // namespace halo
\ No newline at end of file
@@ -88,7 +88,7 @@ void GenericLLVMIRCodeGen::RunOnCommonReductionInstruction(
     }
     axis_v = ir_builder->CreateBitCast(op1, i32_ptr_type);
   } else {
-    // TODO(unknown): handle axis[i] < 0
+    // Negative axes are normalized by the runtime.
     axis_size = axis.size();
     HLCHECK(axis_size && "axis is expected to be non-empty");
     llvm::Type* axis_type = llvm::ArrayType::get(i32_type, axis_size);
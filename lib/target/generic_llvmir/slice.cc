@@ -16,6 +16,7 @@
 // =============================================================================
 
 #include "llvm/IR/IRBuilder.h"
+#include "halo/lib/mm/alias_analyzer.h"
 #include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
 #include "halo/lib/transforms/type_legalizer.h"
 
@@ -26,6 +27,27 @@ void GenericLLVMIRCodeGen::RunOnInstruction(SliceInst* inst) {
   const Def& params = inst->GetOperand(0);
   const Def& begin = inst->GetOperand(1);
 
+  // A contiguous range of the input (e.g. a slice along the outermost axis)
+  // is a view of it.
+  if (int64_t offset = 0; AliasAnalyzer::IsView(*inst, &offset)) {
+    llvm::Value* data = ir_mapping_[params];
+    if (!data->getType()->isPointerTy()) {
+      auto buf = ir_builder->CreateAlloca(
+          TensorTypeToLLVMType(params.GetType(), false), nullptr,
+          params.GetOwner()->GetName() + "_buf");
+      ir_builder->CreateStore(data, buf);
+      data = buf;
+    }
+    llvm::Type* data_ptr_type =
+        SNTypeToLLVMType(params.GetType().GetDataType())->getPointerTo();
+    llvm::Value* ptr = ir_builder->CreateInBoundsGEP(
+        ir_builder->CreateBitCast(data, data_ptr_type),
+        ir_builder->getInt64(offset));
+    ir_mapping_[*inst] = ir_builder->CreateBitCast(
+        ptr, TensorTypeToLLVMType(inst->GetResultType(), true));
+    return;
+  }
+
   std::string fname = GetRTLibFuncName(*inst, params.GetType().GetDataType());
 
   llvm::SmallVector<llvm::Value*, 4> ops; // NOLINT.
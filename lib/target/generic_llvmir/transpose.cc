@@ -26,7 +26,8 @@ void GenericLLVMIRCodeGen::RunOnInstruction(TransposeInst* inst) {
   const Def& params = inst->GetOperand(0);
   llvm::Value* op0 = ir_mapping_[params];
 
-  std::string fname = GetRTLibFuncName(*inst, params.GetType().GetDataType());
+  // The runtime transpose only moves bytes, so one entry serves all types.
+  const std::string& fname = CodeGen::GetRTLibFuncName(*inst);
 
   // llvm::Type* op0_ty = op0->getType();
 #if 0
@@ -39,14 +40,16 @@ void GenericLLVMIRCodeGen::RunOnInstruction(TransposeInst* inst) {
   }
 #endif
 
-  llvm::Type* data_ptr_type =
-      SNTypeToLLVMType(params.GetType().GetDataType())->getPointerTo();
-  llvm::Type* int64_ptr_ty = ir_builder->getInt64Ty()->getPointerTo();
+  llvm::Type* elem_type = SNTypeToLLVMType(params.GetType().GetDataType());
+  llvm::Type* data_ptr_type = ir_builder->getInt8PtrTy();
+  llvm::Type* int64_ty = ir_builder->getInt64Ty();
+  llvm::Type* int64_ptr_ty = int64_ty->getPointerTo();
   llvm::Type* int32_ty = ir_builder->getInt32Ty();
   llvm::Type* int32_ptr_ty = int32_ty->getPointerTo();
   llvm::FunctionType* ftype = llvm::FunctionType::get(
       ir_builder->getVoidTy(),
-      {data_ptr_type, data_ptr_type, int32_ptr_ty, int64_ptr_ty, int32_ty},
+      {data_ptr_type, data_ptr_type, int32_ptr_ty, int64_ptr_ty, int32_ty,
+       int64_ty},
       false);
 
   auto llvm_module = ir_builder->GetInsertBlock()->getParent()->getParent();
@@ -88,7 +91,11 @@ void GenericLLVMIRCodeGen::RunOnInstruction(TransposeInst* inst) {
 
   llvm::Value* ret_buf_ptr = ir_builder->CreateBitCast(ret_buf, data_ptr_type);
 
-  CreateCall(&callee, {ret_buf_ptr, input0, perm_gv_ptr, shape_gv_ptr, dim_v});
+  llvm::Value* elem_size = ir_builder->getInt64(
+      llvm_module_->getDataLayout().getTypeAllocSize(elem_type));
+
+  CreateCall(&callee, {ret_buf_ptr, input0, perm_gv_ptr, shape_gv_ptr, dim_v,
+                       elem_size});
 
   ir_mapping_[*inst] = ret_buf;
 }
@@ -0,0 +1,223 @@
+//===- threadpool.cc ------------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "halo/lib/threadpool/threadpool.h"
+
+#include <cstdlib>
+
+namespace halo {
+
+namespace {
+
+// Chunks dealt per thread. More chunks balance better, fewer chunks cost
+// less bookkeeping.
+constexpr int64_t kChunksPerThread = 8;
+// Number of polls before an idle worker goes to sleep.
+constexpr int kSpinCount = 4096;
+
+thread_local bool in_parallel_region = false;
+
+uint64_t Pack(uint64_t begin, uint64_t end) { return (end << 32) | begin; }
+uint64_t Begin(uint64_t bounds) { return bounds & 0xffffffffU; }
+uint64_t End(uint64_t bounds) { return bounds >> 32; }
+
+std::mutex& GetDefaultMutex() {
+  static std::mutex mu;
+  return mu;
+}
+
+std::unique_ptr<ThreadPool>& GetDefaultPool() {
+  static std::unique_ptr<ThreadPool> pool;
+  return pool;
+}
+
+int& GetDefaultPoolSize() {
+  static int size = 0;
+  return size;
+}
+
+} // namespace
+
+struct ThreadPool::Job {
+  RangeFunc fn;
+  void* ctx;
+  int64_t n;
+  int64_t chunk_size;
+  int joined = 0; // Number of workers that took part; guarded by mu_.
+  std::atomic<int> left{0};
+};
+
+ThreadPool::ThreadPool(int num_threads)
+    : num_threads_(num_threads > 0 ? num_threads : GetDefaultNumOfThreads()),
+      ranges_(new Range[num_threads_]) {
+  workers_.reserve(num_threads_ - 1);
+  for (int i = 1; i < num_threads_; ++i) {
+    workers_.emplace_back([this, i] { WorkerLoop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+bool ThreadPool::InParallelRegion() noexcept { return in_parallel_region; }
+
+int ThreadPool::GetDefaultNumOfThreads() {
+  const char* env = std::getenv("HALO_NUM_THREADS");
+  int n = env == nullptr ? 0 : std::atoi(env);
+  if (n <= 0) {
+    n = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  return std::max(n, 1);
+}
+
+ThreadPool* ThreadPool::GetDefault() {
+  std::lock_guard<std::mutex> lock(GetDefaultMutex());
+  auto& pool = GetDefaultPool();
+  if (pool == nullptr) {
+    pool = std::make_unique<ThreadPool>(GetDefaultPoolSize());
+  }
+  return pool.get();
+}
+
+void ThreadPool::SetDefaultNumOfThreads(int num_threads) {
+  std::lock_guard<std::mutex> lock(GetDefaultMutex());
+  GetDefaultPoolSize() = num_threads;
+  GetDefaultPool().reset();
+}
+
+void ThreadPool::Run(int64_t n, int64_t grain, RangeFunc fn, void* ctx) {
+  if (n <= 0) {
+    return;
+  }
+  grain = std::max<int64_t>(grain, 1);
+  if (num_threads_ == 1 || n <= grain || in_parallel_region) {
+    fn(ctx, 0, n);
+    return;
+  }
+  std::unique_lock<std::mutex> busy(busy_, std::try_to_lock);
+  if (!busy.owns_lock()) {
+    fn(ctx, 0, n);
+    return;
+  }
+
+  int64_t chunks = std::min(n / grain, num_threads_ * kChunksPerThread);
+  Job job{fn, ctx, n, (n + chunks - 1) / chunks};
+  chunks = (n + job.chunk_size - 1) / job.chunk_size;
+  int64_t participants = std::min<int64_t>(num_threads_, chunks);
+  for (int64_t i = 0; i < num_threads_; ++i) {
+    uint64_t begin = i < participants ? chunks * i / participants : 0;
+    uint64_t end = i < participants ? chunks * (i + 1) / participants : 0;
+    ranges_[i].bounds.store(Pack(begin, end), std::memory_order_relaxed);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    job_ = &job;
+    epoch_.fetch_add(1, std::memory_order_release);
+  }
+  cv_.notify_all();
+
+  in_parallel_region = true;
+  RunJob(&job, 0);
+  in_parallel_region = false;
+
+  // Late workers must not pick the job up any more; wait for the ones that
+  // did to finish.
+  int joined = 0;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    job_ = nullptr;
+    joined = job.joined;
+  }
+  while (job.left.load(std::memory_order_acquire) != joined) {
+    std::this_thread::yield();
+  }
+}
+
+void ThreadPool::RunJob(Job* job, int id) {
+  auto& own = ranges_[id].bounds;
+  do {
+    uint64_t bounds = own.load(std::memory_order_acquire);
+    while (Begin(bounds) < End(bounds)) {
+      uint64_t chunk = Begin(bounds);
+      if (!own.compare_exchange_weak(bounds, Pack(chunk + 1, End(bounds)),
+                                     std::memory_order_acq_rel)) {
+        continue;
+      }
+      int64_t begin = static_cast<int64_t>(chunk) * job->chunk_size;
+      job->fn(job->ctx, begin, std::min(job->n, begin + job->chunk_size));
+      bounds = own.load(std::memory_order_acquire);
+    }
+  } while (Steal(id));
+}
+
+bool ThreadPool::Steal(int id) {
+  for (int i = 1; i < num_threads_; ++i) {
+    auto& victim = ranges_[(id + i) % num_threads_].bounds;
+    uint64_t bounds = victim.load(std::memory_order_acquire);
+    while (Begin(bounds) < End(bounds)) {
+      uint64_t mid = Begin(bounds) + (End(bounds) - Begin(bounds)) / 2;
+      if (victim.compare_exchange_weak(bounds, Pack(Begin(bounds), mid),
+                                       std::memory_order_acq_rel)) {
+        ranges_[id].bounds.store(Pack(mid, End(bounds)),
+                                 std::memory_order_release);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ThreadPool::WorkerLoop(int id) {
+  in_parallel_region = true;
+  uint64_t seen = 0;
+  for (;;) {
+    for (int i = 0;
+         i < kSpinCount && epoch_.load(std::memory_order_acquire) == seen;
+         ++i) {
+      std::this_thread::yield();
+    }
+    Job* job = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      cv_.wait(lock, [this, seen] {
+        return stop_ || epoch_.load(std::memory_order_acquire) != seen;
+      });
+      if (stop_) {
+        return;
+      }
+      seen = epoch_.load(std::memory_order_acquire);
+      job = job_;
+      if (job == nullptr) {
+        continue;
+      }
+      ++job->joined;
+    }
+    RunJob(job, id);
+    job->left.fetch_add(1, std::memory_order_release);
+  }
+}
+
+} // namespace halo
@@ -0,0 +1,979 @@
+//===- constant_folding.cc ------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "halo/lib/transforms/constant_folding.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+#include "halo/lib/framework/common.h"
+#include "halo/lib/ir/all_instructions.h"
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+namespace halo {
+
+// Calls `fn` with a value of the C++ type holding the elements of `dt`.
+// Returns false if `dt` is not supported.
+template <typename Fn>
+static bool DispatchOnDataType(DataType dt, Fn&& fn) {
+  switch (dt) {
+    case DataType::FLOAT32: {
+      fn(float{});
+      return true;
+    }
+    case DataType::INT32: {
+      fn(int32_t{});
+      return true;
+    }
+    case DataType::INT64: {
+      fn(int64_t{});
+      return true;
+    }
+    case DataType::BOOL:
+    case DataType::INT8: {
+      fn(int8_t{});
+      return true;
+    }
+    case DataType::UINT8: {
+      fn(uint8_t{});
+      return true;
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+static size_t GetElementSize(DataType dt) {
+  size_t size = 0;
+  DispatchOnDataType(dt, [&size](auto v) { size = sizeof(v); });
+  return size;
+}
+
+template <typename T>
+static const T* GetData(const Constant& c) {
+  return static_cast<const T*>(c.GetRawDataPtr());
+}
+
+static int64_t GetDataAsInt64(const Constant& c, size_t idx) {
+  int64_t ret = 0;
+  DispatchOnDataType(c.GetResultType().GetDataType(), [&](auto v) {
+    ret = static_cast<int64_t>(GetData<decltype(v)>(c)[idx]);
+  });
+  return ret;
+}
+
+static std::vector<int64_t> GetStrides(const std::vector<int64_t>& shape) {
+  std::vector<int64_t> strides(shape.size(), 1);
+  for (int i = static_cast<int>(shape.size()) - 2; i >= 0; --i) {
+    strides[i] = strides[i + 1] * shape[i + 1];
+  }
+  return strides;
+}
+
+// Returns offset + sum(pos[i] * strides[i]) for each position of `shape` in
+// row-major order. This maps the elements of a strided view (transpose,
+// slice, broadcast) to the elements of the viewed data.
+static std::vector<int64_t> GetStridedIndices(
+    const std::vector<int64_t>& shape, const std::vector<int64_t>& strides,
+    int64_t offset) {
+  int64_t n = std::accumulate(shape.begin(), shape.end(), int64_t{1},
+                              std::multiplies<int64_t>());
+  int rank = shape.size();
+  std::vector<int64_t> indices(n);
+  std::vector<int64_t> pos(rank);
+  int64_t idx = offset;
+  for (int64_t i = 0; i < n; ++i) {
+    indices[i] = idx;
+    for (int d = rank - 1; d >= 0; --d) {
+      idx += strides[d];
+      if (++pos[d] < shape[d]) {
+        break;
+      }
+      idx -= strides[d] * shape[d];
+      pos[d] = 0;
+    }
+  }
+  return indices;
+}
+
+// Returns the index of the element of `type` broadcast to each element of
+// `ret_type`, or an empty vector if `type` can not be broadcast to it. Shapes
+// are aligned to the right.
+static std::vector<int64_t> GetBroadcastIndices(const Type& type,
+                                                const Type& ret_type) {
+  const auto& shape = type.GetDimSizes();
+  const auto& ret_shape = ret_type.GetDimSizes();
+  if (shape.size() > ret_shape.size()) {
+    return {};
+  }
+  int offset = ret_shape.size() - shape.size();
+  std::vector<int64_t> strides(ret_shape.size(), 0);
+  int64_t stride = 1;
+  for (int i = static_cast<int>(shape.size()) - 1; i >= 0; --i) {
+    if (shape[i] != 1 && shape[i] != ret_shape[i + offset]) {
+      return {};
+    }
+    strides[i + offset] = shape[i] == 1 ? 0 : stride;
+    stride *= shape[i];
+  }
+  return GetStridedIndices(ret_shape, strides, 0);
+}
+
+// Copies the elements at `indices` of `src` to `dst`.
+static void CopyElements(const Constant& src,
+                         const std::vector<int64_t>& indices, char* dst) {
+  size_t elem_size = GetElementSize(src.GetResultType().GetDataType());
+  const char* data = static_cast<const char*>(src.GetRawDataPtr());
+  for (size_t i = 0, e = indices.size(); i < e; ++i) {
+    std::memcpy(dst + i * elem_size, data + indices[i] * elem_size, elem_size);
+  }
+}
+
+template <typename T>
+static bool FoldUnary(const Instruction& inst, const Constant& x, T* out) {
+  const T* in = GetData<T>(x);
+  int64_t n = x.GetResultType().GetTotalNumOfElements();
+  auto apply = [in, out, n](auto fn) {
+    for (int64_t i = 0; i < n; ++i) {
+      out[i] = static_cast<T>(fn(static_cast<double>(in[i])));
+    }
+    return true;
+  };
+  switch (inst.GetOpCode()) {
+    case OpCode::ABS: {
+      return apply([](double v) { return std::abs(v); });
+    }
+    case OpCode::CEIL: {
+      return apply([](double v) { return std::ceil(v); });
+    }
+    case OpCode::ELU: {
+      return apply([](double v) { return v < 0 ? std::exp(v) - 1 : v; });
+    }
+    case OpCode::ERF: {
+      return apply([](double v) { return std::erf(v); });
+    }
+    case OpCode::EXP: {
+      return apply([](double v) { return std::exp(v); });
+    }
+    case OpCode::FLOOR: {
+      return apply([](double v) { return std::floor(v); });
+    }
+    case OpCode::LEAKYRELU: {
+      double alpha = DynCast<const LeakyReluInst>(&inst)->GetAlpha();
+      return apply([alpha](double v) { return v < 0 ? v * alpha : v; });
+    }
+    case OpCode::NEG: {
+      return apply([](double v) { return -v; });
+    }
+    case OpCode::RCP: {
+      return apply([](double v) { return 1 / v; });
+    }
+    case OpCode::RELU: {
+      return apply([](double v) { return std::max(v, 0.0); });
+    }
+    case OpCode::RELU6: {
+      return apply([](double v) { return std::min(std::max(v, 0.0), 6.0); });
+    }
+    case OpCode::RSQRT: {
+      return apply([](double v) { return 1 / std::sqrt(v); });
+    }
+    case OpCode::SIGMOID: {
+      return apply([](double v) { return 1 / (1 + std::exp(-v)); });
+    }
+    case OpCode::SIGN: {
+      return apply([](double v) { return (v > 0) - (v < 0); });
+    }
+    case OpCode::SQRT: {
+      return apply([](double v) { return std::sqrt(v); });
+    }
+    case OpCode::TANH: {
+      return apply([](double v) { return std::tanh(v); });
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+template <typename T>
+static bool FoldBinary(const Instruction& inst, const Constant& lhs,
+                       const Constant& rhs, void* out) {
+  const Type& ret_type = inst.GetResultType();
+  auto lhs_indices = GetBroadcastIndices(lhs.GetResultType(), ret_type);
+  auto rhs_indices = GetBroadcastIndices(rhs.GetResultType(), ret_type);
+  int64_t n = ret_type.GetTotalNumOfElements();
+  if (static_cast<int64_t>(lhs_indices.size()) != n ||
+      static_cast<int64_t>(rhs_indices.size()) != n) {
+    return false;
+  }
+  const T* a = GetData<T>(lhs);
+  const T* b = GetData<T>(rhs);
+  auto apply = [&](auto fn) {
+    using R = decltype(fn(a[0], b[0]));
+    R* ret = static_cast<R*>(out);
+    for (int64_t i = 0; i < n; ++i) {
+      ret[i] = fn(a[lhs_indices[i]], b[rhs_indices[i]]);
+    }
+    return true;
+  };
+
+  switch (inst.GetOpCode()) {
+    case OpCode::ADD: {
+      return apply([](T x, T y) { return static_cast<T>(x + y); });
+    }
+    case OpCode::SUB: {
+      return apply([](T x, T y) { return static_cast<T>(x - y); });
+    }
+    case OpCode::MUL: {
+      return apply([](T x, T y) { return static_cast<T>(x * y); });
+    }
+    case OpCode::DIV: {
+      if (std::is_integral<T>::value) {
+        for (int64_t i = 0; i < n; ++i) {
+          if (b[rhs_indices[i]] == 0) {
+            return false;
+          }
+        }
+      }
+      return apply([](T x, T y) { return static_cast<T>(x / y); });
+    }
+    case OpCode::MAXIMUM: {
+      return apply([](T x, T y) { return std::max(x, y); });
+    }
+    case OpCode::MINIMUM: {
+      return apply([](T x, T y) { return std::min(x, y); });
+    }
+    case OpCode::POW: {
+      return apply([](T x, T y) {
+        return static_cast<T>(
+            std::pow(static_cast<double>(x), static_cast<double>(y)));
+      });
+    }
+    case OpCode::AND: {
+      return apply([](T x, T y) { return static_cast<int8_t>(x && y); });
+    }
+    case OpCode::OR: {
+      return apply([](T x, T y) { return static_cast<int8_t>(x || y); });
+    }
+    case OpCode::SHIFTL:
+    case OpCode::SHIFTR: {
+      if constexpr (std::is_integral<T>::value) {
+        using U = std::make_unsigned_t<T>;
+        if (inst.GetOpCode() == OpCode::SHIFTL) {
+          return apply([](T x, T y) { return static_cast<T>(U(x) << y); });
+        }
+        return apply([](T x, T y) { return static_cast<T>(U(x) >> y); });
+      }
+      return false;
+    }
+    case OpCode::CMP: {
+      switch (DynCast<const CmpInst>(&inst)->GetPredicator()) {
+        case KindPredicate::EQ: {
+          return apply([](T x, T y) { return static_cast<int8_t>(x == y); });
+        }
+        case KindPredicate::NE: {
+          return apply([](T x, T y) { return static_cast<int8_t>(x != y); });
+        }
+        case KindPredicate::GT: {
+          return apply([](T x, T y) { return static_cast<int8_t>(x > y); });
+        }
+        case KindPredicate::LT: {
+          return apply([](T x, T y) { return static_cast<int8_t>(x < y); });
+        }
+        case KindPredicate::GE: {
+          return apply([](T x, T y) { return static_cast<int8_t>(x >= y); });
+        }
+        case KindPredicate::LE: {
+          return apply([](T x, T y) { return static_cast<int8_t>(x <= y); });
+        }
+        default: {
+          return false;
+        }
+      }
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+static bool FoldCast(const Instruction& inst, const Constant& x, void* out) {
+  int64_t n = x.GetResultType().GetTotalNumOfElements();
+  bool is_zext = inst.GetOpCode() == OpCode::ZEXT;
+  bool folded = false;
+  DispatchOnDataType(x.GetResultType().GetDataType(), [&](auto in_v) {
+    using I = decltype(in_v);
+    const I* in = GetData<I>(x);
+    folded = DispatchOnDataType(
+        inst.GetResultType().GetDataType(), [&](auto out_v) {
+          using O = decltype(out_v);
+          O* ret = static_cast<O*>(out);
+          for (int64_t i = 0; i < n; ++i) {
+            if constexpr (std::is_integral<I>::value) {
+              ret[i] = is_zext ? static_cast<O>(std::make_unsigned_t<I>(in[i]))
+                               : static_cast<O>(in[i]);
+            } else {
+              ret[i] = static_cast<O>(in[i]);
+            }
+          }
+        });
+  });
+  return folded;
+}
+
+static bool FoldTranspose(const TransposeInst& inst, const Constant& x,
+                          char* out) {
+  std::vector<int64_t> perm(inst.GetPermutation().begin(),
+                            inst.GetPermutation().end());
+  if (perm.empty() && inst.GetNumOfOperands() > 1) {
+    const Constant* c = DynCast<Constant>(inst.GetOperand(1));
+    for (int i = 0, e = c->GetResultType().GetTotalNumOfElements(); i < e;
+         ++i) {
+      perm.push_back(GetDataAsInt64(*c, i));
+    }
+  }
+  const auto& shape = x.GetResultType().GetDimSizes();
+  if (perm.size() != shape.size()) {
+    return false;
+  }
+  auto in_strides = GetStrides(shape);
+  std::vector<int64_t> strides(perm.size());
+  for (size_t i = 0; i < perm.size(); ++i) {
+    strides[i] = in_strides[perm[i]];
+  }
+  CopyElements(
+      x, GetStridedIndices(inst.GetResultType().GetDimSizes(), strides, 0),
+      out);
+  return true;
+}
+
+static bool FoldSlice(const Instruction& inst,
+                      const std::vector<const Constant*>& ops, char* out) {
+  const auto& shape = ops[0]->GetResultType().GetDimSizes();
+  int rank = shape.size();
+  std::vector<bool> is_sliced(rank, ops.size() <= 4);
+  if (ops.size() > 4) {
+    for (int i = 0, e = ops[4]->GetResultType().GetTotalNumOfElements(); i < e;
+         ++i) {
+      int64_t axis = GetDataAsInt64(*ops[4], i);
+      is_sliced[axis < 0 ? axis + rank : axis] = true;
+    }
+  }
+  // Starts and steps are given in the order of the sliced dimensions.
+  auto in_strides = GetStrides(shape);
+  std::vector<int64_t> strides(rank);
+  int64_t offset = 0;
+  for (int i = 0, j = 0; i < rank; ++i) {
+    int64_t begin = 0;
+    int64_t step = 1;
+    if (is_sliced[i]) {
+      begin = GetDataAsInt64(*ops[1], j);
+      step = ops.size() > 3 ? GetDataAsInt64(*ops[3], j) : 1;
+      ++j;
+    }
+    if (begin < 0) {
+      begin += shape[i];
+    }
+    offset += begin * in_strides[i];
+    strides[i] = step * in_strides[i];
+  }
+  CopyElements(
+      *ops[0],
+      GetStridedIndices(inst.GetResultType().GetDimSizes(), strides, offset),
+      out);
+  return true;
+}
+
+static bool FoldGather(const GatherInst& inst, const Constant& x,
+                       const Constant& indices, char* out) {
+  const auto& shape = x.GetResultType().GetDimSizes();
+  int axis = inst.GetAxis();
+  if (axis < 0) {
+    axis += shape.size();
+  }
+  int64_t outer = 1;
+  int64_t inner = 1;
+  for (int i = 0, e = shape.size(); i < e; ++i) {
+    (i < axis ? outer : inner) *= i == axis ? 1 : shape[i];
+  }
+  int64_t dim = shape[axis];
+  int64_t n = indices.GetResultType().GetTotalNumOfElements();
+  std::vector<int64_t> src;
+  src.reserve(outer * n * inner);
+  for (int64_t o = 0; o < outer; ++o) {
+    for (int64_t k = 0; k < n; ++k) {
+      int64_t idx = GetDataAsInt64(indices, k);
+      idx = idx < 0 ? idx + dim : idx;
+      if (idx < 0 || idx >= dim) {
+        return false;
+      }
+      for (int64_t i = 0; i < inner; ++i) {
+        src.push_back((o * dim + idx) * inner + i);
+      }
+    }
+  }
+  CopyElements(x, src, out);
+  return true;
+}
+
+// Concatenates `inputs` along `axis` of `ret_type`. Stack is a concatenation
+// along a new axis.
+static bool FoldConcat(const std::vector<const Constant*>& inputs,
+                       const Type& ret_type, int axis, char* out) {
+  const auto& shape = ret_type.GetDimSizes();
+  int64_t outer = 1;
+  for (int i = 0; i < axis; ++i) {
+    outer *= shape[i];
+  }
+  size_t elem_size = GetElementSize(ret_type.GetDataType());
+  std::vector<size_t> row_sizes;
+  size_t row_size = 0;
+  for (const Constant* c : inputs) {
+    size_t size = c->GetResultType().GetTotalNumOfElements() / outer;
+    row_sizes.push_back(size * elem_size);
+    row_size += row_sizes.back();
+  }
+  if (row_size * outer != ret_type.GetTotalNumOfElements() * elem_size) {
+    return false;
+  }
+  for (int64_t o = 0; o < outer; ++o) {
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      const char* src = static_cast<const char*>(inputs[i]->GetRawDataPtr());
+      std::memcpy(out, src + o * row_sizes[i], row_sizes[i]);
+      out += row_sizes[i];
+    }
+  }
+  return true;
+}
+
+static bool FoldPad(const PadInst& inst,
+                    const std::vector<const Constant*>& ops, char* out) {
+  const Type& type = ops[0]->GetResultType();
+  const Type& ret_type = inst.GetResultType();
+  int rank = type.GetNumOfDims();
+  if (inst.GetMode() != PadMode::CONSTANT ||
+      ops[1]->GetResultType().GetTotalNumOfElements() != 2 * rank ||
+      ret_type.GetNumOfDims() != static_cast<size_t>(rank)) {
+    return false;
+  }
+  // Only non-negative paddings that produce the result shape are folded.
+  for (int i = 0; i < rank; ++i) {
+    int64_t before = GetDataAsInt64(*ops[1], i * 2);
+    int64_t after = GetDataAsInt64(*ops[1], i * 2 + 1);
+    if (before < 0 || after < 0 ||
+        ret_type.GetNumOfElementsInDim(i) !=
+            type.GetNumOfElementsInDim(i) + before + after) {
+      return false;
+    }
+  }
+  size_t elem_size = GetElementSize(type.GetDataType());
+  std::vector<char> value(elem_size);
+  if (ops.size() > 2) {
+    std::memcpy(value.data(), ops[2]->GetRawDataPtr(), elem_size);
+  }
+  for (int64_t i = 0, e = ret_type.GetTotalNumOfElements(); i < e; ++i) {
+    std::memcpy(out + i * elem_size, value.data(), elem_size);
+  }
+  auto ret_strides = GetStrides(ret_type.GetDimSizes());
+  int64_t offset = 0;
+  for (int i = 0; i < rank; ++i) {
+    offset += GetDataAsInt64(*ops[1], i * 2) * ret_strides[i];
+  }
+  auto dst = GetStridedIndices(type.GetDimSizes(), ret_strides, offset);
+  const char* src = static_cast<const char*>(ops[0]->GetRawDataPtr());
+  for (size_t i = 0, e = dst.size(); i < e; ++i) {
+    std::memcpy(out + dst[i] * elem_size, src + i * elem_size, elem_size);
+  }
+  return true;
+}
+
+template <typename T>
+static bool FoldReduction(const Instruction& inst,
+                          const std::vector<const Constant*>& ops, T* out) {
+  const auto& shape = ops[0]->GetResultType().GetDimSizes();
+  int rank = shape.size();
+  std::vector<int64_t> axes;
+  if (ops.size() > 1) {
+    for (int i = 0, e = ops[1]->GetResultType().GetTotalNumOfElements(); i < e;
+         ++i) {
+      axes.push_back(GetDataAsInt64(*ops[1], i));
+    }
+  } else {
+    std::vector<int> attr_axes;
+    switch (inst.GetOpCode()) {
+      case OpCode::REDUCEMAX: {
+        attr_axes = DynCast<const ReduceMaxInst>(&inst)->GetAxis();
+        break;
+      }
+      case OpCode::REDUCEMIN: {
+        attr_axes = DynCast<const ReduceMinInst>(&inst)->GetAxis();
+        break;
+      }
+      case OpCode::REDUCEMEAN: {
+        attr_axes = DynCast<const ReduceMeanInst>(&inst)->GetAxis();
+        break;
+      }
+      case OpCode::REDUCEPRODUCT: {
+        attr_axes = DynCast<const ReduceProductInst>(&inst)->GetAxis();
+        break;
+      }
+      default: {
+        attr_axes = DynCast<const ReduceSumInst>(&inst)->GetAxis();
+        break;
+      }
+    }
+    axes.assign(attr_axes.begin(), attr_axes.end());
+  }
+  // Strides of the result for each input dimension (0 if reduced).
+  std::vector<int64_t> keep_shape = shape;
+  std::vector<bool> is_reduced(rank);
+  for (auto axis : axes) {
+    axis = axis < 0 ? axis + rank : axis;
+    if (axis < 0 || axis >= rank) {
+      return false;
+    }
+    keep_shape[axis] = 1;
+    is_reduced[axis] = true;
+  }
+  int64_t n = std::accumulate(keep_shape.begin(), keep_shape.end(),
+                              int64_t{1}, std::multiplies<int64_t>());
+  if (n != inst.GetResultType().GetTotalNumOfElements()) {
+    return false;
+  }
+  auto strides = GetStrides(keep_shape);
+  for (int i = 0; i < rank; ++i) {
+    strides[i] = is_reduced[i] ? 0 : strides[i];
+  }
+  auto dst = GetStridedIndices(shape, strides, 0);
+
+  double init = 0;
+  OpCode op = inst.GetOpCode();
+  if (op == OpCode::REDUCEMAX) {
+    init = -std::numeric_limits<double>::infinity();
+  } else if (op == OpCode::REDUCEMIN) {
+    init = std::numeric_limits<double>::infinity();
+  } else if (op == OpCode::REDUCEPRODUCT) {
+    init = 1;
+  }
+  std::vector<double> acc(n, init);
+  const T* in = GetData<T>(*ops[0]);
+  for (size_t i = 0, e = dst.size(); i < e; ++i) {
+    double v = in[i];
+    double& r = acc[dst[i]];
+    switch (op) {
+      case OpCode::REDUCEMAX: {
+        r = std::max(r, v);
+        break;
+      }
+      case OpCode::REDUCEMIN: {
+        r = std::min(r, v);
+        break;
+      }
+      case OpCode::REDUCEPRODUCT: {
+        r *= v;
+        break;
+      }
+      default: {
+        r += v;
+        break;
+      }
+    }
+  }
+  double scale =
+      op == OpCode::REDUCEMEAN ? static_cast<double>(n) / dst.size() : 1;
+  for (int64_t i = 0; i < n; ++i) {
+    out[i] = static_cast<T>(acc[i] * scale);
+  }
+  return true;
+}
+
+template <typename T>
+static bool FoldArgMinMax(const Instruction& inst,
+                          const std::vector<const Constant*>& ops,
+                          int32_t* out) {
+  const auto& shape = ops[0]->GetResultType().GetDimSizes();
+  bool is_max = inst.GetOpCode() == OpCode::ARGMAX;
+  int axis = is_max ? DynCast<const ArgmaxInst>(&inst)->GetAxis()
+                    : DynCast<const ArgminInst>(&inst)->GetAxis();
+  if (ops.size() > 1) {
+    axis = static_cast<int>(GetDataAsInt64(*ops[1], 0));
+  }
+  if (axis < 0) {
+    axis += shape.size();
+  }
+  int64_t outer = 1;
+  int64_t inner = 1;
+  for (int i = 0, e = shape.size(); i < e; ++i) {
+    (i < axis ? outer : inner) *= i == axis ? 1 : shape[i];
+  }
+  int64_t dim = shape[axis];
+  const T* in = GetData<T>(*ops[0]);
+  for (int64_t o = 0; o < outer; ++o) {
+    for (int64_t i = 0; i < inner; ++i) {
+      const T* x = in + o * dim * inner + i;
+      int32_t best = 0;
+      for (int64_t k = 1; k < dim; ++k) {
+        if (is_max ? x[k * inner] > x[best * inner]
+                   : x[k * inner] < x[best * inner]) {
+          best = static_cast<int32_t>(k);
+        }
+      }
+      *out++ = best;
+    }
+  }
+  return true;
+}
+
+// Computes alpha * op(A) * op(B) (+ beta * C for Gemm) for each matrix of the
+// batch.
+template <typename T>
+static bool FoldMatMul(const Instruction& inst,
+                       const std::vector<const Constant*>& ops, T* out) {
+  bool trans_a = false;
+  bool trans_b = false;
+  double alpha = 1;
+  double beta = 0;
+  if (inst.GetOpCode() == OpCode::GEMM) {
+    const GemmInst* gemm = DynCast<const GemmInst>(&inst);
+    trans_a = gemm->GetTransposeA();
+    trans_b = gemm->GetTransposeB();
+    alpha = gemm->GetAlpha();
+    beta = ops.size() > 2 ? gemm->GetBeta() : 0;
+  } else if (inst.GetOpCode() == OpCode::MATMUL) {
+    const MatMulInst* matmul = DynCast<const MatMulInst>(&inst);
+    // Fused bias and activation are not folded.
+    if (ops.size() > 2 || matmul->GetActivation() != ActivationType::NONE) {
+      return false;
+    }
+    trans_a = matmul->GetTransposeA();
+    trans_b = matmul->GetTransposeB();
+  } else {
+    trans_a = DynCast<const BatchMatMulInst>(&inst)->GetTransposeA();
+    trans_b = DynCast<const BatchMatMulInst>(&inst)->GetTransposeB();
+  }
+  const Type& a_type = ops[0]->GetResultType();
+  const Type& ret_type = inst.GetResultType();
+  int rank = ret_type.GetNumOfDims();
+  if (rank < 2 || a_type.GetNumOfDims() != static_cast<size_t>(rank) ||
+      ops[1]->GetResultType().GetNumOfDims() != static_cast<size_t>(rank)) {
+    return false;
+  }
+  int64_t m = ret_type.GetNumOfElementsInDim(rank - 2);
+  int64_t n = ret_type.GetNumOfElementsInDim(rank - 1);
+  int64_t k = a_type.GetNumOfElementsInDim(trans_a ? rank - 2 : rank - 1);
+  int64_t batch = ret_type.GetTotalNumOfElements() / (m * n);
+  if (ops[0]->GetResultType().GetTotalNumOfElements() != batch * m * k ||
+      ops[1]->GetResultType().GetTotalNumOfElements() != batch * k * n) {
+    return false;
+  }
+  std::vector<int64_t> c_indices;
+  if (beta != 0) {
+    c_indices = GetBroadcastIndices(ops[2]->GetResultType(), ret_type);
+    if (c_indices.empty()) {
+      return false;
+    }
+  }
+  const T* a = GetData<T>(*ops[0]);
+  const T* b = GetData<T>(*ops[1]);
+  for (int64_t p = 0; p < batch; ++p) {
+    for (int64_t i = 0; i < m; ++i) {
+      for (int64_t j = 0; j < n; ++j) {
+        double acc = 0;
+        for (int64_t l = 0; l < k; ++l) {
+          acc += static_cast<double>(a[trans_a ? l * m + i : i * k + l]) *
+                 b[trans_b ? j * k + l : l * n + j];
+        }
+        int64_t idx = (p * m + i) * n + j;
+        acc *= alpha;
+        if (beta != 0) {
+          acc += beta * GetData<T>(*ops[2])[c_indices[idx]];
+        }
+        out[idx] = static_cast<T>(acc);
+      }
+    }
+    a += m * k;
+    b += k * n;
+  }
+  return true;
+}
+
+// Direct convolution over the paddings computed by the type legalizer.
+template <typename T>
+static bool FoldConv2D(const Conv2DInst& inst,
+                       const std::vector<const Constant*>& ops, T* out) {
+  DataFormat format = inst.GetDataFormat();
+  DataFormat filter_format = inst.GetFilterFormat();
+  // A fused activation is not folded.
+  if (inst.GetActivation() != ActivationType::NONE) {
+    return false;
+  }
+  if ((format != DataFormat::NCHW && format != DataFormat::NHWC) ||
+      (format == DataFormat::NHWC && filter_format != DataFormat::HWCN &&
+       filter_format != DataFormat::NHWC)) {
+    return false;
+  }
+  const auto& info = ImageAxisInfo::GetImageAxisInfo(format, filter_format);
+  const auto& x_shape = ops[0]->GetResultType().GetDimSizes();
+  const auto& w_shape = ops[1]->GetResultType().GetDimSizes();
+  const auto& y_shape = inst.GetResultType().GetDimSizes();
+  int64_t group = inst.GetGroup();
+  int64_t ic = x_shape[info.data_channel_axis];
+  int64_t oc = y_shape[info.data_channel_axis];
+  int64_t ic_per_group = w_shape[info.kernel_input_axis];
+  if (group < 1 || ic_per_group * group != ic || oc % group != 0 ||
+      w_shape[info.kernel_output_axis] != oc ||
+      (ops.size() > 2 &&
+       ops[2]->GetResultType().GetTotalNumOfElements() != oc)) {
+    return false;
+  }
+  int h_axis = info.data_height_axis;
+  int w_axis = info.data_width_axis;
+  int64_t stride_h = inst.GetStrides()[info.data_spatial_axis];
+  int64_t stride_w = inst.GetStrides()[info.data_spatial_axis + 1];
+  int64_t dilation_h = inst.GetDilations()[info.data_spatial_axis];
+  int64_t dilation_w = inst.GetDilations()[info.data_spatial_axis + 1];
+  int64_t kh = w_shape[info.kernel_height_axis];
+  int64_t kw = w_shape[info.kernel_width_axis];
+  auto x_strides = GetStrides(x_shape);
+  auto w_strides = GetStrides(w_shape);
+  auto y_strides = GetStrides(y_shape);
+
+  const T* x = GetData<T>(*ops[0]);
+  const T* w = GetData<T>(*ops[1]);
+  int64_t oc_per_group = oc / group;
+  for (int64_t b = 0; b < y_shape[info.batch_axis]; ++b) {
+    for (int64_t c = 0; c < oc; ++c) {
+      int64_t g = c / oc_per_group;
+      for (int64_t oh = 0; oh < y_shape[h_axis]; ++oh) {
+        for (int64_t ow = 0; ow < y_shape[w_axis]; ++ow) {
+          double acc = ops.size() > 2 ? GetData<T>(*ops[2])[c] : 0;
+          for (int64_t ci = 0; ci < ic_per_group; ++ci) {
+            for (int64_t i = 0; i < kh; ++i) {
+              int64_t ih =
+                  oh * stride_h - inst.GetPaddingTop() + i * dilation_h;
+              for (int64_t j = 0; j < kw; ++j) {
+                int64_t iw =
+                    ow * stride_w - inst.GetPaddingLeft() + j * dilation_w;
+                if (ih < 0 || ih >= x_shape[h_axis] || iw < 0 ||
+                    iw >= x_shape[w_axis]) {
+                  continue;
+                }
+                int64_t x_idx = b * x_strides[info.batch_axis] +
+                                (g * ic_per_group + ci) *
+                                    x_strides[info.data_channel_axis] +
+                                ih * x_strides[h_axis] + iw * x_strides[w_axis];
+                int64_t w_idx = c * w_strides[info.kernel_output_axis] +
+                                ci * w_strides[info.kernel_input_axis] +
+                                i * w_strides[info.kernel_height_axis] +
+                                j * w_strides[info.kernel_width_axis];
+                acc += static_cast<double>(x[x_idx]) * w[w_idx];
+              }
+            }
+          }
+          out[b * y_strides[info.batch_axis] +
+              c * y_strides[info.data_channel_axis] + oh * y_strides[h_axis] +
+              ow * y_strides[w_axis]] = static_cast<T>(acc);
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// Evaluates `inst` over the constant operands `ops` into `out`, which has the
+// size of the result. Returns false if `inst` is not supported.
+static bool Evaluate(const Instruction& inst,
+                     const std::vector<const Constant*>& ops, char* out) {
+  DataType dt = ops[0]->GetResultType().GetDataType();
+  bool folded = false;
+  switch (inst.GetOpCode()) {
+    case OpCode::ABS:
+    case OpCode::CEIL:
+    case OpCode::ELU:
+    case OpCode::ERF:
+    case OpCode::EXP:
+    case OpCode::FLOOR:
+    case OpCode::LEAKYRELU:
+    case OpCode::NEG:
+    case OpCode::RCP:
+    case OpCode::RELU:
+    case OpCode::RELU6:
+    case OpCode::RSQRT:
+    case OpCode::SIGMOID:
+    case OpCode::SIGN:
+    case OpCode::SQRT:
+    case OpCode::TANH: {
+      DispatchOnDataType(dt, [&](auto v) {
+        using T = decltype(v);
+        folded = FoldUnary(inst, *ops[0], reinterpret_cast<T*>(out)); // NOLINT
+      });
+      return folded;
+    }
+    case OpCode::ADD:
+    case OpCode::SUB:
+    case OpCode::MUL:
+    case OpCode::DIV:
+    case OpCode::MAXIMUM:
+    case OpCode::MINIMUM:
+    case OpCode::POW:
+    case OpCode::AND:
+    case OpCode::OR:
+    case OpCode::SHIFTL:
+    case OpCode::SHIFTR:
+    case OpCode::CMP: {
+      if (ops[1]->GetResultType().GetDataType() != dt) {
+        return false;
+      }
+      DispatchOnDataType(dt, [&](auto v) {
+        folded = FoldBinary<decltype(v)>(inst, *ops[0], *ops[1], out);
+      });
+      return folded;
+    }
+    case OpCode::SITOFP:
+    case OpCode::FPTOSI:
+    case OpCode::ZEXT: {
+      return FoldCast(inst, *ops[0], out);
+    }
+    case OpCode::RESHAPE: {
+      std::memcpy(out, ops[0]->GetRawDataPtr(),
+                  inst.GetResultType().GetTotalNumOfElements() *
+                      GetElementSize(dt));
+      return true;
+    }
+    case OpCode::TRANSPOSE: {
+      return FoldTranspose(*DynCast<const TransposeInst>(&inst), *ops[0],
+                           out);
+    }
+    case OpCode::SLICE: {
+      return FoldSlice(inst, ops, out);
+    }
+    case OpCode::GATHER: {
+      return FoldGather(*DynCast<const GatherInst>(&inst), *ops[0], *ops[1],
+                        out);
+    }
+    case OpCode::CONCAT: {
+      const ConcatInst* concat = DynCast<const ConcatInst>(&inst);
+      size_t n = concat->GetN() > 0 ? concat->GetN() : ops.size();
+      int axis = concat->GetAxis();
+      if (axis < 0) {
+        axis += inst.GetResultType().GetNumOfDims();
+      }
+      return n <= ops.size() &&
+             FoldConcat({ops.begin(), ops.begin() + n}, inst.GetResultType(),
+                        axis, out);
+    }
+    case OpCode::STACK: {
+      int axis = DynCast<const StackInst>(&inst)->GetAxis();
+      if (axis < 0) {
+        axis += inst.GetResultType().GetNumOfDims();
+      }
+      return FoldConcat(ops, inst.GetResultType(), axis, out);
+    }
+    case OpCode::PAD: {
+      return FoldPad(*DynCast<const PadInst>(&inst), ops, out);
+    }
+    case OpCode::REDUCEMAX:
+    case OpCode::REDUCEMIN:
+    case OpCode::REDUCEMEAN:
+    case OpCode::REDUCEPRODUCT:
+    case OpCode::REDUCESUM: {
+      DispatchOnDataType(dt, [&](auto v) {
+        using T = decltype(v);
+        folded = FoldReduction(inst, ops, reinterpret_cast<T*>(out)); // NOLINT
+      });
+      return folded;
+    }
+    case OpCode::ARGMAX:
+    case OpCode::ARGMIN: {
+      if (inst.GetResultType().GetDataType() != DataType::INT32) {
+        return false;
+      }
+      DispatchOnDataType(dt, [&](auto v) {
+        folded = FoldArgMinMax<decltype(v)>(
+            inst, ops, reinterpret_cast<int32_t*>(out)); // NOLINT
+      });
+      return folded;
+    }
+    case OpCode::BATCHMATMUL:
+    case OpCode::GEMM:
+    case OpCode::MATMUL: {
+      if (dt != DataType::FLOAT32) {
+        return false;
+      }
+      return FoldMatMul(inst, ops, reinterpret_cast<float*>(out)); // NOLINT
+    }
+    case OpCode::CONV2D: {
+      if (dt != DataType::FLOAT32) {
+        return false;
+      }
+      return FoldConv2D(*DynCast<const Conv2DInst>(&inst), ops,
+                        reinterpret_cast<float*>(out)); // NOLINT
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+bool ConstantFolding::RunOnBasicBlock(BasicBlock* bb) {
+  bool changed = false;
+  ConstantBuilder cb(bb->GetParent());
+  for (auto& inst_t : *bb) {
+    Instruction* inst = inst_t.get();
+    const halo::Type& ret_type = inst->GetResultType();
+    if (inst->GetNumberOfUses() == 0 || inst->GetNumOfResults() != 1 ||
+        inst->GetNumOfOperands() == 0 || !ret_type.IsValid()) {
+      continue;
+    }
+    std::vector<const Constant*> ops;
+    size_t ops_size = 0;
+    for (const auto& op : inst->GetOperands()) {
+      if (!IsA<Constant>(op) || !op.GetType().IsValid()) {
+        break;
+      }
+      ops.push_back(DynCast<Constant>(op));
+      ops_size += op.GetType().GetTotalNumOfElements() *
+                  GetElementSize(op.GetType().GetDataType());
+    }
+    size_t elem_size = GetElementSize(ret_type.GetDataType());
+    size_t size = ret_type.GetTotalNumOfElements() * elem_size;
+    if (ops.size() != inst->GetNumOfOperands() || elem_size == 0 ||
+        GetElementSize(ops[0]->GetResultType().GetDataType()) == 0 ||
+        (size > max_size_in_bytes_ && size > ops_size)) {
+      continue;
+    }
+    std::vector<char> data(size);
+    if (!Evaluate(*inst, ops, data.data())) {
+      continue;
+    }
+    Constant* c = cb.CreateConstant(inst->GetName() + "_folded", ret_type,
+                                    data.data());
+    inst->ReplaceAllUsesWith(0, *c);
+    changed = true;
+  }
+  return changed;
+}
+
+} // end namespace halo
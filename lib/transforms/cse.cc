@@ -0,0 +1,125 @@
+//===- cse.cc -------------------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "halo/lib/transforms/cse.h"
+
+#include <limits>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "halo/lib/ir/ir_builder.h"
+
+namespace halo {
+
+static bool IsMergeable(const Instruction& inst) {
+  switch (inst.GetOpCode()) {
+    case OpCode::CALL:
+    case OpCode::EXTENSION:
+    case OpCode::IF:
+    case OpCode::JUMP:
+    case OpCode::LOOP:
+    case OpCode::RANDOMUNIFORM:
+    case OpCode::RETURN: {
+      return false;
+    }
+    default: {
+      return inst.GetNumOfResults() > 0;
+    }
+  }
+}
+
+// Returns the value number of `inst`: its opcode, operands, result types and
+// attributes.
+static std::string GetKey(const Instruction& inst) {
+  std::ostringstream os;
+  // Attributes are printed, so floats must round trip.
+  os.precision(std::numeric_limits<double>::max_digits10);
+  os << static_cast<int>(inst.GetOpCode()) << "(";
+  for (const auto& op : inst.GetOperands()) {
+    os << op.GetOwner() << ":" << op.GetIdx() << ",";
+  }
+  os << ")";
+  for (const auto& type : inst.GetResultsTypes()) {
+    type.Print(os);
+  }
+  inst.PrintAttributes(os);
+  return os.str();
+}
+
+static std::string_view GetContent(const Constant& c) {
+  const auto& type = c.GetResultType();
+  return std::string_view(static_cast<const char*>(c.GetRawDataPtr()),
+                          c.GetElementSizeInBytes() *
+                              type.GetTotalNumOfElements());
+}
+
+static bool MergeConstants(Function* func) {
+  bool changed = false;
+  // Constants bucketed by the hash of their content.
+  std::unordered_map<size_t, std::vector<Constant*>> buckets;
+  for (auto& c : func->Constants()) {
+    const auto& type = c->GetResultType();
+    if (!type.IsValid()) {
+      continue;
+    }
+    std::string_view content = GetContent(*c);
+    auto& bucket = buckets[std::hash<std::string_view>{}(content)];
+    Constant* same = nullptr;
+    for (Constant* other : bucket) {
+      if (other->GetResultType() == type && GetContent(*other) == content) {
+        same = other;
+        break;
+      }
+    }
+    if (same == nullptr) {
+      bucket.push_back(c.get());
+    } else if (c->GetNumberOfUses() > 0) {
+      c->ReplaceAllUsesWith(0, *same);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+bool CSE::RunOnFunction(Function* func) {
+  bool changed = MergeConstants(func);
+  for (auto& bb : *func) {
+    std::unordered_map<std::string, Instruction*> values;
+    for (auto& it : *bb) {
+      Instruction* inst = it.get();
+      if (!IsMergeable(*inst)) {
+        continue;
+      }
+      auto [value, inserted] = values.try_emplace(GetKey(*inst), inst);
+      if (inserted || inst->GetNumberOfUses() == 0) {
+        continue;
+      }
+      std::vector<Def> defs;
+      for (int i = 0, e = inst->GetNumOfResults(); i < e; ++i) {
+        defs.emplace_back(value->second, i);
+      }
+      inst->ReplaceAllUsesWith(defs);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+} // end namespace halo
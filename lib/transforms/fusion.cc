@@ -17,6 +17,11 @@
 
 #include "halo/lib/transforms/fusion.h"
 
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+#include <vector>
+
 #include "halo/api/halo_data.h"
 #include "halo/lib/framework/common.h"
 #include "halo/lib/framework/data_layout.h"
@@ -25,6 +30,113 @@
 
 namespace halo {
 
+std::vector<ElementwiseStep> GetElementwiseSteps(
+    const FusedElementwiseInst& inst) {
+  const auto& op_codes = inst.GetOpcodes();
+  const auto& ids = inst.GetOperandIds();
+  const auto& alphas = inst.GetAlphas();
+  HLCHECK(ids.size() == 2 * op_codes.size() &&
+          alphas.size() == op_codes.size() && "Invalid elementwise steps");
+  std::vector<ElementwiseStep> steps;
+  steps.reserve(op_codes.size());
+  for (size_t i = 0, e = op_codes.size(); i < e; ++i) {
+    steps.push_back({static_cast<OpCode>(op_codes[i]), ids[2 * i],
+                     ids[2 * i + 1], alphas[i]});
+  }
+  return steps;
+}
+
+void SetElementwiseSteps(FusedElementwiseInst* inst,
+                         const std::vector<ElementwiseStep>& steps) {
+  std::vector<int> op_codes;
+  std::vector<int> ids;
+  std::vector<float> alphas;
+  for (const auto& step : steps) {
+    op_codes.push_back(static_cast<int>(step.op_code));
+    ids.push_back(step.lhs);
+    ids.push_back(step.rhs);
+    alphas.push_back(step.alpha);
+  }
+  inst->SetOpcodes(op_codes);
+  inst->SetOperandIds(ids);
+  inst->SetAlphas(alphas);
+}
+
+bool IsFusibleElementwise(const Instruction& inst) {
+  if (inst.GetNumOfResults() != 1 ||
+      inst.GetResultType().GetDataType() != DataType::FLOAT32) {
+    return false;
+  }
+  switch (inst.GetOpCode()) {
+    case OpCode::ADD:
+    case OpCode::DIV:
+    case OpCode::MAXIMUM:
+    case OpCode::MINIMUM:
+    case OpCode::MUL:
+    case OpCode::SUB: {
+      return inst.GetNumOfOperands() == 2;
+    }
+    case OpCode::ABS:
+    case OpCode::LEAKYRELU:
+    case OpCode::NEG:
+    case OpCode::RCP:
+    case OpCode::RELU:
+    case OpCode::RELU6:
+    case OpCode::RSQRT:
+    case OpCode::SQRT: {
+      return inst.GetNumOfOperands() == 1;
+    }
+    case OpCode::FUSEDELEMENTWISE: {
+      return true;
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+// Helpers for the predicates of fusion.td.
+
+static bool HasNumOfUses(const Def& def, size_t n) {
+  return def.GetUses().GetNumOfUses() == n;
+}
+
+static bool IsConstantScalar(const Def& def, float value) {
+  if (!IsA<Constant>(def) || def.GetType().GetDataType() != DataType::FLOAT32 ||
+      def.GetType().GetTotalNumOfElements() != 1) {
+    return false;
+  }
+  constexpr float eps = 1e-4F;
+  float v = DynCast<Constant>(def)->GetData<float>(0);
+  return std::abs(v - value) <= eps * std::abs(value);
+}
+
+// Returns true if `bias` has one value per output channel of the convolution
+// or matmul `def` and is laid out along the channel axis.
+static bool IsChannelBias(const Def& def, const Def& bias) {
+  const Type& type = def.GetType();
+  const Type& bias_type = bias.GetType();
+  if (!type.IsValid() || !bias_type.IsValid() ||
+      bias_type.GetDataType() != type.GetDataType() ||
+      bias_type.GetNumOfDims() > type.GetNumOfDims()) {
+    return false;
+  }
+  int channel_axis = static_cast<int>(type.GetNumOfDims()) - 1;
+  if (IsA<Instruction>(def) &&
+      DynCast<Instruction>(def)->GetOpCode() == OpCode::CONV2D &&
+      DynCast<Conv2DInst>(def)->GetDataFormat() == DataFormat::NCHW) {
+    channel_axis = 1;
+  }
+  int64_t channels = type.GetNumOfElementsInDim(channel_axis);
+  int offset = static_cast<int>(type.GetNumOfDims() - bias_type.GetNumOfDims());
+  for (int i = 0, e = bias_type.GetNumOfDims(); i < e; ++i) {
+    if (bias_type.GetNumOfElementsInDim(i) != 1 && i + offset != channel_axis) {
+      return false;
+    }
+  }
+  return bias_type.GetTotalNumOfElements() == channels;
+}
+
 static bool ValidateOpSizeAndCode(const Instruction* inst, size_t op_num,
                                   OpCode op) {
   return inst->GetNumOfOperands() == op_num && inst->GetOpCode() == op;
@@ -34,13 +146,121 @@ static bool ValidateOpSizeAndCode(const Instruction* inst, size_t op_num,
 #include "halo/lib/ir/fusion.cc.inc"
 #undef HALO_FUSION_MATCHERS
 
+namespace {
+
+// Builds the steps of a FusedElementwiseInst rooted at an instruction.
+// Operands produced by single-use fusible instructions of the result type in
+// the same basic block are computed by the chain, the other ones are inputs.
+class ElementwiseChain {
+ public:
+  explicit ElementwiseChain(const Instruction& root)
+      : bb_(root.GetParent()), type_(root.GetResultType()) {
+    Append(root);
+  }
+
+  const std::vector<Def>& GetInputs() const noexcept { return inputs_; }
+  const std::vector<ElementwiseStep>& GetSteps() const noexcept {
+    return steps_;
+  }
+  // Returns the number of instructions fused into the root.
+  size_t GetNumOfFused() const noexcept { return fused_; }
+
+ private:
+  // Appends the steps computing `inst` and returns the id of its result.
+  int Append(const Instruction& inst) {
+    std::vector<int> ids;
+    for (const auto& op : inst.GetOperands()) {
+      ids.push_back(GetOperandId(op));
+    }
+    if (inst.GetOpCode() == OpCode::FUSEDELEMENTWISE) {
+      // Steps of a fused instruction are inlined with their ids remapped.
+      const auto& fused = static_cast<const FusedElementwiseInst&>(inst);
+      int base = static_cast<int>(steps_.size());
+      auto remap = [&ids, base](int id) {
+        return id >= 0 ? ids[id] : id - base;
+      };
+      for (auto step : GetElementwiseSteps(fused)) {
+        step.lhs = remap(step.lhs);
+        step.rhs = remap(step.rhs);
+        steps_.push_back(step);
+      }
+    } else {
+      float alpha = 0;
+      if (inst.GetOpCode() == OpCode::LEAKYRELU) {
+        alpha = static_cast<const LeakyReluInst&>(inst).GetAlpha();
+      }
+      steps_.push_back(
+          {inst.GetOpCode(), ids[0], ids.size() > 1 ? ids[1] : ids[0], alpha});
+    }
+    return -static_cast<int>(steps_.size());
+  }
+
+  int GetOperandId(const Def& op) {
+    if (IsA<Instruction>(op)) {
+      const Instruction* inst = DynCast<Instruction>(op);
+      if (inst->GetParent() == bb_ && IsFusibleElementwise(*inst) &&
+          HasNumOfUses(op, 1) && op.GetType() == type_) {
+        ++fused_;
+        return Append(*inst);
+      }
+    }
+    auto it = std::find(inputs_.begin(), inputs_.end(), op);
+    if (it != inputs_.end()) {
+      return static_cast<int>(it - inputs_.begin());
+    }
+    inputs_.push_back(op);
+    return static_cast<int>(inputs_.size()) - 1;
+  }
+
+  const BasicBlock* bb_;
+  const Type& type_;
+  std::vector<Def> inputs_;
+  std::vector<ElementwiseStep> steps_;
+  size_t fused_ = 0;
+};
+
+} // end anonymous namespace
+
+static std::pair<Def, Def> FuseElementwiseChain(Instruction* inst,
+                                                IRBuilder* builder) {
+  std::pair<Def, Def> ret{Def{inst, 0}, Def{inst, 0}};
+  if (!IsFusibleElementwise(*inst)) {
+    return ret;
+  }
+  ElementwiseChain chain(*inst);
+  if (chain.GetNumOfFused() == 0) {
+    return ret;
+  }
+  builder->SetInsertAfter(inst);
+  auto fused = builder->CreateFusedElementwise(inst->GetName() + "_fused",
+                                               chain.GetInputs());
+  SetElementwiseSteps(fused, chain.GetSteps());
+  fused->GetResultsTypes() = inst->GetResultsTypes();
+  ret.second = Def(fused, 0);
+  return ret;
+}
+
 bool Fusion::RunOnBasicBlock(BasicBlock* bb) {
   bool changed = false;
   IRBuilder builder(bb);
 
+  // Instructions only used by replaced (or dead) instructions are dead, so
+  // the instructions fused into a pattern are not matched again.
+  std::vector<Instruction*> insts;
   for (auto& inst_t : *bb) {
-    Instruction* inst = inst_t.get();
-    if (inst->GetNumberOfUses() == 0) {
+    insts.push_back(inst_t.get());
+  }
+  std::unordered_set<const IRObject*> dead;
+  for (auto it = insts.rbegin(), e = insts.rend(); it != e; ++it) {
+    Instruction* inst = *it;
+    bool is_live = false;
+    for (const auto& uses : inst->GetResultsUses()) {
+      for (const auto& use : uses) {
+        is_live |= dead.count(use.GetUse()) == 0;
+      }
+    }
+    if (!is_live) {
+      dead.insert(inst);
       continue;
     }
     std::pair<Def, Def> ret{Def{inst, 0}, Def{inst, 0}};
@@ -49,15 +269,20 @@ bool Fusion::RunOnBasicBlock(BasicBlock* bb) {
 #include "halo/lib/ir/fusion.cc.inc"
 #undef HALO_FUSION_CALLS
 
+    if (ret.first == ret.second && opts_.ElementwiseChain) {
+      ret = FuseElementwiseChain(inst, &builder);
+    }
+
     if (ret.first != ret.second) {
       changed |= true;
       if (ret.second.GetOwner() != nullptr) {
         // Replace all uses
         inst->ReplaceAllUsesWith(ret.first.GetIdx(), ret.second);
+        dead.insert(inst);
       }
     }
   }
   return changed;
 }
 
-} // end namespace halo
\ No newline at end of file
+} // end namespace halo
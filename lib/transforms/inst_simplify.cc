@@ -18,6 +18,8 @@
 #include "halo/lib/transforms/inst_simplify.h"
 
 #include <algorithm>
+#include <cmath>
+#include <deque>
 #include <numeric>
 #include <random>
 #include <string>
@@ -113,6 +115,293 @@ static Constant* RunConstantFoldingOnMathBinary(const std::string& name,
   return c_ret;
 }
 
+// Returns the per-channel values of the constant `def` broadcast to a value of
+// `type` whose channels are along `axis`, or an empty vector if the values
+// also vary along other axes. The shape of `def` is aligned to the right.
+static std::vector<float> GetPerChannelData(const Def& def, const Type& type,
+                                            int axis) {
+  const Type& c_type = def.GetType();
+  if (!IsA<Constant>(def) || !c_type.IsValid() ||
+      c_type.GetDataType() != DataType::FLOAT32 ||
+      c_type.GetNumOfDims() > type.GetNumOfDims()) {
+    return {};
+  }
+  const Constant* c = DynCast<Constant>(def);
+  int64_t channels = type.GetNumOfElementsInDim(axis);
+  int c_axis = axis - static_cast<int>(type.GetNumOfDims()) +
+               static_cast<int>(c_type.GetNumOfDims());
+  int64_t c_channels = c_axis < 0 ? 1 : c_type.GetNumOfElementsInDim(c_axis);
+  if (c_channels != 1 && c_channels != channels) {
+    return {};
+  }
+  int64_t stride = 1;
+  for (int i = c_axis + 1, e = c_type.GetNumOfDims(); i < e; ++i) {
+    stride *= c_type.GetNumOfElementsInDim(i);
+  }
+  std::vector<float> ret(c_channels);
+  std::vector<bool> is_set(c_channels, false);
+  for (int64_t i = 0, e = c_type.GetTotalNumOfElements(); i < e; ++i) {
+    int64_t ch = (i / stride) % c_channels;
+    float v = c->GetData<float>(i);
+    if (is_set[ch] && ret[ch] != v) {
+      return {};
+    }
+    ret[ch] = v;
+    is_set[ch] = true;
+  }
+  ret.resize(channels, ret[0]);
+  return ret;
+}
+
+// Returns the axis of the channels of the result of a foldable instruction.
+static int GetChannelAxis(const Instruction& inst) {
+  if (inst.GetOpCode() == OpCode::GEMM) {
+    return 1;
+  }
+  const Conv2DInst* conv = DynCast<const Conv2DInst>(&inst);
+  return ImageAxisInfo::GetImageAxisInfo(conv->GetDataFormat(),
+                                         conv->GetFilterFormat())
+      .data_channel_axis;
+}
+
+// Returns the instruction producing `def` if it is a convolution or a Gemm
+// with constant weights whose result is only read by one instruction, so that
+// a per-channel affine transformation of its result can be folded into its
+// weights.
+static Instruction* GetFoldableProducer(const Def& def) {
+  if (!IsA<Instruction>(def)) {
+    return nullptr;
+  }
+  Instruction* inst = DynCast<Instruction>(def);
+  const Type& type = inst->GetResultType();
+  if (inst->GetNumberOfUses() != 1 || !type.IsValid() ||
+      type.GetDataType() != DataType::FLOAT32) {
+    return nullptr;
+  }
+  auto is_float_constant = [](const Def& op) {
+    return IsA<Constant>(op) && op.GetType().IsValid() &&
+           op.GetType().GetDataType() == DataType::FLOAT32;
+  };
+  if (inst->GetOpCode() == OpCode::CONV2D) {
+    const Conv2DInst* conv = DynCast<Conv2DInst>(inst);
+    const Def& kernel = conv->GetOperand(1);
+    DataFormat format = conv->GetDataFormat();
+    DataFormat filter_format = conv->GetFilterFormat();
+    if (!is_float_constant(kernel) ||
+        (format != DataFormat::NCHW && format != DataFormat::NHWC) ||
+        (format == DataFormat::NHWC && filter_format != DataFormat::HWCN &&
+         filter_format != DataFormat::NHWC)) {
+      return nullptr;
+    }
+    const auto& info = ImageAxisInfo::GetImageAxisInfo(format, filter_format);
+    int64_t channels = type.GetNumOfElementsInDim(info.data_channel_axis);
+    // The optional fused bias has one value per output channel.
+    if (conv->GetNumOfOperands() > 2 &&
+        (!is_float_constant(conv->GetOperand(2)) ||
+         conv->GetOperand(2).GetType().GetTotalNumOfElements() != channels)) {
+      return nullptr;
+    }
+    return kernel.GetType().GetNumOfElementsInDim(info.kernel_output_axis) ==
+                   channels
+               ? inst
+               : nullptr;
+  }
+  if (inst->GetOpCode() == OpCode::GEMM && inst->GetNumOfOperands() == 3) {
+    // The bias is scaled along with the weights.
+    const Def& bias = inst->GetOperand(2);
+    const Type& bias_type = bias.GetType();
+    if (!is_float_constant(inst->GetOperand(1)) || !is_float_constant(bias) ||
+        bias_type.GetNumOfDims() == 0 ||
+        bias_type.GetNumOfElementsInDim(bias_type.GetNumOfDims() - 1) !=
+            type.GetNumOfElementsInDim(1)) {
+      return nullptr;
+    }
+    return inst;
+  }
+  return nullptr;
+}
+
+static bool HasFusedBias(const Instruction& inst) {
+  return inst.GetOpCode() == OpCode::CONV2D && inst.GetNumOfOperands() > 2;
+}
+
+// Matches `def` with op(x) or op(x) + bias, where op is a foldable producer
+// and bias is a per-channel constant. The values of the bias, including the
+// one fused into a convolution, are returned through `bias` (empty if there
+// is no bias at all).
+static Instruction* MatchBiasedProducer(const Def& def,
+                                        std::vector<float>* bias) {
+  bias->clear();
+  Instruction* producer = GetFoldableProducer(def);
+  if (producer == nullptr && IsA<Instruction>(def)) {
+    const Instruction* add = DynCast<Instruction>(def);
+    if (add->GetOpCode() != OpCode::ADD || add->GetNumberOfUses() != 1) {
+      return nullptr;
+    }
+    for (int i = 0; i < 2 && producer == nullptr; ++i) {
+      producer = GetFoldableProducer(add->GetOperand(i));
+      if (producer != nullptr) {
+        *bias = GetPerChannelData(add->GetOperand(1 - i),
+                                  producer->GetResultType(),
+                                  GetChannelAxis(*producer));
+        if (bias->empty() ||
+            add->GetResultType() != producer->GetResultType()) {
+          producer = nullptr;
+        }
+      }
+    }
+  }
+  if (producer != nullptr && HasFusedBias(*producer)) {
+    const Constant* fused = DynCast<Constant>(producer->GetOperand(2));
+    bias->resize(fused->GetResultType().GetTotalNumOfElements());
+    for (size_t i = 0, e = bias->size(); i < e; ++i) {
+      (*bias)[i] += fused->GetData<float>(i);
+    }
+  }
+  return producer;
+}
+
+// Returns the data of `c` with the slices along `axis` multiplied by `scale`.
+static std::vector<float> ScaleAlongAxis(const Constant& c, int axis,
+                                         const std::vector<float>& scale) {
+  const Type& type = c.GetResultType();
+  int64_t stride = 1;
+  for (int i = axis + 1, e = type.GetNumOfDims(); i < e; ++i) {
+    stride *= type.GetNumOfElementsInDim(i);
+  }
+  int64_t channels = type.GetNumOfElementsInDim(axis);
+  std::vector<float> ret(type.GetTotalNumOfElements());
+  for (int64_t i = 0, e = ret.size(); i < e; ++i) {
+    ret[i] = c.GetData<float>(i) * scale[(i / stride) % channels];
+  }
+  return ret;
+}
+
+// Folds y = (op(x) + bias) * scale + shift, where op is a foldable producer
+// and bias, scale and shift are per-channel, into a copy of op with scaled
+// weights followed by the addition of a new bias. The weights of op may be
+// shared, so they are never modified. Returns the value replacing the result
+// of `inst`.
+static Def FoldIntoProducer(Instruction* inst, Instruction* producer,
+                            const std::vector<float>& bias,
+                            const std::vector<float>& scale,
+                            const std::vector<float>& shift) {
+  const Type& type = producer->GetResultType();
+  int axis = GetChannelAxis(*producer);
+  int64_t channels = type.GetNumOfElementsInDim(axis);
+  HLCHECK(static_cast<int64_t>(scale.size()) == channels &&
+          static_cast<int64_t>(shift.size()) == channels);
+
+  bool is_scaled = false;
+  bool has_bias = false;
+  std::vector<float> new_bias(channels);
+  for (int64_t i = 0; i < channels; ++i) {
+    new_bias[i] = (bias.empty() ? 0 : bias[i]) * scale[i] + shift[i];
+    is_scaled |= scale[i] != 1;
+    has_bias |= new_bias[i] != 0;
+  }
+
+  IRBuilder builder(inst->GetParent());
+  builder.SetInsertAfter(inst);
+  ConstantBuilder cb(inst->GetParent()->GetParent());
+  std::string suffix = "_folded_" + std::to_string(inst->GetId());
+  Def ret{producer, 0};
+  // A fused bias is updated in a copy of the convolution.
+  if ((is_scaled || HasFusedBias(*producer)) &&
+      producer->GetOpCode() == OpCode::CONV2D) {
+    const Conv2DInst* conv = DynCast<Conv2DInst>(producer);
+    const Constant* kernel = DynCast<Constant>(conv->GetOperand(1));
+    const auto& info = ImageAxisInfo::GetImageAxisInfo(
+        conv->GetDataFormat(), conv->GetFilterFormat());
+    auto data = ScaleAlongAxis(*kernel, info.kernel_output_axis, scale);
+    Constant* new_kernel = cb.CreateConstant(
+        kernel->GetName() + suffix, kernel->GetResultType(), data.data());
+    std::vector<Def> operands{conv->GetOperand(0), *new_kernel};
+    if (HasFusedBias(*conv)) {
+      operands.push_back(*cb.CreateConstant(
+          conv->GetOperand(2).GetOwner()->GetName() + suffix,
+          Type{DataType::FLOAT32, {channels}}, new_bias.data()));
+      has_bias = false;
+    }
+    Conv2DInst* new_conv =
+        builder.CreateConv2D(conv->GetName() + suffix, operands);
+    new_conv->SetPadding(conv->GetPadding());
+    new_conv->SetStrides(conv->GetStrides());
+    new_conv->SetDataFormat(conv->GetDataFormat());
+    new_conv->SetFilterFormat(conv->GetFilterFormat());
+    new_conv->SetDilations(conv->GetDilations());
+    new_conv->SetPaddingLeft(conv->GetPaddingLeft());
+    new_conv->SetPaddingRight(conv->GetPaddingRight());
+    new_conv->SetPaddingTop(conv->GetPaddingTop());
+    new_conv->SetPaddingBottom(conv->GetPaddingBottom());
+    new_conv->SetGroup(conv->GetGroup());
+    new_conv->GetResultsTypes()[0] = type;
+    ret = *new_conv;
+  } else if (is_scaled) {
+    // alpha * A * (B * s) + beta * (C * s) == (alpha * A * B + beta * C) * s.
+    const GemmInst* gemm = DynCast<GemmInst>(producer);
+    const Constant* weights = DynCast<Constant>(gemm->GetOperand(1));
+    const Constant* gemm_bias = DynCast<Constant>(gemm->GetOperand(2));
+    auto data = ScaleAlongAxis(*weights, gemm->GetTransposeB() ? 0 : 1, scale);
+    Constant* new_weights = cb.CreateConstant(
+        weights->GetName() + suffix, weights->GetResultType(), data.data());
+    const Type& bias_type = gemm_bias->GetResultType();
+    data = ScaleAlongAxis(*gemm_bias, bias_type.GetNumOfDims() - 1, scale);
+    Constant* new_gemm_bias = cb.CreateConstant(gemm_bias->GetName() + suffix,
+                                                bias_type, data.data());
+    GemmInst* new_gemm = builder.CreateGemm(
+        gemm->GetName() + suffix,
+        {gemm->GetOperand(0), *new_weights, *new_gemm_bias});
+    new_gemm->SetAlpha(gemm->GetAlpha());
+    new_gemm->SetBeta(gemm->GetBeta());
+    new_gemm->SetTransposeA(gemm->GetTransposeA());
+    new_gemm->SetTransposeB(gemm->GetTransposeB());
+    new_gemm->GetResultsTypes()[0] = type;
+    ret = *new_gemm;
+  }
+
+  if (has_bias) {
+    std::vector<int64_t> shape(type.GetNumOfDims(), 1);
+    shape[axis] = channels;
+    Constant* c_bias =
+        cb.CreateConstant(inst->GetName() + "_bias" + suffix,
+                          Type{DataType::FLOAT32, shape}, new_bias.data());
+    Instruction* add = builder.CreateAdd(inst->GetName(), ret, *c_bias);
+    add->GetResultsTypes()[0] = type;
+    ret = *add;
+  }
+  return ret;
+}
+
+// Folds mul(op(x) [+ bias], c) and add(op(x) + bias, c), where c is a
+// per-channel constant, into the weights and the bias of op.
+static Def FoldScaleOrShift(Instruction* binary_inst, const Def& op0,
+                            const Def& op1) {
+  OpCode opcode = binary_inst->GetOpCode();
+  if ((opcode != OpCode::MUL && opcode != OpCode::ADD) ||
+      !IsA<Constant>(op1) ||
+      binary_inst->GetResultType() != op0.GetType()) {
+    return Def::GetUndefined();
+  }
+  std::vector<float> bias;
+  Instruction* producer = MatchBiasedProducer(op0, &bias);
+  // add(op(x), c) is already the canonical form.
+  if (producer == nullptr || (opcode == OpCode::ADD && bias.empty())) {
+    return Def::GetUndefined();
+  }
+  auto values =
+      GetPerChannelData(op1, op0.GetType(), GetChannelAxis(*producer));
+  if (values.empty()) {
+    return Def::GetUndefined();
+  }
+  if (opcode == OpCode::MUL) {
+    return FoldIntoProducer(binary_inst, producer, bias, values,
+                            std::vector<float>(values.size()));
+  }
+  return FoldIntoProducer(binary_inst, producer, bias,
+                          std::vector<float>(values.size(), 1), values);
+}
+
 static std::pair<Def, Def> RunOnMathBinaryInstruction(
     Instruction* binary_inst, bool disable_broadcasting) {
   Def orig_def{binary_inst, 0};
@@ -127,6 +416,11 @@ static std::pair<Def, Def> RunOnMathBinaryInstruction(
   const auto& op1_type = op1.GetType();
   OpCode opcode = binary_inst->GetOpCode();
   ConstantBuilder cb(binary_inst->GetParent()->GetParent());
+
+  Def folded = FoldScaleOrShift(binary_inst, op0, op1);
+  if (!folded.IsNull()) {
+    return {orig_def, folded};
+  }
   /*
   // Handle scalar constant
   if (IsA<Constant>(op1.GetOwner())) {
@@ -569,6 +863,56 @@ std::pair<Def, Def> InstSimplify::RunOnInstruction(ReluInst* inst) {
       });
 }
 
+// Folds an inference batch normalization of the result of a convolution (with
+// an optional bias) into the weights and the bias of the convolution:
+// y = (x - mean) * scale / sqrt(variance + epsilon) + offset.
+std::pair<Def, Def> InstSimplify::RunOnInstruction(BatchNormInst* inst) {
+  std::pair<Def, Def> ret{Def{inst, 0}, Def{inst, 0}};
+  // The Caffe form (with a scale factor on mean and variance) is not folded.
+  if (inst->GetNumOfOperands() != 5) {
+    return ret;
+  }
+  std::vector<float> bias;
+  Instruction* producer = MatchBiasedProducer(inst->GetOperand(0), &bias);
+  if (producer == nullptr || producer->GetOpCode() != OpCode::CONV2D ||
+      DynCast<Conv2DInst>(producer)->GetDataFormat() !=
+          inst->GetDataFormat()) {
+    return ret;
+  }
+  const halo::Type& type = producer->GetResultType();
+  int64_t channels = type.GetNumOfElementsInDim(GetChannelAxis(*producer));
+  std::vector<std::vector<float>> params;
+  for (size_t i = 1; i < 5; ++i) {
+    const Def& op = inst->GetOperand(i);
+    const halo::Type& op_type = op.GetType();
+    if (!IsA<Constant>(op) || !op_type.IsValid() ||
+        op_type.GetDataType() != DataType::FLOAT32 ||
+        (op_type.GetTotalNumOfElements() != channels &&
+         op_type.GetTotalNumOfElements() != 1)) {
+      return ret;
+    }
+    const Constant* c = DynCast<Constant>(op);
+    std::vector<float> values(channels);
+    for (int64_t ch = 0; ch < channels; ++ch) {
+      values[ch] = c->GetData<float>(op_type.GetTotalNumOfElements() == 1 ? 0
+                                                                          : ch);
+    }
+    params.push_back(std::move(values));
+  }
+  const auto& bn_scale = params[0];
+  const auto& bn_offset = params[1];
+  const auto& mean = params[2];
+  const auto& variance = params[3];
+  std::vector<float> scale(channels);
+  std::vector<float> shift(channels);
+  for (int64_t ch = 0; ch < channels; ++ch) {
+    scale[ch] = bn_scale[ch] / std::sqrt(variance[ch] + inst->GetEpsilon());
+    shift[ch] = bn_offset[ch] - mean[ch] * scale[ch];
+  }
+  ret.second = FoldIntoProducer(inst, producer, bias, scale, shift);
+  return ret;
+}
+
 std::pair<Def, Def> InstSimplify::RunOnInstruction(Conv2DInst* inst) {
   std::pair<Def, Def> ret{Def{inst, 0}, Def{inst, 0}};
   if (!inst->GetResultType().IsValid()) {
@@ -1425,8 +1769,19 @@ std::pair<Def, Def> InstSimplify::RunOnInstruction(OneHotInst* inst) {
 
 bool InstSimplify::RunOnBasicBlock(BasicBlock* bb) {
   bool changed = false;
+  // Instructions are visited in order. The users of a replaced value are
+  // revisited, so simplifications enabled by a rewrite are applied in the same
+  // run instead of by another sweep over the whole block.
+  std::deque<Instruction*> worklist;
+  std::unordered_set<const Instruction*> queued;
   for (auto& inst_t : *bb) {
-    Instruction* inst = inst_t.get();
+    worklist.push_back(inst_t.get());
+    queued.insert(inst_t.get());
+  }
+  while (!worklist.empty()) {
+    Instruction* inst = worklist.front();
+    worklist.pop_front();
+    queued.erase(inst);
     if (inst->GetNumberOfUses() == 0) {
       if (inst->GetOpCode() == OpCode::RETURN) {
         RunOnInstruction(DynCast<ReturnInst>(inst));
@@ -1448,6 +1803,14 @@ bool InstSimplify::RunOnBasicBlock(BasicBlock* bb) {
       if (ret.second.GetOwner() != nullptr) {
         // Replace all uses
         inst->ReplaceAllUsesWith(ret.first.GetIdx(), ret.second);
+        for (auto& use : ret.second.GetUses()) {
+          IRObject* user = use.GetUse();
+          if (IsA<Instruction>(user) &&
+              Downcast<Instruction>(user)->GetParent() == bb &&
+              queued.insert(Downcast<Instruction>(user)).second) {
+            worklist.push_back(Downcast<Instruction>(user));
+          }
+        }
       }
     }
   }
@@ -0,0 +1,502 @@
+//===- layout_assignment.cc -----------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "halo/lib/transforms/layout_assignment.h"
+
+#include <cstdint>
+#include <numeric>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "halo/lib/framework/data_layout.h"
+#include "halo/lib/framework/global_context.h"
+#include "halo/lib/ir/ir_builder.h"
+
+namespace halo {
+
+using Permutation = std::vector<int>;
+
+static Permutation Inverse(const Permutation& perm) {
+  Permutation ret(perm.size());
+  for (int i = 0, e = perm.size(); i < e; ++i) {
+    ret[perm[i]] = i;
+  }
+  return ret;
+}
+
+// Returns the dimensions of a value of `dims` transposed by `perm`.
+static std::vector<int64_t> PermuteDims(const std::vector<int64_t>& dims,
+                                        const Permutation& perm) {
+  std::vector<int64_t> ret(perm.size());
+  for (int i = 0, e = perm.size(); i < e; ++i) {
+    ret[i] = dims[perm[i]];
+  }
+  return ret;
+}
+
+static bool IsTransposeOf(const Def& def, const Permutation& perm) {
+  if (!IsA<Instruction>(def)) {
+    return false;
+  }
+  const Instruction* inst = DynCast<Instruction>(def);
+  return inst->GetOpCode() == OpCode::TRANSPOSE &&
+         inst->GetNumOfOperands() == 1 &&
+         DynCast<const TransposeInst>(inst)->GetPermutation() == perm;
+}
+
+template <typename T>
+static bool KeepsDims(const Instruction& inst) {
+  return DynCast<const T>(&inst)->GetKeepDims();
+}
+
+template <typename T>
+static void PermuteReductionAxis(Instruction* inst, const Permutation& perm) {
+  T* reduction = DynCast<T>(inst);
+  std::vector<int> axis = reduction->GetAxis();
+  int rank = perm.size();
+  for (auto& a : axis) {
+    a = perm[a < 0 ? a + rank : a];
+  }
+  reduction->SetAxis(axis);
+}
+
+// Returns the indices of the operands of a layout transparent instruction
+// that are in the layout of its result, or an empty list if `inst` is not
+// transparent. Operands of a lower rank are broadcast; unless they are
+// constants or scalars, they can not be permuted cheaply.
+static std::vector<size_t> GetDataOperands(const Instruction& inst) {
+  if (inst.GetNumOfResults() != 1 || !inst.GetResultType().IsValid() ||
+      inst.GetResultType().GetNumOfDims() < 2) {
+    return {};
+  }
+  size_t rank = inst.GetResultType().GetNumOfDims();
+  std::vector<size_t> ops;
+  switch (inst.GetOpCode()) {
+    case OpCode::ABS:
+    case OpCode::ADD:
+    case OpCode::DIV:
+    case OpCode::ERF:
+    case OpCode::EXP:
+    case OpCode::FLOOR:
+    case OpCode::LEAKYRELU:
+    case OpCode::MAXIMUM:
+    case OpCode::MINIMUM:
+    case OpCode::MUL:
+    case OpCode::NEG:
+    case OpCode::POW:
+    case OpCode::RCP:
+    case OpCode::RELU:
+    case OpCode::RELU6:
+    case OpCode::RSQRT:
+    case OpCode::SIGMOID:
+    case OpCode::SQRT:
+    case OpCode::SUB:
+    case OpCode::TANH:
+    case OpCode::CONCAT: {
+      ops.resize(inst.GetNumOfOperands());
+      std::iota(ops.begin(), ops.end(), 0);
+      break;
+    }
+    case OpCode::PAD: {
+      const Def& paddings = inst.GetOperand(1);
+      if (!IsA<Constant>(paddings) ||
+          paddings.GetType().GetDataType() != DataType::INT32) {
+        return {};
+      }
+      ops.push_back(0);
+      break;
+    }
+    case OpCode::REDUCEMAX:
+    case OpCode::REDUCEMEAN:
+    case OpCode::REDUCEMIN:
+    case OpCode::REDUCEPRODUCT:
+    case OpCode::REDUCESUM: {
+      bool keep_dims = false;
+      switch (inst.GetOpCode()) {
+        case OpCode::REDUCEMAX:
+          keep_dims = KeepsDims<ReduceMaxInst>(inst);
+          break;
+        case OpCode::REDUCEMEAN:
+          keep_dims = KeepsDims<ReduceMeanInst>(inst);
+          break;
+        case OpCode::REDUCEMIN:
+          keep_dims = KeepsDims<ReduceMinInst>(inst);
+          break;
+        case OpCode::REDUCEPRODUCT:
+          keep_dims = KeepsDims<ReduceProductInst>(inst);
+          break;
+        default:
+          keep_dims = KeepsDims<ReduceSumInst>(inst);
+          break;
+      }
+      if (!keep_dims || inst.GetNumOfOperands() != 1) {
+        return {};
+      }
+      ops.push_back(0);
+      break;
+    }
+    default: {
+      return {};
+    }
+  }
+  for (size_t i : ops) {
+    const Def& op = inst.GetOperand(i);
+    const auto& type = op.GetType();
+    if (!type.IsValid() || type.GetNumOfDims() > rank) {
+      return {};
+    }
+    if (type.GetNumOfDims() < rank &&
+        (inst.GetOpCode() == OpCode::CONCAT ||
+         (!IsA<Constant>(op) && type.GetTotalNumOfElements() != 1))) {
+      return {};
+    }
+  }
+  return ops;
+}
+
+// Returns a constant of `rank` dimensions holding `c` (broadcast from the
+// right) transposed by `perm`.
+static Constant* TransposeConstant(const Constant& c, size_t rank,
+                                   const Permutation& perm,
+                                   ConstantBuilder* builder) {
+  const auto& type = c.GetResultType();
+  std::vector<int64_t> dims(rank - type.GetNumOfDims(), 1);
+  dims.insert(dims.end(), type.GetDimSizes().begin(),
+              type.GetDimSizes().end());
+  std::vector<int64_t> strides(rank, 1);
+  for (int i = static_cast<int>(rank) - 2; i >= 0; --i) {
+    strides[i] = strides[i + 1] * dims[i + 1];
+  }
+  auto new_dims = PermuteDims(dims, perm);
+  auto src_strides = PermuteDims(strides, perm);
+
+  size_t elem_size = c.GetElementSizeInBytes();
+  size_t elem_cnt = type.GetTotalNumOfElements();
+  const char* src = static_cast<const char*>(c.GetRawDataPtr());
+  std::vector<char> buf(elem_size * elem_cnt);
+  std::vector<int64_t> pos(rank);
+  for (size_t i = 0; i < elem_cnt; ++i) {
+    int64_t offset = std::inner_product(pos.begin(), pos.end(),
+                                        src_strides.begin(), int64_t{0});
+    std::copy_n(src + offset * elem_size, elem_size, &buf[i * elem_size]);
+    for (int d = static_cast<int>(rank) - 1; d >= 0; --d) {
+      if (++pos[d] < new_dims[d]) {
+        break;
+      }
+      pos[d] = 0;
+    }
+  }
+  return builder->CreateConstant(c.GetName() + "_T",
+                                 halo::Type{type.GetDataType(), new_dims},
+                                 buf.data());
+}
+
+namespace {
+
+// A region of connected layout transparent instructions.
+class Region {
+ public:
+  Region(std::vector<Instruction*> insts, const DataLayout& dl)
+      : insts_(std::move(insts)),
+        members_(insts_.begin(), insts_.end()),
+        rank_(insts_.front()->GetResultType().GetNumOfDims()),
+        dl_(dl) {}
+
+  // Returns the permutations of the transposes around the region, as seen
+  // from the region (i.e. the layout of the values of the region in terms of
+  // the permuted layout).
+  std::set<Permutation> GetCandidates() const {
+    std::set<Permutation> ret;
+    auto add = [&ret, this](const Permutation& perm) {
+      Permutation identity(rank_);
+      std::iota(identity.begin(), identity.end(), 0);
+      if (perm.size() == rank_ && perm != identity) {
+        ret.insert(perm);
+      }
+    };
+    for (const Instruction* inst : insts_) {
+      for (size_t i : GetDataOperands(*inst)) {
+        const Def& op = inst->GetOperand(i);
+        if (!IsMember(op) && IsA<Instruction>(op) &&
+            DynCast<Instruction>(op)->GetOpCode() == OpCode::TRANSPOSE) {
+          add(DynCast<TransposeInst>(op.GetOwner())->GetPermutation());
+        }
+      }
+      for (const auto& use : inst->GetResultsUses()[0]) {
+        const IRObject* user = use.GetUse();
+        if (members_.count(user) == 0 && IsA<Instruction>(user) &&
+            DynCast<const Instruction>(user)->GetOpCode() ==
+                OpCode::TRANSPOSE) {
+          add(Inverse(DynCast<const TransposeInst>(user)->GetPermutation()));
+        }
+      }
+    }
+    return ret;
+  }
+
+  // Returns the change of the number of bytes transposed if the region
+  // computes in the layout its values are permuted from by `perm`.
+  int64_t GetCost(const Permutation& perm) const {
+    Permutation inv = Inverse(perm);
+    int64_t cost = 0;
+    std::unordered_set<Def> inputs;
+    for (Instruction* inst : insts_) {
+      for (size_t i : GetDataOperands(*inst)) {
+        const Def& op = inst->GetOperand(i);
+        if (IsMember(op) || !inputs.insert(op).second) {
+          continue;
+        }
+        if (IsTransposeOf(op, perm)) {
+          bool removed = true;
+          for (const auto& use : op.GetUses()) {
+            removed &= members_.count(use.GetUse()) != 0;
+          }
+          cost -= removed ? GetBytes(op) : 0;
+        } else if (!IsA<Constant>(op) &&
+                   op.GetType().GetTotalNumOfElements() != 1) {
+          cost += GetBytes(op);
+        }
+      }
+      bool materialized = false;
+      for (const auto& use : inst->GetResultsUses()[0]) {
+        IRObject* user = use.GetUse();
+        if (members_.count(user) != 0) {
+          continue;
+        }
+        if (Def result{user, 0}; IsTransposeOf(result, inv)) {
+          cost -= GetBytes(result);
+        } else if (!materialized) {
+          cost += GetBytes(Def{inst, 0});
+          materialized = true;
+        }
+      }
+    }
+    return cost;
+  }
+
+  // Makes the region compute in the layout its values are permuted from by
+  // `perm` and transposes its results back for the users outside the region.
+  void Apply(const Permutation& perm, IRBuilder* builder,
+             ConstantBuilder* c_builder) {
+    Permutation inv = Inverse(perm);
+    // Users outside the region, recorded before new users are added.
+    std::vector<std::vector<Use>> outputs;
+    for (Instruction* inst : insts_) {
+      outputs.emplace_back();
+      for (const auto& use : inst->GetResultsUses()[0]) {
+        if (members_.count(use.GetUse()) == 0) {
+          outputs.back().push_back(use);
+        }
+      }
+    }
+
+    std::unordered_map<Def, Def> inputs;
+    for (Instruction* inst : insts_) {
+      for (size_t i : GetDataOperands(*inst)) {
+        Def op = inst->GetOperand(i);
+        if (IsMember(op)) {
+          continue;
+        }
+        auto it = inputs.find(op);
+        if (it == inputs.end()) {
+          Def new_op = op;
+          if (IsTransposeOf(op, perm)) {
+            new_op = DynCast<Instruction>(op)->GetOperand(0);
+          } else if (op.GetType().GetTotalNumOfElements() == 1) {
+            new_op = op;
+          } else if (IsA<Constant>(op)) {
+            new_op = *TransposeConstant(*DynCast<Constant>(op), rank_, inv,
+                                        c_builder);
+          } else {
+            builder->SetInsertBefore(inst);
+            TransposeInst* trans = builder->CreateTranspose(
+                op.GetOwner()->GetName() + "_T", {op});
+            trans->SetPermutation(inv);
+            trans->GetResultsTypes()[0] =
+                halo::Type{op.GetType().GetDataType(),
+                           PermuteDims(op.GetType().GetDimSizes(), inv)};
+            new_op = *trans;
+          }
+          it = inputs.emplace(op, new_op).first;
+        }
+        if (it->second != op) {
+          inst->ReplaceOperandWith(i, it->second);
+        }
+      }
+      PermuteAttributes(inst, perm, c_builder);
+      const auto& type = inst->GetResultType();
+      inst->GetResultsTypes()[0] = halo::Type{
+          type.GetDataType(), PermuteDims(type.GetDimSizes(), inv)};
+    }
+
+    for (size_t k = 0, e = insts_.size(); k < e; ++k) {
+      Instruction* inst = insts_[k];
+      Def def{inst, 0};
+      Def back = Def::GetUndefined();
+      for (const auto& use : outputs[k]) {
+        Instruction* user = DynCast<Instruction>(use.GetUse());
+        if (IsTransposeOf(Def{user, 0}, inv)) {
+          user->ReplaceAllUsesWith(0, def);
+          continue;
+        }
+        if (back.IsNull()) {
+          builder->SetInsertAfter(inst);
+          TransposeInst* trans =
+              builder->CreateTranspose(inst->GetName() + "_T", {def});
+          trans->SetPermutation(perm);
+          const auto& type = inst->GetResultType();
+          trans->GetResultsTypes()[0] = halo::Type{
+              type.GetDataType(), PermuteDims(type.GetDimSizes(), perm)};
+          back = *trans;
+        }
+        user->ReplaceOperandWith(use.GetUseOperandIdx(), back);
+      }
+    }
+  }
+
+ private:
+  bool IsMember(const Def& def) const {
+    return members_.count(def.GetOwner()) != 0;
+  }
+
+  int64_t GetBytes(const Def& def) const {
+    return static_cast<int64_t>(dl_.Bytes(def.GetType()));
+  }
+
+  // Maps the axis attributes from the layout of the values of the region to
+  // the one they are permuted from by `perm`.
+  void PermuteAttributes(Instruction* inst, const Permutation& perm,
+                         ConstantBuilder* c_builder) const {
+    int rank = rank_;
+    switch (inst->GetOpCode()) {
+      case OpCode::CONCAT: {
+        ConcatInst* concat = DynCast<ConcatInst>(inst);
+        int axis = concat->GetAxis();
+        concat->SetAxis(perm[axis < 0 ? axis + rank : axis]);
+        break;
+      }
+      case OpCode::PAD: {
+        const Constant* paddings = DynCast<Constant>(inst->GetOperand(1));
+        std::vector<int32_t> data(2 * rank);
+        for (int i = 0; i < rank; ++i) {
+          data[2 * perm[i]] = paddings->GetData<int32_t>(2 * i);
+          data[2 * perm[i] + 1] = paddings->GetData<int32_t>(2 * i + 1);
+        }
+        Constant* new_paddings = c_builder->CreateConstant(
+            paddings->GetName() + "_T", paddings->GetResultType(), data);
+        inst->ReplaceOperandWith(1, *new_paddings);
+        break;
+      }
+      case OpCode::REDUCEMAX: {
+        PermuteReductionAxis<ReduceMaxInst>(inst, perm);
+        break;
+      }
+      case OpCode::REDUCEMEAN: {
+        PermuteReductionAxis<ReduceMeanInst>(inst, perm);
+        break;
+      }
+      case OpCode::REDUCEMIN: {
+        PermuteReductionAxis<ReduceMinInst>(inst, perm);
+        break;
+      }
+      case OpCode::REDUCEPRODUCT: {
+        PermuteReductionAxis<ReduceProductInst>(inst, perm);
+        break;
+      }
+      case OpCode::REDUCESUM: {
+        PermuteReductionAxis<ReduceSumInst>(inst, perm);
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+  }
+
+  std::vector<Instruction*> insts_;
+  std::unordered_set<const IRObject*> members_;
+  size_t rank_;
+  const DataLayout& dl_;
+};
+
+} // end anonymous namespace
+
+bool LayoutAssignment::RunOnBasicBlock(BasicBlock* bb) {
+  // Group the transparent instructions into connected regions of one rank.
+  std::vector<Instruction*> insts;
+  std::unordered_map<const IRObject*, size_t> ids;
+  for (auto& it : *bb) {
+    Instruction* inst = it.get();
+    if (!GetDataOperands(*inst).empty()) {
+      ids[inst] = insts.size();
+      insts.push_back(inst);
+    }
+  }
+  std::vector<size_t> parents(insts.size());
+  std::iota(parents.begin(), parents.end(), 0);
+  auto find = [&parents](size_t i) {
+    while (parents[i] != i) {
+      i = parents[i] = parents[parents[i]];
+    }
+    return i;
+  };
+  for (size_t i = 0, e = insts.size(); i < e; ++i) {
+    for (size_t k : GetDataOperands(*insts[i])) {
+      const Def& op = insts[i]->GetOperand(k);
+      auto it = ids.find(op.GetOwner());
+      if (it != ids.end() && op.GetType().GetNumOfDims() ==
+                                 insts[i]->GetResultType().GetNumOfDims()) {
+        parents[find(i)] = find(it->second);
+      }
+    }
+  }
+  std::unordered_map<size_t, std::vector<Instruction*>> groups;
+  std::vector<size_t> roots;
+  for (size_t i = 0, e = insts.size(); i < e; ++i) {
+    size_t root = find(i);
+    if (groups.count(root) == 0) {
+      roots.push_back(root);
+    }
+    groups[root].push_back(insts[i]);
+  }
+
+  bool changed = false;
+  const DataLayout& dl = bb->GetGlobalContext().GetDefaultDataLayout();
+  IRBuilder builder(bb);
+  ConstantBuilder c_builder(bb->GetParent());
+  for (size_t root : roots) {
+    Region region(std::move(groups[root]), dl);
+    int64_t best_cost = 0;
+    Permutation best;
+    for (const auto& perm : region.GetCandidates()) {
+      int64_t cost = region.GetCost(perm);
+      if (cost < best_cost) {
+        best_cost = cost;
+        best = perm;
+      }
+    }
+    if (!best.empty()) {
+      region.Apply(best, &builder, &c_builder);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+} // end namespace halo
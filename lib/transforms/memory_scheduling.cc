@@ -0,0 +1,341 @@
+//===- memory_scheduling.cc -----------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "halo/lib/transforms/memory_scheduling.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "halo/lib/framework/data_layout.h"
+#include "halo/lib/framework/global_context.h"
+#include "halo/lib/mm/alias_analyzer.h"
+
+namespace halo {
+
+namespace {
+
+// Blocks with up to this many instructions are scheduled exactly.
+constexpr int kExactScheduleLimit = 16;
+// Number of instructions the greedy scheduler looks ahead.
+constexpr int kLookaheadDepth = 2;
+
+// An instruction of the block being scheduled. The memory model is the one of
+// the memory planner: a result is allocated when its instruction runs and is
+// released once the last instruction reading it has run. Results that are
+// read after the block are never released. Views (see AliasAnalyzer) allocate
+// nothing, reading them reads the memory of their operand.
+struct Node {
+  size_t size = 0;          // Bytes allocated by the node.
+  std::vector<int> deps;    // Nodes producing the operands.
+  std::vector<int> users;   // Nodes reading the results, once per operand.
+  std::vector<int> reads;   // Owners of the memory read, once per operand.
+  int num_of_reads = 0;     // Number of reads of the memory the node owns.
+  bool is_live_out = false; // The memory is read after the block.
+};
+
+// Incrementally tracks the memory in use and the ready nodes while nodes are
+// scheduled. Run() and Undo() must be called in LIFO order.
+class ScheduleState {
+ public:
+  explicit ScheduleState(const std::vector<Node>& nodes)
+      : nodes_(nodes), pending_deps_(nodes.size()), unread_(nodes.size()) {
+    for (size_t i = 0, e = nodes.size(); i < e; ++i) {
+      pending_deps_[i] = static_cast<int>(nodes[i].deps.size());
+      unread_[i] = nodes[i].num_of_reads;
+      if (pending_deps_[i] == 0) {
+        ready_.push_back(static_cast<int>(i));
+      }
+    }
+  }
+
+  const std::vector<int>& GetReady() const noexcept { return ready_; }
+  size_t GetLive() const noexcept { return live_; }
+
+  // Runs `n` and returns the memory in use while it runs.
+  size_t Run(int n) {
+    const Node& node = nodes_[n];
+    auto it = std::find(ready_.begin(), ready_.end(), n);
+    positions_.push_back(static_cast<int>(it - ready_.begin()));
+    ready_.erase(it);
+
+    live_ += node.size;
+    size_t in_use = live_;
+    for (int r : node.reads) {
+      if (--unread_[r] == 0 && !nodes_[r].is_live_out) {
+        live_ -= nodes_[r].size;
+      }
+    }
+    if (node.num_of_reads == 0 && !node.is_live_out) {
+      live_ -= node.size;
+    }
+    for (int u : node.users) {
+      if (--pending_deps_[u] == 0) {
+        ready_.push_back(u);
+      }
+    }
+    return in_use;
+  }
+
+  void Undo(int n) {
+    const Node& node = nodes_[n];
+    for (auto it = node.users.rbegin(), e = node.users.rend(); it != e; ++it) {
+      if (pending_deps_[*it]++ == 0) {
+        ready_.pop_back();
+      }
+    }
+    if (node.num_of_reads == 0 && !node.is_live_out) {
+      live_ += node.size;
+    }
+    for (int r : node.reads) {
+      if (unread_[r]++ == 0 && !nodes_[r].is_live_out) {
+        live_ += nodes_[r].size;
+      }
+    }
+    live_ -= node.size;
+
+    ready_.insert(ready_.begin() + positions_.back(), n);
+    positions_.pop_back();
+  }
+
+ private:
+  const std::vector<Node>& nodes_;
+  std::vector<int> pending_deps_;
+  std::vector<int> unread_;
+  std::vector<int> ready_;
+  std::vector<int> positions_;
+  size_t live_ = 0;
+};
+
+// Peak memory of scheduling `n` and then the best sequence of `depth` - 1
+// nodes, and the memory in use at the end of it.
+struct Cost {
+  size_t peak;
+  size_t live;
+  bool operator<(const Cost& other) const {
+    return peak != other.peak ? peak < other.peak : live < other.live;
+  }
+};
+
+Cost Evaluate(ScheduleState* state, int n, int depth) {
+  size_t in_use = state->Run(n);
+  Cost cost{in_use, state->GetLive()};
+  if (depth > 1 && !state->GetReady().empty()) {
+    Cost best{std::numeric_limits<size_t>::max(),
+              std::numeric_limits<size_t>::max()};
+    std::vector<int> ready = state->GetReady();
+    for (int next : ready) {
+      best = std::min(best, Evaluate(state, next, depth - 1));
+    }
+    cost = Cost{std::max(in_use, best.peak), best.live};
+  }
+  state->Undo(n);
+  return cost;
+}
+
+size_t GetPeak(const std::vector<Node>& nodes, const std::vector<int>& order) {
+  ScheduleState state(nodes);
+  size_t peak = 0;
+  for (int n : order) {
+    peak = std::max(peak, state.Run(n));
+  }
+  return peak;
+}
+
+std::vector<int> ScheduleGreedily(const std::vector<Node>& nodes) {
+  ScheduleState state(nodes);
+  std::vector<int> order;
+  order.reserve(nodes.size());
+  while (!state.GetReady().empty()) {
+    int best_node = -1;
+    Cost best_cost{0, 0};
+    std::vector<int> ready = state.GetReady();
+    for (int n : ready) {
+      Cost cost = Evaluate(&state, n, kLookaheadDepth);
+      // Prefer the original order among equally good candidates.
+      if (best_node < 0 || cost < best_cost ||
+          (!(best_cost < cost) && n < best_node)) {
+        best_node = n;
+        best_cost = cost;
+      }
+    }
+    state.Run(best_node);
+    order.push_back(best_node);
+  }
+  return order;
+}
+
+// Dynamic programming over the sets of scheduled nodes: the memory in use
+// only depends on which nodes have run, not on their order.
+std::vector<int> ScheduleExactly(const std::vector<Node>& nodes) {
+  const int n = static_cast<int>(nodes.size());
+  const uint32_t all = (1U << n) - 1;
+  std::vector<uint32_t> deps(n);
+  std::vector<uint32_t> readers(n);
+  for (int i = 0; i < n; ++i) {
+    for (int d : nodes[i].deps) {
+      deps[i] |= 1U << d;
+    }
+    for (int r : nodes[i].reads) {
+      readers[r] |= 1U << i;
+    }
+  }
+  auto live = [&](uint32_t scheduled) {
+    size_t bytes = 0;
+    for (int i = 0; i < n; ++i) {
+      if ((scheduled >> i & 1U) != 0 &&
+          (nodes[i].is_live_out || (readers[i] & ~scheduled) != 0)) {
+        bytes += nodes[i].size;
+      }
+    }
+    return bytes;
+  };
+
+  std::vector<size_t> peaks(all + 1, std::numeric_limits<size_t>::max());
+  std::vector<int8_t> last(all + 1, -1);
+  peaks[0] = 0;
+  for (uint32_t s = 0; s < all; ++s) {
+    if (peaks[s] == std::numeric_limits<size_t>::max()) {
+      continue;
+    }
+    size_t bytes = live(s);
+    for (int i = 0; i < n; ++i) {
+      if ((s >> i & 1U) != 0 || (deps[i] & ~s) != 0) {
+        continue;
+      }
+      uint32_t t = s | 1U << i;
+      size_t peak = std::max(peaks[s], bytes + nodes[i].size);
+      if (peak < peaks[t]) {
+        peaks[t] = peak;
+        last[t] = static_cast<int8_t>(i);
+      }
+    }
+  }
+
+  std::vector<int> order(n);
+  uint32_t s = all;
+  for (int i = n - 1; i >= 0; --i) {
+    order[i] = last[s];
+    s &= ~(1U << last[s]);
+  }
+  return order;
+}
+
+bool RunOnBasicBlock(BasicBlock* bb, size_t* peak_before, size_t* peak_after) {
+  const DataLayout& dl = bb->GetGlobalContext().GetDefaultDataLayout();
+  std::vector<Instruction*> insts;
+  std::unordered_map<const IRObject*, int> ids;
+  Instruction* terminator = nullptr;
+  for (auto& inst : *bb) {
+    OpCode op = inst->GetOpCode();
+    if (op == OpCode::JUMP || op == OpCode::IF || op == OpCode::LOOP) {
+      return false;
+    }
+    if (op == OpCode::RETURN) {
+      terminator = inst.get();
+      continue;
+    }
+    ids[inst.get()] = static_cast<int>(insts.size());
+    insts.push_back(inst.get());
+  }
+
+  std::vector<Node> nodes(insts.size());
+  std::vector<int> owners(insts.size());
+  for (int i = 0, e = static_cast<int>(insts.size()); i < e; ++i) {
+    Instruction* inst = insts[i];
+    Node& node = nodes[i];
+    owners[i] = i;
+    for (const auto& op : inst->GetOperands()) {
+      auto it = ids.find(op.GetOwner());
+      if (it == ids.end()) {
+        continue;
+      }
+      int dep = it->second;
+      node.deps.push_back(dep);
+      nodes[dep].users.push_back(i);
+      node.reads.push_back(owners[dep]);
+      ++nodes[owners[dep]].num_of_reads;
+    }
+    if (AliasAnalyzer::IsView(*inst) &&
+        ids.count(inst->GetOperand(0).GetOwner()) != 0) {
+      owners[i] = owners[ids[inst->GetOperand(0).GetOwner()]];
+    } else {
+      for (const auto& ty : inst->GetResultsTypes()) {
+        node.size += ty.IsValid() ? dl.Bytes(ty) : 0;
+      }
+    }
+    for (const auto& uses : inst->GetResultsUses()) {
+      for (const auto& use : uses.GetUses()) {
+        const IRObject* user = use.GetUse();
+        if (user == terminator || ids.count(user) == 0) {
+          nodes[owners[i]].is_live_out = true;
+        }
+      }
+    }
+  }
+
+  std::vector<int> order(insts.size());
+  for (int i = 0, e = static_cast<int>(order.size()); i < e; ++i) {
+    order[i] = i;
+  }
+  size_t before = GetPeak(nodes, order);
+  std::vector<int> scheduled = nodes.size() <= kExactScheduleLimit
+                                   ? ScheduleExactly(nodes)
+                                   : ScheduleGreedily(nodes);
+  size_t after = GetPeak(nodes, scheduled);
+  *peak_before = std::max(*peak_before, before);
+  if (after >= before) {
+    *peak_after = std::max(*peak_after, before);
+    return false;
+  }
+  *peak_after = std::max(*peak_after, after);
+
+  auto& list = bb->Instructions();
+  std::unordered_map<const Instruction*, BasicBlock::iterator> positions;
+  for (auto it = list.begin(), e = list.end(); it != e; ++it) {
+    positions[it->get()] = it;
+  }
+  for (int i : scheduled) {
+    list.splice(list.end(), list, positions[insts[i]]);
+  }
+  if (terminator != nullptr) {
+    list.splice(list.end(), list, positions[terminator]);
+  }
+  return true;
+}
+
+} // end namespace
+
+bool MemoryScheduling::RunOnFunction(Function* func) {
+  bool changed = false;
+  size_t peak_before = 0;
+  size_t peak_after = 0;
+  for (auto& bb : *func) {
+    changed |= RunOnBasicBlock(bb.get(), &peak_before, &peak_after);
+  }
+  if (print_stats_) {
+    std::cout << "Peak Memory of " << func->GetName()
+              << " Before Scheduling: " << peak_before << " bytes\n";
+    std::cout << "Peak Memory of " << func->GetName()
+              << " After Scheduling: " << peak_after << " bytes\n";
+  }
+  return changed;
+}
+
+} // end namespace halo
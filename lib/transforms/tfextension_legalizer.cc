@@ -721,8 +721,9 @@ bool TFExtensionLegalizer::RunOnBasicBlock(BasicBlock* bb) {
           auto filter = DynCast<Constant>(conv_inst->GetOperand(1));
           const auto& shape = filter->GetResultsTypes()[0];
           HLCHECK(shape.GetNumOfDims() == 4);
-          conv_inst->SetGroup(static_cast<int>(shape.GetNumOfElementsInDim(2) /
-                                               shape.GetNumOfElementsInDim(3)));
+          // Depthwise filter is [h, w, in, multiplier]: one group per input
+          // channel.
+          conv_inst->SetGroup(static_cast<int>(shape.GetNumOfElementsInDim(2)));
         }
       }
     }
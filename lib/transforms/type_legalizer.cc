@@ -288,17 +288,24 @@ static Type ComputeKernelWiseType(
   int kernel_h = kernel_shape[info.kernel_height_axis];
   int kernel_w = kernel_shape[info.kernel_width_axis];
   if (op != OpCode::POOLINGMAX && op != OpCode::POOLINGAVG) {
-    // for depthwise, for NHWC, the kernel is H, W, <group>, 1
-    // for NCHW, the kernel is output, in/<group>, H, W
+    // Grouped kernels are H, W, in/<group>, output (HWCN) or
+    // output, in/<group>, H, W (NCHW). Depthwise kernels from TF are
+    // H, W, in, multiplier, which produce in * multiplier channels.
     ret_shape[info.data_channel_axis] = kernel_shape[info.kernel_output_axis];
-    if (group > 1 && kernel_format == DataFormat::HWCN) {
+    if (group > 1 && kernel_format == DataFormat::HWCN &&
+        kernel_shape[info.kernel_input_axis] ==
+            data_shape[info.data_channel_axis]) {
       ret_shape[info.data_channel_axis] =
-          kernel_shape[info.kernel_input_axis] * group;
+          kernel_shape[info.kernel_input_axis] *
+          kernel_shape[info.kernel_output_axis];
     }
   }
 
   auto index_h = info.data_spatial_axis;
   auto index_w = index_h + 1;
+  // Window covered by a dilated kernel.
+  int window_h = (kernel_h - 1) * dilations[index_h] + 1;
+  int window_w = (kernel_w - 1) * dilations[index_w] + 1;
   switch (padding_mode) {
     case Padding::SAME: {
       ret_shape[index_h] =
@@ -308,9 +315,9 @@ static Type ComputeKernelWiseType(
       break;
     }
     case Padding::VALID: {
-      ret_shape[index_h] = (data_shape[index_h] - kernel_h + strides[index_h]) /
+      ret_shape[index_h] = (data_shape[index_h] - window_h + strides[index_h]) /
                            strides[index_h];
-      ret_shape[index_w] = (data_shape[index_w] - kernel_w + strides[index_w]) /
+      ret_shape[index_w] = (data_shape[index_w] - window_w + strides[index_w]) /
                            strides[index_w];
       break;
     }
@@ -324,11 +331,11 @@ static Type ComputeKernelWiseType(
                              explicit_paddings[3];
       } else {
         ret_shape[index_h] = (data_shape[index_h] + explicit_paddings[0] +
-                              explicit_paddings[1] - kernel_h) /
+                              explicit_paddings[1] - window_h) /
                                  strides[index_h] +
                              1;
         ret_shape[index_w] = (data_shape[index_w] + explicit_paddings[2] +
-                              explicit_paddings[3] - kernel_w) /
+                              explicit_paddings[3] - window_w) /
                                  strides[index_w] +
                              1;
       }
@@ -483,6 +490,10 @@ static void RunOnInstruction(ReduceProductInst* inst) {
   RunOnCommonReductionInstruction(inst, inst->GetAxis(), inst->GetKeepDims());
 }
 
+static void RunOnInstruction(ReduceSumInst* inst) {
+  RunOnCommonReductionInstruction(inst, inst->GetAxis(), inst->GetKeepDims());
+}
+
 static void RunOnInstruction(ArgmaxInst* inst) {
   std::vector<int32_t> axis;
   if (inst->GetNumOfOperands() < 2) {
@@ -558,8 +569,10 @@ static void RunOnMatrixMultiplyInstruction(Instruction* inst, bool trans_a,
 
   auto row = trans_a ? input_type.GetNumOfElementsInDim(dims - 1)
                      : input_type.GetNumOfElementsInDim(dims - 2);
-  auto col = trans_b ? op1.GetType().GetNumOfElementsInDim(dims - 2)
-                     : op1.GetType().GetNumOfElementsInDim(dims - 1);
+  // The rhs may have a lower rank than lhs when it is shared by all batches.
+  auto rhs_dims = op1.GetType().GetNumOfDims();
+  auto col = trans_b ? op1.GetType().GetNumOfElementsInDim(rhs_dims - 2)
+                     : op1.GetType().GetNumOfElementsInDim(rhs_dims - 1);
   ret_shape.pop_back();
   ret_shape.pop_back();
   ret_shape.push_back(row);
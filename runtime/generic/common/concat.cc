@@ -0,0 +1,42 @@
+//===- concat.cc ----------------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include <stdint.h>
+
+#include <cstring>
+
+#include "parallel.h"
+
+extern "C" {
+// Copies the input, seen as `rows` rows of `input_size` elements, into the
+// columns [offset, offset + input_size) of the rows of `out`, which hold
+// `out_size` elements each. The output is written with a row stride so that
+// every input of a concatenation lands directly in its part of the result.
+// Elements are `elem_size` bytes, so one kernel serves every data type.
+void _sn_rt_concat(int8_t* out, const int8_t* input, int64_t rows,
+                   int64_t input_size, int64_t out_size, int64_t offset,
+                   int64_t elem_size) {
+  const int64_t row_bytes = input_size * elem_size;
+  out += offset * elem_size;
+  _sn_rt_parallel_for(rows, row_bytes, [=](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i) {
+      std::memcpy(out + i * out_size * elem_size, input + i * row_bytes,
+                  row_bytes);
+    }
+  });
+}
+}
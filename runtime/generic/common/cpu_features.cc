@@ -0,0 +1,73 @@
+//===- cpu_features.cc ----------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+
+// Returns the ISA level as documented by _sn_rt_get_x86_isa_level.
+static int32_t _sn_rt_detect_x86_isa_level() {
+  unsigned int eax = 0;
+  unsigned int ebx = 0;
+  unsigned int ecx = 0;
+  unsigned int edx = 0;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0 ||
+      (ecx & bit_SSE4_2) == 0 || (ecx & bit_POPCNT) == 0) {
+    return 0;
+  }
+  constexpr unsigned int avx = bit_OSXSAVE | bit_AVX | bit_FMA;
+  if ((ecx & avx) != avx) {
+    return 1;
+  }
+  // The OS must save the YMM (and ZMM) registers on context switches.
+  unsigned int xcr0 = 0;
+  unsigned int xcr0_hi = 0;
+  __asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0_hi) : "c"(0));
+  constexpr unsigned int ymm_state = 0x6;
+  constexpr unsigned int zmm_state = 0xe6;
+  if ((xcr0 & ymm_state) != ymm_state ||
+      __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) == 0 ||
+      (ebx & bit_AVX2) == 0) {
+    return 1;
+  }
+  constexpr unsigned int avx512 =
+      bit_AVX512F | bit_AVX512BW | bit_AVX512DQ | bit_AVX512VL;
+  if ((ebx & avx512) != avx512 || (xcr0 & zmm_state) != zmm_state) {
+    return 2;
+  }
+  return 3;
+}
+#else
+static int32_t _sn_rt_detect_x86_isa_level() { return 0; }
+#endif
+
+extern "C" {
+/// Returns the highest x86 ISA level supported by both the CPU and the OS:
+/// 0: baseline, 1: SSE4.2 + POPCNT, 2: AVX2 + FMA,
+/// 3: AVX-512 F/BW/DQ/VL.
+/// Fat binaries dispatch to the variant of a function built for this level.
+int32_t _sn_rt_get_x86_isa_level() {
+  static int32_t level = -1;
+  int32_t ret = __atomic_load_n(&level, __ATOMIC_RELAXED);
+  if (ret < 0) {
+    ret = _sn_rt_detect_x86_isa_level();
+    __atomic_store_n(&level, ret, __ATOMIC_RELAXED);
+  }
+  return ret;
+}
+}
@@ -0,0 +1,40 @@
+//===- parallel.cc --------------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include <stdint.h>
+
+#include "parallel.h"
+
+extern "C" {
+/// Runs a loop outlined by the code generator: calls task(ctx, begin, end)
+/// over sub-ranges of [0, n) of at least `grain` iterations on the default
+/// thread pool. Short loops and loops nested in a parallel region run serially
+/// on the caller.
+void _sn_rt_fork_call(void (*task)(void*, int64_t, int64_t), void* ctx,
+                      int64_t n, int64_t grain) {
+  if (n <= grain || halo::ThreadPool::InParallelRegion()) {
+    if (n > 0) {
+      task(ctx, 0, n);
+    }
+    return;
+  }
+  halo::ThreadPool::GetDefault()->ParallelFor(
+      n, grain, [task, ctx](int64_t begin, int64_t end) {
+        task(ctx, begin, end);
+      });
+}
+} // end of extern "C"
@@ -0,0 +1,54 @@
+//===- parallel.h ---------------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HALO_LIB_RUNTIME_GENERIC_COMMON_PARALLEL_H_
+#define HALO_LIB_RUNTIME_GENERIC_COMMON_PARALLEL_H_
+
+#include <stdint.h>
+
+#include "halo/lib/threadpool/threadpool.h"
+
+// Kernels split their outermost independent loop over the default thread
+// pool. The pool size is taken from $HALO_NUM_THREADS (all hardware threads
+// by default). Loops whose total cost is below the threshold run serially on
+// the caller so small tensors never pay for synchronization.
+
+/// Minimum amount of work, in elementary operations (e.g. multiply-adds or
+/// element loads), worth handing to another thread.
+constexpr int64_t _sn_rt_parallel_min_cost = 1 << 15;
+
+/// Number of iterations of `cost` operations each that make up one task.
+static inline int64_t _sn_rt_parallel_grain(int64_t cost) {
+  return cost <= 0 ? _sn_rt_parallel_min_cost
+                   : (_sn_rt_parallel_min_cost + cost - 1) / cost;
+}
+
+/// Calls fn(begin, end) over sub-ranges of [0, n); `cost` is the cost of one
+/// iteration.
+template <typename F>
+static inline void _sn_rt_parallel_for(int64_t n, int64_t cost, F&& fn) {
+  int64_t grain = _sn_rt_parallel_grain(cost);
+  if (n <= grain || halo::ThreadPool::InParallelRegion()) {
+    if (n > 0) {
+      fn(0, n);
+    }
+    return;
+  }
+  halo::ThreadPool::GetDefault()->ParallelFor(n, grain, fn);
+}
+
+#endif // HALO_LIB_RUNTIME_GENERIC_COMMON_PARALLEL_H_
@@ -15,116 +15,360 @@
 // limitations under the License.
 // =============================================================================
 
+#include <stdint.h>
+
 #include <algorithm>
-#include <cstring>
+#include <cmath>
+#include <limits>
 
-extern "C" {
-/// Helper function
-static void _sn_rt_reduce_helper(float* data, int64_t* in_dims,
-                                 int in_dims_size, const int64_t* axies,
-                                 int axies_size, int index) {
-  if (index == axies_size) {
-    return;
+#include "../math/simd.h"
+#include "parallel.h"
+
+// Reductions are lowered to an outer/reduce/inner form: reduced axes are
+// normalized (negative values wrap, duplicates are ignored), unit dims are
+// dropped and adjacent dims with the same role are merged. The kernel then
+// makes a single pass over the input:
+//  - if the innermost merged dim is kept, whole rows of it are accumulated
+//    lane-wise into the output row for each position of the reduced dims;
+//  - otherwise, the innermost merged dim is reduced and each output is the
+//    combination of contiguous segments, accumulated in vector registers.
+// Additive reductions use blocked / pairwise summation to bound the
+// accumulated rounding error. Scratch memory is always taken from the heap.
+
+struct _sn_rt_reduce_op_sum {
+  static constexpr bool kPairwise = true;
+  static float Identity() { return 0.0F; }
+  static float Map(float x) { return x; }
+  static _sn_rt_vf8 Map(_sn_rt_vf8 x) { return x; }
+  static float Combine(float a, float b) { return a + b; }
+  static _sn_rt_vf8 Combine(_sn_rt_vf8 a, _sn_rt_vf8 b) { return a + b; }
+  static float Finalize(float acc, int64_t /*n*/) { return acc; }
+};
+
+struct _sn_rt_reduce_op_mean : public _sn_rt_reduce_op_sum {
+  static float Finalize(float acc, int64_t n) {
+    return acc / static_cast<float>(n);
   }
-  int64_t curr = axies[index];
-  int64_t dim = in_dims[curr];
-  int64_t before, after;
-  before = after = 1;
-  for (int i = 0; i < in_dims_size; ++i) {
-    if (i < curr) {
-      before *= in_dims[i];
-    } else if (i > curr) {
-      after *= in_dims[i];
-    } else {
-      in_dims[i] = 1;
+};
+
+struct _sn_rt_reduce_op_l2 : public _sn_rt_reduce_op_sum {
+  static float Map(float x) { return x * x; }
+  static _sn_rt_vf8 Map(_sn_rt_vf8 x) { return x * x; }
+  static float Finalize(float acc, int64_t /*n*/) { return std::sqrt(acc); }
+};
+
+struct _sn_rt_reduce_op_prod {
+  static constexpr bool kPairwise = false;
+  static float Identity() { return 1.0F; }
+  static float Map(float x) { return x; }
+  static _sn_rt_vf8 Map(_sn_rt_vf8 x) { return x; }
+  static float Combine(float a, float b) { return a * b; }
+  static _sn_rt_vf8 Combine(_sn_rt_vf8 a, _sn_rt_vf8 b) { return a * b; }
+  static float Finalize(float acc, int64_t /*n*/) { return acc; }
+};
+
+struct _sn_rt_reduce_op_max {
+  static constexpr bool kPairwise = false;
+  static float Identity() { return -std::numeric_limits<float>::infinity(); }
+  static float Map(float x) { return x; }
+  static _sn_rt_vf8 Map(_sn_rt_vf8 x) { return x; }
+  static float Combine(float a, float b) { return a > b ? a : b; }
+  static _sn_rt_vf8 Combine(_sn_rt_vf8 a, _sn_rt_vf8 b) {
+    return _sn_rt_vf8_max(a, b);
+  }
+  static float Finalize(float acc, int64_t /*n*/) { return acc; }
+};
+
+struct _sn_rt_reduce_op_min {
+  static constexpr bool kPairwise = false;
+  static float Identity() { return std::numeric_limits<float>::infinity(); }
+  static float Map(float x) { return x; }
+  static _sn_rt_vf8 Map(_sn_rt_vf8 x) { return x; }
+  static float Combine(float a, float b) { return a < b ? a : b; }
+  static _sn_rt_vf8 Combine(_sn_rt_vf8 a, _sn_rt_vf8 b) {
+    return _sn_rt_vf8_min(a, b);
+  }
+  static float Finalize(float acc, int64_t /*n*/) { return acc; }
+};
+
+/// Segments longer than this are split in halves and summed pairwise. Rows of
+/// the kept-inner case are summed in blocks of the same number of rows.
+constexpr int64_t _sn_rt_reduce_pairwise_block = 256;
+
+/// Advances the odometer `idx` over `sizes` and returns the new offset.
+static inline int64_t _sn_rt_reduce_advance(int64_t* idx, const int64_t* sizes,
+                                            const int64_t* strides, int n,
+                                            int64_t offset) {
+  for (int i = n - 1; i >= 0; --i) {
+    offset += strides[i];
+    if (++idx[i] < sizes[i]) {
+      return offset;
     }
+    offset -= strides[i] * sizes[i];
+    idx[i] = 0;
   }
-  for (int i = 0; i < before; ++i) {
-    for (int j = 0; j < dim; ++j) {
-      for (int k = 0; k < after; ++k) {
-        auto o_index = k + i * after;
-        auto i_index = k + (j + i * dim) * after;
-        if (j == 0) {
-          data[o_index] = data[i_index];
-        } else {
-          data[o_index] += data[i_index];
-        }
-      }
+  return offset;
+}
+
+/// Sets the odometer `idx` over `sizes` to position `pos` and returns its
+/// offset.
+static inline int64_t _sn_rt_reduce_seek(int64_t* idx, const int64_t* sizes,
+                                         const int64_t* strides, int n,
+                                         int64_t pos) {
+  int64_t offset = 0;
+  for (int i = n - 1; i >= 0; --i) {
+    idx[i] = pos % sizes[i];
+    pos /= sizes[i];
+    offset += idx[i] * strides[i];
+  }
+  return offset;
+}
+
+/// Reduces `n` contiguous elements.
+template <typename Op>
+static float _sn_rt_reduce_segment(const float* src, int64_t n) {
+  if (Op::kPairwise && n > _sn_rt_reduce_pairwise_block) {
+    int64_t half = n / 2 / _sn_rt_vf8_lanes * _sn_rt_vf8_lanes;
+    return Op::Combine(_sn_rt_reduce_segment<Op>(src, half),
+                       _sn_rt_reduce_segment<Op>(src + half, n - half));
+  }
+  constexpr int64_t unroll = 4 * _sn_rt_vf8_lanes;
+  int64_t i = 0;
+  float acc = Op::Identity();
+  if (n >= unroll) {
+    _sn_rt_vf8 acc0 = _sn_rt_vf8_splat(Op::Identity());
+    _sn_rt_vf8 acc1 = acc0;
+    _sn_rt_vf8 acc2 = acc0;
+    _sn_rt_vf8 acc3 = acc0;
+    for (; i + unroll <= n; i += unroll) {
+      acc0 = Op::Combine(acc0, Op::Map(_sn_rt_vf8_load(src + i)));
+      acc1 = Op::Combine(acc1, Op::Map(_sn_rt_vf8_load(src + i + 8)));
+      acc2 = Op::Combine(acc2, Op::Map(_sn_rt_vf8_load(src + i + 16)));
+      acc3 = Op::Combine(acc3, Op::Map(_sn_rt_vf8_load(src + i + 24)));
     }
+    for (; i + _sn_rt_vf8_lanes <= n; i += _sn_rt_vf8_lanes) {
+      acc0 = Op::Combine(acc0, Op::Map(_sn_rt_vf8_load(src + i)));
+    }
+    _sn_rt_vf8 v =
+        Op::Combine(Op::Combine(acc0, acc1), Op::Combine(acc2, acc3));
+    float lo = Op::Combine(Op::Combine(v[0], v[1]), Op::Combine(v[2], v[3]));
+    float hi = Op::Combine(Op::Combine(v[4], v[5]), Op::Combine(v[6], v[7]));
+    acc = Op::Combine(lo, hi);
   }
-  for (int i = 0; i < before * after; ++i) {
-    data[i] /= (float)dim;
+  for (; i < n; ++i) {
+    acc = Op::Combine(acc, Op::Map(src[i]));
   }
-  _sn_rt_reduce_helper(data, in_dims, in_dims_size, axies, axies_size,
-                       index + 1);
+  return acc;
 }
 
-/// reducemean with fp32.
-void _sn_rt_reduce_mean_f32(float* result, const float* data,
-                            const int64_t* shape, const int32_t* axis,
-                            int64_t num_of_elements, int32_t dim,
-                            int32_t axis_dim) {
-  constexpr int DIM_BEFORE = 4;
-  int64_t in_dims[] = {1, 1, 1, 1};
-  constexpr int in_dims_size = sizeof(in_dims) / sizeof(in_dims[0]);
-  int64_t axies[axis_dim];
-  const int axies_size = axis_dim;
-  for (int i = 0; i < axis_dim; ++i) {
-    axies[i] = 1;
+/// acc[0:n] = Combine(acc[0:n], Map(src[0:n])).
+template <typename Op>
+static inline void _sn_rt_reduce_row(float* acc, const float* src, int64_t n) {
+  int64_t i = 0;
+  for (; i + _sn_rt_vf8_lanes <= n; i += _sn_rt_vf8_lanes) {
+    _sn_rt_vf8_store(acc + i, Op::Combine(_sn_rt_vf8_load(acc + i),
+                                          Op::Map(_sn_rt_vf8_load(src + i))));
   }
-  const int DIM_EXPAND = DIM_BEFORE - dim;
-  for (auto i = 0; i != DIM_BEFORE; ++i) {
-    in_dims[i] = i >= DIM_EXPAND ? shape[i - DIM_EXPAND] : 1;
+  for (; i < n; ++i) {
+    acc[i] = Op::Combine(acc[i], Op::Map(src[i]));
   }
-  for (auto i = 0; i != axis_dim; ++i) {
-    axies[i] = axis[i] + DIM_EXPAND;
+}
+
+/// acc[0:n] = Combine(acc[0:n], src[0:n]) for partial results.
+template <typename Op>
+static inline void _sn_rt_reduce_merge(float* acc, const float* src,
+                                       int64_t n) {
+  int64_t i = 0;
+  for (; i + _sn_rt_vf8_lanes <= n; i += _sn_rt_vf8_lanes) {
+    _sn_rt_vf8_store(acc + i, Op::Combine(_sn_rt_vf8_load(acc + i),
+                                          _sn_rt_vf8_load(src + i)));
   }
-  // std::sort(axies.begin(), axies.end());
-  // axies.erase(std::unique(axies.begin(), axies.end()), axies.end());
-  int64_t before, after;
-  before = after = 1;
-  int64_t curr = axies[0];
-  int64_t reduced_dim = in_dims[curr];
-  for (int i = 0; i < in_dims_size; ++i) {
-    if (i < curr) {
-      before *= in_dims[i];
-    } else if (i > curr) {
-      after *= in_dims[i];
+  for (; i < n; ++i) {
+    acc[i] = Op::Combine(acc[i], src[i]);
+  }
+}
+
+template <typename Op>
+static inline void _sn_rt_reduce_fill(float* dst, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) {
+    dst[i] = Op::Identity();
+  }
+}
+
+template <typename Op>
+static void _sn_rt_reduce(float* result, const float* data,
+                          const int64_t* shape, const int32_t* axis, int dim,
+                          int axis_dim) {
+  bool is_reduced[dim + 1];
+  for (int i = 0; i < dim; ++i) {
+    is_reduced[i] = axis_dim == 0;
+  }
+  for (int i = 0; i < axis_dim; ++i) {
+    is_reduced[axis[i] < 0 ? axis[i] + dim : axis[i]] = true;
+  }
+
+  // Merge dims into alternating groups of kept / reduced dims.
+  int64_t sizes[dim + 1];
+  bool reduced[dim + 1];
+  int rank = 0;
+  int64_t count = 1;
+  int64_t outputs = 1;
+  for (int i = 0; i < dim; ++i) {
+    (is_reduced[i] ? count : outputs) *= shape[i];
+    if (shape[i] == 1) {
+      continue;
+    }
+    if (rank > 0 && reduced[rank - 1] == is_reduced[i]) {
+      sizes[rank - 1] *= shape[i];
     } else {
-      in_dims[i] = 1;
+      sizes[rank] = shape[i];
+      reduced[rank++] = is_reduced[i];
     }
   }
-  float temp[before * after];
-  for (int i = 0; i < before; ++i) {
-    for (int j = 0; j < reduced_dim; ++j) {
-      for (int k = 0; k < after; ++k) {
-        auto o_index = k + i * after;
-        auto i_index = k + (j + i * reduced_dim) * after;
-        if (j == 0) {
-          temp[o_index] = data[i_index];
-        } else {
-          temp[o_index] += data[i_index];
-        }
-      }
-    }
+  if (rank == 0) {
+    sizes[rank] = 1;
+    reduced[rank++] = false;
   }
-  for (int i = 0; i < before * after; ++i) {
-    temp[i] /= (float)reduced_dim;
+  if (outputs == 0) {
+    return;
   }
-
-  if (axies_size > 1) {
-    _sn_rt_reduce_helper(temp, in_dims, in_dims_size, axies, axies_size, 1);
+  if (count == 0) {
+    for (int64_t i = 0; i < outputs; ++i) {
+      result[i] = Op::Finalize(Op::Identity(), count);
+    }
+    return;
   }
 
-  int64_t result_noe = 1;
-  for (auto i : in_dims) {
-    result_noe *= i;
+  // Split the groups into the kept and reduced parts with their strides.
+  int64_t kept_sizes[rank];
+  int64_t kept_strides[rank];
+  int64_t red_sizes[rank];
+  int64_t red_strides[rank];
+  int kept_rank = 0;
+  int red_rank = 0;
+  for (int64_t i = rank - 1, stride = 1; i >= 0; stride *= sizes[i--]) {
+    if (reduced[i]) {
+      red_sizes[red_rank] = sizes[i];
+      red_strides[red_rank++] = stride;
+    } else {
+      kept_sizes[kept_rank] = sizes[i];
+      kept_strides[kept_rank++] = stride;
+    }
   }
-  for (int i = 0; i < result_noe; ++i) {
-    result[i] = temp[i];
+  std::reverse(kept_sizes, kept_sizes + kept_rank);
+  std::reverse(kept_strides, kept_strides + kept_rank);
+  std::reverse(red_sizes, red_sizes + red_rank);
+  std::reverse(red_strides, red_strides + red_rank);
+  // Outputs are independent; each task walks its own odometers. Pointers are
+  // taken since arrays of runtime size cannot be captured.
+  const int64_t* ksizes = kept_sizes;
+  const int64_t* kstrides = kept_strides;
+  const int64_t* rsizes = red_sizes;
+  const int64_t* rstrides = red_strides;
+
+  if (!reduced[rank - 1]) {
+    // The innermost group is kept: accumulate rows of `inner` elements. For
+    // additive reductions, blocks of rows are summed into a stack of partial
+    // rows which are merged pairwise as in a binary counter.
+    int64_t inner = kept_sizes[--kept_rank];
+    int64_t block_rows = count;
+    int levels = 0;
+    if (Op::kPairwise) {
+      block_rows = std::min(count, _sn_rt_reduce_pairwise_block);
+      while ((block_rows << levels) < count) {
+        ++levels;
+      }
+    }
+    auto run_rows = [&](int64_t begin, int64_t end) {
+      int64_t kept_idx[rank];
+      int64_t red_idx[rank];
+      std::fill_n(red_idx, rank, 0);
+      float* partials = nullptr;
+      if (levels > 0) {
+        partials = static_cast<float*>(
+            _sn_rt_aligned_alloc(levels * inner * sizeof(float)));
+      }
+      int64_t base =
+          _sn_rt_reduce_seek(kept_idx, ksizes, kstrides, kept_rank, begin);
+      for (int64_t o = begin; o < end; ++o) {
+        float* dst = result + o * inner;
+        auto slot = [=](int depth) {
+          return depth == 0 ? dst : partials + (depth - 1) * inner;
+        };
+        int64_t offset = base;
+        int depth = 0;
+        for (int64_t r = 0, blocks = 0; r < count; r += block_rows) {
+          float* acc = slot(depth++);
+          _sn_rt_reduce_fill<Op>(acc, inner);
+          for (int64_t i = 0, e = std::min(block_rows, count - r); i < e;
+               ++i) {
+            _sn_rt_reduce_row<Op>(acc, data + offset, inner);
+            offset = _sn_rt_reduce_advance(red_idx, rsizes, rstrides,
+                                           red_rank, offset);
+          }
+          for (int64_t k = ++blocks; (k & 1) == 0; k >>= 1, --depth) {
+            _sn_rt_reduce_merge<Op>(slot(depth - 2), slot(depth - 1), inner);
+          }
+        }
+        for (; depth > 1; --depth) {
+          _sn_rt_reduce_merge<Op>(slot(depth - 2), slot(depth - 1), inner);
+        }
+        for (int64_t i = 0; i < inner; ++i) {
+          dst[i] = Op::Finalize(dst[i], count);
+        }
+        base = _sn_rt_reduce_advance(kept_idx, ksizes, kstrides, kept_rank,
+                                     base);
+      }
+      _sn_rt_aligned_free(partials);
+    };
+    _sn_rt_parallel_for(outputs / inner, count * inner, run_rows);
+    return;
   }
+
+  // The innermost group is reduced: combine contiguous segments.
+  int64_t segment = red_sizes[--red_rank];
+  int64_t segments = count / segment;
+  auto run_outputs = [&](int64_t begin, int64_t end) {
+    int64_t kept_idx[rank];
+    int64_t red_idx[rank];
+    std::fill_n(red_idx, rank, 0);
+    int64_t base =
+        _sn_rt_reduce_seek(kept_idx, ksizes, kstrides, kept_rank, begin);
+    for (int64_t o = begin; o < end; ++o) {
+      float acc = Op::Identity();
+      int64_t offset = base;
+      for (int64_t s = 0; s < segments; ++s) {
+        acc = Op::Combine(acc,
+                          _sn_rt_reduce_segment<Op>(data + offset, segment));
+        offset = _sn_rt_reduce_advance(red_idx, rsizes, rstrides, red_rank,
+                                       offset);
+      }
+      result[o] = Op::Finalize(acc, count);
+      base = _sn_rt_reduce_advance(kept_idx, ksizes, kstrides, kept_rank,
+                                   base);
+    }
+  };
+  _sn_rt_parallel_for(outputs, count, run_outputs);
 }
 
+extern "C" {
+
+#define _SN_RT_DEFINE_REDUCE(func, op)                                       \
+  void func(float* result, const float* data, const int64_t* shape,         \
+            const int32_t* axis, int64_t /*num_of_elements*/, int32_t dim,  \
+            int32_t axis_dim) {                                             \
+    _sn_rt_reduce<op>(result, data, shape, axis, dim, axis_dim);            \
+  }
+
+_SN_RT_DEFINE_REDUCE(_sn_rt_reduce_sum_f32, _sn_rt_reduce_op_sum)
+_SN_RT_DEFINE_REDUCE(_sn_rt_reduce_mean_f32, _sn_rt_reduce_op_mean)
+_SN_RT_DEFINE_REDUCE(_sn_rt_reduce_l2_f32, _sn_rt_reduce_op_l2)
+_SN_RT_DEFINE_REDUCE(_sn_rt_reduce_prod_f32, _sn_rt_reduce_op_prod)
+_SN_RT_DEFINE_REDUCE(_sn_rt_reduce_max_f32, _sn_rt_reduce_op_max)
+_SN_RT_DEFINE_REDUCE(_sn_rt_reduce_min_f32, _sn_rt_reduce_op_min)
+
+#undef _SN_RT_DEFINE_REDUCE
+
 void _sn_rt_argmax_f32(int* result, const float* data, const int64_t* shape,
                        const int32_t* axis, int64_t num_of_elements,
                        int32_t dim, int32_t axis_dim) {
@@ -143,8 +387,9 @@ void _sn_rt_argmax_f32(int* result, const float* data, const int64_t* shape,
     }
   }
   int64_t reduced_dims = shape[axis_adj];
+  float* value_max =
+      static_cast<float*>(_sn_rt_aligned_alloc(after * sizeof(float)));
   for (int i = 0; i < before; ++i) {
-    float value_max[after];
     for (int j = 0; j < reduced_dims; ++j) {
       for (int k = 0; k < after; ++k) {
         auto o_index = k + i * after;
@@ -159,5 +404,7 @@ void _sn_rt_argmax_f32(int* result, const float* data, const int64_t* shape,
       }
     }
   }
+  _sn_rt_aligned_free(value_max);
 }
-}
\ No newline at end of file
+}
+
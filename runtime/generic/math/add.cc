@@ -17,40 +17,9 @@
 
 #include <stdint.h>
 
-#include "broadcast.h"
+#include "elementwise.h"
 
 extern "C" {
-void _sn_rt_add_f32(float* out, const float* lhs, const float* rhs,
-                    int64_t ret_size, bool need_broadcast,
-                    const int64_t* ret_shape, const int64_t* lhs_shape,
-                    const int64_t* rhs_shape, int32_t dims) {
-  if (!need_broadcast) {
-    for (int64_t i = 0; i < ret_size; ++i) {
-      out[i] = lhs[i] + rhs[i];
-    }
-    return;
-  }
-  int64_t lhs_strides[dims];
-  int64_t rhs_strides[dims];
-  _sn_rt_broadcast_strides_calculation(lhs_strides, rhs_strides, ret_shape,
-                                       lhs_shape, rhs_shape, dims);
-  int pos[dims];
-  std::fill_n(&pos[0], dims, 0);
-  for (size_t i = 0; i < ret_size; ++i) {
-    size_t lhs_index =
-        std::inner_product(&pos[0], pos + dims, &lhs_strides[0], 0UL);
-    size_t rhs_index =
-        std::inner_product(&pos[0], pos + dims, &rhs_strides[0], 0UL);
-    *out++ = lhs[lhs_index] + rhs[rhs_index];
-    int c = 1;
-    for (int i = dims - 1; i >= 0 && c == 1; --i) {
-      pos[i] += c;
-      if (pos[i] >= ret_shape[i]) {
-        pos[i] = 0;
-      } else {
-        c = 0;
-      }
-    }
-  }
+_SN_RT_DEFINE_BINARY(_sn_rt_add_f32, _sn_rt_op_add, float, float)
+_SN_RT_DEFINE_BINARY(_sn_rt_add_i32, _sn_rt_op_add, int32_t, int32_t)
 }
-}
\ No newline at end of file
@@ -0,0 +1,41 @@
+//===- cmp.cc -------------------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include <stdint.h>
+
+#include "elementwise.h"
+
+extern "C" {
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_eq_f32, _sn_rt_op_cmp_eq, float, bool)
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_ne_f32, _sn_rt_op_cmp_ne, float, bool)
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_gt_f32, _sn_rt_op_cmp_gt, float, bool)
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_lt_f32, _sn_rt_op_cmp_lt, float, bool)
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_ge_f32, _sn_rt_op_cmp_ge, float, bool)
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_le_f32, _sn_rt_op_cmp_le, float, bool)
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_eq_i32, _sn_rt_op_cmp_eq, int32_t, bool)
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_ne_i32, _sn_rt_op_cmp_ne, int32_t, bool)
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_gt_i32, _sn_rt_op_cmp_gt, int32_t, bool)
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_lt_i32, _sn_rt_op_cmp_lt, int32_t, bool)
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_ge_i32, _sn_rt_op_cmp_ge, int32_t, bool)
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_le_i32, _sn_rt_op_cmp_le, int32_t, bool)
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_eq_bool, _sn_rt_op_cmp_eq, bool, bool)
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_ne_bool, _sn_rt_op_cmp_ne, bool, bool)
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_gt_bool, _sn_rt_op_cmp_gt, bool, bool)
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_lt_bool, _sn_rt_op_cmp_lt, bool, bool)
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_ge_bool, _sn_rt_op_cmp_ge, bool, bool)
+_SN_RT_DEFINE_BINARY(_sn_rt_cmp_le_bool, _sn_rt_op_cmp_le, bool, bool)
+}
@@ -0,0 +1,311 @@
+//===- elementwise.h ------------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HALO_LIB_RUNTIME_GENERIC_MATH_ELEMENTWISE_H_
+#define HALO_LIB_RUNTIME_GENERIC_MATH_ELEMENTWISE_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+#include "../common/parallel.h"
+#include "simd.h"
+
+// Broadcasting elementwise engine shared by all binary runtime ops.
+//
+// Shapes are first collapsed: dimensions of size 1 in the result are dropped
+// and adjacent dimensions are merged when each operand is either broadcast
+// along both or along neither. Common patterns then reduce to very few
+// dimensions, e.g. an NCHW per-channel bias [1,C,1,1] + [N,C,H,W] becomes
+// [N, C, H*W] where the bias is a scalar per innermost run. The innermost
+// run is processed by one of four loops (both contiguous, lhs scalar, rhs
+// scalar, both scalar), vectorized for float ops; outer dimensions are walked
+// with incremental offsets. Large outputs are split into runs over the thread
+// pool.
+//
+// An op is a type with `static R Apply(T, T)`. Ops that also provide
+// `Apply(_sn_rt_vf8, _sn_rt_vf8)` and set `kVectorizable` get explicit SIMD
+// loops for float operands.
+
+struct _sn_rt_op_add {
+  static constexpr bool kVectorizable = true;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return a + b;
+  }
+};
+
+struct _sn_rt_op_sub {
+  static constexpr bool kVectorizable = true;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return a - b;
+  }
+};
+
+struct _sn_rt_op_mul {
+  static constexpr bool kVectorizable = true;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return a * b;
+  }
+};
+
+struct _sn_rt_op_div {
+  static constexpr bool kVectorizable = true;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return a / b;
+  }
+};
+
+struct _sn_rt_op_maximum {
+  static constexpr bool kVectorizable = true;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return a > b ? a : b;
+  }
+  static _sn_rt_vf8 Apply(_sn_rt_vf8 a, _sn_rt_vf8 b) {
+    return _sn_rt_vf8_max(a, b);
+  }
+};
+
+struct _sn_rt_op_minimum {
+  static constexpr bool kVectorizable = true;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return a < b ? a : b;
+  }
+  static _sn_rt_vf8 Apply(_sn_rt_vf8 a, _sn_rt_vf8 b) {
+    return _sn_rt_vf8_min(a, b);
+  }
+};
+
+struct _sn_rt_op_pow {
+  static constexpr bool kVectorizable = false;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return static_cast<T>(std::pow(a, b));
+  }
+};
+
+struct _sn_rt_op_shiftl {
+  static constexpr bool kVectorizable = false;
+  template <typename T>
+  static T Apply(T a, T b) {
+    using U = typename std::make_unsigned<T>::type;
+    return static_cast<T>(static_cast<U>(a) << b);
+  }
+};
+
+// Logical shift: zeros are shifted in as MSB.
+struct _sn_rt_op_shiftr {
+  static constexpr bool kVectorizable = false;
+  template <typename T>
+  static T Apply(T a, T b) {
+    using U = typename std::make_unsigned<T>::type;
+    return static_cast<T>(static_cast<U>(a) >> b);
+  }
+};
+
+struct _sn_rt_op_and {
+  static constexpr bool kVectorizable = false;
+  static bool Apply(bool a, bool b) { return a && b; }
+};
+
+struct _sn_rt_op_or {
+  static constexpr bool kVectorizable = false;
+  static bool Apply(bool a, bool b) { return a || b; }
+};
+
+#define _SN_RT_DEFINE_CMP_OP(name, op)                                        \
+  struct _sn_rt_op_cmp_##name {                                               \
+    static constexpr bool kVectorizable = false;                              \
+    template <typename T>                                                     \
+    static bool Apply(T a, T b) {                                             \
+      return a op b;                                                          \
+    }                                                                         \
+  };
+
+_SN_RT_DEFINE_CMP_OP(eq, ==)
+_SN_RT_DEFINE_CMP_OP(ne, !=)
+_SN_RT_DEFINE_CMP_OP(gt, >)
+_SN_RT_DEFINE_CMP_OP(lt, <)
+_SN_RT_DEFINE_CMP_OP(ge, >=)
+_SN_RT_DEFINE_CMP_OP(le, <=)
+
+#undef _SN_RT_DEFINE_CMP_OP
+
+// out[i] = op(lhs[i * lhs_step], rhs[i * rhs_step]) for steps in {0, 1}.
+template <typename Op, typename T, typename R>
+static inline void _sn_rt_binary_run(R* out, const T* lhs, int64_t lhs_step,
+                                     const T* rhs, int64_t rhs_step,
+                                     int64_t n) {
+  int64_t i = 0;
+  if constexpr (Op::kVectorizable && std::is_same<T, float>::value &&
+                std::is_same<R, float>::value) {
+    constexpr int64_t lanes = _sn_rt_vf8_lanes;
+    const int64_t vec_end = n / lanes * lanes;
+    if (lhs_step != 0 && rhs_step != 0) {
+      for (; i < vec_end; i += lanes) {
+        _sn_rt_vf8_store(out + i, Op::Apply(_sn_rt_vf8_load(lhs + i),
+                                            _sn_rt_vf8_load(rhs + i)));
+      }
+    } else if (lhs_step != 0) {
+      _sn_rt_vf8 b = _sn_rt_vf8_splat(*rhs);
+      for (; i < vec_end; i += lanes) {
+        _sn_rt_vf8_store(out + i, Op::Apply(_sn_rt_vf8_load(lhs + i), b));
+      }
+    } else if (rhs_step != 0) {
+      _sn_rt_vf8 a = _sn_rt_vf8_splat(*lhs);
+      for (; i < vec_end; i += lanes) {
+        _sn_rt_vf8_store(out + i, Op::Apply(a, _sn_rt_vf8_load(rhs + i)));
+      }
+    }
+  }
+  if (lhs_step != 0 && rhs_step != 0) {
+    for (; i < n; ++i) {
+      out[i] = Op::Apply(lhs[i], rhs[i]);
+    }
+  } else if (lhs_step != 0) {
+    const T b = *rhs;
+    for (; i < n; ++i) {
+      out[i] = Op::Apply(lhs[i], b);
+    }
+  } else if (rhs_step != 0) {
+    const T a = *lhs;
+    for (; i < n; ++i) {
+      out[i] = Op::Apply(a, rhs[i]);
+    }
+  } else {
+    std::fill(out + i, out + n, static_cast<R>(Op::Apply(*lhs, *rhs)));
+  }
+}
+
+// Collapses rank-aligned broadcast shapes. Returns the new rank and fills
+// `shape` with the merged result dims and `lhs_bcast`/`rhs_bcast` with whether
+// each operand is broadcast along them.
+static inline int _sn_rt_broadcast_collapse(const int64_t* ret_shape,
+                                            const int64_t* lhs_shape,
+                                            const int64_t* rhs_shape,
+                                            int32_t dims, int64_t* shape,
+                                            bool* lhs_bcast, bool* rhs_bcast) {
+  int rank = 0;
+  for (int i = 0; i < dims; ++i) {
+    if (ret_shape[i] == 1) {
+      continue;
+    }
+    bool lb = lhs_shape[i] != ret_shape[i];
+    bool rb = rhs_shape[i] != ret_shape[i];
+    if (rank > 0 && lhs_bcast[rank - 1] == lb && rhs_bcast[rank - 1] == rb) {
+      shape[rank - 1] *= ret_shape[i];
+      continue;
+    }
+    shape[rank] = ret_shape[i];
+    lhs_bcast[rank] = lb;
+    rhs_bcast[rank] = rb;
+    ++rank;
+  }
+  return rank;
+}
+
+template <typename Op, typename T, typename R>
+static void _sn_rt_binary_broadcast(R* out, const T* lhs, const T* rhs,
+                                    int64_t ret_size, bool need_broadcast,
+                                    const int64_t* ret_shape,
+                                    const int64_t* lhs_shape,
+                                    const int64_t* rhs_shape, int32_t dims) {
+  // Empty results have no rows to split.
+  if (ret_size == 0) {
+    return;
+  }
+  if (!need_broadcast) {
+    _sn_rt_parallel_for(ret_size, 1, [=](int64_t begin, int64_t end) {
+      _sn_rt_binary_run<Op>(out + begin, lhs + begin, 1, rhs + begin, 1,
+                            end - begin);
+    });
+    return;
+  }
+  int64_t shape[dims + 1];
+  bool lhs_bcast[dims + 1];
+  bool rhs_bcast[dims + 1];
+  int rank = _sn_rt_broadcast_collapse(ret_shape, lhs_shape, rhs_shape, dims,
+                                       shape, lhs_bcast, rhs_bcast);
+  if (rank == 0) {
+    *out = Op::Apply(*lhs, *rhs);
+    return;
+  }
+
+  // Element strides of each operand; broadcast dimensions have stride 0.
+  int64_t lhs_strides[rank];
+  int64_t rhs_strides[rank];
+  int64_t lhs_size = 1;
+  int64_t rhs_size = 1;
+  for (int i = rank - 1; i >= 0; --i) {
+    lhs_strides[i] = lhs_bcast[i] ? 0 : lhs_size;
+    rhs_strides[i] = rhs_bcast[i] ? 0 : rhs_size;
+    lhs_size *= lhs_bcast[i] ? 1 : shape[i];
+    rhs_size *= rhs_bcast[i] ? 1 : shape[i];
+  }
+
+  const int64_t n = shape[rank - 1];
+  const int outer = rank - 1;
+  const int64_t* dims_size = shape;
+  const int64_t* lhs_step = lhs_strides;
+  const int64_t* rhs_step = rhs_strides;
+  auto run_rows = [&](int64_t begin, int64_t end) {
+    int64_t idx[rank];
+    int64_t lhs_off = 0;
+    int64_t rhs_off = 0;
+    for (int64_t i = outer - 1, pos = begin; i >= 0; --i) {
+      idx[i] = pos % dims_size[i];
+      pos /= dims_size[i];
+      lhs_off += idx[i] * lhs_step[i];
+      rhs_off += idx[i] * rhs_step[i];
+    }
+    for (int64_t row = begin; row < end; ++row) {
+      _sn_rt_binary_run<Op>(out + row * n, lhs + lhs_off, lhs_step[outer],
+                            rhs + rhs_off, rhs_step[outer], n);
+      for (int i = outer - 1; i >= 0; --i) {
+        lhs_off += lhs_step[i];
+        rhs_off += rhs_step[i];
+        if (++idx[i] < dims_size[i]) {
+          break;
+        }
+        lhs_off -= lhs_step[i] * dims_size[i];
+        rhs_off -= rhs_step[i] * dims_size[i];
+        idx[i] = 0;
+      }
+    }
+  };
+  _sn_rt_parallel_for(ret_size / n, n, run_rows);
+}
+
+// Defines the runtime entry `func` computing `op` on T operands with R results.
+// The shapes are rank aligned and only read when `need_broadcast` is true.
+#define _SN_RT_DEFINE_BINARY(func, op, T, R)                                  \
+  void func(R* out, const T* lhs, const T* rhs, int64_t ret_size,              \
+            bool need_broadcast, const int64_t* ret_shape,                     \
+            const int64_t* lhs_shape, const int64_t* rhs_shape,                \
+            int32_t dims) {                                                    \
+    _sn_rt_binary_broadcast<op>(out, lhs, rhs, ret_size, need_broadcast,       \
+                                ret_shape, lhs_shape, rhs_shape, dims);        \
+  }
+
+#endif // HALO_LIB_RUNTIME_GENERIC_MATH_ELEMENTWISE_H_
@@ -15,14 +15,14 @@
 // limitations under the License.
 // =============================================================================
 
-#include <math.h>
 #include <stdint.h>
 
+#include "vmath.h"
+
 extern "C" {
-/// A dummy implementation.
+/// erf with fp32.
 void _sn_rt_erf_f32(float* out, const float* lhs, int64_t lhs_size) {
-  for (int64_t i = 0; i < lhs_size; ++i) {
-    out[i] = std::erf(lhs[i]);
-  }
+  _sn_rt_vf8_map(out, lhs, lhs_size,
+                 [](_sn_rt_vf8 x) { return _sn_rt_vf8_erf(x); });
+}
 }
-}
\ No newline at end of file
@@ -0,0 +1,365 @@
+//===- gemm.h -------------------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HALO_LIB_RUNTIME_GENERIC_MATH_GEMM_H_
+#define HALO_LIB_RUNTIME_GENERIC_MATH_GEMM_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "../common/parallel.h"
+#include "simd.h"
+
+// Packed, register-blocked single precision GEMM:
+//   C[M x N] = alpha * op(A)[M x K] * op(B)[K x N] + beta * bias
+//
+// op(B) is packed into panels of NR columns spanning the whole K dimension so
+// the packed copy can be shared by several GEMMs (e.g. batch matmul with a
+// broadcast rhs, or convolutions reusing the same weights). op(A) is packed per
+// MC x KC block into panels of MR rows. The micro-kernel keeps an MR x NR tile
+// of C in registers and the bias/alpha/beta epilogue is fused into its store.
+
+constexpr int64_t _sn_rt_gemm_mr = 6;
+constexpr int64_t _sn_rt_gemm_nr = 2 * _sn_rt_vf8_lanes;
+// KC * NR floats of B (16KB) stay in L1, MC * KC floats of A (96KB) in L2.
+constexpr int64_t _sn_rt_gemm_kc = 256;
+constexpr int64_t _sn_rt_gemm_mc = 16 * _sn_rt_gemm_mr;
+
+enum class _sn_rt_gemm_bias_mode {
+  NONE,   // no bias.
+  SCALAR, // bias[0].
+  ROW,    // bias[i], one value per row of C.
+  COL,    // bias[j], one value per column of C.
+  FULL,   // bias[i * ld_bias + j].
+};
+
+struct _sn_rt_gemm_epilogue {
+  float alpha = 1.0F;
+  float beta = 1.0F;
+  const float* bias = nullptr;
+  _sn_rt_gemm_bias_mode mode = _sn_rt_gemm_bias_mode::NONE;
+  int64_t ld_bias = 0;
+  // Fused clipping activation (e.g. Relu: [0, max], Relu6: [0, 6]).
+  float clip_min = std::numeric_limits<float>::lowest();
+  float clip_max = std::numeric_limits<float>::max();
+};
+
+static inline float _sn_rt_clip(float v, float lo, float hi) {
+  return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static inline float _sn_rt_gemm_epilogue_apply(const _sn_rt_gemm_epilogue& ep,
+                                               float v, int64_t i, int64_t j) {
+  v *= ep.alpha;
+  switch (ep.mode) {
+    case _sn_rt_gemm_bias_mode::SCALAR:
+      v += ep.beta * ep.bias[0];
+      break;
+    case _sn_rt_gemm_bias_mode::ROW:
+      v += ep.beta * ep.bias[i];
+      break;
+    case _sn_rt_gemm_bias_mode::COL:
+      v += ep.beta * ep.bias[j];
+      break;
+    case _sn_rt_gemm_bias_mode::FULL:
+      v += ep.beta * ep.bias[i * ep.ld_bias + j];
+      break;
+    default:
+      break;
+  }
+  return _sn_rt_clip(v, ep.clip_min, ep.clip_max);
+}
+
+static inline _sn_rt_vf8 _sn_rt_gemm_epilogue_apply(
+    const _sn_rt_gemm_epilogue& ep, _sn_rt_vf8 v, int64_t i, int64_t j) {
+  v *= ep.alpha;
+  switch (ep.mode) {
+    case _sn_rt_gemm_bias_mode::SCALAR:
+      v += ep.beta * ep.bias[0];
+      break;
+    case _sn_rt_gemm_bias_mode::ROW:
+      v += ep.beta * ep.bias[i];
+      break;
+    case _sn_rt_gemm_bias_mode::COL:
+      v += ep.beta * _sn_rt_vf8_load(ep.bias + j);
+      break;
+    case _sn_rt_gemm_bias_mode::FULL:
+      v += ep.beta * _sn_rt_vf8_load(ep.bias + i * ep.ld_bias + j);
+      break;
+    default:
+      break;
+  }
+  v = _sn_rt_vf8_max(v, _sn_rt_vf8_splat(ep.clip_min));
+  return _sn_rt_vf8_min(v, _sn_rt_vf8_splat(ep.clip_max));
+}
+
+/// Number of floats needed to hold op(B) packed by _sn_rt_gemm_pack_b.
+static inline int64_t _sn_rt_gemm_packed_b_size(int64_t n, int64_t k) {
+  return (n + _sn_rt_gemm_nr - 1) / _sn_rt_gemm_nr * _sn_rt_gemm_nr * k;
+}
+
+/// Packs op(B) (K x N) into NR-column panels. Panel p holds columns
+/// [p * NR, p * NR + NR) stored k-major, zero padded on the right edge.
+static inline void _sn_rt_gemm_pack_b(float* dst, const float* b, int64_t ldb,
+                                      bool trans_b, int64_t n, int64_t k) {
+  constexpr int64_t nr = _sn_rt_gemm_nr;
+  for (int64_t j0 = 0; j0 < n; j0 += nr, dst += nr * k) {
+    int64_t cols = std::min(nr, n - j0);
+    if (!trans_b) {
+      for (int64_t kk = 0; kk < k; ++kk) {
+        const float* src = b + kk * ldb + j0;
+        float* d = dst + kk * nr;
+        int64_t j = 0;
+        for (; j < cols; ++j) {
+          d[j] = src[j];
+        }
+        for (; j < nr; ++j) {
+          d[j] = 0;
+        }
+      }
+    } else {
+      int64_t j = 0;
+      for (; j < cols; ++j) {
+        const float* src = b + (j0 + j) * ldb;
+        for (int64_t kk = 0; kk < k; ++kk) {
+          dst[kk * nr + j] = src[kk];
+        }
+      }
+      for (; j < nr; ++j) {
+        for (int64_t kk = 0; kk < k; ++kk) {
+          dst[kk * nr + j] = 0;
+        }
+      }
+    }
+  }
+}
+
+/// Packs an mc x kc block of op(A) starting at (i0, k0) into MR-row panels
+/// stored k-major, zero padded at the bottom edge.
+static inline void _sn_rt_gemm_pack_a(float* dst, const float* a, int64_t lda,
+                                      bool trans_a, int64_t i0, int64_t k0,
+                                      int64_t mc, int64_t kc) {
+  constexpr int64_t mr = _sn_rt_gemm_mr;
+  for (int64_t r0 = 0; r0 < mc; r0 += mr, dst += mr * kc) {
+    int64_t rows = std::min(mr, mc - r0);
+    if (!trans_a) {
+      int64_t r = 0;
+      for (; r < rows; ++r) {
+        const float* src = a + (i0 + r0 + r) * lda + k0;
+        for (int64_t kk = 0; kk < kc; ++kk) {
+          dst[kk * mr + r] = src[kk];
+        }
+      }
+      for (; r < mr; ++r) {
+        for (int64_t kk = 0; kk < kc; ++kk) {
+          dst[kk * mr + r] = 0;
+        }
+      }
+    } else {
+      for (int64_t kk = 0; kk < kc; ++kk) {
+        const float* src = a + (k0 + kk) * lda + i0 + r0;
+        float* d = dst + kk * mr;
+        int64_t r = 0;
+        for (; r < rows; ++r) {
+          d[r] = src[r];
+        }
+        for (; r < mr; ++r) {
+          d[r] = 0;
+        }
+      }
+    }
+  }
+}
+
+/// Computes an MR x NR tile of C from packed panels. When `accumulate` is set
+/// the tile is added to the partial sums already in C. The epilogue is applied
+/// only on the last K block (`ep` != nullptr). (i, j) is the tile origin in C.
+static inline void _sn_rt_gemm_micro_kernel(
+    int64_t kc, const float* pa, const float* pb, float* c, int64_t ldc,
+    int64_t rows, int64_t cols, bool accumulate, const _sn_rt_gemm_epilogue* ep,
+    int64_t i, int64_t j) {
+  constexpr int64_t mr = _sn_rt_gemm_mr;
+  constexpr int64_t nr = _sn_rt_gemm_nr;
+  constexpr int64_t w = _sn_rt_vf8_lanes;
+  _sn_rt_vf8 acc[mr][2] = {};
+  for (int64_t kk = 0; kk < kc; ++kk, pa += mr, pb += nr) {
+    _sn_rt_vf8 b0 = _sn_rt_vf8_load(pb);
+    _sn_rt_vf8 b1 = _sn_rt_vf8_load(pb + w);
+    for (int64_t r = 0; r < mr; ++r) {
+      _sn_rt_vf8 a = _sn_rt_vf8_splat(pa[r]);
+      acc[r][0] += a * b0;
+      acc[r][1] += a * b1;
+    }
+  }
+
+  if (rows == mr && cols == nr) {
+    for (int64_t r = 0; r < mr; ++r) {
+      float* dst = c + r * ldc;
+      for (int64_t h = 0; h < 2; ++h) {
+        _sn_rt_vf8 v = acc[r][h];
+        if (accumulate) {
+          v += _sn_rt_vf8_load(dst + h * w);
+        }
+        if (ep != nullptr) {
+          v = _sn_rt_gemm_epilogue_apply(*ep, v, i + r, j + h * w);
+        }
+        _sn_rt_vf8_store(dst + h * w, v);
+      }
+    }
+    return;
+  }
+
+  // Edge tile: spill the accumulators and store element-wise.
+  alignas(_sn_rt_buffer_alignment) float tile[mr * nr];
+  for (int64_t r = 0; r < mr; ++r) {
+    _sn_rt_vf8_store(tile + r * nr, acc[r][0]);
+    _sn_rt_vf8_store(tile + r * nr + w, acc[r][1]);
+  }
+  for (int64_t r = 0; r < rows; ++r) {
+    float* dst = c + r * ldc;
+    for (int64_t col = 0; col < cols; ++col) {
+      float v = tile[r * nr + col];
+      if (accumulate) {
+        v += dst[col];
+      }
+      if (ep != nullptr) {
+        v = _sn_rt_gemm_epilogue_apply(*ep, v, i + r, j + col);
+      }
+      dst[col] = v;
+    }
+  }
+}
+
+/// The blocked GEMM loop nest. Operands are supplied by packers so callers can
+/// pack directly from implicit matrices (e.g. convolution patches) without
+/// materializing them:
+///   pack_a(float* dst, i0, k0, mc, kc) packs an mc x kc block of op(A) into
+///   MR-row panels (see _sn_rt_gemm_pack_a). It may run on several threads.
+///   pack_b(j0, k0, nc, kc, int64_t* panel_stride) returns the kc x nc block of
+///   op(B) as NR-column panels, `*panel_stride` floats apart. It is only
+///   called from the calling thread.
+/// Columns are processed in blocks of `nc_block`. Within a (column, K) block,
+/// the MC x NR-panel tiles of C are computed in parallel: by row blocks, and
+/// also by column panels when there are too few row blocks (e.g. batch 1).
+/// `pa_buf` holds MC * KC floats and is used when the block runs serially.
+template <typename PackA, typename PackB>
+static inline void _sn_rt_gemm_blocked(int64_t m, int64_t n, int64_t k,
+                                       PackA&& pack_a, PackB&& pack_b,
+                                       float* c, int64_t ldc,
+                                       const _sn_rt_gemm_epilogue& ep,
+                                       float* pa_buf, int64_t nc_block) {
+  constexpr int64_t mr = _sn_rt_gemm_mr;
+  constexpr int64_t nr = _sn_rt_gemm_nr;
+  if (k == 0) {
+    for (int64_t i = 0; i < m; ++i) {
+      for (int64_t j = 0; j < n; ++j) {
+        c[i * ldc + j] = _sn_rt_gemm_epilogue_apply(ep, 0.0F, i, j);
+      }
+    }
+    return;
+  }
+  const int64_t m_blocks = (m + _sn_rt_gemm_mc - 1) / _sn_rt_gemm_mc;
+  for (int64_t jc = 0; jc < n; jc += nc_block) {
+    int64_t nc = std::min(nc_block, n - jc);
+    int64_t n_panels = (nc + nr - 1) / nr;
+    int64_t n_splits = 1;
+    if (m * nc * std::min(k, _sn_rt_gemm_kc) > 2 * _sn_rt_parallel_min_cost) {
+      int64_t threads = halo::ThreadPool::GetDefault()->GetNumOfThreads();
+      n_splits = std::min(n_panels, (threads + m_blocks - 1) / m_blocks);
+    }
+    const int64_t tasks = m_blocks * n_splits;
+    for (int64_t k0 = 0; k0 < k; k0 += _sn_rt_gemm_kc) {
+      int64_t kc = std::min(_sn_rt_gemm_kc, k - k0);
+      bool first = k0 == 0;
+      const _sn_rt_gemm_epilogue* last_ep = (k0 + kc == k) ? &ep : nullptr;
+      int64_t pb_stride = 0;
+      const float* pb_block = pack_b(jc, k0, nc, kc, &pb_stride);
+      auto run_tasks = [&](int64_t begin, int64_t end) {
+        float* pa = pa_buf;
+        if (begin != 0 || end != tasks) {
+          pa = static_cast<float*>(_sn_rt_aligned_alloc(
+              sizeof(float) * _sn_rt_gemm_mc * _sn_rt_gemm_kc));
+        }
+        for (int64_t t = begin; t < end; ++t) {
+          int64_t i0 = t / n_splits * _sn_rt_gemm_mc;
+          int64_t mc = std::min(_sn_rt_gemm_mc, m - i0);
+          int64_t split = t % n_splits;
+          int64_t j_begin = n_panels * split / n_splits * nr;
+          int64_t j_end = std::min(nc, n_panels * (split + 1) / n_splits * nr);
+          pack_a(pa, i0, k0, mc, kc);
+          for (int64_t j0 = j_begin; j0 < j_end; j0 += nr) {
+            int64_t cols = std::min(nr, nc - j0);
+            const float* pb = pb_block + j0 / nr * pb_stride;
+            for (int64_t r0 = 0; r0 < mc; r0 += mr) {
+              int64_t rows = std::min(mr, mc - r0);
+              _sn_rt_gemm_micro_kernel(kc, pa + r0 * kc, pb,
+                                       c + (i0 + r0) * ldc + jc + j0, ldc,
+                                       rows, cols, !first, last_ep, i0 + r0,
+                                       jc + j0);
+            }
+          }
+        }
+        if (pa != pa_buf) {
+          _sn_rt_aligned_free(pa);
+        }
+      };
+      _sn_rt_parallel_for(tasks, _sn_rt_gemm_mc * kc * nc / n_splits,
+                          run_tasks);
+    }
+  }
+}
+
+/// GEMM with op(B) already packed by _sn_rt_gemm_pack_b. `pa_buf` must hold
+/// MC * KC floats.
+static inline void _sn_rt_gemm_packed(int64_t m, int64_t n, int64_t k,
+                                      const float* a, int64_t lda,
+                                      bool trans_a, const float* packed_b,
+                                      float* c, int64_t ldc,
+                                      const _sn_rt_gemm_epilogue& ep,
+                                      float* pa_buf) {
+  auto pack_a = [a, lda, trans_a](float* dst, int64_t i0, int64_t k0,
+                                  int64_t mc, int64_t kc) {
+    _sn_rt_gemm_pack_a(dst, a, lda, trans_a, i0, k0, mc, kc);
+  };
+  // op(B) is packed whole, so every block lies within the packed panels.
+  auto pack_b = [packed_b, k](int64_t j0, int64_t k0, int64_t /*nc*/,
+                              int64_t /*kc*/, int64_t* panel_stride) {
+    *panel_stride = k * _sn_rt_gemm_nr;
+    return packed_b + j0 * k + k0 * _sn_rt_gemm_nr;
+  };
+  _sn_rt_gemm_blocked(m, n, k, pack_a, pack_b, c, ldc, ep, pa_buf,
+                      n > 0 ? n : 1);
+}
+
+/// General entry: C = alpha * op(A) * op(B) + beta * bias.
+static inline void _sn_rt_gemm(int64_t m, int64_t n, int64_t k, const float* a,
+                               int64_t lda, bool trans_a, const float* b,
+                               int64_t ldb, bool trans_b, float* c,
+                               int64_t ldc, const _sn_rt_gemm_epilogue& ep) {
+  float* pb = static_cast<float*>(
+      _sn_rt_aligned_alloc(sizeof(float) * _sn_rt_gemm_packed_b_size(n, k)));
+  float* pa = static_cast<float*>(
+      _sn_rt_aligned_alloc(sizeof(float) * _sn_rt_gemm_mc * _sn_rt_gemm_kc));
+  _sn_rt_gemm_pack_b(pb, b, ldb, trans_b, n, k);
+  _sn_rt_gemm_packed(m, n, k, a, lda, trans_a, pb, c, ldc, ep, pa);
+  _sn_rt_aligned_free(pa);
+  _sn_rt_aligned_free(pb);
+}
+
+#endif // HALO_LIB_RUNTIME_GENERIC_MATH_GEMM_H_
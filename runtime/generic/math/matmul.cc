@@ -17,111 +17,75 @@
 
 #include <stdint.h>
 
+#include "gemm.h"
+
 extern "C" {
-/// A dummy implementation.
 void _sn_rt_matmul_f32(float* C, const float* A, const float* B, int64_t A_row,
                        int64_t A_col, int64_t B_row, int64_t B_col,
                        bool transposeA, bool transposeB) {
   auto C_row = (transposeA ? A_col : A_row);
   auto C_col = (transposeB ? B_row : B_col);
-  if (!transposeA && transposeB) {
-    for (int64_t i = 0; i < C_row; ++i) {
-      for (int64_t j = 0; j < C_col; ++j) {
-        *C = 0;
-        for (int64_t k = 0; k < B_col; ++k)
-          *C += A[i * A_col + k] * B[j * B_col + k];
-        ++C;
-      }
-    }
-    return;
-  }
-  if (transposeA && !transposeB) {
-    for (int64_t i = 0; i < C_row; ++i) {
-      for (int64_t j = 0; j < C_col; ++j) {
-        *C = 0;
-        for (int64_t k = 0; k < B_row; ++k)
-          *C += A[k * A_col + i] * B[k * B_col + j];
-        ++C;
-      }
-    }
-    return;
-  }
-  if (!transposeA && !transposeB) {
-    for (int64_t i = 0; i < C_row; ++i) {
-      for (int64_t j = 0; j < C_col; ++j) {
-        *C = 0;
-        for (int64_t k = 0; k < B_row; ++k)
-          *C += A[i * A_col + k] * B[k * B_col + j];
-        ++C;
-      }
-    }
-  }
+  auto K = (transposeA ? A_row : A_col);
+  _sn_rt_gemm_epilogue ep;
+  _sn_rt_gemm(C_row, C_col, K, A, A_col, transposeA, B, B_col, transposeB, C,
+              C_col, ep);
 }
 
 void _sn_rt_gemm_f32(float* result, const float* A, const float* B,
                      const float* C, int64_t A_row, int64_t A_col,
                      int64_t B_row, int64_t B_col, int64_t C_noe,
                      bool transposeA, bool transposeB, float alpha,
-                     float beta) {
-  _sn_rt_matmul_f32(result, A, B, A_row, A_col, B_row, B_col, transposeA,
-                    transposeB);
+                     float beta, float clip_min, float clip_max) {
   auto result_row = (transposeA ? A_col : A_row);
   auto result_col = (transposeB ? B_row : B_col);
+  auto K = (transposeA ? A_row : A_col);
+  _sn_rt_gemm_epilogue ep;
+  ep.alpha = alpha;
+  ep.beta = beta;
+  ep.bias = C;
+  ep.clip_min = clip_min;
+  ep.clip_max = clip_max;
+  // Keep the precedence of bias shapes when they are ambiguous (e.g. square
+  // result): full matrix, scalar, per row, per column.
   if (C_noe == result_row * result_col) {
-    for (int64_t i = 0; i < result_row; ++i) {
-      for (int64_t j = 0; j < result_col; ++j) {
-        *result *= alpha;
-        *result += beta * C[i * result_col + j];
-        ++result;
-      }
-    }
-    return;
-  }
-  if (C_noe == 1) {
-    for (int64_t i = 0; i < result_row; ++i) {
-      for (int64_t j = 0; j < result_col; ++j) {
-        *result *= alpha;
-        *result += beta * (*C);
-        ++result;
-      }
-    }
-    return;
-  }
-  if (C_noe == result_row) {
-    for (int64_t i = 0; i < result_row; ++i) {
-      for (int64_t j = 0; j < result_col; ++j) {
-        *result *= alpha;
-        *result += beta * C[i];
-        ++result;
-      }
-    }
-    return;
-  }
-  if (C_noe == result_col) {
-    for (int64_t i = 0; i < result_row; ++i) {
-      for (int64_t j = 0; j < result_col; ++j) {
-        *result *= alpha;
-        *result += beta * C[j];
-        ++result;
-      }
-    }
-    return;
+    ep.mode = _sn_rt_gemm_bias_mode::FULL;
+    ep.ld_bias = result_col;
+  } else if (C_noe == 1) {
+    ep.mode = _sn_rt_gemm_bias_mode::SCALAR;
+  } else if (C_noe == result_row) {
+    ep.mode = _sn_rt_gemm_bias_mode::ROW;
+  } else if (C_noe == result_col) {
+    ep.mode = _sn_rt_gemm_bias_mode::COL;
   }
+  _sn_rt_gemm(result_row, result_col, K, A, A_col, transposeA, B, B_col,
+              transposeB, result, result_col, ep);
 }
 
 void _sn_rt_batch_matmul_f32(float* C, const float* A, const float* B,
                              int64_t batches, int64_t A_row, int64_t A_col,
                              int64_t B_row, int64_t B_col, bool transposeA,
-                             bool transposeB) {
+                             bool transposeB, bool shared_B) {
   auto C_row = (transposeA ? A_col : A_row);
   auto C_col = (transposeB ? B_row : B_col);
+  auto K = (transposeA ? A_row : A_col);
   auto C_stride = C_row * C_col;
   auto A_stride = A_row * A_col;
-  auto B_stride = B_row * B_col;
+  auto B_stride = shared_B ? 0 : B_row * B_col;
+  _sn_rt_gemm_epilogue ep;
+  float* pb = static_cast<float*>(_sn_rt_aligned_alloc(
+      sizeof(float) * _sn_rt_gemm_packed_b_size(C_col, K)));
+  float* pa = static_cast<float*>(
+      _sn_rt_aligned_alloc(sizeof(float) * _sn_rt_gemm_mc * _sn_rt_gemm_kc));
   for (int64_t i = 0, offset_c = 0, offset_a = 0, offset_b = 0; i < batches;
        ++i, offset_c += C_stride, offset_a += A_stride, offset_b += B_stride) {
-    _sn_rt_matmul_f32(&C[offset_c], &A[offset_a], &B[offset_b], A_row, A_col,
-                      B_row, B_col, transposeA, transposeB);
+    // A shared rhs is packed only once for all batches.
+    if (i == 0 || !shared_B) {
+      _sn_rt_gemm_pack_b(pb, &B[offset_b], B_col, transposeB, C_col, K);
+    }
+    _sn_rt_gemm_packed(C_row, C_col, K, &A[offset_a], A_col, transposeA, pb,
+                       &C[offset_c], C_col, ep, pa);
   }
+  _sn_rt_aligned_free(pa);
+  _sn_rt_aligned_free(pb);
+}
 }
-}
\ No newline at end of file
@@ -0,0 +1,25 @@
+//===- minimum.cc ---------------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include <stdint.h>
+
+#include "elementwise.h"
+
+extern "C" {
+_SN_RT_DEFINE_BINARY(_sn_rt_minimum_f32, _sn_rt_op_minimum, float, float)
+_SN_RT_DEFINE_BINARY(_sn_rt_minimum_i32, _sn_rt_op_minimum, int32_t, int32_t)
+}
@@ -0,0 +1,86 @@
+//===- simd.h -------------------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#ifndef HALO_LIB_RUNTIME_GENERIC_MATH_SIMD_H_
+#define HALO_LIB_RUNTIME_GENERIC_MATH_SIMD_H_
+
+#include <stdint.h>
+
+#include <cstdlib>
+#include <cstring>
+
+// The runtime library is shipped as bitcode and its target attributes are
+// stripped before being linked into the generated module. Kernels therefore use
+// the generic vector extension instead of ISA specific intrinsics. LLVM lowers
+// 8 x float to one AVX register, or two SSE/NEON registers, depending on the
+// final target machine.
+typedef float _sn_rt_vf8 __attribute__((vector_size(32)));
+typedef int32_t _sn_rt_vi8 __attribute__((vector_size(32)));
+
+constexpr int64_t _sn_rt_vf8_lanes = 8;
+constexpr size_t _sn_rt_buffer_alignment = 64;
+
+static inline _sn_rt_vf8 _sn_rt_vf8_load(const float* src) {
+  _sn_rt_vf8 v;
+  __builtin_memcpy(&v, src, sizeof(v));
+  return v;
+}
+
+static inline void _sn_rt_vf8_store(float* dst, _sn_rt_vf8 v) {
+  __builtin_memcpy(dst, &v, sizeof(v));
+}
+
+static inline _sn_rt_vf8 _sn_rt_vf8_splat(float x) {
+  _sn_rt_vf8 v = {x, x, x, x, x, x, x, x};
+  return v;
+}
+
+/// Lane permutation of the concatenation of `a` and `b` (indices 0-15).
+#if defined(__clang__)
+#define _SN_RT_VF8_SHUFFLE(a, b, ...) __builtin_shufflevector(a, b, __VA_ARGS__)
+#else
+#define _SN_RT_VF8_SHUFFLE(a, b, ...) \
+  __builtin_shuffle(a, b, _sn_rt_vi8{__VA_ARGS__})
+#endif
+
+/// Lane-wise `mask ? a : b`. Vector ?: is not available to all the compilers
+/// building the runtime, so select with bitwise operations instead.
+static inline _sn_rt_vf8 _sn_rt_vf8_select(_sn_rt_vi8 mask, _sn_rt_vf8 a,
+                                           _sn_rt_vf8 b) {
+  return (_sn_rt_vf8)(((_sn_rt_vi8)a & mask) | ((_sn_rt_vi8)b & ~mask));
+}
+
+static inline _sn_rt_vf8 _sn_rt_vf8_min(_sn_rt_vf8 a, _sn_rt_vf8 b) {
+  return _sn_rt_vf8_select(a < b, a, b);
+}
+
+static inline _sn_rt_vf8 _sn_rt_vf8_max(_sn_rt_vf8 a, _sn_rt_vf8 b) {
+  return _sn_rt_vf8_select(a > b, a, b);
+}
+
+/// Allocates a heap buffer aligned to the cache line size. Kernels must never
+/// place tensor sized scratch buffers on the stack.
+static inline void* _sn_rt_aligned_alloc(size_t bytes) {
+  size_t size = (bytes + _sn_rt_buffer_alignment - 1) /
+                _sn_rt_buffer_alignment * _sn_rt_buffer_alignment;
+  return std::aligned_alloc(_sn_rt_buffer_alignment,
+                            size == 0 ? _sn_rt_buffer_alignment : size);
+}
+
+static inline void _sn_rt_aligned_free(void* ptr) { std::free(ptr); }
+
+#endif // HALO_LIB_RUNTIME_GENERIC_MATH_SIMD_H_
@@ -17,46 +17,341 @@
 
 #include <stdint.h>
 
+#include <algorithm>
 #include <cstring>
-#include <iostream>
-#include <numeric>
 
-extern "C" {
-/// A dummy implementation.
-void _sn_rt_transpose_f32(float* out, const float* data, const int* perm,
-                          const int64_t* orig_shape, int dims) {
-  int orig_strides[dims];
-  std::fill_n(&orig_strides[0], dims, 1);
-  for (int i = dims - 2; i >= 0; --i) {
-    orig_strides[i] = orig_strides[i + 1] * orig_shape[i + 1];
-  }
-  int64_t new_shape[dims];
-  int perm_strides[dims];
-  size_t elem_cnt = 1;
-  for (int i = 0; i < dims; ++i) {
-    new_shape[i] = orig_shape[perm[i]];
-    perm_strides[i] = orig_strides[perm[i]];
-    elem_cnt *= orig_shape[i];
-  }
-  int pos[dims];
-  std::fill_n(&pos[0], dims, 0);
-  const size_t elem_size = 4;
-  char* buf = reinterpret_cast<char*>(out); // NOLINT
-  for (size_t i = 0; i < elem_cnt; ++i) {
-    size_t offset =
-        std::inner_product(&pos[0], pos + dims, &perm_strides[0], 0UL);
-    const char* src =
-        reinterpret_cast<const char*>(data) + offset * elem_size; // NOLINT
-    std::memcpy(&buf[i * elem_size], src, elem_size);
-    int c = 1;
-    for (int i = dims - 1; i >= 0 && c == 1; --i) {
-      pos[i] += c;
-      if (pos[i] >= new_shape[i]) {
-        pos[i] = 0;
-      } else {
-        c = 0;
+#include "../common/parallel.h"
+#include "simd.h"
+
+// Transpose engine. The permutation is first simplified:
+//  - size 1 dimensions are dropped,
+//  - dimensions that stay adjacent and in order are merged,
+//  - if the innermost input dimension stays innermost, it is folded into the
+//    element size so whole contiguous runs are moved at once.
+// What remains is either a plain copy, or a batch of 2D transposes between the
+// innermost input dimension (read contiguously) and the innermost output
+// dimension (written contiguously), e.g. NCHW <-> NHWC becomes a batch of
+// [C x HW] transposes. The 2D transposes are cache blocked and use in-register
+// 8x8 tiles for 4 byte elements.
+
+constexpr int64_t _sn_rt_transpose_block = 64;
+
+// 2D transpose of an [na x nb] block: dst[b + a * ld_dst] = src[a + b * ld_src]
+// (in elements of `T`).
+template <typename T, int64_t tile>
+static void _sn_rt_transpose_2d(T* dst, const T* src, int64_t na, int64_t nb,
+                                int64_t ld_src, int64_t ld_dst) {
+  constexpr int64_t block = _sn_rt_transpose_block;
+  for (int64_t a0 = 0; a0 < na; a0 += block) {
+    int64_t a1 = std::min(na, a0 + block);
+    for (int64_t b0 = 0; b0 < nb; b0 += block) {
+      int64_t b1 = std::min(nb, b0 + block);
+      int64_t a = a0;
+      for (; a + tile <= a1; a += tile) {
+        int64_t b = b0;
+        for (; b + tile <= b1; b += tile) {
+          for (int64_t i = 0; i < tile; ++i) {
+            for (int64_t j = 0; j < tile; ++j) {
+              dst[b + j + (a + i) * ld_dst] = src[a + i + (b + j) * ld_src];
+            }
+          }
+        }
+        for (; b < b1; ++b) {
+          for (int64_t i = 0; i < tile; ++i) {
+            dst[b + (a + i) * ld_dst] = src[a + i + b * ld_src];
+          }
+        }
+      }
+      for (; a < a1; ++a) {
+        for (int64_t b = b0; b < b1; ++b) {
+          dst[b + a * ld_dst] = src[a + b * ld_src];
+        }
+      }
+    }
+  }
+}
+
+// Transposes the 8x8 tile of 4 byte elements at src (rows ld_src apart) into
+// dst (rows ld_dst apart) in registers.
+static inline void _sn_rt_transpose_8x8(float* dst, const float* src,
+                                        int64_t ld_src, int64_t ld_dst) {
+  _sn_rt_vf8 r0 = _sn_rt_vf8_load(src);
+  _sn_rt_vf8 r1 = _sn_rt_vf8_load(src + ld_src);
+  _sn_rt_vf8 r2 = _sn_rt_vf8_load(src + 2 * ld_src);
+  _sn_rt_vf8 r3 = _sn_rt_vf8_load(src + 3 * ld_src);
+  _sn_rt_vf8 r4 = _sn_rt_vf8_load(src + 4 * ld_src);
+  _sn_rt_vf8 r5 = _sn_rt_vf8_load(src + 5 * ld_src);
+  _sn_rt_vf8 r6 = _sn_rt_vf8_load(src + 6 * ld_src);
+  _sn_rt_vf8 r7 = _sn_rt_vf8_load(src + 7 * ld_src);
+  // Interleave pairs of rows.
+  _sn_rt_vf8 t0 = _SN_RT_VF8_SHUFFLE(r0, r1, 0, 8, 1, 9, 4, 12, 5, 13);
+  _sn_rt_vf8 t1 = _SN_RT_VF8_SHUFFLE(r0, r1, 2, 10, 3, 11, 6, 14, 7, 15);
+  _sn_rt_vf8 t2 = _SN_RT_VF8_SHUFFLE(r2, r3, 0, 8, 1, 9, 4, 12, 5, 13);
+  _sn_rt_vf8 t3 = _SN_RT_VF8_SHUFFLE(r2, r3, 2, 10, 3, 11, 6, 14, 7, 15);
+  _sn_rt_vf8 t4 = _SN_RT_VF8_SHUFFLE(r4, r5, 0, 8, 1, 9, 4, 12, 5, 13);
+  _sn_rt_vf8 t5 = _SN_RT_VF8_SHUFFLE(r4, r5, 2, 10, 3, 11, 6, 14, 7, 15);
+  _sn_rt_vf8 t6 = _SN_RT_VF8_SHUFFLE(r6, r7, 0, 8, 1, 9, 4, 12, 5, 13);
+  _sn_rt_vf8 t7 = _SN_RT_VF8_SHUFFLE(r6, r7, 2, 10, 3, 11, 6, 14, 7, 15);
+  // Interleave pairs of pairs.
+  _sn_rt_vf8 u0 = _SN_RT_VF8_SHUFFLE(t0, t2, 0, 1, 8, 9, 4, 5, 12, 13);
+  _sn_rt_vf8 u1 = _SN_RT_VF8_SHUFFLE(t0, t2, 2, 3, 10, 11, 6, 7, 14, 15);
+  _sn_rt_vf8 u2 = _SN_RT_VF8_SHUFFLE(t1, t3, 0, 1, 8, 9, 4, 5, 12, 13);
+  _sn_rt_vf8 u3 = _SN_RT_VF8_SHUFFLE(t1, t3, 2, 3, 10, 11, 6, 7, 14, 15);
+  _sn_rt_vf8 u4 = _SN_RT_VF8_SHUFFLE(t4, t6, 0, 1, 8, 9, 4, 5, 12, 13);
+  _sn_rt_vf8 u5 = _SN_RT_VF8_SHUFFLE(t4, t6, 2, 3, 10, 11, 6, 7, 14, 15);
+  _sn_rt_vf8 u6 = _SN_RT_VF8_SHUFFLE(t5, t7, 0, 1, 8, 9, 4, 5, 12, 13);
+  _sn_rt_vf8 u7 = _SN_RT_VF8_SHUFFLE(t5, t7, 2, 3, 10, 11, 6, 7, 14, 15);
+  // Swap the 128 bit halves.
+  _sn_rt_vf8_store(dst, _SN_RT_VF8_SHUFFLE(u0, u4, 0, 1, 2, 3, 8, 9, 10, 11));
+  _sn_rt_vf8_store(dst + ld_dst,
+                   _SN_RT_VF8_SHUFFLE(u1, u5, 0, 1, 2, 3, 8, 9, 10, 11));
+  _sn_rt_vf8_store(dst + 2 * ld_dst,
+                   _SN_RT_VF8_SHUFFLE(u2, u6, 0, 1, 2, 3, 8, 9, 10, 11));
+  _sn_rt_vf8_store(dst + 3 * ld_dst,
+                   _SN_RT_VF8_SHUFFLE(u3, u7, 0, 1, 2, 3, 8, 9, 10, 11));
+  _sn_rt_vf8_store(dst + 4 * ld_dst,
+                   _SN_RT_VF8_SHUFFLE(u0, u4, 4, 5, 6, 7, 12, 13, 14, 15));
+  _sn_rt_vf8_store(dst + 5 * ld_dst,
+                   _SN_RT_VF8_SHUFFLE(u1, u5, 4, 5, 6, 7, 12, 13, 14, 15));
+  _sn_rt_vf8_store(dst + 6 * ld_dst,
+                   _SN_RT_VF8_SHUFFLE(u2, u6, 4, 5, 6, 7, 12, 13, 14, 15));
+  _sn_rt_vf8_store(dst + 7 * ld_dst,
+                   _SN_RT_VF8_SHUFFLE(u3, u7, 4, 5, 6, 7, 12, 13, 14, 15));
+}
+
+// 4 byte elements: full 8x8 tiles go through registers. Tiles are copied
+// through `float` lanes without arithmetic, so integer bit patterns are kept.
+template <>
+void _sn_rt_transpose_2d<float, _sn_rt_vf8_lanes>(float* dst, const float* src,
+                                                  int64_t na, int64_t nb,
+                                                  int64_t ld_src,
+                                                  int64_t ld_dst) {
+  constexpr int64_t block = _sn_rt_transpose_block;
+  constexpr int64_t tile = _sn_rt_vf8_lanes;
+  for (int64_t a0 = 0; a0 < na; a0 += block) {
+    int64_t a1 = std::min(na, a0 + block);
+    for (int64_t b0 = 0; b0 < nb; b0 += block) {
+      int64_t b1 = std::min(nb, b0 + block);
+      int64_t a = a0;
+      for (; a + tile <= a1; a += tile) {
+        int64_t b = b0;
+        for (; b + tile <= b1; b += tile) {
+          _sn_rt_transpose_8x8(dst + b + a * ld_dst, src + a + b * ld_src,
+                               ld_src, ld_dst);
+        }
+        for (; b < b1; ++b) {
+          for (int64_t i = 0; i < tile; ++i) {
+            dst[b + (a + i) * ld_dst] = src[a + i + b * ld_src];
+          }
+        }
+      }
+      for (; a < a1; ++a) {
+        for (int64_t b = b0; b < b1; ++b) {
+          dst[b + a * ld_dst] = src[a + b * ld_src];
+        }
+      }
+    }
+  }
+}
+
+// Elements of any other size are moved with memcpy, still cache blocked.
+static void _sn_rt_transpose_2d_bytes(char* dst, const char* src, int64_t na,
+                                      int64_t nb, int64_t ld_src,
+                                      int64_t ld_dst, int64_t elem_size) {
+  constexpr int64_t block = _sn_rt_transpose_block;
+  for (int64_t a0 = 0; a0 < na; a0 += block) {
+    int64_t a1 = std::min(na, a0 + block);
+    for (int64_t b0 = 0; b0 < nb; b0 += block) {
+      int64_t b1 = std::min(nb, b0 + block);
+      for (int64_t a = a0; a < a1; ++a) {
+        for (int64_t b = b0; b < b1; ++b) {
+          std::memcpy(dst + (b + a * ld_dst) * elem_size,
+                      src + (a + b * ld_src) * elem_size, elem_size);
+        }
       }
     }
   }
 }
-}
\ No newline at end of file
+
+static void _sn_rt_transpose_2d_dispatch(void* dst, const void* src,
+                                         int64_t na, int64_t nb,
+                                         int64_t ld_src, int64_t ld_dst,
+                                         int64_t elem_size) {
+  switch (elem_size) {
+    case 1:
+      _sn_rt_transpose_2d<uint8_t, 16>(static_cast<uint8_t*>(dst),
+                                       static_cast<const uint8_t*>(src), na, nb,
+                                       ld_src, ld_dst);
+      break;
+    case 2:
+      _sn_rt_transpose_2d<uint16_t, 16>(static_cast<uint16_t*>(dst),
+                                        static_cast<const uint16_t*>(src), na,
+                                        nb, ld_src, ld_dst);
+      break;
+    case 4:
+      _sn_rt_transpose_2d<float, _sn_rt_vf8_lanes>(
+          static_cast<float*>(dst), static_cast<const float*>(src), na, nb,
+          ld_src, ld_dst);
+      break;
+    case 8:
+      _sn_rt_transpose_2d<uint64_t, 8>(static_cast<uint64_t*>(dst),
+                                       static_cast<const uint64_t*>(src), na,
+                                       nb, ld_src, ld_dst);
+      break;
+    default:
+      _sn_rt_transpose_2d_bytes(static_cast<char*>(dst),
+                                static_cast<const char*>(src), na, nb, ld_src,
+                                ld_dst, elem_size);
+  }
+}
+
+static void _sn_rt_transpose_impl(void* out, const void* data, const int* perm,
+                                  const int64_t* orig_shape, int dims,
+                                  int64_t elem_size) {
+  int64_t bytes = elem_size;
+  for (int i = 0; i < dims; ++i) {
+    bytes *= orig_shape[i];
+  }
+  if (bytes == 0) {
+    return;
+  }
+
+  // Drop size 1 dimensions; renumber the remaining input dimensions.
+  int64_t shape[dims];
+  int new_index[dims];
+  int rank = 0;
+  for (int i = 0; i < dims; ++i) {
+    new_index[i] = orig_shape[i] == 1 ? -1 : rank;
+    if (orig_shape[i] != 1) {
+      shape[rank++] = orig_shape[i];
+    }
+  }
+  int p[dims];
+  int n = 0;
+  for (int i = 0; i < dims; ++i) {
+    if (new_index[perm[i]] >= 0) {
+      p[n++] = new_index[perm[i]];
+    }
+  }
+
+  // Merge output dimensions that are consecutive input dimensions.
+  int64_t merged_shape[dims];
+  int merged_perm[dims];
+  int first_of[dims]; // input dim -> merged group leader.
+  int groups = 0;
+  for (int i = 0; i < n; ++i) {
+    if (i > 0 && p[i] == p[i - 1] + 1) {
+      first_of[p[i]] = -1;
+      continue;
+    }
+    first_of[p[i]] = groups;
+    merged_perm[groups++] = p[i];
+  }
+  // Renumber merged groups in input order and compute their sizes.
+  int order[dims];
+  int r = 0;
+  for (int d = 0; d < rank; ++d) {
+    if (first_of[d] >= 0) {
+      order[first_of[d]] = r;
+      merged_shape[r] = shape[d];
+      ++r;
+    } else {
+      merged_shape[r - 1] *= shape[d];
+    }
+  }
+  for (int i = 0; i < groups; ++i) {
+    merged_perm[i] = order[i];
+  }
+
+  // A preserved innermost dimension becomes part of the element.
+  if (r > 0 && merged_perm[r - 1] == r - 1) {
+    elem_size *= merged_shape[r - 1];
+    --r;
+  }
+  if (r <= 1) {
+    std::memcpy(out, data, bytes);
+    return;
+  }
+
+  // Input strides (in elements) of the merged dimensions.
+  int64_t in_strides[dims];
+  in_strides[r - 1] = 1;
+  for (int i = r - 2; i >= 0; --i) {
+    in_strides[i] = in_strides[i + 1] * merged_shape[i + 1];
+  }
+  // Output strides, indexed by output position.
+  int64_t out_strides[dims];
+  out_strides[r - 1] = 1;
+  for (int i = r - 2; i >= 0; --i) {
+    out_strides[i] = out_strides[i + 1] * merged_shape[merged_perm[i + 1]];
+  }
+
+  // The 2D kernel walks input dim `r - 1` (contiguous in the input) and the
+  // input dim written innermost in the output. All others form the batch.
+  int inner_out = merged_perm[r - 1];
+  int pos_of_inner_in = 0; // output position of input dim r - 1.
+  for (int i = 0; i < r; ++i) {
+    if (merged_perm[i] == r - 1) {
+      pos_of_inner_in = i;
+    }
+  }
+  const int64_t na = merged_shape[r - 1];
+  const int64_t nb = merged_shape[inner_out];
+  const int64_t ld_src = in_strides[inner_out];
+  const int64_t ld_dst = out_strides[pos_of_inner_in];
+
+  int64_t batch_count[dims];
+  int64_t batch_src[dims];
+  int64_t batch_dst[dims];
+  int nbatch = 0;
+  for (int i = 0; i < r; ++i) {
+    if (i == pos_of_inner_in || i == r - 1) {
+      continue;
+    }
+    batch_count[nbatch] = merged_shape[merged_perm[i]];
+    batch_src[nbatch] = in_strides[merged_perm[i]];
+    batch_dst[nbatch] = out_strides[i];
+    ++nbatch;
+  }
+
+  // Tasks are blocks of rows of the 2D transposes: each one covers up to
+  // `_sn_rt_transpose_block` values of `a` of a single batch entry.
+  int64_t batches = 1;
+  for (int i = 0; i < nbatch; ++i) {
+    batches *= batch_count[i];
+  }
+  const int64_t a_blocks =
+      (na + _sn_rt_transpose_block - 1) / _sn_rt_transpose_block;
+  const int64_t* counts = batch_count;
+  const int64_t* src_strides = batch_src;
+  const int64_t* dst_strides = batch_dst;
+  const char* src = static_cast<const char*>(data);
+  char* dst = static_cast<char*>(out);
+  auto run_blocks = [&](int64_t begin, int64_t end) {
+    for (int64_t t = begin; t < end; ++t) {
+      int64_t a0 = t % a_blocks * _sn_rt_transpose_block;
+      int64_t src_off = a0;
+      int64_t dst_off = a0 * ld_dst;
+      for (int64_t i = nbatch - 1, pos = t / a_blocks; i >= 0; --i) {
+        src_off += pos % counts[i] * src_strides[i];
+        dst_off += pos % counts[i] * dst_strides[i];
+        pos /= counts[i];
+      }
+      _sn_rt_transpose_2d_dispatch(
+          dst + dst_off * elem_size, src + src_off * elem_size,
+          std::min(_sn_rt_transpose_block, na - a0), nb, ld_src, ld_dst,
+          elem_size);
+    }
+  };
+  _sn_rt_parallel_for(batches * a_blocks, _sn_rt_transpose_block * nb,
+                      run_blocks);
+}
+
+extern "C" {
+/// Transposes a `dims`-D tensor of `elem_size` byte elements. out[i0, ...] is
+/// data[...] with output dimension `i` being input dimension `perm[i]`.
+void _sn_rt_transpose(void* out, const void* data, const int* perm,
+                      const int64_t* orig_shape, int dims, int64_t elem_size) {
+  _sn_rt_transpose_impl(out, data, perm, orig_shape, dims, elem_size);
+}
+}
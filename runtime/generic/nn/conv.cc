@@ -17,92 +17,487 @@
 
 #include <stdint.h>
 
-#include <limits>
+#include <algorithm>
 
-#include "utils.h"
+#include "../math/gemm.h"
 
-extern "C" {
-/// conv2d helper
-void _sn_rt_conv2d_f32_helper(
-    float* output, const float* data, const float* kernel, int64_t batch,
-    int64_t spatial_h, int64_t spatial_w, int64_t channel, int64_t output_h,
-    int64_t output_w, int64_t output_channel, int64_t kernel_h,
-    int64_t kernel_w, int64_t stride_h, int64_t stride_w, int64_t pad_top,
-    int64_t pad_bottom, int64_t pad_left, int64_t pad_right, bool is_nchw) {
-  int64_t b, c, i, j, m, n, k;
-  int64_t h_offset = -pad_top;
-  int64_t w_offset = -pad_left;
-  const float lattic = 0;
-  for (b = 0; b < batch; ++b) {
-    for (c = 0; c < output_channel; ++c) {
-      for (i = 0; i < output_h; ++i) {
-        for (j = 0; j < output_w; ++j) {
-          // auto o_index =
-          //    c + (j + (i + b * output_h) * output_w) * output_channel;
-          auto o_index =
-              is_nchw ? _sn_rt_flatten_index_calculation(
-                            b, c, i, j, output_channel, output_h, output_w)
-                      : _sn_rt_flatten_index_calculation(
-                            b, i, j, c, output_h, output_w, output_channel);
-          float sum = 0;
-          for (m = 0; m < kernel_h; ++m) {
-            for (n = 0; n < kernel_w; ++n) {
-              for (k = 0; k < channel; ++k) {
-                auto curr_h = h_offset + i * stride_h + m;
-                auto curr_w = w_offset + j * stride_w + n;
-                // auto in_index =
-                //    k +
-                //    (curr_w + (curr_h + b * spatial_h) * spatial_w) * channel;
-                auto in_index = is_nchw ? _sn_rt_flatten_index_calculation(
-                                              b, k, curr_h, curr_w, channel,
-                                              spatial_h, spatial_w)
-                                        : _sn_rt_flatten_index_calculation(
-                                              b, curr_h, curr_w, k, spatial_h,
-                                              spatial_w, channel);
-                auto k_index =
-                    is_nchw ?
-                            // oihw
-                        _sn_rt_flatten_index_calculation(c, k, m, n, channel,
-                                                         kernel_h, kernel_w)
-                            :
-                            // hwio
-                        _sn_rt_flatten_index_calculation(
-                            m, n, k, c, kernel_w, channel, output_channel);
-                bool valid = curr_h >= 0 && curr_h < spatial_h && curr_w >= 0 &&
-                             curr_w < spatial_w;
-                auto value = valid ? data[in_index] : lattic;
-                sum += value * kernel[k_index];
+// Convolutions are lowered to the packed GEMM engine without materializing an
+// im2col buffer:
+//  - NHWC (HWIO filter): C[pixels x oc] = patches[pixels x kh*kw*ic] * W. The
+//    patch matrix is packed through an indirection buffer that maps every
+//    (pixel, tap) to an input row of `ic` contiguous floats, or to a zero row
+//    for padded taps.
+//  - NCHW (OIHW filter): C[oc x pixels] = W[oc x ic*kh*kw] * patches. The patch
+//    panels are gathered block by block; runs that stay inside the image are
+//    copied without bounds checks and only border runs take the slow path.
+//  - 1x1 convolutions with unit stride and no padding are plain GEMMs.
+// Grouped convolutions run one GEMM per group over a channel slice of the
+// data, filter and output. Depthwise convolutions (one input channel per
+// group) have too little reduction depth for a GEMM and use direct kernels
+// that vectorize over channels (NHWC) or output pixels (NCHW) instead.
+// Bias and clipping activations are fused into the output stores.
+
+struct _sn_rt_conv2d_params {
+  int64_t batch;
+  int64_t spatial_h;
+  int64_t spatial_w;
+  int64_t channel;
+  int64_t output_h;
+  int64_t output_w;
+  int64_t output_channel;
+  int64_t kernel_h;
+  int64_t kernel_w;
+  int64_t stride_h;
+  int64_t stride_w;
+  int64_t dilation_h;
+  int64_t dilation_w;
+  int64_t pad_top;
+  int64_t pad_left;
+  int64_t group;
+
+  bool IsPointwise() const {
+    return kernel_h == 1 && kernel_w == 1 && stride_h == 1 && stride_w == 1 &&
+           pad_top == 0 && pad_left == 0 && output_h == spatial_h &&
+           output_w == spatial_w;
+  }
+
+  bool IsDepthwise() const { return group > 1 && group == channel; }
+};
+
+// Output range [lo, hi) whose taps all fall inside the input along one axis.
+static inline void _sn_rt_conv2d_interior(int64_t in, int64_t out, int64_t k,
+                                          int64_t stride, int64_t dilation,
+                                          int64_t pad, int64_t* lo,
+                                          int64_t* hi) {
+  *lo = std::min(out, (pad + stride - 1) / stride);
+  int64_t last = in + pad - (k - 1) * dilation - 1; // largest valid o*stride.
+  *hi = last < 0 ? 0 : std::min(out, last / stride + 1);
+  *hi = std::max(*hi, *lo);
+}
+
+// Rounds a / b towards positive infinity for b > 0.
+static inline int64_t _sn_rt_ceil_div(int64_t a, int64_t b) {
+  return a >= 0 ? (a + b - 1) / b : -(-a / b);
+}
+
+// Range [lo, hi) of `x` such that 0 <= base + x * step < in, clamped to
+// [0, count).
+static inline void _sn_rt_conv2d_valid_range(int64_t base, int64_t step,
+                                             int64_t in, int64_t count,
+                                             int64_t* lo, int64_t* hi) {
+  *lo = std::min(count, std::max<int64_t>(0, _sn_rt_ceil_div(-base, step)));
+  *hi = std::min(count, _sn_rt_ceil_div(in - base, step));
+  *hi = std::max(*hi, *lo);
+}
+
+// Epilogue of one group: per-channel bias is offset to the group's slice.
+static inline _sn_rt_gemm_epilogue _sn_rt_conv2d_group_epilogue(
+    const _sn_rt_gemm_epilogue& ep, int64_t offset) {
+  _sn_rt_gemm_epilogue ret = ep;
+  if (ep.mode == _sn_rt_gemm_bias_mode::ROW ||
+      ep.mode == _sn_rt_gemm_bias_mode::COL) {
+    ret.bias += offset;
+  }
+  return ret;
+}
+
+static void _sn_rt_conv2d_f32_nhwc_impl(const _sn_rt_conv2d_params& p,
+                                        float* output, const float* data,
+                                        const float* kernel,
+                                        const _sn_rt_gemm_epilogue& ep) {
+  const int64_t ic = p.channel;
+  const int64_t oc = p.output_channel;
+  const int64_t ic_g = ic / p.group;
+  const int64_t oc_g = oc / p.group;
+  if (p.IsPointwise()) {
+    for (int64_t g = 0; g < p.group; ++g) {
+      _sn_rt_gemm(p.batch * p.spatial_h * p.spatial_w, oc_g, ic_g,
+                  data + g * ic_g, ic, false, kernel + g * oc_g, oc, false,
+                  output + g * oc_g, oc,
+                  _sn_rt_conv2d_group_epilogue(ep, g * oc_g));
+    }
+    return;
+  }
+
+  const int64_t taps = p.kernel_h * p.kernel_w;
+  const int64_t pixels = p.output_h * p.output_w;
+  const int64_t k = taps * ic_g;
+
+  // Indirection buffer: input offset of each (pixel, tap), -1 for padding.
+  int64_t* indirection =
+      static_cast<int64_t*>(_sn_rt_aligned_alloc(sizeof(int64_t) * pixels * taps));
+  int64_t h_lo, h_hi, w_lo, w_hi;
+  _sn_rt_conv2d_interior(p.spatial_h, p.output_h, p.kernel_h, p.stride_h,
+                         p.dilation_h, p.pad_top, &h_lo, &h_hi);
+  _sn_rt_conv2d_interior(p.spatial_w, p.output_w, p.kernel_w, p.stride_w,
+                         p.dilation_w, p.pad_left, &w_lo, &w_hi);
+  for (int64_t oh = 0; oh < p.output_h; ++oh) {
+    for (int64_t ow = 0; ow < p.output_w; ++ow) {
+      int64_t* ind = indirection + (oh * p.output_w + ow) * taps;
+      int64_t ih0 = oh * p.stride_h - p.pad_top;
+      int64_t iw0 = ow * p.stride_w - p.pad_left;
+      bool interior = oh >= h_lo && oh < h_hi && ow >= w_lo && ow < w_hi;
+      for (int64_t m = 0; m < p.kernel_h; ++m) {
+        int64_t ih = ih0 + m * p.dilation_h;
+        for (int64_t n = 0; n < p.kernel_w; ++n) {
+          int64_t iw = iw0 + n * p.dilation_w;
+          bool valid = interior || (ih >= 0 && ih < p.spatial_h && iw >= 0 &&
+                                    iw < p.spatial_w);
+          *ind++ = valid ? (ih * p.spatial_w + iw) * ic : -1;
+        }
+      }
+    }
+  }
+
+  float* zeros =
+      static_cast<float*>(_sn_rt_aligned_alloc(sizeof(float) * ic_g));
+  std::fill_n(zeros, ic_g, 0.0F);
+  // Grouped HWIO filter is [kh*kw*ic_g x oc]; each group is a column slice.
+  const int64_t packed_size = _sn_rt_gemm_packed_b_size(oc_g, k);
+  float* pb = static_cast<float*>(
+      _sn_rt_aligned_alloc(sizeof(float) * packed_size * p.group));
+  float* pa = static_cast<float*>(
+      _sn_rt_aligned_alloc(sizeof(float) * _sn_rt_gemm_mc * _sn_rt_gemm_kc));
+  for (int64_t g = 0; g < p.group; ++g) {
+    _sn_rt_gemm_pack_b(pb + g * packed_size, kernel + g * oc_g, oc, false,
+                       oc_g, k);
+  }
+
+  const int64_t in_size = p.spatial_h * p.spatial_w * ic;
+  for (int64_t b = 0; b < p.batch; ++b) {
+    for (int64_t g = 0; g < p.group; ++g) {
+      const float* image = data + b * in_size + g * ic_g;
+      auto pack_a = [&](float* dst, int64_t i0, int64_t k0, int64_t mc,
+                        int64_t kc) {
+        constexpr int64_t mr = _sn_rt_gemm_mr;
+        for (int64_t r0 = 0; r0 < mc; r0 += mr, dst += mr * kc) {
+          for (int64_t r = 0; r < mr; ++r) {
+            if (r0 + r >= mc) {
+              for (int64_t kk = 0; kk < kc; ++kk) {
+                dst[kk * mr + r] = 0;
+              }
+              continue;
+            }
+            const int64_t* ind = indirection + (i0 + r0 + r) * taps;
+            int64_t tap = k0 / ic_g;
+            int64_t c = k0 % ic_g;
+            for (int64_t kk = 0; kk < kc; ++tap, c = 0) {
+              const float* src = ind[tap] < 0 ? zeros : image + ind[tap];
+              int64_t run = std::min(ic_g - c, kc - kk);
+              for (int64_t t = 0; t < run; ++t) {
+                dst[(kk + t) * mr + r] = src[c + t];
+              }
+              kk += run;
+            }
+          }
+        }
+      };
+      const float* group_pb = pb + g * packed_size;
+      auto pack_b = [group_pb, k](int64_t j0, int64_t k0, int64_t /*nc*/,
+                                  int64_t /*kc*/, int64_t* panel_stride) {
+        *panel_stride = k * _sn_rt_gemm_nr;
+        return group_pb + j0 * k + k0 * _sn_rt_gemm_nr;
+      };
+      _sn_rt_gemm_blocked(pixels, oc_g, k, pack_a, pack_b,
+                          output + b * pixels * oc + g * oc_g, oc,
+                          _sn_rt_conv2d_group_epilogue(ep, g * oc_g), pa,
+                          oc_g);
+    }
+  }
+
+  _sn_rt_aligned_free(pa);
+  _sn_rt_aligned_free(pb);
+  _sn_rt_aligned_free(zeros);
+  _sn_rt_aligned_free(indirection);
+}
+
+static void _sn_rt_conv2d_f32_nchw_impl(const _sn_rt_conv2d_params& p,
+                                        float* output, const float* data,
+                                        const float* kernel,
+                                        const _sn_rt_gemm_epilogue& ep) {
+  const int64_t ic = p.channel;
+  const int64_t oc = p.output_channel;
+  const int64_t ic_g = ic / p.group;
+  const int64_t oc_g = oc / p.group;
+  const int64_t in_plane = p.spatial_h * p.spatial_w;
+  const int64_t pixels = p.output_h * p.output_w;
+  const int64_t in_size = ic * in_plane;
+  if (p.IsPointwise()) {
+    for (int64_t b = 0; b < p.batch; ++b) {
+      for (int64_t g = 0; g < p.group; ++g) {
+        _sn_rt_gemm(oc_g, pixels, ic_g, kernel + g * oc_g * ic_g, ic_g, false,
+                    data + b * in_size + g * ic_g * in_plane, pixels, false,
+                    output + (b * oc + g * oc_g) * pixels, pixels,
+                    _sn_rt_conv2d_group_epilogue(ep, g * oc_g));
+      }
+    }
+    return;
+  }
+
+  constexpr int64_t nr = _sn_rt_gemm_nr;
+  constexpr int64_t nc_block = 32 * nr;
+  const int64_t taps = p.kernel_h * p.kernel_w;
+  const int64_t k = ic_g * taps;
+  float* pa = static_cast<float*>(
+      _sn_rt_aligned_alloc(sizeof(float) * _sn_rt_gemm_mc * _sn_rt_gemm_kc));
+  float* pb = static_cast<float*>(
+      _sn_rt_aligned_alloc(sizeof(float) * nc_block * _sn_rt_gemm_kc));
+
+  for (int64_t b = 0; b < p.batch; ++b) {
+    for (int64_t g = 0; g < p.group; ++g) {
+      // OIHW filter of a group is the row-major [oc_g x ic_g*kh*kw] lhs.
+      const float* group_kernel = kernel + g * oc_g * k;
+      auto pack_a = [group_kernel, k](float* dst, int64_t i0, int64_t k0,
+                                      int64_t mc, int64_t kc) {
+        _sn_rt_gemm_pack_a(dst, group_kernel, k, false, i0, k0, mc, kc);
+      };
+      const float* image = data + b * in_size + g * ic_g * in_plane;
+      auto pack_b = [&](int64_t j0, int64_t k0, int64_t nc, int64_t kc,
+                        int64_t* panel_stride) {
+        *panel_stride = kc * nr;
+        for (int64_t q = 0; q < nc; q += nr) {
+          float* panel = pb + q / nr * kc * nr;
+          int64_t cols = std::min(nr, nc - q);
+          int64_t pix = j0 + q;
+          int64_t c = k0 / taps;
+          int64_t m = k0 % taps / p.kernel_w;
+          int64_t n = k0 % p.kernel_w;
+          for (int64_t kk = 0; kk < kc; ++kk) {
+            float* dst = panel + kk * nr;
+            const float* plane = image + c * in_plane;
+            // Split the panel into runs of pixels within one output row. Runs
+            // that stay inside the image are copied without bounds checks.
+            for (int64_t j = 0; j < cols;) {
+              int64_t oh = (pix + j) / p.output_w;
+              int64_t ow = (pix + j) % p.output_w;
+              int64_t run = std::min(cols - j, p.output_w - ow);
+              int64_t ih = oh * p.stride_h - p.pad_top + m * p.dilation_h;
+              int64_t iw = ow * p.stride_w - p.pad_left + n * p.dilation_w;
+              int64_t iw_last = iw + (run - 1) * p.stride_w;
+              if (ih < 0 || ih >= p.spatial_h) {
+                std::fill_n(dst + j, run, 0.0F);
+              } else if (iw >= 0 && iw_last < p.spatial_w) {
+                const float* src = plane + ih * p.spatial_w + iw;
+                for (int64_t t = 0; t < run; ++t) {
+                  dst[j + t] = src[t * p.stride_w];
+                }
+              } else {
+                const float* src = plane + ih * p.spatial_w;
+                for (int64_t t = 0; t < run; ++t) {
+                  int64_t x = iw + t * p.stride_w;
+                  dst[j + t] = (x >= 0 && x < p.spatial_w) ? src[x] : 0;
+                }
+              }
+              j += run;
+            }
+            for (int64_t j = cols; j < nr; ++j) {
+              dst[j] = 0;
+            }
+            if (++n == p.kernel_w) {
+              n = 0;
+              if (++m == p.kernel_h) {
+                m = 0;
+                ++c;
               }
             }
           }
-          output[o_index] = sum;
+        }
+        return static_cast<const float*>(pb);
+      };
+      _sn_rt_gemm_blocked(oc_g, pixels, k, pack_a, pack_b,
+                          output + (b * oc + g * oc_g) * pixels, pixels,
+                          _sn_rt_conv2d_group_epilogue(ep, g * oc_g), pa,
+                          nc_block);
+    }
+  }
+
+  _sn_rt_aligned_free(pb);
+  _sn_rt_aligned_free(pa);
+}
+
+// Depthwise NHWC with an [kh][kw][1][oc] filter, oc = ic * multiplier. Each
+// output pixel accumulates over its valid taps only, in registers, 8 channels
+// at a time.
+static void _sn_rt_depthwise_conv2d_f32_nhwc_impl(
+    const _sn_rt_conv2d_params& p, float* output, const float* data,
+    const float* kernel, const float* bias, float clip_min, float clip_max) {
+  constexpr int64_t lanes = _sn_rt_vf8_lanes;
+  const int64_t ic = p.channel;
+  const int64_t oc = p.output_channel;
+  const int64_t multiplier = oc / ic;
+  const int64_t vec_end = multiplier == 1 ? oc / lanes * lanes : 0;
+  const _sn_rt_vf8 v_min = _sn_rt_vf8_splat(clip_min);
+  const _sn_rt_vf8 v_max = _sn_rt_vf8_splat(clip_max);
+
+  const int64_t taps = p.kernel_h * p.kernel_w;
+  auto run_rows = [&](int64_t begin, int64_t end) {
+    for (int64_t row = begin; row < end; ++row) {
+      int64_t b = row / p.output_h;
+      int64_t oh = row % p.output_h;
+      const float* image = data + b * p.spatial_h * p.spatial_w * ic;
+      int64_t ih0 = oh * p.stride_h - p.pad_top;
+      int64_t m_lo, m_hi;
+      _sn_rt_conv2d_valid_range(ih0, p.dilation_h, p.spatial_h, p.kernel_h,
+                                &m_lo, &m_hi);
+      for (int64_t ow = 0; ow < p.output_w; ++ow) {
+        int64_t iw0 = ow * p.stride_w - p.pad_left;
+        int64_t n_lo, n_hi;
+        _sn_rt_conv2d_valid_range(iw0, p.dilation_w, p.spatial_w, p.kernel_w,
+                                  &n_lo, &n_hi);
+        float* dst = output + ((b * p.output_h + oh) * p.output_w + ow) * oc;
+        for (int64_t c = 0; c < vec_end; c += lanes) {
+          _sn_rt_vf8 acc = bias == nullptr ? _sn_rt_vf8_splat(0)
+                                           : _sn_rt_vf8_load(bias + c);
+          for (int64_t m = m_lo; m < m_hi; ++m) {
+            int64_t ih = ih0 + m * p.dilation_h;
+            for (int64_t n = n_lo; n < n_hi; ++n) {
+              int64_t iw = iw0 + n * p.dilation_w;
+              acc += _sn_rt_vf8_load(image + (ih * p.spatial_w + iw) * ic + c) *
+                     _sn_rt_vf8_load(kernel + (m * p.kernel_w + n) * oc + c);
+            }
+          }
+          acc = _sn_rt_vf8_min(_sn_rt_vf8_max(acc, v_min), v_max);
+          _sn_rt_vf8_store(dst + c, acc);
+        }
+        for (int64_t o = vec_end; o < oc; ++o) {
+          float acc = bias == nullptr ? 0 : bias[o];
+          for (int64_t m = m_lo; m < m_hi; ++m) {
+            int64_t ih = ih0 + m * p.dilation_h;
+            for (int64_t n = n_lo; n < n_hi; ++n) {
+              int64_t iw = iw0 + n * p.dilation_w;
+              acc += image[(ih * p.spatial_w + iw) * ic + o / multiplier] *
+                     kernel[(m * p.kernel_w + n) * oc + o];
+            }
+          }
+          dst[o] = _sn_rt_clip(acc, clip_min, clip_max);
+        }
+      }
+    }
+  };
+  _sn_rt_parallel_for(p.batch * p.output_h, p.output_w * oc * taps, run_rows);
+}
+
+// Depthwise NCHW with an [oc][1][kh][kw] filter, oc = ic * multiplier. Each
+// output row is accumulated tap by tap over the range of output columns whose
+// input stays inside the image, so the inner loop is a bounds-check free
+// multiply-add along the row.
+static void _sn_rt_depthwise_conv2d_f32_nchw_impl(
+    const _sn_rt_conv2d_params& p, float* output, const float* data,
+    const float* kernel, const float* bias, float clip_min, float clip_max) {
+  const int64_t ic = p.channel;
+  const int64_t oc = p.output_channel;
+  const int64_t multiplier = oc / ic;
+  const int64_t in_plane = p.spatial_h * p.spatial_w;
+  const int64_t out_plane = p.output_h * p.output_w;
+  const int64_t taps = p.kernel_h * p.kernel_w;
+
+  auto run_planes = [&](int64_t begin, int64_t end) {
+    for (int64_t bo = begin; bo < end; ++bo) {
+      int64_t b = bo / oc;
+      int64_t o = bo % oc;
+      const float* plane = data + (b * ic + o / multiplier) * in_plane;
+      const float* k = kernel + o * taps;
+      float* dst_plane = output + (b * oc + o) * out_plane;
+      float init = bias == nullptr ? 0 : bias[o];
+      for (int64_t oh = 0; oh < p.output_h; ++oh) {
+        float* dst = dst_plane + oh * p.output_w;
+        std::fill_n(dst, p.output_w, init);
+        int64_t ih0 = oh * p.stride_h - p.pad_top;
+        int64_t m_lo, m_hi;
+        _sn_rt_conv2d_valid_range(ih0, p.dilation_h, p.spatial_h, p.kernel_h,
+                                  &m_lo, &m_hi);
+        for (int64_t m = m_lo; m < m_hi; ++m) {
+          const float* src_row =
+              plane + (ih0 + m * p.dilation_h) * p.spatial_w;
+          for (int64_t n = 0; n < p.kernel_w; ++n) {
+            float kv = k[m * p.kernel_w + n];
+            int64_t offset = n * p.dilation_w - p.pad_left;
+            int64_t ow_lo, ow_hi;
+            _sn_rt_conv2d_valid_range(offset, p.stride_w, p.spatial_w,
+                                      p.output_w, &ow_lo, &ow_hi);
+            const float* src = src_row + offset;
+            if (p.stride_w == 1) {
+              for (int64_t ow = ow_lo; ow < ow_hi; ++ow) {
+                dst[ow] += kv * src[ow];
+              }
+            } else {
+              for (int64_t ow = ow_lo; ow < ow_hi; ++ow) {
+                dst[ow] += kv * src[ow * p.stride_w];
+              }
+            }
+          }
+        }
+        for (int64_t ow = 0; ow < p.output_w; ++ow) {
+          dst[ow] = _sn_rt_clip(dst[ow], clip_min, clip_max);
         }
       }
     }
+  };
+  _sn_rt_parallel_for(p.batch * oc, out_plane * taps, run_planes);
+}
+
+static inline _sn_rt_gemm_epilogue _sn_rt_conv2d_epilogue(
+    const float* bias, _sn_rt_gemm_bias_mode mode, float clip_min,
+    float clip_max) {
+  _sn_rt_gemm_epilogue ep;
+  if (bias != nullptr) {
+    ep.bias = bias;
+    ep.mode = mode;
   }
+  ep.clip_min = clip_min;
+  ep.clip_max = clip_max;
+  return ep;
 }
 
+extern "C" {
+// `bias` holds `output_channel` values or is null. `group` splits the input and
+// output channels into independent convolutions; the filter input dimension is
+// `channel / group`. Results are clipped to [clip_min, clip_max]. The bottom and
+// right padding, which follow from the output size, are kept for the signature
+// shared with the other runtimes.
 void _sn_rt_conv2d_f32_nhwc(
-    float* output, const float* data, const float* kernel, int64_t batch,
-    int64_t spatial_h, int64_t spatial_w, int64_t channel, int64_t output_h,
-    int64_t output_w, int64_t output_channel, int64_t kernel_h,
-    int64_t kernel_w, int64_t stride_h, int64_t stride_w, int64_t pad_top,
-    int64_t pad_bottom, int64_t pad_left, int64_t pad_right) {
-  return _sn_rt_conv2d_f32_helper(
-      output, data, kernel, batch, spatial_h, spatial_w, channel, output_h,
-      output_w, output_channel, kernel_h, kernel_w, stride_h, stride_w, pad_top,
-      pad_bottom, pad_left, pad_right, false /*is_nhwc*/);
+    float* output, const float* data, const float* kernel, const float* bias,
+    int64_t batch, int64_t spatial_h, int64_t spatial_w, int64_t channel,
+    int64_t output_h, int64_t output_w, int64_t output_channel,
+    int64_t kernel_h, int64_t kernel_w, int64_t stride_h, int64_t stride_w,
+    int64_t dilation_h, int64_t dilation_w, int64_t pad_top,
+    int64_t /*pad_bottom*/, int64_t pad_left, int64_t /*pad_right*/,
+    int64_t group, float clip_min, float clip_max) {
+  _sn_rt_conv2d_params params{batch,      spatial_h, spatial_w,      channel,
+                              output_h,   output_w,  output_channel, kernel_h,
+                              kernel_w,   stride_h,  stride_w,       dilation_h,
+                              dilation_w, pad_top,   pad_left,       group};
+  if (params.IsDepthwise()) {
+    _sn_rt_depthwise_conv2d_f32_nhwc_impl(params, output, data, kernel, bias,
+                                          clip_min, clip_max);
+    return;
+  }
+  _sn_rt_conv2d_f32_nhwc_impl(
+      params, output, data, kernel,
+      _sn_rt_conv2d_epilogue(bias, _sn_rt_gemm_bias_mode::COL, clip_min,
+                             clip_max));
 }
 
 void _sn_rt_conv2d_f32_nchw(
-    float* output, const float* data, const float* kernel, int64_t batch,
-    int64_t spatial_h, int64_t spatial_w, int64_t channel, int64_t output_h,
-    int64_t output_w, int64_t output_channel, int64_t kernel_h,
-    int64_t kernel_w, int64_t stride_h, int64_t stride_w, int64_t pad_top,
-    int64_t pad_bottom, int64_t pad_left, int64_t pad_right) {
-  return _sn_rt_conv2d_f32_helper(
-      output, data, kernel, batch, spatial_h, spatial_w, channel, output_h,
-      output_w, output_channel, kernel_h, kernel_w, stride_h, stride_w, pad_top,
-      pad_bottom, pad_left, pad_right, true /*is_nhwc*/);
+    float* output, const float* data, const float* kernel, const float* bias,
+    int64_t batch, int64_t spatial_h, int64_t spatial_w, int64_t channel,
+    int64_t output_h, int64_t output_w, int64_t output_channel,
+    int64_t kernel_h, int64_t kernel_w, int64_t stride_h, int64_t stride_w,
+    int64_t dilation_h, int64_t dilation_w, int64_t pad_top,
+    int64_t /*pad_bottom*/, int64_t pad_left, int64_t /*pad_right*/,
+    int64_t group, float clip_min, float clip_max) {
+  _sn_rt_conv2d_params params{batch,      spatial_h, spatial_w,      channel,
+                              output_h,   output_w,  output_channel, kernel_h,
+                              kernel_w,   stride_h,  stride_w,       dilation_h,
+                              dilation_w, pad_top,   pad_left,       group};
+  if (params.IsDepthwise()) {
+    _sn_rt_depthwise_conv2d_f32_nchw_impl(params, output, data, kernel, bias,
+                                          clip_min, clip_max);
+    return;
+  }
+  _sn_rt_conv2d_f32_nchw_impl(
+      params, output, data, kernel,
+      _sn_rt_conv2d_epilogue(bias, _sn_rt_gemm_bias_mode::ROW, clip_min,
+                             clip_max));
+}
 }
-}
\ No newline at end of file
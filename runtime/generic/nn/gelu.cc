@@ -0,0 +1,30 @@
+//===- gelu.cc ------------------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#include <stdint.h>
+
+#include "../math/vmath.h"
+
+extern "C" {
+/// gelu with fp32: x * 0.5 * (1 + erf(x / sqrt(2))). `out` may be `lhs`.
+void _sn_rt_gelu_f32(float* out, const float* lhs, int64_t lhs_size) {
+  _sn_rt_vf8_map(out, lhs, lhs_size, [](_sn_rt_vf8 x) {
+    return x * 0.5F * (1.0F + _sn_rt_vf8_erf(x * 0.70710678F));
+  });
+}
+}
@@ -17,79 +17,375 @@
 
 #include <stdint.h>
 
+#include <algorithm>
 #include <limits>
 
-#include "utils.h"
+#include "../common/parallel.h"
+#include "../math/simd.h"
 
-extern "C" {
-/// pooling max helper func
-/// general implementation for both nchw and nhwc format.
-void _sn_rt_poolingmax_f32_helper(
-    float* output, const float* data, int64_t batch, int64_t spatial_h,
-    int64_t spatial_w, int64_t channel, int64_t output_h, int64_t output_w,
-    int64_t kernel_h, int64_t kernel_w, int64_t stride_h, int64_t stride_w,
-    int64_t pad_top, int64_t pad_bottom, int64_t pad_left, int64_t pad_right,
-    bool is_nchw) {
-  int64_t b, c, i, j, m, n;
-  int64_t h_offset = -pad_top;
-  int64_t w_offset = -pad_left;
-  const float lattic = std::numeric_limits<float>::lowest();
-  for (b = 0; b < batch; ++b) {
-    for (c = 0; c < channel; ++c) {
-      for (i = 0; i < output_h; ++i) {
-        for (j = 0; j < output_w; ++j) {
-          // auto o_index = c + (j + (i + b * output_h) * output_w) * channel;
-          auto o_index = is_nchw ? _sn_rt_flatten_index_calculation(
-                                       b, c, i, j, channel, output_h, output_w)
-                                 : _sn_rt_flatten_index_calculation(
-                                       b, i, j, c, output_h, output_w, channel);
-          float max = std::numeric_limits<float>::lowest();
-          for (m = 0; m < kernel_h; ++m) {
-            for (n = 0; n < kernel_w; ++n) {
-              auto curr_h = h_offset + i * stride_h + m;
-              auto curr_w = w_offset + j * stride_w + n;
-              // auto in_index =
-              //    c + (curr_w + (curr_h + b * spatial_h) * spatial_w) *
-              //    channel;
-              auto in_index =
-                  is_nchw
-                      ? _sn_rt_flatten_index_calculation(
-                            b, c, curr_h, curr_w, channel, spatial_h, spatial_w)
-                      : _sn_rt_flatten_index_calculation(b, curr_h, curr_w, c,
-                                                         spatial_h, spatial_w,
-                                                         channel);
-              bool valid = curr_h >= 0 && curr_h < spatial_h && curr_w >= 0 &&
-                           curr_w < spatial_w;
-              auto value = valid ? data[in_index] : lattic;
-              max = max > value ? max : value;
-            }
-          }
-          output[o_index] = max;
+// Max and average pooling. Windows are combined separably: first vertically
+// over the valid input rows of an output row, then horizontally. Padded
+// positions never contribute to the combined value. Average pooling divides by
+// the kernel size, or by the number of valid positions when padding is not
+// counted (`count_include_pad` is false).
+//  - NHWC vectorizes over channels. An image row is a contiguous run of
+//    width * channel floats, so the vertical pass is a single vector loop.
+//    When windows overlap horizontally (stride < kernel width, e.g. 3x3 / 2)
+//    the vertical results of the whole row are shared by adjacent windows;
+//    otherwise (e.g. 2x2 / 2) each window is combined directly.
+//  - NCHW vectorizes over the output width. The vertical pass produces one row
+//    padded with the identity so that the horizontal pass is branch free. Unit
+//    and 2 strides are vectorized, the latter by splitting even / odd lanes,
+//    and kernel widths 2 and 3 are unrolled.
+//  - Global pooling (one window covering the whole image) reduces each
+//    channel directly.
+
+struct _sn_rt_pool2d_params {
+  int64_t batch;
+  int64_t spatial_h;
+  int64_t spatial_w;
+  int64_t channel;
+  int64_t output_h;
+  int64_t output_w;
+  int64_t kernel_h;
+  int64_t kernel_w;
+  int64_t stride_h;
+  int64_t stride_w;
+  int64_t pad_top;
+  int64_t pad_left;
+  bool count_include_pad;
+
+  // Divisor of a window with `valid` of its `kernel` positions inside the
+  // input along one axis. Windows entirely in the padding produce 0.
+  float Count(int64_t valid, int64_t kernel) const {
+    return static_cast<float>(std::max<int64_t>(
+        count_include_pad ? kernel : valid, 1));
+  }
+
+  bool IsGlobal() const {
+    return output_h == 1 && output_w == 1 && pad_top == 0 && pad_left == 0 &&
+           kernel_h >= spatial_h && kernel_w >= spatial_w;
+  }
+};
+
+struct _sn_rt_pool_op_max {
+  static constexpr bool kAverage = false;
+  static float Identity() { return std::numeric_limits<float>::lowest(); }
+  static float Combine(float a, float b) { return a > b ? a : b; }
+  static _sn_rt_vf8 Combine(_sn_rt_vf8 a, _sn_rt_vf8 b) {
+    return _sn_rt_vf8_max(a, b);
+  }
+  template <typename T>
+  static T Finalize(T acc, T /*divisor*/) {
+    return acc;
+  }
+};
+
+struct _sn_rt_pool_op_avg {
+  static constexpr bool kAverage = true;
+  static float Identity() { return 0.0F; }
+  static float Combine(float a, float b) { return a + b; }
+  static _sn_rt_vf8 Combine(_sn_rt_vf8 a, _sn_rt_vf8 b) { return a + b; }
+  template <typename T>
+  static T Finalize(T acc, T divisor) {
+    return acc / divisor;
+  }
+};
+
+// Valid input range [lo, hi) of the window of output `o` along one axis.
+static inline void _sn_rt_pool_window_range(int64_t o, int64_t stride,
+                                            int64_t pad, int64_t kernel,
+                                            int64_t in, int64_t* lo,
+                                            int64_t* hi) {
+  int64_t start = o * stride - pad;
+  *lo = std::max<int64_t>(start, 0);
+  *hi = std::max(*lo, std::min(start + kernel, in));
+}
+
+// dst[i] = Finalize(Combine of src[r * ld_row + s * ld_col + i], divisor) over
+// r < rows, s < cols, for i < n. Blocks of channels are accumulated in
+// registers across the whole window.
+template <typename Op>
+static inline void _sn_rt_pool_window(float* dst, const float* src,
+                                      int64_t rows, int64_t ld_row,
+                                      int64_t cols, int64_t ld_col, int64_t n,
+                                      float divisor) {
+  constexpr int64_t lanes = _sn_rt_vf8_lanes;
+  const _sn_rt_vf8 vdivisor = _sn_rt_vf8_splat(divisor);
+  int64_t i = 0;
+  for (; i + 4 * lanes <= n; i += 4 * lanes) {
+    _sn_rt_vf8 acc0 = _sn_rt_vf8_splat(Op::Identity());
+    _sn_rt_vf8 acc1 = acc0;
+    _sn_rt_vf8 acc2 = acc0;
+    _sn_rt_vf8 acc3 = acc0;
+    for (int64_t r = 0; r < rows; ++r) {
+      for (int64_t s = 0; s < cols; ++s) {
+        const float* p = src + r * ld_row + s * ld_col + i;
+        acc0 = Op::Combine(acc0, _sn_rt_vf8_load(p));
+        acc1 = Op::Combine(acc1, _sn_rt_vf8_load(p + lanes));
+        acc2 = Op::Combine(acc2, _sn_rt_vf8_load(p + 2 * lanes));
+        acc3 = Op::Combine(acc3, _sn_rt_vf8_load(p + 3 * lanes));
+      }
+    }
+    _sn_rt_vf8_store(dst + i, Op::Finalize(acc0, vdivisor));
+    _sn_rt_vf8_store(dst + i + lanes, Op::Finalize(acc1, vdivisor));
+    _sn_rt_vf8_store(dst + i + 2 * lanes, Op::Finalize(acc2, vdivisor));
+    _sn_rt_vf8_store(dst + i + 3 * lanes, Op::Finalize(acc3, vdivisor));
+  }
+  for (; i + lanes <= n; i += lanes) {
+    _sn_rt_vf8 acc = _sn_rt_vf8_splat(Op::Identity());
+    for (int64_t r = 0; r < rows; ++r) {
+      for (int64_t s = 0; s < cols; ++s) {
+        acc = Op::Combine(acc,
+                          _sn_rt_vf8_load(src + r * ld_row + s * ld_col + i));
+      }
+    }
+    _sn_rt_vf8_store(dst + i, Op::Finalize(acc, vdivisor));
+  }
+  for (; i < n; ++i) {
+    float acc = Op::Identity();
+    for (int64_t r = 0; r < rows; ++r) {
+      for (int64_t s = 0; s < cols; ++s) {
+        acc = Op::Combine(acc, src[r * ld_row + s * ld_col + i]);
+      }
+    }
+    dst[i] = Op::Finalize(acc, divisor);
+  }
+}
+
+// Combines `n` contiguous elements.
+template <typename Op>
+static inline float _sn_rt_pool_segment(const float* src, int64_t n) {
+  constexpr int64_t lanes = _sn_rt_vf8_lanes;
+  float acc = Op::Identity();
+  int64_t i = 0;
+  if (n >= 4 * lanes) {
+    _sn_rt_vf8 acc0 = _sn_rt_vf8_splat(Op::Identity());
+    _sn_rt_vf8 acc1 = acc0;
+    _sn_rt_vf8 acc2 = acc0;
+    _sn_rt_vf8 acc3 = acc0;
+    for (; i + 4 * lanes <= n; i += 4 * lanes) {
+      acc0 = Op::Combine(acc0, _sn_rt_vf8_load(src + i));
+      acc1 = Op::Combine(acc1, _sn_rt_vf8_load(src + i + lanes));
+      acc2 = Op::Combine(acc2, _sn_rt_vf8_load(src + i + 2 * lanes));
+      acc3 = Op::Combine(acc3, _sn_rt_vf8_load(src + i + 3 * lanes));
+    }
+    _sn_rt_vf8 v =
+        Op::Combine(Op::Combine(acc0, acc1), Op::Combine(acc2, acc3));
+    for (int64_t j = 0; j < lanes; ++j) {
+      acc = Op::Combine(acc, v[j]);
+    }
+  }
+  for (; i < n; ++i) {
+    acc = Op::Combine(acc, src[i]);
+  }
+  return acc;
+}
+
+template <typename Op>
+static void _sn_rt_pool2d_global(const _sn_rt_pool2d_params& p, float* output,
+                                 const float* data, bool is_nchw) {
+  const int64_t c = p.channel;
+  const int64_t pixels = p.spatial_h * p.spatial_w;
+  const float divisor = p.Count(pixels, p.kernel_h * p.kernel_w);
+  if (is_nchw) {
+    _sn_rt_parallel_for(p.batch * c, pixels, [&](int64_t begin, int64_t end) {
+      for (int64_t i = begin; i < end; ++i) {
+        output[i] = Op::Finalize(
+            _sn_rt_pool_segment<Op>(data + i * pixels, pixels), divisor);
+      }
+    });
+    return;
+  }
+  // Tasks are blocks of channels of one image.
+  constexpr int64_t block = 8 * _sn_rt_vf8_lanes;
+  const int64_t blocks = (c + block - 1) / block;
+  _sn_rt_parallel_for(
+      p.batch * blocks, pixels * block, [&](int64_t begin, int64_t end) {
+        for (int64_t t = begin; t < end; ++t) {
+          int64_t c0 = t % blocks * block;
+          int64_t offset = t / blocks * pixels * c + c0;
+          _sn_rt_pool_window<Op>(output + t / blocks * c + c0, data + offset,
+                                 pixels, c, 1, 0, std::min(block, c - c0),
+                                 divisor);
+        }
+      });
+}
+
+template <typename Op>
+static void _sn_rt_pool2d_nhwc(const _sn_rt_pool2d_params& p, float* output,
+                               const float* data) {
+  const int64_t c = p.channel;
+  const int64_t row_size = p.spatial_w * c;
+  const bool overlap = p.stride_w < p.kernel_w;
+  auto run_rows = [&](int64_t begin, int64_t end) {
+    float* cols = nullptr;
+    if (overlap) {
+      cols = static_cast<float*>(
+          _sn_rt_aligned_alloc(sizeof(float) * row_size));
+    }
+    for (int64_t row = begin; row < end; ++row) {
+      int64_t h0, h1;
+      _sn_rt_pool_window_range(row % p.output_h, p.stride_h, p.pad_top,
+                               p.kernel_h, p.spatial_h, &h0, &h1);
+      const float* image =
+          data + (row / p.output_h * p.spatial_h + h0) * row_size;
+      float* dst = output + row * p.output_w * c;
+      const float count_h = p.Count(h1 - h0, p.kernel_h);
+      if (overlap) {
+        _sn_rt_pool_window<Op>(cols, image, h1 - h0, row_size, 1, 0, row_size,
+                               1.0F);
+      }
+      for (int64_t ow = 0; ow < p.output_w; ++ow, dst += c) {
+        int64_t w0, w1;
+        _sn_rt_pool_window_range(ow, p.stride_w, p.pad_left, p.kernel_w,
+                                 p.spatial_w, &w0, &w1);
+        float divisor = count_h * p.Count(w1 - w0, p.kernel_w);
+        if (overlap) {
+          _sn_rt_pool_window<Op>(dst, cols + w0 * c, 1, 0, w1 - w0, c, c,
+                                 divisor);
+        } else {
+          _sn_rt_pool_window<Op>(dst, image + w0 * c, h1 - h0, row_size,
+                                 w1 - w0, c, c, divisor);
+        }
+      }
+    }
+    _sn_rt_aligned_free(cols);
+  };
+  _sn_rt_parallel_for(p.batch * p.output_h,
+                      p.output_w * c * p.kernel_h * p.kernel_w, run_rows);
+}
+
+// Horizontal pass of NCHW pooling over an identity padded row:
+// dst[o] = Finalize(Combine of line[o * stride + k] for k < kernel,
+//                   count_w[o] * count_h).
+// A zero `kKernel` or `kStride` means the runtime value.
+template <typename Op, int64_t kStride, int64_t kKernel>
+static void _sn_rt_pool_hpass(float* dst, const float* line, int64_t out_w,
+                              int64_t stride, int64_t kernel,
+                              const float* count_w, float count_h) {
+  constexpr int64_t lanes = _sn_rt_vf8_lanes;
+  if (kStride != 0) {
+    stride = kStride;
+  }
+  if (kKernel != 0) {
+    kernel = kKernel;
+  }
+  int64_t o = 0;
+  if (kStride == 1 || kStride == 2) {
+    const _sn_rt_vf8 vcount_h = _sn_rt_vf8_splat(count_h);
+    for (; o + lanes <= out_w; o += lanes) {
+      const float* src = line + o * kStride;
+      _sn_rt_vf8 acc = _sn_rt_vf8_splat(Op::Identity());
+      for (int64_t k = 0; k < kernel; ++k) {
+        _sn_rt_vf8 v = _sn_rt_vf8_load(src + k);
+        if (kStride == 2) {
+          v = _SN_RT_VF8_SHUFFLE(v, _sn_rt_vf8_load(src + k + lanes), 0, 2, 4,
+                                 6, 8, 10, 12, 14);
         }
+        acc = Op::Combine(acc, v);
       }
+      _sn_rt_vf8_store(
+          dst + o, Op::Finalize(acc, _sn_rt_vf8_load(count_w + o) * vcount_h));
     }
   }
+  for (; o < out_w; ++o) {
+    float acc = Op::Identity();
+    for (int64_t k = 0; k < kernel; ++k) {
+      acc = Op::Combine(acc, line[o * stride + k]);
+    }
+    dst[o] = Op::Finalize(acc, count_w[o] * count_h);
+  }
 }
 
-void _sn_rt_poolingmax_f32_nhwc(
-    float* output, const float* data, int64_t batch, int64_t spatial_h,
-    int64_t spatial_w, int64_t channel, int64_t output_h, int64_t output_w,
-    int64_t kernel_h, int64_t kernel_w, int64_t stride_h, int64_t stride_w,
-    int64_t pad_top, int64_t pad_bottom, int64_t pad_left, int64_t pad_right) {
-  return _sn_rt_poolingmax_f32_helper(
-      output, data, batch, spatial_h, spatial_w, channel, output_h, output_w,
-      kernel_h, kernel_w, stride_h, stride_w, pad_top, pad_bottom, pad_left,
-      pad_right, false /*is_nhwc*/);
+template <typename Op>
+static void _sn_rt_pool2d_nchw(const _sn_rt_pool2d_params& p, float* output,
+                               const float* data) {
+  constexpr int64_t lanes = _sn_rt_vf8_lanes;
+  const int64_t plane = p.spatial_h * p.spatial_w;
+  // The padded row holds every position read by the horizontal pass,
+  // including the over-read of the last vectors.
+  const int64_t line_size =
+      std::max(p.pad_left + p.spatial_w,
+               (p.output_w - 1) * p.stride_w + p.kernel_w) +
+      2 * lanes;
+  // Divisors of the horizontal windows, padded to whole vectors.
+  float* count_w = static_cast<float*>(_sn_rt_aligned_alloc(
+      sizeof(float) * (p.output_w + lanes)));
+  for (int64_t ow = 0; ow < p.output_w; ++ow) {
+    int64_t w0, w1;
+    _sn_rt_pool_window_range(ow, p.stride_w, p.pad_left, p.kernel_w,
+                             p.spatial_w, &w0, &w1);
+    count_w[ow] = Op::kAverage ? p.Count(w1 - w0, p.kernel_w) : 1.0F;
+  }
+
+  auto hpass = _sn_rt_pool_hpass<Op, 0, 0>;
+  if (p.stride_w == 1) {
+    hpass = p.kernel_w == 2   ? _sn_rt_pool_hpass<Op, 1, 2>
+            : p.kernel_w == 3 ? _sn_rt_pool_hpass<Op, 1, 3>
+                              : _sn_rt_pool_hpass<Op, 1, 0>;
+  } else if (p.stride_w == 2) {
+    hpass = p.kernel_w == 2   ? _sn_rt_pool_hpass<Op, 2, 2>
+            : p.kernel_w == 3 ? _sn_rt_pool_hpass<Op, 2, 3>
+                              : _sn_rt_pool_hpass<Op, 2, 0>;
+  }
+
+  auto run_rows = [&](int64_t begin, int64_t end) {
+    float* line =
+        static_cast<float*>(_sn_rt_aligned_alloc(sizeof(float) * line_size));
+    std::fill_n(line, line_size, Op::Identity());
+    for (int64_t row = begin; row < end; ++row) {
+      int64_t h0, h1;
+      _sn_rt_pool_window_range(row % p.output_h, p.stride_h, p.pad_top,
+                               p.kernel_h, p.spatial_h, &h0, &h1);
+      const float* image = data + row / p.output_h * plane + h0 * p.spatial_w;
+      _sn_rt_pool_window<Op>(line + p.pad_left, image, h1 - h0, p.spatial_w,
+                             1, 0, p.spatial_w, 1.0F);
+      hpass(output + row * p.output_w, line, p.output_w, p.stride_w,
+            p.kernel_w, count_w,
+            Op::kAverage ? p.Count(h1 - h0, p.kernel_h) : 1.0F);
+    }
+    _sn_rt_aligned_free(line);
+  };
+  _sn_rt_parallel_for(p.batch * p.channel * p.output_h,
+                      p.output_w * p.kernel_w + p.spatial_w * p.kernel_h,
+                      run_rows);
+  _sn_rt_aligned_free(count_w);
 }
 
-void _sn_rt_poolingmax_f32_nchw(
-    float* output, const float* data, int64_t batch, int64_t spatial_h,
-    int64_t spatial_w, int64_t channel, int64_t output_h, int64_t output_w,
-    int64_t kernel_h, int64_t kernel_w, int64_t stride_h, int64_t stride_w,
-    int64_t pad_top, int64_t pad_bottom, int64_t pad_left, int64_t pad_right) {
-  return _sn_rt_poolingmax_f32_helper(
-      output, data, batch, spatial_h, spatial_w, channel, output_h, output_w,
-      kernel_h, kernel_w, stride_h, stride_w, pad_top, pad_bottom, pad_left,
-      pad_right, true /*is_nhwc*/);
+template <typename Op>
+static void _sn_rt_pool2d(const _sn_rt_pool2d_params& p, float* output,
+                          const float* data, bool is_nchw) {
+  if (p.IsGlobal()) {
+    _sn_rt_pool2d_global<Op>(p, output, data, is_nchw);
+  } else if (is_nchw) {
+    _sn_rt_pool2d_nchw<Op>(p, output, data);
+  } else {
+    _sn_rt_pool2d_nhwc<Op>(p, output, data);
+  }
+}
+
+extern "C" {
+
+// `count_include_pad` only affects average pooling.
+#define _SN_RT_DEFINE_POOLING(func, op, is_nchw)                              \
+  void func(float* output, const float* data, int64_t batch,                  \
+            int64_t spatial_h, int64_t spatial_w, int64_t channel,            \
+            int64_t output_h, int64_t output_w, int64_t kernel_h,             \
+            int64_t kernel_w, int64_t stride_h, int64_t stride_w,             \
+            int64_t pad_top, int64_t /*pad_bottom*/, int64_t pad_left,        \
+            int64_t /*pad_right*/, bool count_include_pad) {                  \
+    _sn_rt_pool2d_params p{batch,    spatial_h, spatial_w, channel,           \
+                           output_h, output_w,  kernel_h,  kernel_w,          \
+                           stride_h, stride_w,  pad_top,   pad_left,          \
+                           count_include_pad};                                \
+    _sn_rt_pool2d<op>(p, output, data, is_nchw);                              \
+  }
+
+_SN_RT_DEFINE_POOLING(_sn_rt_poolingmax_f32_nhwc, _sn_rt_pool_op_max, false)
+_SN_RT_DEFINE_POOLING(_sn_rt_poolingmax_f32_nchw, _sn_rt_pool_op_max, true)
+_SN_RT_DEFINE_POOLING(_sn_rt_poolingavg_f32_nhwc, _sn_rt_pool_op_avg, false)
+_SN_RT_DEFINE_POOLING(_sn_rt_poolingavg_f32_nchw, _sn_rt_pool_op_avg, true)
+
+#undef _SN_RT_DEFINE_POOLING
 }
-}
\ No newline at end of file
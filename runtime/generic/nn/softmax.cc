@@ -15,36 +15,119 @@
 // limitations under the License.
 // =============================================================================
 
+#include <stdint.h>
+
 #include <algorithm>
 #include <cmath>
-#include <cstdint>
 #include <limits>
-#include <vector>
+
+#include "../math/vmath.h"
+
+// Softmax normalizes rows made of all the dims from `axis` on. Each row is
+// processed in three vectorized passes: the maximum, exp(x - max) written to
+// the result together with the running sum, and the final scaling. No
+// scratch buffer is needed.
+
+static inline float _sn_rt_softmax_row_max(const float* src, int64_t n) {
+  float max_value = -std::numeric_limits<float>::infinity();
+  int64_t i = 0;
+  if (n >= _sn_rt_vf8_lanes) {
+    _sn_rt_vf8 acc = _sn_rt_vf8_splat(max_value);
+    for (; i + _sn_rt_vf8_lanes <= n; i += _sn_rt_vf8_lanes) {
+      acc = _sn_rt_vf8_max(acc, _sn_rt_vf8_load(src + i));
+    }
+    for (int j = 0; j < _sn_rt_vf8_lanes; ++j) {
+      max_value = std::max(max_value, acc[j]);
+    }
+  }
+  for (; i < n; ++i) {
+    max_value = std::max(max_value, src[i]);
+  }
+  return max_value;
+}
+
+/// Returns the sum of exp(src[i] - shift), which is also written to `dst`
+/// when `kStore` is set. The tail is padded with -inf so it adds nothing.
+template <bool kStore>
+static inline float _sn_rt_softmax_row_exp(float* dst, const float* src,
+                                           int64_t n, float shift) {
+  _sn_rt_vf8 acc = _sn_rt_vf8_splat(0.0F);
+  int64_t i = 0;
+  for (; i + _sn_rt_vf8_lanes <= n; i += _sn_rt_vf8_lanes) {
+    _sn_rt_vf8 e = _sn_rt_vf8_exp(_sn_rt_vf8_load(src + i) - shift);
+    acc += e;
+    if (kStore) {
+      _sn_rt_vf8_store(dst + i, e);
+    }
+  }
+  if (i < n) {
+    float buf[_sn_rt_vf8_lanes];
+    std::fill_n(buf, _sn_rt_vf8_lanes, -std::numeric_limits<float>::infinity());
+    std::copy(src + i, src + n, buf);
+    _sn_rt_vf8 e = _sn_rt_vf8_exp(_sn_rt_vf8_load(buf) - shift);
+    acc += e;
+    if (kStore) {
+      _sn_rt_vf8_store(buf, e);
+      std::copy(buf, buf + n - i, dst + i);
+    }
+  }
+  float sum = 0;
+  for (int j = 0; j < _sn_rt_vf8_lanes; ++j) {
+    sum += acc[j];
+  }
+  return sum;
+}
+
+/// dst[i] = src[i] * scale + offset.
+static inline void _sn_rt_softmax_row_affine(float* dst, const float* src,
+                                             int64_t n, float scale,
+                                             float offset) {
+  int64_t i = 0;
+  for (; i + _sn_rt_vf8_lanes <= n; i += _sn_rt_vf8_lanes) {
+    _sn_rt_vf8_store(dst + i, _sn_rt_vf8_load(src + i) * scale + offset);
+  }
+  for (; i < n; ++i) {
+    dst[i] = src[i] * scale + offset;
+  }
+}
+
+static inline int64_t _sn_rt_softmax_row_size(const int64_t* shape,
+                                              int32_t axis, int32_t dim) {
+  int64_t after = 1;
+  for (int d = axis; d < dim; ++d) {
+    after *= shape[d];
+  }
+  return after;
+}
 
 extern "C" {
 /// softmax with fp32.
 void _sn_rt_softmax_f32(float* result, const float* logits,
                         const int64_t* shape, int32_t axis, int32_t dim,
                         int64_t num_of_elements) {
-  int64_t after = 1;
-  for (int d = axis; d < dim; ++d) {
-    after *= shape[d];
+  int64_t after = _sn_rt_softmax_row_size(shape, axis, dim);
+  int64_t before = after == 0 ? 0 : num_of_elements / after;
+  for (int64_t i = 0; i < before; ++i) {
+    const float* src = logits + i * after;
+    float* dst = result + i * after;
+    float max_value = _sn_rt_softmax_row_max(src, after);
+    float sum = _sn_rt_softmax_row_exp<true>(dst, src, after, max_value);
+    _sn_rt_softmax_row_affine(dst, dst, after, 1.0F / sum, 0.0F);
   }
-  float temp[after];
-  // std::vector<float> temp(after);
-  int64_t before = num_of_elements / after;
-  for (int i = 0; i < before; ++i) {
-    float sum = 0;
-    int64_t index = i * after;
-
-    float max_value = *std::max_element(logits + index, logits + index + after);
-    for (int j = 0; j < after; ++j) {
-      temp[j] = std::exp(logits[j + index] - max_value);
-      sum += temp[j];
-    }
-    for (int j = 0; j < after; ++j) {
-      result[j + index] = temp[j] / sum;
-    }
+}
+
+/// log(softmax) with fp32, computed as x - max - log(sum(exp(x - max))).
+void _sn_rt_log_softmax_f32(float* result, const float* logits,
+                            const int64_t* shape, int32_t axis, int32_t dim,
+                            int64_t num_of_elements) {
+  int64_t after = _sn_rt_softmax_row_size(shape, axis, dim);
+  int64_t before = after == 0 ? 0 : num_of_elements / after;
+  for (int64_t i = 0; i < before; ++i) {
+    const float* src = logits + i * after;
+    float max_value = _sn_rt_softmax_row_max(src, after);
+    float sum = _sn_rt_softmax_row_exp<false>(nullptr, src, after, max_value);
+    _sn_rt_softmax_row_affine(result + i * after, src, after, 1.0F,
+                              -max_value - std::log(sum));
   }
 }
-}
\ No newline at end of file
+}
@@ -0,0 +1,28 @@
+//===- tanh.cc ------------------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include <stdint.h>
+
+#include "../math/vmath.h"
+
+extern "C" {
+/// tanh with fp32.
+void _sn_rt_tanh_f32(float* out, const float* lhs, int64_t lhs_size) {
+  _sn_rt_vf8_map(out, lhs, lhs_size,
+                 [](_sn_rt_vf8 x) { return _sn_rt_vf8_tanh(x); });
+}
+}
@@ -0,0 +1,234 @@
+//===- winograd.cc --------------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include <stdint.h>
+
+#include <algorithm>
+
+#include "../math/gemm.h"
+
+// Winograd F(4x4, 3x3) convolution for 3x3 kernels with unit stride and
+// dilation. The kernel is transformed at compile time (U = G * g * G^T) and
+// passed in as [36][ic][oc]. At runtime, each 6x6 input tile is transformed
+// (V = B^T * d * B) for a block of tiles, the 36 element-wise products become
+// 36 independent GEMMs of [tiles x ic] * [ic x oc], and the 4x4 output tile is
+// recovered as Y = A^T * M * A. Bias and clipping are applied when the output
+// tile is stored.
+
+constexpr int64_t _sn_rt_wino_alpha = 6;
+constexpr int64_t _sn_rt_wino_out = 4;
+constexpr int64_t _sn_rt_wino_points = _sn_rt_wino_alpha * _sn_rt_wino_alpha;
+constexpr int64_t _sn_rt_wino_tile_block = 4 * _sn_rt_gemm_mr;
+
+// In-place B^T * d (or d * B when stride is along columns) for one 6-vector of
+// each of `n` channels. `x` points to element 0, elements are `stride` apart.
+static inline void _sn_rt_wino_input_1d(float* x, int64_t stride, int64_t n) {
+  for (int64_t c = 0; c < n; ++c) {
+    float d0 = x[c];
+    float d1 = x[c + stride];
+    float d2 = x[c + 2 * stride];
+    float d3 = x[c + 3 * stride];
+    float d4 = x[c + 4 * stride];
+    float d5 = x[c + 5 * stride];
+    x[c] = 4 * d0 - 5 * d2 + d4;
+    x[c + stride] = -4 * d1 - 4 * d2 + d3 + d4;
+    x[c + 2 * stride] = 4 * d1 - 4 * d2 - d3 + d4;
+    x[c + 3 * stride] = -2 * d1 - d2 + 2 * d3 + d4;
+    x[c + 4 * stride] = 2 * d1 - d2 - 2 * d3 + d4;
+    x[c + 5 * stride] = 4 * d1 - 5 * d3 + d5;
+  }
+}
+
+// A^T * m for one 6-vector of each of `n` channels, producing a 4-vector.
+static inline void _sn_rt_wino_output_1d(const float* x, int64_t stride,
+                                         float* y, int64_t y_stride,
+                                         int64_t n) {
+  for (int64_t c = 0; c < n; ++c) {
+    float m0 = x[c];
+    float m1 = x[c + stride];
+    float m2 = x[c + 2 * stride];
+    float m3 = x[c + 3 * stride];
+    float m4 = x[c + 4 * stride];
+    float m5 = x[c + 5 * stride];
+    y[c] = m0 + m1 + m2 + m3 + m4;
+    y[c + y_stride] = m1 - m2 + 2 * (m3 - m4);
+    y[c + 2 * y_stride] = m1 + m2 + 4 * (m3 + m4);
+    y[c + 3 * y_stride] = m1 - m2 + 8 * (m3 - m4) + m5;
+  }
+}
+
+static void _sn_rt_conv2d_winograd_f32_impl(
+    float* output, const float* data, const float* kernel, int64_t batch,
+    int64_t spatial_h, int64_t spatial_w, int64_t channel, int64_t output_h,
+    int64_t output_w, int64_t output_channel, int64_t pad_top,
+    int64_t pad_left, const float* bias, float clip_min, float clip_max,
+    bool is_nchw) {
+  constexpr int64_t alpha = _sn_rt_wino_alpha;
+  constexpr int64_t points = _sn_rt_wino_points;
+  constexpr int64_t tb = _sn_rt_wino_tile_block;
+  const int64_t ic = channel;
+  const int64_t oc = output_channel;
+  const int64_t tiles_h = (output_h + _sn_rt_wino_out - 1) / _sn_rt_wino_out;
+  const int64_t tiles_w = (output_w + _sn_rt_wino_out - 1) / _sn_rt_wino_out;
+  const int64_t tiles = tiles_h * tiles_w;
+  const int64_t in_size = spatial_h * spatial_w * ic;
+  const int64_t out_size = output_h * output_w * oc;
+
+  // Pack the 36 transformed kernels once.
+  const int64_t packed_size = _sn_rt_gemm_packed_b_size(oc, ic);
+  float* pb = static_cast<float*>(
+      _sn_rt_aligned_alloc(sizeof(float) * packed_size * points));
+  for (int64_t p = 0; p < points; ++p) {
+    _sn_rt_gemm_pack_b(pb + p * packed_size, kernel + p * ic * oc, oc, false,
+                       oc, ic);
+  }
+  // Blocks of tiles are independent: each task transforms, multiplies and
+  // stores its own blocks with private scratch buffers.
+  const int64_t blocks = (tiles + tb - 1) / tb;
+  _sn_rt_gemm_epilogue ep;
+  auto run_blocks = [&](int64_t begin, int64_t end) {
+    float* pa = static_cast<float*>(
+        _sn_rt_aligned_alloc(sizeof(float) * _sn_rt_gemm_mc * _sn_rt_gemm_kc));
+    // V: [36][tb][ic], M: [36][tb][oc], tile: [36][ic] scratch.
+    float* v = static_cast<float*>(
+        _sn_rt_aligned_alloc(sizeof(float) * points * tb * ic));
+    float* m = static_cast<float*>(
+        _sn_rt_aligned_alloc(sizeof(float) * points * tb * oc));
+    float* tile = static_cast<float*>(
+        _sn_rt_aligned_alloc(sizeof(float) * points * std::max(ic, oc)));
+    for (int64_t blk = begin; blk < end; ++blk) {
+      int64_t b = blk / blocks;
+      int64_t t0 = blk % blocks * tb;
+      const float* image = data + b * in_size;
+      float* result = output + b * out_size;
+      int64_t nt = std::min(tb, tiles - t0);
+      // Input transform.
+      for (int64_t t = 0; t < nt; ++t) {
+        int64_t ty = (t0 + t) / tiles_w;
+        int64_t tx = (t0 + t) % tiles_w;
+        int64_t y0 = ty * _sn_rt_wino_out - pad_top;
+        int64_t x0 = tx * _sn_rt_wino_out - pad_left;
+        bool interior = y0 >= 0 && y0 + alpha <= spatial_h && x0 >= 0 &&
+                        x0 + alpha <= spatial_w;
+        for (int64_t i = 0; i < alpha; ++i) {
+          for (int64_t j = 0; j < alpha; ++j) {
+            float* dst = tile + (i * alpha + j) * ic;
+            int64_t y = y0 + i;
+            int64_t x = x0 + j;
+            if (!interior &&
+                (y < 0 || y >= spatial_h || x < 0 || x >= spatial_w)) {
+              std::fill_n(dst, ic, 0.0F);
+            } else if (is_nchw) {
+              const float* src = image + y * spatial_w + x;
+              for (int64_t c = 0; c < ic; ++c) {
+                dst[c] = src[c * spatial_h * spatial_w];
+              }
+            } else {
+              std::copy_n(image + (y * spatial_w + x) * ic, ic, dst);
+            }
+          }
+        }
+        for (int64_t i = 0; i < alpha; ++i) {
+          _sn_rt_wino_input_1d(tile + i * ic, alpha * ic, ic); // columns.
+        }
+        for (int64_t i = 0; i < alpha; ++i) {
+          _sn_rt_wino_input_1d(tile + i * alpha * ic, ic, ic); // rows.
+        }
+        for (int64_t p = 0; p < points; ++p) {
+          std::copy_n(tile + p * ic, ic, v + (p * tb + t) * ic);
+        }
+      }
+      // Element-wise products as 36 GEMMs.
+      for (int64_t p = 0; p < points; ++p) {
+        _sn_rt_gemm_packed(nt, oc, ic, v + p * tb * ic, ic, false,
+                           pb + p * packed_size, m + p * tb * oc, oc, ep, pa);
+      }
+      // Output transform.
+      for (int64_t t = 0; t < nt; ++t) {
+        for (int64_t p = 0; p < points; ++p) {
+          std::copy_n(m + (p * tb + t) * oc, oc, tile + p * oc);
+        }
+        // Rows: 6x6 -> 6x4, kept in the first 4 columns of each row.
+        for (int64_t i = 0; i < alpha; ++i) {
+          _sn_rt_wino_output_1d(tile + i * alpha * oc, oc, tile + i * alpha * oc,
+                                oc, oc);
+        }
+        int64_t ty = (t0 + t) / tiles_w;
+        int64_t tx = (t0 + t) % tiles_w;
+        int64_t oy = ty * _sn_rt_wino_out;
+        int64_t ox = tx * _sn_rt_wino_out;
+        int64_t rows = std::min(_sn_rt_wino_out, output_h - oy);
+        int64_t cols = std::min(_sn_rt_wino_out, output_w - ox);
+        // Columns: 6x4 -> 4x4, kept in the first 4 rows.
+        for (int64_t j = 0; j < _sn_rt_wino_out; ++j) {
+          _sn_rt_wino_output_1d(tile + j * oc, alpha * oc, tile + j * oc,
+                                alpha * oc, oc);
+        }
+        for (int64_t i = 0; i < rows; ++i) {
+          for (int64_t j = 0; j < cols; ++j) {
+            float* src = tile + (i * alpha + j) * oc;
+            for (int64_t c = 0; c < oc; ++c) {
+              float y = bias == nullptr ? src[c] : src[c] + bias[c];
+              src[c] = _sn_rt_clip(y, clip_min, clip_max);
+            }
+            if (is_nchw) {
+              float* dst = result + (oy + i) * output_w + ox + j;
+              for (int64_t c = 0; c < oc; ++c) {
+                dst[c * output_h * output_w] = src[c];
+              }
+            } else {
+              std::copy_n(src, oc,
+                          result + ((oy + i) * output_w + ox + j) * oc);
+            }
+          }
+        }
+      }
+    }
+    _sn_rt_aligned_free(tile);
+    _sn_rt_aligned_free(m);
+    _sn_rt_aligned_free(v);
+    _sn_rt_aligned_free(pa);
+  };
+  _sn_rt_parallel_for(batch * blocks, tb * points * ic * oc, run_blocks);
+  _sn_rt_aligned_free(pb);
+}
+
+extern "C" {
+// The bottom and right padding follow from the output size: taps outside the
+// input read zeros.
+void _sn_rt_conv2d_winograd_f32_nhwc(
+    float* output, const float* data, const float* kernel, const float* bias,
+    int64_t batch, int64_t spatial_h, int64_t spatial_w, int64_t channel,
+    int64_t output_h, int64_t output_w, int64_t output_channel,
+    int64_t pad_top, int64_t pad_left, float clip_min, float clip_max) {
+  _sn_rt_conv2d_winograd_f32_impl(output, data, kernel, batch, spatial_h,
+                                  spatial_w, channel, output_h, output_w,
+                                  output_channel, pad_top, pad_left, bias,
+                                  clip_min, clip_max, false);
+}
+
+void _sn_rt_conv2d_winograd_f32_nchw(
+    float* output, const float* data, const float* kernel, const float* bias,
+    int64_t batch, int64_t spatial_h, int64_t spatial_w, int64_t channel,
+    int64_t output_h, int64_t output_w, int64_t output_channel,
+    int64_t pad_top, int64_t pad_left, float clip_min, float clip_max) {
+  _sn_rt_conv2d_winograd_f32_impl(output, data, kernel, batch, spatial_h,
+                                  spatial_w, channel, output_h, output_w,
+                                  output_channel, pad_top, pad_left, bias,
+                                  clip_min, clip_max, true);
+}
+}
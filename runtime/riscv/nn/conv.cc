@@ -21,9 +21,11 @@ extern "C" {
 /// conv2d in nhwc.
 
 void _sn_rt_conv2d_f32_nhwc(
-    float* output, const float* data, const float* kernel, int64_t batch,
-    int64_t spatial_h, int64_t spatial_w, int64_t channel, int64_t output_h,
-    int64_t output_w, int64_t output_channel, int64_t kernel_h,
-    int64_t kernel_w, int64_t stride_h, int64_t stride_w, int64_t pad_top,
-    int64_t pad_bottom, int64_t pad_left, int64_t pad_right);
+    float* output, const float* data, const float* kernel, const float* bias,
+    int64_t batch, int64_t spatial_h, int64_t spatial_w, int64_t channel,
+    int64_t output_h, int64_t output_w, int64_t output_channel,
+    int64_t kernel_h, int64_t kernel_w, int64_t stride_h, int64_t stride_w,
+    int64_t dilation_h, int64_t dilation_w, int64_t pad_top,
+    int64_t pad_bottom, int64_t pad_left, int64_t pad_right, int64_t group,
+    float clip_min, float clip_max);
 }
\ No newline at end of file
@@ -55,18 +55,27 @@ void build() {
   // CHECK: void @func(<3 x float>* readonly %input, <3 x float>* %out_add1)  {{.*}} {
   // CHECK: bb0:
   // CHECK:   %add0 = alloca <3 x float>
-  // CHECK:   %0 = bitcast <3 x float>* %add0 to float*
-  // CHECK:   %1 = bitcast <3 x float>* %input to float*
-  // CHECK:   call void @_sn_rt_add_f32(float* %0, float* %1, {{.*}}, i64 3, i1 false, i64* null, i64* null, i64* null, i32 1)
+  // CHECK:   br label %loop
+  // CHECK: loop:
+  // CHECK:   %iv0 = phi i64 [ 0, %bb0 ], [ {{.*}}, %loop ]
+  // CHECK:   getelementptr float, float* bitcast (<3 x float>* @w0 to float*), i64 %{{.*}}
+  // CHECK:   fadd float
+  // CHECK:   store float
+  // CHECK:   icmp ult i64 {{.*}}, 3
+  // CHECK:   br i1 {{.*}}, label %loop, label %loop.exit, !llvm.loop ![[LOOP0:[0-9]+]]
+  // CHECK: loop.exit:
   // CHECK:   %add1 = alloca <3 x float>
-  // CHECK:   %2 = bitcast <3 x float>* %add1 to float*
-  // CHECK:   %3 = bitcast <3 x float>* %add0 to float*
-  // CHECK:   call void @_sn_rt_add_f32(float* %2, float* %3, {{.*}}, i64 3, i1 false, i64* null, i64* null, i64* null, i32 1)
-  // CHECK:   %4 = bitcast <3 x float>* %out_add1 to i8*
-  // CHECK:   %5 = bitcast <3 x float>* %add1 to i8*
-  // CHECK:   call void @llvm.memcpy.p0i8.p0i8.i64(i8* align 4 %4, i8* align 4 %5, i64 12, i1 false)
+  // CHECK:   phi i64 [ 0, %loop.exit ]
+  // CHECK:   getelementptr float, float* bitcast (<3 x float>* @w1 to float*), i64 %{{.*}}
+  // CHECK:   fadd float
+  // CHECK:   br i1 {{.*}}, !llvm.loop ![[LOOP1:[0-9]+]]
+  // CHECK-NOT: call void @_sn_rt_add_f32
+  // CHECK:   call void @llvm.memcpy.p0i8.p0i8.i64(i8* align 4 %{{.*}}, i8* align 4 %{{.*}}, i64 12, i1 false)
   // CHECK:   ret void
   // CHECK: }
+  // CHECK: ![[LOOP0]] = distinct !{![[LOOP0]], ![[VEC:[0-9]+]]}
+  // CHECK: ![[VEC]] = !{!"llvm.loop.vectorize.enable", i1 true}
+  // CHECK: ![[LOOP1]] = distinct !{![[LOOP1]], ![[VEC]]}
   // clang-format on
 }
 
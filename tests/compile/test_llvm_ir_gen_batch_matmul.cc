@@ -0,0 +1,62 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  Function* func = func_builder.CreateFunction("func");
+
+  ArgumentBuilder arg_builder(func);
+  auto input =
+      arg_builder.CreateArgument("input", Type{DataType::FLOAT32, {2, 1, 3}});
+
+  BasicBlockBuilder bb_builder(func);
+  BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+  std::vector<float> w0{1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+
+  ConstantBuilder c_builder(func);
+  auto w = c_builder.CreateConstant("w0", Type{DataType::FLOAT32, {3, 2}},
+                                    w0.data());
+
+  IRBuilder ir_builder(bb);
+
+  // The rhs is shared by both batches.
+  Instruction* mm = ir_builder.CreateBatchMatMul("mm", *input, *w);
+  ir_builder.CreateReturn("ret", *mm);
+
+  // simulate the driver's argv[0] by reading from env var.
+  ctx.SetBasePath(getenv("HALO_BASE_PATH"));
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  pm.AddPass<GenericLLVMIRCodeGen>();
+  pm.AddPass<GenericLLVMIRWriter>(std::ref(std::cout), false);
+
+  pm.Run(&m);
+
+  // clang-format off
+  // CHECK: void @func(<6 x float>* readonly %input, <4 x float>* %out_mm)  {{.*}} {
+  // CHECK: bb0:
+  // CHECK:   %mm = alloca <4 x float>
+  // CHECK:   call void @_sn_rt_batch_matmul_f32(float* %{{.*}}, float* %{{.*}}, float* {{.*}}, i64 2, i64 1, i64 3, i64 3, i64 2, i1 false, i1 false, i1 true)
+  // CHECK:   ret void
+
+  // CHECK: define {{.*}} void @_sn_rt_batch_matmul_f32
+  // CHECK:   ret void
+  // CHECK: }
+  // clang-format on
+}
+
+int main() { build(); }
@@ -0,0 +1,73 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  Function* func = func_builder.CreateFunction("func");
+
+  ArgumentBuilder arg_builder(func);
+  auto input =
+      arg_builder.CreateArgument("input", Type{DataType::FLOAT32, {2, 3, 4}});
+
+  BasicBlockBuilder bb_builder(func);
+  BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+  std::vector<float> w0{1.0, 2.0, 3.0};
+
+  ConstantBuilder c_builder(func);
+  auto c0 = c_builder.CreateConstant("w0", Type{DataType::FLOAT32, {3, 1}},
+                                     w0.data());
+
+  IRBuilder ir_builder(bb);
+
+  Instruction* add0 = ir_builder.CreateAdd("add0", *input, *c0);
+  Instruction* cmp0 = ir_builder.CreateBinary("cmp0", *add0, *input,
+                                              OpCode::CMP, KindPredicate::LT);
+  ir_builder.CreateReturn("ret", *cmp0);
+
+  // simulate the driver's argv[0] by reading from env var.
+  ctx.SetBasePath(getenv("HALO_BASE_PATH"));
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  pm.AddPass<GenericLLVMIRCodeGen>();
+  pm.AddPass<GenericLLVMIRWriter>(std::ref(std::cout), false);
+
+  pm.Run(&m);
+
+  // clang-format off
+  // CHECK-NOT: @add0_shape
+  // CHECK: void @func(<24 x float>* readonly %input, <24 x i8>* %out_cmp0)  {{.*}} {
+  // CHECK: bb0:
+  // CHECK-NOT: call void @_sn_rt_
+  // CHECK:   %iv0 = phi i64
+  // CHECK:   %iv1 = phi i64
+  // CHECK:   %iv2 = phi i64
+  // CHECK:   mul nuw i64 %iv1, 1
+  // CHECK:   getelementptr float, float* {{.*}}@w0
+  // CHECK:   fadd float
+  // CHECK:   icmp ult i64 {{.*}}, 4
+  // CHECK:   icmp ult i64 {{.*}}, 3
+  // CHECK:   icmp ult i64 {{.*}}, 2
+  // CHECK:   fcmp olt float
+  // CHECK:   zext i1 {{.*}} to i8
+  // CHECK:   store i8
+  // CHECK:   icmp ult i64 {{.*}}, 24
+  // CHECK-NOT: call void @_sn_rt_
+  // CHECK:   ret void
+  // clang-format on
+}
+
+int main() { build(); }
@@ -0,0 +1,73 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  Function* func = func_builder.CreateFunction("func");
+
+  Type ty(DataType::FLOAT32, {1, 512});
+
+  ArgumentBuilder arg_builder(func);
+  auto input = arg_builder.CreateArgument("input", ty);
+
+  BasicBlockBuilder bb_builder(func);
+  BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+  IRBuilder ir_builder(bb);
+
+  Instruction* exp0 = ir_builder.CreateExp("exp0", *input);
+  Instruction* sqrt0 = ir_builder.CreateSqrt("sqrt0", *input);
+  ConcatInst* concat0 = ir_builder.CreateConcat("concat0", {*exp0, *sqrt0});
+  concat0->SetAxis(1);
+  Instruction* add0 = ir_builder.CreateAdd("add0", *concat0, *concat0);
+  ir_builder.CreateReturn("ret", *add0);
+
+  // simulate the driver's argv[0] by reading from env var.
+  ctx.SetBasePath(getenv("HALO_BASE_PATH"));
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  auto cg = pm.AddPass<GenericLLVMIRCodeGen>();
+  cg->SetPrintMemStats(true);
+  pm.AddPass<GenericLLVMIRWriter>(std::ref(std::cout), false);
+
+  pm.Run(&m);
+
+  // exp0 and sqrt0 are written into the two halves of concat0, so nothing is
+  // copied. add0 is computed in place over concat0.
+  // clang-format off
+  // CHECK: Total Activation Memory: 4096 bytes
+  // CHECK-NEXT: Peak Activation Memory: 4096 bytes
+  // CHECK-NEXT: Planned Activation Memory: 4096 bytes
+  // CHECK: ModuleID = 'test_module'
+  // CHECK-NOT: @exp0
+  // CHECK-NOT: @sqrt0
+  // CHECK-NOT: @concat0
+  // CHECK: @func_arena = internal global [4096 x i8] zeroinitializer, align 64
+  // CHECK: void @func(<512 x float>* readonly %input, <1024 x float>* %out_add0)  {{.*}} {
+  // CHECK: call void @_sn_rt_exp_f32(float* {{.*}}@func_arena, i64 0, i64 0){{.*}}, i64 512)
+  // CHECK-NOT: call void @llvm.memcpy
+  // CHECK: call float @llvm.sqrt.f32
+  // CHECK: getelementptr float, float* {{.*}}@func_arena{{.*}}2048
+  // CHECK-NOT: call void @llvm.memcpy
+  // CHECK: fadd float
+  // CHECK: getelementptr float, float* {{.*}}@func_arena, i64 0, i64 0)
+  // CHECK: icmp ult i64 {{.*}}, 1024
+  // CHECK: call void @llvm.memcpy
+  // CHECK: ret void
+  // clang-format on
+}
+
+int main() { build(); }
@@ -0,0 +1,53 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  Function* func = func_builder.CreateFunction("func");
+
+  Type ty(DataType::INT8, {2, 3});
+
+  ArgumentBuilder arg_builder(func);
+  auto x = arg_builder.CreateArgument("x", ty);
+  auto y = arg_builder.CreateArgument("y", ty);
+
+  BasicBlockBuilder bb_builder(func);
+  BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+  IRBuilder ir_builder(bb);
+
+  ConcatInst* concat0 = ir_builder.CreateConcat("concat0", {*x, *y});
+  concat0->SetAxis(1);
+  ir_builder.CreateReturn("ret", *concat0);
+
+  // simulate the driver's argv[0] by reading from env var.
+  ctx.SetBasePath(getenv("HALO_BASE_PATH"));
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  pm.AddPass<GenericLLVMIRCodeGen>();
+  pm.AddPass<GenericLLVMIRWriter>(std::ref(std::cout), false);
+
+  pm.Run(&m);
+
+  // Each input is copied into its columns of the 2 rows by the byte-wise
+  // runtime kernel, whatever the element type.
+  // clang-format off
+  // CHECK: call void @_sn_rt_concat(i8* {{.*}}, i8* {{.*}}, i64 2, i64 3, i64 6, i64 0, i64 1)
+  // CHECK: call void @_sn_rt_concat(i8* {{.*}}, i8* {{.*}}, i64 2, i64 3, i64 6, i64 3, i64 1)
+  // clang-format on
+}
+
+int main() { build(); }
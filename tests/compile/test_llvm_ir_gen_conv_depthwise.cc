@@ -0,0 +1,67 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  Function* func = func_builder.CreateFunction("func");
+
+  ArgumentBuilder arg_builder(func);
+  auto input =
+      arg_builder.CreateArgument("input", Type{DataType::FLOAT32, {1, 8, 8, 16}});
+
+  BasicBlockBuilder bb_builder(func);
+  BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+  std::vector<float> w0(3 * 3 * 16, 1.0);
+  std::vector<float> b0(16, 0.5);
+
+  ConstantBuilder c_builder(func);
+  auto w = c_builder.CreateConstant("w0", Type{DataType::FLOAT32, {3, 3, 16, 1}},
+                                    w0.data());
+  auto b = c_builder.CreateConstant("b0", Type{DataType::FLOAT32, {16}},
+                                    b0.data());
+
+  IRBuilder ir_builder(bb);
+
+  // TF style depthwise conv: [h, w, in, multiplier] filter, one group per
+  // input channel, with a fused bias.
+  Conv2DInst* conv = ir_builder.CreateConv2D("conv", {*input, *w, *b});
+  conv->SetFilterFormat(DataFormat::HWCN);
+  conv->SetGroup(16);
+  ir_builder.CreateReturn("ret", *conv);
+
+  // simulate the driver's argv[0] by reading from env var.
+  ctx.SetBasePath(getenv("HALO_BASE_PATH"));
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  pm.AddPass<GenericLLVMIRCodeGen>();
+  pm.AddPass<GenericLLVMIRWriter>(std::ref(std::cout), false);
+
+  pm.Run(&m);
+
+  // clang-format off
+  // CHECK: void @func(<1024 x float>* readonly %input, <576 x float>* %out_conv)  {{.*}} {
+  // CHECK: bb0:
+  // CHECK:   call void @_sn_rt_conv2d_f32_nhwc(float* %{{.*}}, float* %{{.*}}, float* {{.*}}w0{{.*}}, float* {{.*}}b0{{.*}}, i64 1, i64 8, i64 8, i64 16, i64 6, i64 6, i64 16, i64 3, i64 3, i64 1, i64 1, i64 1, i64 1, i64 0, i64 0, i64 0, i64 0, i64 16, float 0xC7EFFFFFE0000000, float 0x47EFFFFFE0000000)
+  // CHECK:   ret void
+
+  // CHECK: define {{.*}} void @_sn_rt_conv2d_f32_nhwc
+  // CHECK:   ret void
+  // CHECK: }
+  // clang-format on
+}
+
+int main() { build(); }
@@ -0,0 +1,63 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  Function* func = func_builder.CreateFunction("func");
+
+  ArgumentBuilder arg_builder(func);
+  auto input =
+      arg_builder.CreateArgument("input", Type{DataType::FLOAT32, {1, 8, 8, 8}});
+
+  BasicBlockBuilder bb_builder(func);
+  BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+  std::vector<float> w0(3 * 3 * 8 * 8, 1.0);
+
+  ConstantBuilder c_builder(func);
+  auto w = c_builder.CreateConstant("w0", Type{DataType::FLOAT32, {3, 3, 8, 8}},
+                                    w0.data());
+
+  IRBuilder ir_builder(bb);
+
+  Conv2DInst* conv = ir_builder.CreateConv2D("conv", *input, *w);
+  conv->SetFilterFormat(DataFormat::HWCN);
+  ir_builder.CreateReturn("ret", *conv);
+
+  // simulate the driver's argv[0] by reading from env var.
+  ctx.SetBasePath(getenv("HALO_BASE_PATH"));
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  pm.AddPass<GenericLLVMIRCodeGen>();
+  pm.AddPass<GenericLLVMIRWriter>(std::ref(std::cout), false);
+
+  pm.Run(&m);
+
+  // clang-format off
+  // CHECK-NOT: @w0 =
+  // CHECK: @w0_winograd = internal constant [2304 x float]
+  // CHECK: void @func(<512 x float>* readonly %input, <288 x float>* %out_conv)  {{.*}} {
+  // CHECK: bb0:
+  // CHECK:   call void @_sn_rt_conv2d_winograd_f32_nhwc(float* %{{.*}}, float* %{{.*}}, float* {{.*}}w0_winograd{{.*}}, float* null, i64 1, i64 8, i64 8, i64 8, i64 6, i64 6, i64 8, i64 0, i64 0, float 0xC7EFFFFFE0000000, float 0x47EFFFFFE0000000)
+  // CHECK:   ret void
+
+  // CHECK: define {{.*}} void @_sn_rt_conv2d_winograd_f32_nhwc
+  // CHECK:   ret void
+  // CHECK: }
+  // clang-format on
+}
+
+int main() { build(); }
@@ -0,0 +1,94 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/target/cpu/x86/binary/x86_llvmir_codegen.h"
+#include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  Function* func = func_builder.CreateFunction("func");
+
+  ArgumentBuilder arg_builder(func);
+  auto x = arg_builder.CreateArgument("x", Type{DataType::FLOAT32, {64, 1024}});
+  auto y = arg_builder.CreateArgument("y", Type{DataType::FLOAT32, {1024}});
+
+  BasicBlockBuilder bb_builder(func);
+  BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+  IRBuilder ir_builder(bb);
+
+  Instruction* add0 = ir_builder.CreateAdd("add0", *x, *y);
+  ir_builder.CreateReturn("ret", *add0);
+
+  // simulate the driver's argv[0] by reading from env var.
+  ctx.SetBasePath(getenv("HALO_BASE_PATH"));
+  ctx.SetProcessorName("x86-64");
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  auto cg = pm.AddPass<X86LLVMIRCodeGen>();
+  cg->SetFatBinary(true);
+  pm.AddPass<GenericLLVMIRWriter>(std::ref(std::cout), false);
+
+  pm.Run(&m);
+
+  // The original function and the outlined task are kept as the baseline.
+  // Each variant clones both, and the clone of func forks the task clone of
+  // the same variant through the clone of the runtime function.
+  // clang-format off
+  // CHECK: define internal void @func_generic(
+  // CHECK: call void @_sn_rt_fork_call(void (i8*, i64, i64)* @func_task,
+  // CHECK: define internal void @func_task(
+
+  // CHECK: define internal void @func_avx512({{.*}}) #[[AVX512:[0-9]+]]
+  // CHECK-NOT: define
+  // CHECK: call void @_sn_rt_fork_call_avx512(void (i8*, i64, i64)* @func_task_avx512,
+  // CHECK: define internal void @func_task_avx512({{.*}}) #[[TASK_AVX512:[0-9]+]]
+
+  // CHECK: define internal void @func_avx2({{.*}}) #[[AVX2:[0-9]+]]
+  // CHECK-NOT: define
+  // CHECK: call void @_sn_rt_fork_call_avx2(void (i8*, i64, i64)* @func_task_avx2,
+  // CHECK: define internal void @func_task_avx2({{.*}}) #[[TASK_AVX2:[0-9]+]]
+
+  // CHECK: define internal void @func_sse42({{.*}}) #[[SSE42:[0-9]+]]
+  // CHECK-NOT: define
+  // CHECK: call void @_sn_rt_fork_call_sse42(void (i8*, i64, i64)* @func_task_sse42,
+  // CHECK: define internal void @func_task_sse42({{.*}}) #[[TASK_SSE42:[0-9]+]]
+
+  // The dispatcher takes over the name of func and tries the widest ISA first.
+  // CHECK: define void @func(
+  // CHECK-NEXT: entry:
+  // CHECK-NEXT: %[[LEVEL:[0-9]+]] = call i32 @_sn_rt_get_x86_isa_level()
+  // CHECK-NEXT: %[[GE3:[0-9]+]] = icmp sge i32 %[[LEVEL]], 3
+  // CHECK-NEXT: br i1 %[[GE3]], label %isa_avx512, label %next
+  // CHECK: isa_avx512:
+  // CHECK-NEXT: tail call void @func_avx512(
+  // CHECK: icmp sge i32 %[[LEVEL]], 2
+  // CHECK: isa_avx2:
+  // CHECK-NEXT: tail call void @func_avx2(
+  // CHECK: icmp sge i32 %[[LEVEL]], 1
+  // CHECK: isa_sse42:
+  // CHECK-NEXT: tail call void @func_sse42(
+  // CHECK: tail call void @func_generic(
+  // CHECK-NEXT: ret void
+
+  // CHECK-DAG: attributes #[[AVX512]] = { {{.*}}"target-features"="+avx512f,+avx512bw,+avx512dq,+avx512vl,+avx2,+fma,+popcnt"
+  // CHECK-DAG: attributes #[[TASK_AVX512]] = { {{.*}}"target-features"="+avx512f,+avx512bw,+avx512dq,+avx512vl,+avx2,+fma,+popcnt"
+  // CHECK-DAG: attributes #[[AVX2]] = { {{.*}}"target-features"="+avx2,+fma,+popcnt"
+  // CHECK-DAG: attributes #[[TASK_AVX2]] = { {{.*}}"target-features"="+avx2,+fma,+popcnt"
+  // CHECK-DAG: attributes #[[SSE42]] = { {{.*}}"target-features"="+sse4.2,+popcnt"
+  // CHECK-DAG: attributes #[[TASK_SSE42]] = { {{.*}}"target-features"="+sse4.2,+popcnt"
+  // clang-format on
+}
+
+int main() { build(); }
@@ -0,0 +1,70 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
+#include "halo/lib/transforms/dce.h"
+#include "halo/lib/transforms/fusion.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  Function* func = func_builder.CreateFunction("func");
+
+  ArgumentBuilder arg_builder(func);
+  auto x = arg_builder.CreateArgument("x", Type{DataType::FLOAT32, {8, 512}});
+  auto y = arg_builder.CreateArgument("y", Type{DataType::FLOAT32, {8, 512}});
+  auto z = arg_builder.CreateArgument("z", Type{DataType::FLOAT32, {512}});
+
+  BasicBlockBuilder bb_builder(func);
+  BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+  IRBuilder ir_builder(bb);
+
+  Instruction* add0 = ir_builder.CreateAdd("add0", *x, *y);
+  Instruction* mul0 = ir_builder.CreateMul("mul0", *add0, *z);
+  Instruction* relu0 = ir_builder.CreateRelu("relu0", *mul0);
+  ir_builder.CreateReturn("ret", *relu0);
+
+  // simulate the driver's argv[0] by reading from env var.
+  ctx.SetBasePath(getenv("HALO_BASE_PATH"));
+
+  Fusion::Options opts;
+  opts.ElementwiseChain = true;
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  pm.AddPass<Fusion>(opts);
+  pm.AddPass<DCE>();
+  pm.AddPass<GenericLLVMIRCodeGen>();
+  pm.AddPass<GenericLLVMIRWriter>(std::ref(std::cout), false);
+
+  pm.Run(&m);
+
+  // The chain is one loop nest over [8, 512] without runtime calls. z is
+  // broadcast along the outer loop.
+  // clang-format off
+  // CHECK: void @func(
+  // CHECK-NOT: call void @_sn_rt_
+  // CHECK: %iv0 = phi i64 [ 0, %bb0 ], [ {{.*}}, %loop.exit ]
+  // CHECK: %iv1 = phi i64 [ 0, %loop ], [ {{.*}}, %loop{{[0-9]*}} ]
+  // CHECK: fadd float
+  // CHECK: fmul float
+  // CHECK: fcmp ogt float
+  // CHECK: select i1
+  // CHECK: icmp ult i64 {{.*}}, 512
+  // CHECK: icmp ult i64 {{.*}}, 8
+  // CHECK-NOT: call void @_sn_rt_
+  // CHECK: ret void
+  // clang-format on
+}
+
+int main() { build(); }
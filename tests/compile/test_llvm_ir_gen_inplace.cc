@@ -0,0 +1,74 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  Function* func = func_builder.CreateFunction("func");
+
+  Type ty(DataType::FLOAT32, {1024});
+
+  ArgumentBuilder arg_builder(func);
+  auto input = arg_builder.CreateArgument("input", ty);
+
+  BasicBlockBuilder bb_builder(func);
+  BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+  IRBuilder ir_builder(bb);
+
+  Instruction* add0 = ir_builder.CreateAdd("add0", *input, *input);
+  Instruction* exp0 = ir_builder.CreateExp("exp0", *add0);
+  Instruction* add1 = ir_builder.CreateAdd("add1", *exp0, *add0);
+  Instruction* sqrt0 = ir_builder.CreateSqrt("sqrt0", *add1);
+  ir_builder.CreateReturn("ret", *sqrt0);
+
+  // simulate the driver's argv[0] by reading from env var.
+  ctx.SetBasePath(getenv("HALO_BASE_PATH"));
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  auto cg = pm.AddPass<GenericLLVMIRCodeGen>();
+  cg->SetPrintMemStats(true);
+  pm.AddPass<GenericLLVMIRWriter>(std::ref(std::cout), false);
+
+  pm.Run(&m);
+
+  // add0 is read again by add1, so exp0 needs a buffer of its own. add1 is
+  // computed over exp0 and sqrt0 over add1.
+  // clang-format off
+  // CHECK: Total Activation Memory: 8192 bytes
+  // CHECK-NEXT: Peak Activation Memory: 8192 bytes
+  // CHECK-NEXT: Planned Activation Memory: 8192 bytes
+  // CHECK: ModuleID = 'test_module'
+  // CHECK-NOT: @add
+  // CHECK-NOT: @exp
+  // CHECK-NOT: @sqrt
+  // CHECK: @func_arena = internal global [8192 x i8] zeroinitializer, align 64
+  // CHECK: void @func(<1024 x float>* readonly %input, <1024 x float>* %out_sqrt0)  {{.*}} {
+  // CHECK: fadd float
+  // CHECK: getelementptr float, float* {{.*}}@func_arena, i64 0, i64 [[ADD0:[0-9]+]])
+  // CHECK: icmp ult i64 {{.*}}, 1024
+  // CHECK: call void @_sn_rt_exp_f32(float* {{.*}}@func_arena, i64 0, i64 [[EXP0:[0-9]+]]){{.*}}@func_arena, i64 0, i64 [[ADD0]]){{.*}}, i64 1024)
+  // CHECK: getelementptr float, float* {{.*}}@func_arena, i64 0, i64 [[EXP0]])
+  // CHECK: getelementptr float, float* {{.*}}@func_arena, i64 0, i64 [[ADD0]])
+  // CHECK: fadd float
+  // CHECK: getelementptr float, float* {{.*}}@func_arena, i64 0, i64 [[EXP0]])
+  // CHECK: getelementptr float, float* {{.*}}@func_arena, i64 0, i64 [[EXP0]])
+  // CHECK: call float @llvm.sqrt.f32
+  // CHECK: getelementptr float, float* {{.*}}@func_arena, i64 0, i64 [[EXP0]])
+  // CHECK: ret void
+  // clang-format on
+}
+
+int main() { build(); }
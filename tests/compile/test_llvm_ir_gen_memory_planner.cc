@@ -0,0 +1,65 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  Function* func = func_builder.CreateFunction("func");
+
+  Type ty(DataType::FLOAT32, {32, 32});
+
+  ArgumentBuilder arg_builder(func);
+  auto input = arg_builder.CreateArgument("input", ty);
+
+  BasicBlockBuilder bb_builder(func);
+  BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+  IRBuilder ir_builder(bb);
+
+  Instruction* mm0 = ir_builder.CreateMatMul("mm0", *input, *input);
+  Instruction* mm1 = ir_builder.CreateMatMul("mm1", *mm0, *mm0);
+  Instruction* mm2 = ir_builder.CreateMatMul("mm2", *mm1, *mm1);
+  Instruction* mm3 = ir_builder.CreateMatMul("mm3", *mm2, *mm2);
+  ir_builder.CreateReturn("ret", *mm3);
+
+  // simulate the driver's argv[0] by reading from env var.
+  ctx.SetBasePath(getenv("HALO_BASE_PATH"));
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  auto cg = pm.AddPass<GenericLLVMIRCodeGen>();
+  cg->SetPrintMemStats(true);
+  pm.AddPass<GenericLLVMIRWriter>(std::ref(std::cout), false);
+
+  pm.Run(&m);
+
+  // Each activation is 4096 bytes and lives until the next matmul, so mm2 and
+  // mm3 reuse the memory of mm0 and mm1.
+  // clang-format off
+  // CHECK: Total Activation Memory: 16384 bytes
+  // CHECK-NEXT: Peak Activation Memory: 8192 bytes
+  // CHECK-NEXT: Planned Activation Memory: 8192 bytes
+  // CHECK: ModuleID = 'test_module'
+  // CHECK-NOT: @mm
+  // CHECK: @func_arena = internal global [8192 x i8] zeroinitializer, align 64
+  // CHECK: void @func(<1024 x float>* readonly %input, <1024 x float>* %out_mm3)  {{.*}} {
+  // CHECK: call void @_sn_rt_matmul_f32(float* {{.*}}@func_arena, i64 0, i64 0)
+  // CHECK: call void @_sn_rt_matmul_f32(float* {{.*}}@func_arena, i64 0, i64 4096)
+  // CHECK: call void @_sn_rt_matmul_f32(float* {{.*}}@func_arena, i64 0, i64 0)
+  // CHECK: call void @_sn_rt_matmul_f32(float* {{.*}}@func_arena, i64 0, i64 4096)
+  // CHECK: ret void
+  // clang-format on
+}
+
+int main() { build(); }
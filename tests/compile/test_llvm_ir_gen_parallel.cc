@@ -0,0 +1,66 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  Function* func = func_builder.CreateFunction("func");
+
+  ArgumentBuilder arg_builder(func);
+  auto x = arg_builder.CreateArgument("x", Type{DataType::FLOAT32, {64, 1024}});
+  auto y = arg_builder.CreateArgument("y", Type{DataType::FLOAT32, {1024}});
+  auto z = arg_builder.CreateArgument("z", Type{DataType::FLOAT32, {16}});
+
+  BasicBlockBuilder bb_builder(func);
+  BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+  IRBuilder ir_builder(bb);
+
+  Instruction* add0 = ir_builder.CreateAdd("add0", *x, *y);
+  Instruction* sqrt0 = ir_builder.CreateSqrt("sqrt0", *z);
+  ir_builder.CreateReturn("ret", std::vector<Def>{*add0, *sqrt0});
+
+  // simulate the driver's argv[0] by reading from env var.
+  ctx.SetBasePath(getenv("HALO_BASE_PATH"));
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  pm.AddPass<GenericLLVMIRCodeGen>();
+  pm.AddPass<GenericLLVMIRWriter>(std::ref(std::cout), false);
+
+  pm.Run(&m);
+
+  // add0 is outlined and its 64 rows are split into tasks of 32 rows (32K
+  // elements). sqrt0 is too small and runs inline.
+  // clang-format off
+  // CHECK: define void @func(
+  // CHECK: %task_ctx = alloca [3 x i8*]
+  // CHECK: call void @_sn_rt_fork_call(void (i8*, i64, i64)* @func_task, i8* %{{.*}}, i64 64, i64 32)
+  // CHECK-NOT: call void @_sn_rt_fork_call
+  // CHECK: call float @llvm.sqrt.f32
+  // CHECK-NOT: call void @_sn_rt_fork_call
+  // CHECK: ret void
+  // CHECK: define internal void @func_task(i8* %0, i64 %1, i64 %2)
+  // CHECK: %task_ctx = bitcast i8* %0 to i8**
+  // CHECK: sub i64 %2, %1
+  // CHECK: %iv0 = phi i64
+  // CHECK: add nuw i64 %1, %iv0
+  // CHECK: fadd float
+  // CHECK: icmp ult i64 {{.*}}, 1024
+  // CHECK: ret void
+  // CHECK: define {{.*}} void @_sn_rt_fork_call
+  // clang-format on
+}
+
+int main() { build(); }
@@ -0,0 +1,53 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/target/generic_llvmir/generic_llvmir_codegen.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  Function* func = func_builder.CreateFunction("func");
+
+  Type ty(DataType::FLOAT32, {2, 4});
+
+  ArgumentBuilder arg_builder(func);
+  auto input = arg_builder.CreateArgument("input", ty);
+
+  BasicBlockBuilder bb_builder(func);
+  BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+  IRBuilder ir_builder(bb);
+
+  Instruction* sigmoid0 = ir_builder.CreateSigmoid("sigmoid0", *input);
+  Instruction* tanh0 = ir_builder.CreateTanh("tanh0", *sigmoid0);
+  Instruction* exp0 = ir_builder.CreateExp("exp0", *tanh0);
+  ir_builder.CreateReturn("ret", *exp0);
+
+  // simulate the driver's argv[0] by reading from env var.
+  ctx.SetBasePath(getenv("HALO_BASE_PATH"));
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  pm.AddPass<GenericLLVMIRCodeGen>();
+  pm.AddPass<GenericLLVMIRWriter>(std::ref(std::cout), false);
+
+  pm.Run(&m);
+  // clang-format off
+  // CHECK: define void @func(<8 x float>* readonly %input, <8 x float>* %out_exp0) {{.*}} {
+  // CHECK: call void @_sn_rt_sigmoid_f32(float* %{{.*}}, float* %{{.*}}, i64 8)
+  // CHECK: call void @_sn_rt_tanh_f32(float* %{{.*}}, float* %{{.*}}, i64 8)
+  // CHECK: call void @_sn_rt_exp_f32(float* %{{.*}}, float* %{{.*}}, i64 8)
+  // CHECK: ret void
+  // clang-format on
+}
+
+int main() { build(); }
\ No newline at end of file
@@ -0,0 +1,83 @@
+// RUN: %cxx %s -o %t %flags %include %link -DBUILD_IR
+// RUN: %t > %t.a
+// RUN: %cxx %s %t.a -o %t2 -pthread
+// RUN: %t2  2>&1| FileCheck %s
+
+#ifdef BUILD_IR
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/target/cpu/x86/binary/x86_llvmir_codegen.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void Build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+  Type ty{DataType::FLOAT32, {4}};
+
+  // Two functions so that each of the two threads compiles a partition.
+  Function* add_func = func_builder.CreateFunction("add_func");
+  ArgumentBuilder add_arg_builder(add_func);
+  auto add_x = add_arg_builder.CreateArgument("x", ty);
+  auto add_y = add_arg_builder.CreateArgument("y", ty);
+  BasicBlockBuilder add_bb_builder(add_func);
+  IRBuilder add_builder(add_bb_builder.CreateBasicBlock("bb0"));
+  Instruction* add = add_builder.CreateAdd("add", *add_x, *add_y);
+  add_builder.CreateReturn("ret", *add);
+
+  Function* mul_func = func_builder.CreateFunction("mul_func");
+  ArgumentBuilder mul_arg_builder(mul_func);
+  auto mul_x = mul_arg_builder.CreateArgument("x", ty);
+  auto mul_y = mul_arg_builder.CreateArgument("y", ty);
+  BasicBlockBuilder mul_bb_builder(mul_func);
+  IRBuilder mul_builder(mul_bb_builder.CreateBasicBlock("bb0"));
+  Instruction* mul = mul_builder.CreateMul("mul", *mul_x, *mul_y);
+  mul_builder.CreateReturn("ret", *mul);
+
+  // simulate the driver's argv[0] by reading from env var.
+  ctx.SetBasePath(getenv("HALO_BASE_PATH"));
+  // Same as -codegen-threads=2: the object code is emitted as an archive.
+  ctx.SetNumOfCodeGenThreads(2);
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  pm.AddPass<X86LLVMIRCodeGen>();
+  pm.AddPass<X86BinaryWriter>(std::ref(std::cout));
+
+  pm.Run(&m);
+}
+
+int main() { Build(); }
+
+#else
+
+#include <stdio.h>
+
+extern "C" {
+extern void add_func(const float* x, const float* y, float* out);
+extern void mul_func(const float* x, const float* y, float* out);
+}
+
+int main() {
+  float x[] = {1.0f, 2.0f, 3.0f, 4.0f};
+  float y[] = {5.0f, 6.0f, 7.0f, 8.0f};
+  float sum[4];
+  float prod[4];
+  add_func(x, y, sum);
+  mul_func(x, y, prod);
+  // CHECK: 6.000000 8.000000 10.000000 12.000000
+  // CHECK: 5.000000 12.000000 21.000000 32.000000
+  for (int i = 0; i < 4; ++i) {
+    printf("%f ", sum[i]);
+  }
+  printf("\n");
+  for (int i = 0; i < 4; ++i) {
+    printf("%f ", prod[i]);
+  }
+  printf("\n");
+}
+#endif
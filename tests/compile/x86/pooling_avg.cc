@@ -0,0 +1,87 @@
+// RUN: %cxx %s -o %t %flags %include %link -DBUILD_IR
+// RUN: %t > %t.obj
+// RUN: %cxx %s %t.obj %flags -static -o %t2
+// RUN: %t2  2>&1| FileCheck %s
+
+#ifdef BUILD_IR
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/target/cpu/x86/binary/x86_llvmir_codegen.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void Build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  // func counts the padded positions (the default), func_exclude_pad does not.
+  for (bool count_include_pad : {true, false}) {
+    Function* func = func_builder.CreateFunction(
+        count_include_pad ? "func" : "func_exclude_pad");
+
+    ArgumentBuilder arg_builder(func);
+    auto input = arg_builder.CreateArgument(
+        "input", Type{DataType::FLOAT32, {1, 4, 4, 1}});
+
+    BasicBlockBuilder bb_builder(func);
+    BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+    IRBuilder ir_builder(bb);
+
+    PoolingAvgInst* pooling = ir_builder.CreatePoolingAvg("pooling", *input);
+    pooling->SetKsize({1, 3, 3, 1});
+    pooling->SetStrides({1, 2, 2, 1});
+    pooling->SetPadding(Padding::SAME);
+    pooling->SetCountIncludePad(count_include_pad);
+    ir_builder.CreateReturn("ret", *pooling);
+  }
+
+  // simulate the driver's argv[0] by reading from env var.
+  ctx.SetBasePath(getenv("HALO_BASE_PATH"));
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  // pm.AddPass<GenericLLVMIRCodeGen>();
+  // pm.AddPass<GenericLLVMIRWriter>(std::ref(std::cout), false);
+  pm.AddPass<X86LLVMIRCodeGen>();
+  pm.AddPass<X86BinaryWriter>(std::ref(std::cout));
+
+  pm.Run(&m);
+}
+
+int main() { Build(); }
+
+#else
+
+#include <stdio.h>
+
+extern "C" {
+extern void func(float* input, float* output);
+extern void func_exclude_pad(float* input, float* output);
+}
+
+int main() {
+  float input[16];
+  for (int i = 0; i < 16; ++i) {
+    input[i] = i + 1;
+  }
+  float output[4] = {0.0};
+  func(input, output);
+  // Windows are divided by the kernel size.
+  // CHECK: 6.000000 5.000000 8.000000 6.000000
+  for (int i = 0; i < 4; ++i) {
+    printf("%f ", output[i]);
+  }
+  printf("\n");
+  func_exclude_pad(input, output);
+  // Padded positions (bottom and right) are not counted.
+  // CHECK: 6.000000 7.500000 12.000000 13.500000
+  for (int i = 0; i < 4; ++i) {
+    printf("%f ", output[i]);
+  }
+}
+#endif
\ No newline at end of file
@@ -1,6 +1,6 @@
 // RUN: %cxx %s -o %t %flags %include %link -DBUILD_IR
 // RUN: %t > %t.obj
-// RUN: %cxx %s %t.obj -o %t2 %include
+// RUN: %cxx %s %t.obj -o %t2 %include -pthread
 // RUN: %t2 2>&1| FileCheck %s
 
 #ifdef BUILD_IR
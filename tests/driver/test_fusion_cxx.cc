@@ -0,0 +1,30 @@
+//===- test_fusion_cxx.cc -------------------------------------------------===//
+//
+// Copyright (C) 2019-2020 Alibaba Group Holding Limited.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+// The GELU and elementwise fusions are only enabled for the LLVM targets: the
+// C++ codegen emits the unfused ODLA calls.
+
+// clang-format off
+
+// RUN: %halo_compiler -target cxx -fuse-matmul-bias-gelu -fuse-add-relu -fuse-elementwise-chain -disable-code-format -o %t.cc %S/Inputs/gelu_add_relu.pbtxt
+// RUN: FileCheck %s < %t.cc
+
+// CHECK: odla_Gemm
+// CHECK: odla_Erf
+// CHECK: odla_Mul
+// CHECK: odla_Add
+// CHECK: odla_Relu
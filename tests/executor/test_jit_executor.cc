@@ -0,0 +1,109 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "halo/lib/executor/jit_executor.h"
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+static void Build(Module* m) {
+  FunctionBuilder func_builder(m);
+  Function* func = func_builder.CreateFunction("func");
+
+  Type ty(DataType::FLOAT32, {2, 4});
+  ArgumentBuilder arg_builder(func);
+  auto x = arg_builder.CreateArgument("x", ty);
+  auto y = arg_builder.CreateArgument("y", Type{DataType::FLOAT32, {4}});
+
+  BasicBlockBuilder bb_builder(func);
+  BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+  std::vector<float> w0{1, 2, 3, 4, 5, 6, 7, 8};
+  ConstantBuilder c_builder(func);
+  auto c0 = c_builder.CreateConstant("w0", ty, w0.data());
+
+  IRBuilder ir_builder(bb);
+  Instruction* add0 = ir_builder.CreateAdd("add0", *x, *y);
+  Instruction* mul0 = ir_builder.CreateMul("mul0", *add0, *c0);
+  Instruction* sqrt0 = ir_builder.CreateSqrt("sqrt0", *mul0);
+  ir_builder.CreateReturn("ret", std::vector<Def>{*sqrt0, *add0});
+
+  PassManager pm(m->GetGlobalContext());
+  pm.AddPass<TypeLegalizer>();
+  pm.Run(m);
+}
+
+static void Print(const std::vector<float>& v) {
+  for (float x : v) {
+    std::cout << x << " ";
+  }
+  std::cout << std::endl;
+}
+
+int main() {
+  GlobalContext ctx;
+  // simulate the driver's argv[0] by reading from env var.
+  ctx.SetBasePath(getenv("HALO_BASE_PATH"));
+
+  std::vector<float> x{0, 1, 2, 3, 4, 5, 6, 7};
+  std::vector<float> y{1, 1, 1, 1};
+  std::vector<float> out0(8);
+  std::vector<float> out1(8);
+
+  Module m0(ctx, "test_module");
+  Build(&m0);
+  JITExecutor executor;
+  Status status = executor.Compile(&m0);
+  std::cout << "compiled: " << (status == Status::SUCCESS)
+            << " cached: " << executor.IsCacheHit() << std::endl;
+  executor.Run({x.data(), y.data()}, {out0.data(), out1.data()});
+  Print(out0);
+  Print(out1);
+
+  // The same module is not compiled again.
+  Module m1(ctx, "test_module");
+  Build(&m1);
+  JITExecutor executor1;
+  executor1.Compile(&m1);
+  std::cout << "cached: " << executor1.IsCacheHit() << std::endl;
+
+  // Wrong number of buffers.
+  status = executor1.Run({x.data()}, {out0.data()});
+  std::cout << "illegal: " << (status == Status::ILLEGAL_PARAM) << std::endl;
+
+  // Concurrent runs of the shared code are serialized.
+  const std::vector<float> expected{1, 2, 3, 4, 5, 6, 7, 8};
+  std::atomic<int> mismatches{0};
+  std::vector<std::thread> threads;
+  for (JITExecutor* e : {&executor, &executor1}) {
+    threads.emplace_back([&, e] {
+      std::vector<float> ret0(8);
+      std::vector<float> ret1(8);
+      for (int i = 0; i < 1000; ++i) {
+        e->Run({x.data(), y.data()}, {ret0.data(), ret1.data()});
+        mismatches += ret0 != expected || ret1 != expected;
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  std::cout << "mismatches: " << mismatches << std::endl;
+
+  // clang-format off
+  // CHECK: compiled: 1 cached: 0
+  // CHECK-NEXT: 1 2 3 4 5 6 7 8
+  // CHECK-NEXT: 1 2 3 4 5 6 7 8
+  // CHECK-NEXT: cached: 1
+  // CHECK-NEXT: illegal: 1
+  // CHECK-NEXT: mismatches: 0
+  // clang-format on
+}
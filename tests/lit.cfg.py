@@ -42,7 +42,8 @@ odla_path = os.path.sep.join((config.halo_src_dir, 'ODLA'))
 link_path = '-Wl,-rpath=%s -L %s ' % (
     config.halo_lib_dir, config.halo_lib_dir)
 
-flags = '-std=c++17'
+# The runtime library runs large kernels on a thread pool.
+flags = '-std=c++17 -pthread'
 if (config.build_type.lower() == "debug"):
     flags = flags + " -O0 -g"
 
@@ -0,0 +1,60 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: env HALO_NUM_THREADS=3 %t 2>&1| FileCheck %s
+
+#include <atomic>
+#include <iostream>
+#include <vector>
+
+#include "halo/lib/threadpool/threadpool.h"
+
+using namespace halo;
+
+int main() {
+  ThreadPool* pool = ThreadPool::GetDefault();
+  // CHECK: threads: 3
+  std::cout << "threads: " << pool->GetNumOfThreads() << std::endl;
+
+  const int64_t n = 100003;
+  std::vector<std::atomic<int>> hits(n);
+  std::atomic<bool> nested_serial{true};
+  pool->ParallelFor(n, 64, [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i) {
+      ++hits[i];
+    }
+    nested_serial = nested_serial && ThreadPool::InParallelRegion();
+    // Nested loops run on the calling thread.
+    pool->ParallelFor(4, 1, [&](int64_t b, int64_t e) {
+      nested_serial = nested_serial && b == 0 && e == 4;
+    });
+  });
+  int covered = 0;
+  for (auto& hit : hits) {
+    covered += hit == 1 ? 1 : 0;
+  }
+  // CHECK: covered: 100003
+  std::cout << "covered: " << covered << std::endl;
+  // CHECK: nested serial: 1
+  std::cout << "nested serial: " << nested_serial << std::endl;
+
+  std::vector<std::atomic<int>> tiles(37 * 53);
+  pool->ParallelFor2D(37, 53, 4, 9,
+                      [&](int64_t b0, int64_t e0, int64_t b1, int64_t e1) {
+                        for (int64_t i = b0; i < e0; ++i) {
+                          for (int64_t j = b1; j < e1; ++j) {
+                            ++tiles[i * 53 + j];
+                          }
+                        }
+                      });
+  covered = 0;
+  for (auto& hit : tiles) {
+    covered += hit == 1 ? 1 : 0;
+  }
+  // CHECK: covered 2d: 1961
+  std::cout << "covered 2d: " << covered << std::endl;
+
+  ThreadPool::SetDefaultNumOfThreads(2);
+  // CHECK: threads: 2
+  std::cout << "threads: " << ThreadPool::GetDefault()->GetNumOfThreads()
+            << std::endl;
+  return 0;
+}
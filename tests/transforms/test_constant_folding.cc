@@ -0,0 +1,83 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/transforms/constant_folding.h"
+#include "halo/lib/transforms/dce.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  Function* func = func_builder.CreateFunction("func");
+
+  ArgumentBuilder arg_builder(func);
+  auto input =
+      arg_builder.CreateArgument("input", Type{DataType::FLOAT32, {2, 8}});
+
+  BasicBlockBuilder bb_builder(func);
+  BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+  std::vector<int64_t> shape{1, 2, 8};
+  std::vector<int32_t> indices{2, 1};
+  std::vector<float> w0{1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+
+  ConstantBuilder c_builder(func);
+  auto c_shape = c_builder.CreateConstant(
+      "shape", Type{DataType::INT64, {3}}, shape.data());
+  auto c_indices = c_builder.CreateConstant(
+      "indices", Type{DataType::INT32, {2}}, indices.data());
+  auto w = c_builder.CreateConstant("w0", Type{DataType::FLOAT32, {2, 3}},
+                                    w0.data());
+
+  IRBuilder ir_builder(bb);
+
+  // Shape computation: reshape(input, gather(shape, [2, 1])).
+  Instruction* g = ir_builder.CreateGather("g", {*c_shape, *c_indices});
+  Instruction* r = ir_builder.CreateReshape("r", {*input, *g});
+
+  // add(reduce_sum(transpose(w0), axis=1), ...) is evaluated entirely.
+  TransposeInst* t = ir_builder.CreateTranspose("t", {*w});
+  t->SetPermutation({1, 0});
+  ReduceSumInst* s = ir_builder.CreateReduceSum("s", {*t});
+  s->SetAxis({1});
+  s->SetKeepDims(false);
+  Instruction* e = ir_builder.CreateAdd("e", *s, *s);
+
+  // A matmul with a fused activation is left alone.
+  MatMulInst* mm = ir_builder.CreateMatMul("mm", {*w, *w});
+  mm->SetTransposeB(true);
+  mm->SetActivation(ActivationType::RELU);
+  ir_builder.CreateReturn("ret", std::vector<Def>{*r, *e, *mm});
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>(true);
+  pm.AddPass<ConstantFolding>();
+  pm.AddPass<TypeLegalizer>(true);
+  pm.AddPass<DCE>();
+  pm.Run(&m);
+
+  m.Dump();
+
+  // clang-format off
+  // CHECK: Function: func
+  // CHECK-NOT: Constant
+  // CHECK: Constant w0([FLOAT32: 2x3])
+  // CHECK-NEXT: Constant g_folded([INT64: 2]) = [8, 2]
+  // CHECK-NEXT: Constant e_folded([FLOAT32: 3]) = [10, 14, 18]
+  // CHECK-NOT: Constant
+  // CHECK: BasicBlock: bb0
+  // CHECK-NEXT: Inst: r([FLOAT32: 8x2]) = reshape(<input, 0>:[FLOAT32: 2x8], <g_folded, 0>:[INT64: 2])
+  // CHECK-NEXT: Inst: mm([FLOAT32: 2x2]) = matmul(<w0, 0>:[FLOAT32: 2x3], <w0, 0>:[FLOAT32: 2x3]
+  // CHECK-NEXT: Inst: ret() = return(<r, 0>:[FLOAT32: 8x2], <e_folded, 0>:[FLOAT32: 3], <mm, 0>:[FLOAT32: 2x2])
+  // clang-format on
+}
+
+int main() { build(); }
@@ -0,0 +1,72 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/transforms/cse.h"
+#include "halo/lib/transforms/dce.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  Function* func = func_builder.CreateFunction("func");
+
+  ArgumentBuilder arg_builder(func);
+  auto input =
+      arg_builder.CreateArgument("input", Type{DataType::FLOAT32, {2, 8}});
+
+  BasicBlockBuilder bb_builder(func);
+  BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+  std::vector<int64_t> shape{8, 2};
+
+  ConstantBuilder c_builder(func);
+  auto s0 = c_builder.CreateConstant("s0", Type{DataType::INT64, {2}},
+                                     shape.data());
+  auto s1 = c_builder.CreateConstant("s1", Type{DataType::INT64, {2}},
+                                     shape.data());
+
+  IRBuilder ir_builder(bb);
+
+  // Two identical reshape + transpose chains over identical shapes.
+  Instruction* r0 = ir_builder.CreateReshape("r0", {*input, *s0});
+  Instruction* r1 = ir_builder.CreateReshape("r1", {*input, *s1});
+  TransposeInst* t0 = ir_builder.CreateTranspose("t0", {*r0});
+  t0->SetPermutation({1, 0});
+  TransposeInst* t1 = ir_builder.CreateTranspose("t1", {*r1});
+  t1->SetPermutation({1, 0});
+  // Same operand, different attributes.
+  TransposeInst* t2 = ir_builder.CreateTranspose("t2", {*r1});
+  t2->SetPermutation({0, 1});
+  Instruction* add = ir_builder.CreateAdd("add", *t0, *t1);
+  ir_builder.CreateReturn("ret", std::vector<Def>{*add, *t2});
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  pm.AddPass<CSE>();
+  pm.AddPass<DCE>();
+  pm.Run(&m);
+
+  m.Dump();
+
+  // clang-format off
+  // CHECK: Function: func
+  // CHECK: Constant s0([INT64: 2]) = [8, 2]
+  // CHECK-NOT: Constant s1
+  // CHECK: BasicBlock: bb0
+  // CHECK-NEXT: Inst: r0([FLOAT32: 8x2]) = reshape(<input, 0>:[FLOAT32: 2x8], <s0, 0>:[INT64: 2])
+  // CHECK-NEXT: Inst: t0([FLOAT32: 2x8]) = transpose(<r0, 0>:[FLOAT32: 8x2])
+  // CHECK-NEXT: Inst: t2([FLOAT32: 8x2]) = transpose(<r0, 0>:[FLOAT32: 8x2])
+  // CHECK-NEXT: Inst: add([FLOAT32: 2x8]) = add(<t0, 0>:[FLOAT32: 2x8], <t0, 0>:[FLOAT32: 2x8])
+  // CHECK-NEXT: Inst: ret() = return(<add, 0>:[FLOAT32: 2x8], <t2, 0>:[FLOAT32: 8x2])
+  // clang-format on
+}
+
+int main() { build(); }
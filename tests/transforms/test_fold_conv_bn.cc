@@ -0,0 +1,118 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/transforms/dce.h"
+#include "halo/lib/transforms/inst_simplify.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  // conv (NCHW, OIHW) + bias + batchnorm.
+  {
+    Function* func = func_builder.CreateFunction("func0");
+    ArgumentBuilder arg_builder(func);
+    auto input = arg_builder.CreateArgument(
+        "input", Type{DataType::FLOAT32, {1, 2, 4, 4}});
+
+    BasicBlockBuilder bb_builder(func);
+    BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+    std::vector<float> w0{1.0, 2.0, 3.0, 4.0};
+    std::vector<float> b0{1.0, 1.0};
+    std::vector<float> scale{4.0, 1.0};
+    std::vector<float> offset{1.0, 0.0};
+    std::vector<float> mean{1.0, 2.0};
+    std::vector<float> var{4.0, 1.0};
+
+    ConstantBuilder c_builder(func);
+    auto w = c_builder.CreateConstant(
+        "w0", Type{DataType::FLOAT32, {2, 2, 1, 1}}, w0.data());
+    auto b = c_builder.CreateConstant(
+        "b0", Type{DataType::FLOAT32, {1, 2, 1, 1}}, b0.data());
+    auto c_scale = c_builder.CreateConstant(
+        "scale", Type{DataType::FLOAT32, {2}}, scale.data());
+    auto c_offset = c_builder.CreateConstant(
+        "offset", Type{DataType::FLOAT32, {2}}, offset.data());
+    auto c_mean = c_builder.CreateConstant(
+        "mean", Type{DataType::FLOAT32, {2}}, mean.data());
+    auto c_var = c_builder.CreateConstant("var", Type{DataType::FLOAT32, {2}},
+                                          var.data());
+
+    IRBuilder ir_builder(bb);
+    Conv2DInst* conv = ir_builder.CreateConv2D("conv", {*input, *w});
+    conv->SetDataFormat(DataFormat::NCHW);
+    conv->SetFilterFormat(DataFormat::NCHW);
+    Instruction* add = ir_builder.CreateAdd("add", *conv, *b);
+    BatchNormInst* bn = ir_builder.CreateBatchNorm(
+        "bn", {*add, *c_scale, *c_offset, *c_mean, *c_var});
+    bn->SetDataFormat(DataFormat::NCHW);
+    bn->SetEpsilon(0);
+    ir_builder.CreateReturn("ret", *bn);
+  }
+
+  // conv (NHWC, HWIO) * per-channel scale.
+  {
+    Function* func = func_builder.CreateFunction("func1");
+    ArgumentBuilder arg_builder(func);
+    auto input = arg_builder.CreateArgument(
+        "input", Type{DataType::FLOAT32, {1, 4, 4, 2}});
+
+    BasicBlockBuilder bb_builder(func);
+    BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+    std::vector<float> w1{1.0, 2.0, 3.0, 4.0};
+    std::vector<float> s1{2.0, 3.0};
+
+    ConstantBuilder c_builder(func);
+    auto w = c_builder.CreateConstant(
+        "w1", Type{DataType::FLOAT32, {1, 1, 2, 2}}, w1.data());
+    auto s = c_builder.CreateConstant("s1", Type{DataType::FLOAT32, {2}},
+                                      s1.data());
+
+    IRBuilder ir_builder(bb);
+    Conv2DInst* conv = ir_builder.CreateConv2D("conv", {*input, *w});
+    conv->SetDataFormat(DataFormat::NHWC);
+    conv->SetFilterFormat(DataFormat::HWCN);
+    Instruction* mul = ir_builder.CreateMul("mul", *conv, *s);
+    ir_builder.CreateReturn("ret", *mul);
+  }
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  pm.AddPass<InstSimplify>();
+  pm.AddPass<DCE>();
+  pm.Run(&m);
+
+  m.Dump();
+
+  // The weights are scaled by scale / sqrt(var) = [2, 1] along the output
+  // channels and the bias becomes (b0 - mean) * [2, 1] + offset.
+  // clang-format off
+  // CHECK: Function: func0
+  // CHECK-NOT: Constant w0(
+  // CHECK: Constant w0_folded_{{[0-9]+}}([FLOAT32: 2x2x1x1]) = [2, 4, 3, 4]
+  // CHECK: Constant bn_bias_folded_{{[0-9]+}}([FLOAT32: 1x2x1x1]) = [1, -1]
+  // CHECK: BasicBlock: bb0
+  // CHECK-NEXT: Inst: conv_folded_{{[0-9]+}}([FLOAT32: 1x2x4x4]) = conv2d(<input, 0>:[FLOAT32: 1x2x4x4], <w0_folded_{{[0-9]+}}, 0>:[FLOAT32: 2x2x1x1])
+  // CHECK-NEXT: Inst: bn([FLOAT32: 1x2x4x4]) = add(<conv_folded_{{[0-9]+}}, 0>:[FLOAT32: 1x2x4x4], <bn_bias_folded_{{[0-9]+}}, 0>:[FLOAT32: 1x2x1x1])
+  // CHECK-NEXT: Inst: ret() = return(<bn, 0>:[FLOAT32: 1x2x4x4])
+
+  // CHECK: Function: func1
+  // CHECK-NOT: Constant w1(
+  // CHECK: Constant w1_folded_{{[0-9]+}}([FLOAT32: 1x1x2x2]) = [2, 6, 6, 12]
+  // CHECK: BasicBlock: bb0
+  // CHECK-NEXT: Inst: conv_folded_{{[0-9]+}}([FLOAT32: 1x4x4x2]) = conv2d(<input, 0>:[FLOAT32: 1x4x4x2], <w1_folded_{{[0-9]+}}, 0>:[FLOAT32: 1x1x2x2])
+  // CHECK-NEXT: Inst: ret() = return(<conv_folded_{{[0-9]+}}, 0>:[FLOAT32: 1x4x4x2])
+  // clang-format on
+}
+
+int main() { build(); }
@@ -0,0 +1,99 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/transforms/dce.h"
+#include "halo/lib/transforms/fusion.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  // relu(conv + bias) and relu6(bias + conv).
+  for (int i = 0; i < 2; ++i) {
+    Function* func = func_builder.CreateFunction("func" + std::to_string(i));
+    ArgumentBuilder arg_builder(func);
+    auto input = arg_builder.CreateArgument(
+        "input", Type{DataType::FLOAT32, {1, 4, 4, 2}});
+
+    BasicBlockBuilder bb_builder(func);
+    BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+    std::vector<float> w0{1.0, 2.0, 3.0, 4.0};
+    std::vector<float> b0{1.0, -1.0};
+
+    ConstantBuilder c_builder(func);
+    auto w = c_builder.CreateConstant(
+        "w0", Type{DataType::FLOAT32, {1, 1, 2, 2}}, w0.data());
+    auto b = c_builder.CreateConstant("b0", Type{DataType::FLOAT32, {2}},
+                                      b0.data());
+
+    IRBuilder ir_builder(bb);
+    Conv2DInst* conv = ir_builder.CreateConv2D("conv", {*input, *w});
+    conv->SetDataFormat(DataFormat::NHWC);
+    conv->SetFilterFormat(DataFormat::HWCN);
+    if (i == 0) {
+      Instruction* add = ir_builder.CreateAdd("add", *conv, *b);
+      ir_builder.CreateReturn("ret", *ir_builder.CreateRelu("act", *add));
+    } else {
+      Instruction* add = ir_builder.CreateAdd("add", *b, *conv);
+      ir_builder.CreateReturn("ret", *ir_builder.CreateRelu6("act", *add));
+    }
+  }
+
+  // relu((x + y) * z) with a broadcast z.
+  {
+    Function* func = func_builder.CreateFunction("func2");
+    ArgumentBuilder arg_builder(func);
+    auto x = arg_builder.CreateArgument("x", Type{DataType::FLOAT32, {2, 4}});
+    auto y = arg_builder.CreateArgument("y", Type{DataType::FLOAT32, {2, 4}});
+    auto z = arg_builder.CreateArgument("z", Type{DataType::FLOAT32, {4}});
+
+    BasicBlockBuilder bb_builder(func);
+    BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+    IRBuilder ir_builder(bb);
+    Instruction* add = ir_builder.CreateAdd("add", *x, *y);
+    Instruction* mul = ir_builder.CreateMul("mul", *add, *z);
+    ir_builder.CreateReturn("ret", *ir_builder.CreateRelu("act", *mul));
+  }
+
+  Fusion::Options opts;
+  opts.ConvBiasRelu = true;
+  opts.ConvBiasRelu6 = true;
+  opts.ElementwiseChain = true;
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  pm.AddPass<Fusion>(opts);
+  pm.AddPass<DCE>();
+  pm.Run(&m);
+
+  m.Dump();
+
+  // clang-format off
+  // CHECK: Function: func0
+  // CHECK: BasicBlock: bb0
+  // CHECK-NEXT: Inst: act_fused([FLOAT32: 1x4x4x2]) = conv2d(<input, 0>:[FLOAT32: 1x4x4x2], <w0, 0>:[FLOAT32: 1x1x2x2], <b0, 0>:[FLOAT32: 2])
+  // CHECK-NEXT: Inst: ret() = return(<act_fused, 0>:[FLOAT32: 1x4x4x2])
+
+  // CHECK: Function: func1
+  // CHECK: BasicBlock: bb0
+  // CHECK-NEXT: Inst: act_fused([FLOAT32: 1x4x4x2]) = conv2d(<input, 0>:[FLOAT32: 1x4x4x2], <w0, 0>:[FLOAT32: 1x1x2x2], <b0, 0>:[FLOAT32: 2])
+  // CHECK-NEXT: Inst: ret() = return(<act_fused, 0>:[FLOAT32: 1x4x4x2])
+
+  // CHECK: Function: func2
+  // CHECK: BasicBlock: bb0
+  // CHECK-NEXT: Inst: act_fused([FLOAT32: 2x4]) = fusedelementwise(<x, 0>:[FLOAT32: 2x4], <y, 0>:[FLOAT32: 2x4], <z, 0>:[FLOAT32: 4])
+  // CHECK-NEXT: Inst: ret() = return(<act_fused, 0>:[FLOAT32: 2x4])
+  // clang-format on
+}
+
+int main() { build(); }
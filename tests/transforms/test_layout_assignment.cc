@@ -0,0 +1,101 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/transforms/dce.h"
+#include "halo/lib/transforms/layout_assignment.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  const std::vector<int> nhwc2nchw{0, 3, 1, 2};
+  const std::vector<int> nchw2nhwc{0, 2, 3, 1};
+
+  // NHWC input computed in NCHW and transposed back.
+  {
+    Function* func = func_builder.CreateFunction("func0");
+    ArgumentBuilder arg_builder(func);
+    auto input = arg_builder.CreateArgument(
+        "input", Type{DataType::FLOAT32, {1, 4, 4, 2}});
+
+    BasicBlockBuilder bb_builder(func);
+    BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+    std::vector<float> b0{1.0, -1.0};
+    std::vector<int32_t> p0{0, 0, 0, 0, 1, 1, 2, 2};
+
+    ConstantBuilder c_builder(func);
+    auto b = c_builder.CreateConstant("b0", Type{DataType::FLOAT32, {2, 1, 1}},
+                                      b0.data());
+    auto p = c_builder.CreateConstant("p0", Type{DataType::INT32, {4, 2}},
+                                      p0.data());
+
+    IRBuilder ir_builder(bb);
+    TransposeInst* t0 = ir_builder.CreateTranspose("t0", {*input});
+    t0->SetPermutation(nhwc2nchw);
+    Instruction* add = ir_builder.CreateAdd("add", *t0, *b);
+    Instruction* relu = ir_builder.CreateRelu("relu", *add);
+    ConcatInst* concat = ir_builder.CreateConcat("concat", {*relu, *relu});
+    concat->SetAxis(1);
+    concat->SetN(2);
+    Instruction* pad = ir_builder.CreatePad("pad", {*concat, *p});
+    TransposeInst* t1 = ir_builder.CreateTranspose("t1", {*pad});
+    t1->SetPermutation(nchw2nhwc);
+    ir_builder.CreateReturn("ret", *t1);
+  }
+
+  // The reduced result is smaller than the input, so it is transposed
+  // instead.
+  {
+    Function* func = func_builder.CreateFunction("func1");
+    ArgumentBuilder arg_builder(func);
+    auto input = arg_builder.CreateArgument(
+        "input", Type{DataType::FLOAT32, {1, 4, 4, 2}});
+
+    BasicBlockBuilder bb_builder(func);
+    BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+    IRBuilder ir_builder(bb);
+    TransposeInst* t0 = ir_builder.CreateTranspose("t0", {*input});
+    t0->SetPermutation(nhwc2nchw);
+    ReduceMeanInst* mean = ir_builder.CreateReduceMean("mean", {*t0});
+    mean->SetAxis({2, 3});
+    ir_builder.CreateReturn("ret", *mean);
+  }
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  pm.AddPass<LayoutAssignment>();
+  pm.AddPass<DCE>();
+  pm.Run(&m);
+
+  m.Dump();
+
+  // clang-format off
+  // CHECK: Function: func0
+  // CHECK: Constant b0_T([FLOAT32: 1x1x1x2]) = [1, -1]
+  // CHECK: Constant p0_T([INT32: 4x2]) = [0, 0, 1, 1, 2, 2, 0, 0]
+  // CHECK: BasicBlock: bb0
+  // CHECK-NEXT: Inst: add([FLOAT32: 1x4x4x2]) = add(<input, 0>:[FLOAT32: 1x4x4x2], <b0_T, 0>:[FLOAT32: 1x1x1x2])
+  // CHECK-NEXT: Inst: relu([FLOAT32: 1x4x4x2]) = relu(<add, 0>:[FLOAT32: 1x4x4x2])
+  // CHECK-NEXT: Inst: concat([FLOAT32: 1x4x4x4]) = concat(<relu, 0>:[FLOAT32: 1x4x4x2], <relu, 0>:[FLOAT32: 1x4x4x2]) {Attrs: <axis: 3>
+  // CHECK-NEXT: Inst: pad([FLOAT32: 1x6x8x4]) = pad(<concat, 0>:[FLOAT32: 1x4x4x4], <p0_T, 0>:[INT32: 4x2])
+  // CHECK-NEXT: Inst: ret() = return(<pad, 0>:[FLOAT32: 1x6x8x4])
+
+  // CHECK: Function: func1
+  // CHECK: BasicBlock: bb0
+  // CHECK-NEXT: Inst: mean([FLOAT32: 1x1x1x2]) = reducemean(<input, 0>:[FLOAT32: 1x4x4x2]) {Attrs: <axis: [1, 2]>
+  // CHECK-NEXT: Inst: mean_T([FLOAT32: 1x2x1x1]) = transpose(<mean, 0>:[FLOAT32: 1x1x1x2]) {Attrs: <permutation: [0, 3, 1, 2]>}
+  // CHECK-NEXT: Inst: ret() = return(<mean_T, 0>:[FLOAT32: 1x2x1x1])
+  // clang-format on
+}
+
+int main() { build(); }
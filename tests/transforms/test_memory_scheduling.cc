@@ -0,0 +1,69 @@
+// RUN: %cxx %s -o %t %flags %include %link
+// RUN: %t 2>&1| FileCheck %s
+
+#include "halo/lib/ir/ir_builder.h"
+#include "halo/lib/ir/values.h"
+#include "halo/lib/pass/pass_manager.h"
+#include "halo/lib/transforms/memory_scheduling.h"
+#include "halo/lib/transforms/type_legalizer.h"
+
+using namespace halo;
+
+void build() {
+  GlobalContext ctx;
+  Module m(ctx, "test_module");
+
+  FunctionBuilder func_builder(&m);
+
+  Function* func = func_builder.CreateFunction("func");
+
+  ArgumentBuilder arg_builder(func);
+  auto input =
+      arg_builder.CreateArgument("input", Type(DataType::FLOAT32, {256}));
+
+  BasicBlockBuilder bb_builder(func);
+  BasicBlock* bb = bb_builder.CreateBasicBlock("bb0");
+
+  std::vector<int> w0{0};
+
+  ConstantBuilder c_builder(func);
+  auto axis = c_builder.CreateConstant("axis", Type(DataType::INT32, {1}), w0);
+
+  IRBuilder ir_builder(bb);
+
+  // Three 1KB branches reduced to scalars. In this order, all the branches are
+  // alive when the first reduction runs.
+  Instruction* big0 = ir_builder.CreateMul("big0", *input, *input);
+  Instruction* big1 = ir_builder.CreateAdd("big1", *input, *input);
+  Instruction* big2 = ir_builder.CreateSub("big2", *input, *input);
+  Instruction* small0 = ir_builder.CreateReduceMean("small0", *big0, *axis);
+  Instruction* small1 = ir_builder.CreateReduceMean("small1", *big1, *axis);
+  Instruction* small2 = ir_builder.CreateReduceMean("small2", *big2, *axis);
+  Instruction* sum0 = ir_builder.CreateAdd("sum0", *small0, *small1);
+  Instruction* sum1 = ir_builder.CreateAdd("sum1", *sum0, *small2);
+  ir_builder.CreateReturn("ret", *sum1);
+
+  PassManager pm(ctx);
+  pm.AddPass<TypeLegalizer>();
+  pm.AddPass<MemoryScheduling>(true);
+
+  pm.Run(&m);
+
+  m.Dump();
+  // clang-format off
+  // CHECK: Peak Memory of func Before Scheduling: 3076 bytes
+  // CHECK: Peak Memory of func After Scheduling: 1032 bytes
+  // CHECK: BasicBlock: bb0
+  // CHECK-NEXT: Inst: big0
+  // CHECK-NEXT: Inst: small0
+  // CHECK-NEXT: Inst: big1
+  // CHECK-NEXT: Inst: small1
+  // CHECK-NEXT: Inst: sum0
+  // CHECK-NEXT: Inst: big2
+  // CHECK-NEXT: Inst: small2
+  // CHECK-NEXT: Inst: sum1
+  // CHECK-NEXT: Inst: ret
+  // clang-format on
+}
+
+int main() { build(); }
@@ -16,6 +16,8 @@
 // =============================================================================
 
 #include <algorithm>
+#include <set>
+#include <string>
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/Support/CommandLine.h"
@@ -26,18 +28,46 @@
 
 namespace halo {
 
-static void EmitOptions(llvm::raw_ostream* os, llvm::StringRef name) {}
-
 static llvm::StringRef GetDagName(const llvm::DagInit* dag) {
   const llvm::DefInit* def = llvm::cast<llvm::DefInit>(dag->getOperator());
   return def->getDef()->getName();
 }
 
-static void EmitMatcher(llvm::raw_ostream* os, llvm::DagInit* pat,
-                        llvm::StringRef var_name) {
+static bool IsCommutative(const llvm::DagInit* dag) {
+  const llvm::DefInit* def = llvm::cast<llvm::DefInit>(dag->getOperator());
+  return dag->arg_size() == 2 && def->getDef()->getValueAsBit("commutative_");
+}
+
+static int GetNumOfCommutativeNodes(const llvm::DagInit* pat) {
+  int n = IsCommutative(pat) ? 1 : 0;
+  for (const llvm::Init* arg : pat->getArgs()) {
+    if (const auto* dag = llvm::dyn_cast<llvm::DagInit>(arg)) {
+      n += GetNumOfCommutativeNodes(dag);
+    }
+  }
+  return n;
+}
+
+// The state of matching one variant of a pattern.
+struct MatcherState {
+  // Bit i is set if the operands of the i-th commutative node (in pre-order)
+  // are swapped.
+  unsigned swaps = 0;
+  int commutative_nodes = 0;
+  // Names bound to a value so far.
+  std::set<std::string> names;
+  int aliases = 0;
+};
+
+static void EmitMatcher(llvm::raw_ostream* os, const llvm::DagInit* pat,
+                        llvm::StringRef var_name, MatcherState* state) {
   int n = pat->arg_size();
   *os << "  if (!ValidateOpSizeAndCode(" << var_name << ", " << n
       << ", OpCode::" << GetDagName(pat).upper() << ")) {return ret;}\n";
+  bool swap = false;
+  if (IsCommutative(pat)) {
+    swap = ((state->swaps >> state->commutative_nodes++) & 1U) != 0;
+  }
   for (int i = 0; i < n; ++i) {
     llvm::Init* arg = pat->getArg(i);
     std::string op_name;
@@ -51,9 +81,19 @@ static void EmitMatcher(llvm::raw_ostream* os, llvm::DagInit* pat,
     if (op_name.empty()) {
       op_name = var_name.str() + "_op_" + std::to_string(i);
     }
+    int idx = swap ? n - 1 - i : i;
 
-    *os << "  auto " << op_name << " = " << var_name << "->GetOperand(" << i
-        << ");\n";
+    if (state->names.insert(op_name).second) {
+      *os << "  auto " << op_name << " = " << var_name << "->GetOperand("
+          << idx << ");\n";
+    } else {
+      // A name bound more than once must refer to the same value.
+      std::string alias = op_name + "_" + std::to_string(++state->aliases);
+      *os << "  auto " << alias << " = " << var_name << "->GetOperand(" << idx
+          << ");\n";
+      *os << "  if (" << alias << " != " << op_name << ") { return ret;}\n";
+      op_name = alias;
+    }
 
     if (llvm::isa<llvm::DagInit>(arg)) {
       llvm::DagInit* dag = llvm::cast<llvm::DagInit>(arg);
@@ -61,7 +101,7 @@ static void EmitMatcher(llvm::raw_ostream* os, llvm::DagInit* pat,
       *os << "  if (!IsA<Instruction>(" << op_name << ")) { return ret;}\n";
       *os << "  auto " << op_inst << " = DynCast<Instruction>(" << op_name
           << ");\n";
-      EmitMatcher(os, dag, op_inst);
+      EmitMatcher(os, dag, op_inst, state);
     }
   }
 }
@@ -71,35 +111,67 @@ static void EmitMatcher(llvm::raw_ostream* os, const llvm::Record* rec) {
   llvm::DagInit* result = rec->getValueAsDag("result_");
   auto rule_name = rec->getName();
   const std::string var_name = "inst";
+  // One matcher per combination of operand orders of commutative nodes.
+  unsigned variants = 1U << GetNumOfCommutativeNodes(pat);
+  for (unsigned variant = 0; variant < variants; ++variant) {
+    *os << "static std::pair<Def, Def> " << rule_name << "Matcher" << variant
+        << "(Instruction *inst, IRBuilder *builder) {\n";
+    *os << "  std::pair<Def, Def> ret{Def{" << var_name << ", 0}, Def{"
+        << var_name << ", 0}};\n";
+
+    MatcherState state;
+    state.swaps = variant;
+    EmitMatcher(os, pat, var_name, &state);
+    if (auto pred = rec->getValueAsString("predicate_").trim();
+        !pred.empty()) {
+      *os << "  if (!(" << pred << ")) { return ret;}\n";
+    }
+
+    // Create fusion instr.
+    const std::string fused = "fused";
+    *os << "  builder->SetInsertAfter(" << var_name << ");\n";
+    std::string arg_list = "{";
+    for (auto i = result->name_begin(), e = result->name_end(); i != e; ++i) {
+      arg_list += (*i)->getValue().str() + ", ";
+    }
+    arg_list += "}";
+    *os << "  auto " << fused << " = builder->Create" << GetDagName(result)
+        << "(" << var_name << "->GetName() + \"_fused\", " << arg_list
+        << "); \n";
+    if (auto src = rec->getValueAsString("copy_attrs_from_"); !src.empty()) {
+      *os << "  " << fused << "->CopyAttrsFrom(" << src << ");\n";
+    }
+    if (auto attrs = rec->getValueAsString("result_attrs_").trim();
+        !attrs.empty()) {
+      *os << "  " << attrs << "\n";
+    }
+    *os << "  " << fused << "->GetResultsTypes() = inst->GetResultsTypes();";
+    *os << "  ret.second = Def(" << fused << ", 0);\n";
+    *os << "  return ret; \n}\n";
+  }
+
   *os << "static std::pair<Def, Def> " << rule_name
       << "Matcher(Instruction *inst, IRBuilder *builder) {\n";
-  *os << "  std::pair<Def, Def> ret{Def{" << var_name << ", 0}, Def{"
-      << var_name << ", 0}};\n";
-
-  EmitMatcher(os, pat, "inst");
-  //*os << "if ("
-  // Create fusion instr.
-  const std::string fused = var_name + "_fused";
-  *os << "  builder->SetInsertAfter(" << var_name << ");\n";
-  std::string arg_list = "{";
-  for (auto i = result->name_begin(), e = result->name_end(); i != e; ++i) {
-    arg_list += (*i)->getValue().str() + ", ";
+  *os << "  std::pair<Def, Def> ret{Def{inst, 0}, Def{inst, 0}};\n";
+  for (unsigned variant = 0; variant < variants; ++variant) {
+    *os << "  if (ret.first == ret.second) {\n";
+    *os << "    ret = " << rule_name << "Matcher" << variant
+        << "(inst, builder);\n";
+    *os << "  }\n";
   }
-  arg_list += "}";
-  *os << "  auto " << fused << " = builder->Create" << GetDagName(result) << "("
-      << var_name << "->GetName() + \"_fused\", " << arg_list << "); \n";
-  if (auto src = rec->getValueAsString("copy_attrs_from_"); !src.empty()) {
-    *os << "  " << fused << "->CopyAttrsFrom(" << src << ");\n";
-  }
-  *os << "  " << fused << "->GetResultsTypes() = inst->GetResultsTypes();";
-  *os << "  ret.second = Def(" << fused << ", 0);\n";
-  *os << "  return ret; \n}\n";
+  *os << "  return ret;\n}\n";
 }
 
 void EmitFusion(const llvm::RecordKeeper& records, llvm::raw_ostream& os) {
   os << "#ifdef HALO_FUSION_MATCHERS\n";
   std::vector<llvm::Record*> fusions =
       records.getAllDerivedDefinitions("Fusion");
+  // Larger patterns are tried before the patterns they contain.
+  std::stable_sort(fusions.begin(), fusions.end(),
+                   [](const llvm::Record* lhs, const llvm::Record* rhs) {
+                     return lhs->getValueAsInt("benefit_") >
+                            rhs->getValueAsInt("benefit_");
+                   });
   for (auto& rec : fusions) {
     EmitMatcher(&os, rec);
   }
@@ -116,9 +188,15 @@ void EmitFusion(const llvm::RecordKeeper& records, llvm::raw_ostream& os) {
   }
   os << "#endif";
 
+  // Options of the fusions implemented in C++.
+  std::vector<llvm::Record*> all_fusions = fusions;
+  for (auto& rec : records.getAllDerivedDefinitions("CustomFusion")) {
+    all_fusions.push_back(rec);
+  }
+
   // Emit option member
   os << "\n#ifdef HALO_FUSION_OPTIONS\n";
-  for (auto& rec : fusions) {
+  for (auto& rec : all_fusions) {
     auto rule_name = rec->getName();
     os << "    bool " << rule_name << " = false;\n";
   }
@@ -126,7 +204,7 @@ void EmitFusion(const llvm::RecordKeeper& records, llvm::raw_ostream& os) {
 
   // Emit command line option
   os << "\n#ifdef HALO_FUSION_CMD_OPTIONS_DECL\n";
-  for (auto& rec : fusions) {
+  for (auto& rec : all_fusions) {
     auto rule_name = rec->getName();
     os << "static llvm::cl::opt<bool> Fusion" << rule_name << "(\""
        << rec->getValueAsString("option_name_") << "\",\n";
@@ -135,7 +213,7 @@ void EmitFusion(const llvm::RecordKeeper& records, llvm::raw_ostream& os) {
   }
   os << "static Fusion::Options GetFusionOptions() {\n";
   os << "  Fusion::Options opts;";
-  for (auto& rec : fusions) {
+  for (auto& rec : all_fusions) {
     auto rule_name = rec->getName();
     os << "    opts." << rule_name << " = Fusion" << rule_name << ";\n";
   }
@@ -144,4 +222,4 @@ void EmitFusion(const llvm::RecordKeeper& records, llvm::raw_ostream& os) {
   os << "#endif";
 }
 
-} // namespace halo
\ No newline at end of file
+} // namespace halo